@@ -16,9 +16,42 @@
 
 #include "AST.hpp"
 
+#include <algorithm>
+#include <utility>
+
 // Default implementation for the toString method of the ASTNode base class
 std::string ASTNode::toString() const{ return " ";}
 
+/*=============================  Printing ============================== */
+/**
+* The toString() and toString2() of the expressions with children render the whole
+* subtree with a stack of (expression, part) pairs (see Expr::printPart) instead of
+* calling those of their children, so that printing a deeply nested expression neither
+* overflows the stack nor copies the text of each level into the one above it.
+*/
+static std::string render(const Expr* root, bool typed) {
+   std::string result;
+   std::vector<std::pair<const Expr*, size_t>> stack{{root, 0}};
+   while (!stack.empty()) {
+      auto& [expr, part] = stack.back();
+      if (const Expr* child = expr->printPart(typed, part, result))
+         stack.push_back({child, 0});
+      else
+         stack.pop_back();
+   }
+   return result;
+}
+
+// Ends the text of an expression: 'close', then its type if 'typed'
+static void closeText(bool typed, const char* close, const Type& type, std::string& out) {
+   out += close;
+   if (typed) {
+      out += " : ";
+      out += type.toString();
+   }
+}
+/*====================================================================== */
+
 
 /*=============================  Integers ============================== */
 /**
@@ -50,22 +83,115 @@ std::string IntegerLiteral::toString2() const {
 /**
 * StringLiteral - Represents a string literal in the source program
 */
-StringLiteral::StringLiteral(const std::string &value) : Expr(Type("string")), str(value) {}
+StringLiteral::StringLiteral(std::string_view text, bool escapes) : Expr(Type("string")), text(text), escapes(escapes) {}
+
+static bool isLiteralWhitespace(char c) {
+   return c == ' ' || c == '\t' || c == '\f' || c == '\r';
+}
+
+static int hexValue(char c) {
+   return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+/**
+* Reads the text of a literal as the lexer does: 'plain' gets the runs of characters kept
+* as they are, 'escape' the value and the printed form of each escape and each run of
+* whitespace. Line continuations and NUL characters are dropped. The escapes are complete:
+* the lexer has rejected the others.
+*/
+template <typename Plain, typename Escape>
+static void readLiteral(std::string_view text, Plain plain, Escape escape) {
+   size_t i = 0;
+   while (i < text.size()) {
+      // a run ends at an escape, a NUL, or whitespace other than a single space
+      size_t run = i;
+      for (;; ++i) {
+         i = std::find_if(text.begin() + i, text.end(), [](char c) { return (unsigned char)c <= ' ' || c == '\\'; })
+             - text.begin();
+         if (i == text.size() || text[i] != ' ' || (i + 1 < text.size() && isLiteralWhitespace(text[i + 1])))
+            break;
+      }
+      if (i > run)
+         plain(text.substr(run, i - run));
+      if (i == text.size())
+         break;
+      if (text[i] == '\0') {
+         ++i;
+         continue;
+      }
+      if (text[i] != '\\') {
+         while (i < text.size() && isLiteralWhitespace(text[i]))
+            ++i;
+         escape(' ', " ");
+         continue;
+      }
+      switch (text[i + 1]) {
+      case '\n':
+         for (i += 2; i < text.size() && isLiteralWhitespace(text[i]); ++i) {}
+         continue;
+      case 'x':
+         escape(char(hexValue(text[i + 2]) * 16 + hexValue(text[i + 3])), text.substr(i, 4));
+         i += 4;
+         continue;
+      case '"': escape('"', "\\x22"); break;
+      case 'b': escape('\b', "\\x08"); break;
+      case 't': escape('\t', "\\x09"); break;
+      case 'n': escape('\n', "\\x0a"); break;
+      case 'r': escape('\r', "\\x0d"); break;
+      default: escape('\\', "\\x5c"); break;
+      }
+      i += 2;
+   }
+}
 
 /**
-* Returns the stored string value
+* Appends the string as printed, with the \xhh escapes of the lexer
 */
+void StringLiteral::appendString(std::string_view text, bool escapes, std::string& out) {
+   if (!escapes) {
+      out += text;
+      return;
+   }
+   readLiteral(text, [&](std::string_view run) { out += run; }, [&](char, std::string_view form) { out += form; });
+}
+
 std::string StringLiteral::getString() const {
-   return str;
+   std::string printed;
+   appendString(text, escapes, printed);
+   return printed;
+}
+
+/**
+* Returns the characters of the string, escapes decoded
+*/
+std::string StringLiteral::getValue() const {
+   if (!escapes)
+      return std::string(text);
+   std::string value;
+   value.reserve(text.size());
+   readLiteral(text, [&](std::string_view run) { value += run; },
+               [&](char character, std::string_view) { value += character; });
+   return value;
 }
 
 /**
 * Returns the string representation
 */
 std::string StringLiteral::toString() const {
-   return "\"" + str + "\"";
+   return "\"" + getString() + "\"";
 }std::string StringLiteral::toString2() const {
-   return "\"" + str + "\""  + " : " + type.toString();
+   return "\"" + getString() + "\""  + " : " + type.toString();
+}
+
+/**
+* Prints the string straight into the text of the tree
+*/
+const Expr* StringLiteral::printPart(bool typed, size_t& part, std::string& out) const {
+   (void) part;
+   out += '"';
+   appendString(text, escapes, out);
+   closeText(typed, "\"", type, out);
+   return nullptr;
 }
 /*==================================================================== */
 
@@ -132,11 +258,39 @@ Expr* BinaryOperation::getRight() const {
 * Returns a string representation of the binary operation in the AST
 */
 std::string BinaryOperation::toString() const {
-   return "BinOp(" + op +", " + left->toString() + ", " + right->toString() + ")";
+   return render(this, false);
 }
 
 std::string BinaryOperation::toString2() const {
-   return "BinOp(" + op +", " + left->toString2() + ", " + right->toString2() + ") : " + type.toString();
+   return render(this, true);
+}
+
+BinaryOperation::~BinaryOperation() { release(left); release(right); }
+
+/**
+* Prints the binary operation up to its operand number 'part'
+*/
+const Expr* BinaryOperation::printPart(bool typed, size_t& part, std::string& out) const {
+   switch (part++) {
+   case 0:
+      out += "BinOp(";
+      out += op;
+      out += ", ";
+      return left.get();
+   case 1:
+      out += ", ";
+      return right.get();
+   default:
+      closeText(typed, ")", type, out);
+      return nullptr;
+   }
+}
+
+/**
+* Returns the operand slots, left first
+*/
+std::vector<std::unique_ptr<Expr>*> BinaryOperation::getChildren() {
+   return {&left, &right};
 }
 /*====================================================================== */
 
@@ -155,14 +309,36 @@ Conditional::Conditional(std::unique_ptr<Expr> cond_expr, std::unique_ptr<Expr>
 * Returns a string representation of the conditional expression in the AST
 */
 std::string Conditional::toString() const {
-   return "If(" + cond_expr->toString() + ", " + then_expr->toString() + (has_else ? ", " + else_expr->toString() : "") + ")";
+   return render(this, false);
 }
 
 std::string Conditional::toString2() const {
-   return "If(" + cond_expr->toString2() + ", " 
-         + then_expr->toString2() 
-         + (has_else ? ", " + else_expr->toString2() : "") 
-         + ") : " + type.toString();
+   return render(this, true);
+}
+
+Conditional::~Conditional() { release(cond_expr); release(then_expr); release(else_expr); }
+
+/**
+* Prints the conditional up to its sub-expression number 'part'
+*/
+const Expr* Conditional::printPart(bool typed, size_t& part, std::string& out) const {
+   switch (part++) {
+   case 0:
+      out += "If(";
+      return cond_expr.get();
+   case 1:
+      out += ", ";
+      return then_expr.get();
+   case 2:
+      if (has_else) {
+         out += ", ";
+         return else_expr.get();
+      }
+      // fall through
+   default:
+      closeText(typed, ")", type, out);
+      return nullptr;
+   }
 }
 
 /**
@@ -185,6 +361,13 @@ Expr* Conditional::getThen_expr() const {
 Expr* Conditional::getElse_expr() const {
    return else_expr.get();
 }
+
+/**
+* Returns the condition and branch slots
+*/
+std::vector<std::unique_ptr<Expr>*> Conditional::getChildren() {
+   return {&cond_expr, &then_expr, &else_expr};
+}
 /*====================================================================== */
 
 /*=============================  While ============================== */
@@ -200,11 +383,30 @@ WhileLoop::WhileLoop(std::unique_ptr<Expr> cond_expr, std::unique_ptr<Expr> body
 * Returns a string representation of the while loop in the AST
 */
 std::string WhileLoop::toString() const {
-   return "While(" + cond_expr->toString() + ", " + body_expr->toString() + ")";
+   return render(this, false);
 }
 
 std::string WhileLoop::toString2() const {
-   return "While(" + cond_expr->toString2() + ", " + body_expr->toString2() + ") : " + type.toString();
+   return render(this, true);
+}
+
+WhileLoop::~WhileLoop() { release(cond_expr); release(body_expr); }
+
+/**
+* Prints the loop up to its sub-expression number 'part'
+*/
+const Expr* WhileLoop::printPart(bool typed, size_t& part, std::string& out) const {
+   switch (part++) {
+   case 0:
+      out += "While(";
+      return cond_expr.get();
+   case 1:
+      out += ", ";
+      return body_expr.get();
+   default:
+      closeText(typed, ")", type, out);
+      return nullptr;
+   }
 }
 
 /**
@@ -221,6 +423,13 @@ Expr* WhileLoop::getBody_expr() const {
    return body_expr.get();
 }
 
+/**
+* Returns the condition and body slots
+*/
+std::vector<std::unique_ptr<Expr>*> WhileLoop::getChildren() {
+   return {&cond_expr, &body_expr};
+}
+
 /*====================================================================== */
 
 /*============================= Formal =================================*/
@@ -274,57 +483,49 @@ void Block::addExpr(std::unique_ptr<Expr> expr) {
    exprs.push_back(std::move(expr));
 }
 
+/**
+* Returns the slots of the expressions of the block
+*/
+std::vector<std::unique_ptr<Expr>*> Block::getChildren() {
+   std::vector<std::unique_ptr<Expr>*> children;
+   children.reserve(exprs.size());
+   for (auto& expr : exprs)
+       children.push_back(&expr);
+   return children;
+}
+
 /**
 * Returns a string representation of the block
 */
 std::string Block::toString() const {
-   std::string result;
-   if (exprs.size() > 0)
-       result = "\n\t[";
-   else
-       result = "[";    
-   
-   int E_size = exprs.size();
-   int cpt = 0;
-
-   for (const auto& expr : exprs) {
-       if (expr) {
-           result += expr->toString();
-           cpt++;
-       } else {
-           result += "null";
-       }
-       if (E_size - cpt > 0)
-           result += ", ";
-       
-   }
-   result += "]";
-   return result;
+   return render(this, false);
 }
 
 std::string Block::toString2() const {
-   std::string result;
-   if (exprs.size() > 0)
-       result = "\n\t[";
-   else
-       result = "[";    
-   
-   int E_size = exprs.size();
-   int cpt = 0;
+   return render(this, true);
+}
 
-   for (const auto& expr : exprs) {
-       if (expr) {
-           result += expr->toString2();
-           cpt++;
-       } else {
-           result += "null";
-       }
-       if (E_size - cpt > 0)
-           result += ", ";
-       
+Block::~Block() { for (auto& expr : exprs) release(expr); }
+
+/**
+* Prints the block up to its expression number 'part'. A null expression prints
+* as "null" and, as it is not counted, leaves a separator after the last one
+*/
+const Expr* Block::printPart(bool typed, size_t& part, std::string& out) const {
+   if (part == 0)
+      out += exprs.size() > 0 ? "\n\t[" : "[";
+   while (part < exprs.size()) {
+      if (part > 0)
+         out += ", ";
+      const Expr* expr = exprs[part++].get();
+      if (expr)
+         return expr;
+      out += "null";
    }
-   result += "] : " + type.toString();
-   return result;
+   if (std::find(exprs.begin(), exprs.end(), nullptr) != exprs.end())
+      out += ", ";
+   closeText(typed, "]", type, out);
+   return nullptr;
 }
 
 /*====================================================================== */
@@ -333,6 +534,17 @@ std::string Block::toString2() const {
 /**
 * MethodNode - Represents a method definition in a class
 */
+std::unique_ptr<Block> (*MethodNode::parseBody)(const SourceRange& body) = nullptr;
+
+/**
+* Returns the body, parsing it first if the parser left it
+*/
+Block* MethodNode::getBlock() const {
+   if (!bloc && body.length && parseBody)
+      bloc = parseBody(body);
+   return bloc.get();
+}
+
 std::string MethodNode::toString() const {
    std::string paramStr = "[";
    for (size_t i = 0; i < formals.size(); ++i) {
@@ -340,7 +552,7 @@ std::string MethodNode::toString() const {
        if (i != formals.size() - 1) paramStr += ", ";
    }
    paramStr += "]";
-   return "Method(" + name + ", " + paramStr + ", " + returnType.toString() + ", " + bloc->toString() + ")";
+   return "Method(" + name + ", " + paramStr + ", " + returnType.toString() + ", " + getBlock()->toString() + ")";
 }
 
 std::string MethodNode::toString2() const {
@@ -350,7 +562,7 @@ std::string MethodNode::toString2() const {
        if (i != formals.size() - 1) paramStr += ", ";
    }
    paramStr += "]";
-   return "Method(" + name + ", " + paramStr + ", " + returnType.toString2() + ", " + bloc->toString2() + ")";
+   return "Method(" + name + ", " + paramStr + ", " + returnType.toString2() + ", " + getBlock()->toString2() + ")";
 }
 
 /*====================================================================== */
@@ -361,6 +573,31 @@ std::string MethodNode::toString2() const {
 */
 std::string Expr::toString() const { return " ";}
 
+/**
+* The release() that finds no worklist creates it and drains it: destroying a node found
+* there only moves its own children to the worklist, and so on. Each thread has its own
+* worklist, as trees may be released on several threads at once.
+*/
+static thread_local std::vector<std::unique_ptr<Expr>>* releasedExprs = nullptr;
+
+void Expr::release(std::unique_ptr<Expr>& child) {
+   if (!child)
+      return;
+   if (releasedExprs) {
+      releasedExprs->push_back(std::move(child));
+      return;
+   }
+   std::vector<std::unique_ptr<Expr>> worklist;
+   releasedExprs = &worklist;
+   worklist.push_back(std::move(child));
+   while (!worklist.empty()) {
+      std::unique_ptr<Expr> expr = std::move(worklist.back());
+      worklist.pop_back();
+      expr.reset();
+   }
+   releasedExprs = nullptr;
+}
+
 /*============================================================================ */
 /*=========================== Type =========================================== */
 /**
@@ -399,17 +636,41 @@ Let::Let(std::string n, Type t, unsigned int column, unsigned int line, std::uni
 * Returns a string representation of the let expression
 */
 std::string Let::toString() const {
-   return init_expr ?
-   "Let(" + name + ", " + type.toString() + ", " + init_expr->toString() + ", " + scope_expr->toString() + ")"
-   :
-   "Let(" + name + ", " + type.toString() + ", " + scope_expr->toString() + ")";
+   return render(this, false);
 }
 
 std::string Let::toString2() const {
-   return init_expr ? 
-   "Let(" + name + ", " + type.toString2() + ", " + init_expr->toString2() + ", " + scope_expr->toString2() + ") : " + getTypeName()
-   :
-   "Let(" + name + ", " + type.toString() + ", " + scope_expr->toString2() + ") : " + getTypeName() ;
+   return render(this, true);
+}
+
+Let::~Let() { release(init_expr); release(scope_expr); }
+
+/**
+* Prints the let up to its initializer ('part' 0) or scope
+*/
+const Expr* Let::printPart(bool typed, size_t& part, std::string& out) const {
+   switch (part++) {
+   case 0:
+      out += "Let(";
+      out += name;
+      out += ", ";
+      out += type.toString();
+      out += ", ";
+      if (init_expr)
+         return init_expr.get();
+      part++;
+      return scope_expr.get();
+   case 1:
+      out += ", ";
+      return scope_expr.get();
+   default:
+      out += ")";
+      if (typed) {
+         out += " : ";
+         out += getTypeName();
+      }
+      return nullptr;
+   }
 }
 
 /**
@@ -440,6 +701,15 @@ Expr* Let::getScopeExpr() const {
    return scope_expr.get();
 }
 
+/**
+* Returns the initializer (if any) and scope slots
+*/
+std::vector<std::unique_ptr<Expr>*> Let::getChildren() {
+   if (init_expr)
+       return {&init_expr, &scope_expr};
+   return {&scope_expr};
+}
+
 /*==================================================================================== */
 
 /*============================== Assign ============================================ */
@@ -463,14 +733,37 @@ Expr* Assign::getExpr() const{
    return expr.get();
 }
 
+/**
+* Returns the slot of the assigned expression
+*/
+std::vector<std::unique_ptr<Expr>*> Assign::getChildren() {
+   return {&expr};
+}
+
 /**
 * Returns a string representation of the assignment
 */
 std::string Assign::toString() const {
-   return "Assign(" + name + ", " + expr->toString() + ")";
+   return render(this, false);
 }
 std::string Assign::toString2() const {
-   return "Assign(" + name + ", " + expr->toString2() + ") : " + type.toString();
+   return render(this, true);
+}
+
+Assign::~Assign() { release(expr); }
+
+/**
+* Prints the assignment up to the assigned expression
+*/
+const Expr* Assign::printPart(bool typed, size_t& part, std::string& out) const {
+   if (part++ == 0) {
+      out += "Assign(";
+      out += name;
+      out += ", ";
+      return expr.get();
+   }
+   closeText(typed, ")", type, out);
+   return nullptr;
 }
 /* ================================================================================== */
 
@@ -484,11 +777,27 @@ UnOp::UnOp(std::string oper, std::unique_ptr<Expr> expr): op(std::move(oper)), e
 * Returns a string representation of the unary operation
 */
 std::string UnOp::toString() const {
-   return "UnOp(" + op + ", " + expr->toString() + ")"; 
+   return render(this, false);
 }
 
 std::string UnOp::toString2() const {
-   return "UnOp(" + op + ", " + expr->toString2() + ") : " + type.toString(); 
+   return render(this, true);
+}
+
+UnOp::~UnOp() { release(expr); }
+
+/**
+* Prints the unary operation up to its operand
+*/
+const Expr* UnOp::printPart(bool typed, size_t& part, std::string& out) const {
+   if (part++ == 0) {
+      out += "UnOp(";
+      out += op;
+      out += ", ";
+      return expr.get();
+   }
+   closeText(typed, ")", type, out);
+   return nullptr;
 }
 
 /**
@@ -505,6 +814,13 @@ Expr* UnOp::getExpr(){
    return expr.get();
 }
 
+/**
+* Returns the slot of the operand
+*/
+std::vector<std::unique_ptr<Expr>*> UnOp::getChildren() {
+   return {&expr};
+}
+
 /* ================================================================================== */
 
 /* ============================ Call =============================================== */
@@ -528,23 +844,35 @@ std::string Call::getMethodName() const {
 * Returns a string representation of the method call
 */
 std::string Call::toString() const {
-   std::string result = "Call(" + exprobject_ident->toString() + ", " + method_name + ", [";
-   for (size_t i = 0; i < args.size(); ++i) {
-       result += args[i]->toString();
-       if (i != args.size() - 1) result += ", ";
-   }
-   result += "])";
-   return result;
+   return render(this, false);
 }
 
 std::string Call::toString2() const {
-   std::string result = "Call(" + exprobject_ident->toString2() + ", " + method_name + ", [";
-   for (size_t i = 0; i < args.size(); ++i) {
-       result += args[i]->toString2();
-       if (i != args.size() - 1) result += ", ";
+   return render(this, true);
+}
+
+Call::~Call() { release(exprobject_ident); for (auto& arg : args) release(arg); }
+
+/**
+* Prints the call up to its receiver ('part' 0) or argument number 'part' - 1
+*/
+const Expr* Call::printPart(bool typed, size_t& part, std::string& out) const {
+   size_t arg = part++;
+   if (arg == 0) {
+      out += "Call(";
+      return exprobject_ident.get();
    }
-   result += "]) : " + type.toString();
-   return result;
+   if (arg == 1) {
+      out += ", ";
+      out += method_name;
+      out += ", [";
+   } else if (arg <= args.size()) {
+      out += ", ";
+   }
+   if (arg <= args.size())
+      return args[arg - 1].get();
+   closeText(typed, "])", type, out);
+   return nullptr;
 }
 
 std::string Call::getClassName() const {
@@ -557,6 +885,18 @@ std::vector<std::unique_ptr<Expr>>& Call::getArgs() {
    return args;
 }
 
+/**
+* Returns the receiver slot followed by the argument slots
+*/
+std::vector<std::unique_ptr<Expr>*> Call::getChildren() {
+   std::vector<std::unique_ptr<Expr>*> children;
+   children.reserve(args.size() + 1);
+   children.push_back(&exprobject_ident);
+   for (auto& arg : args)
+       children.push_back(&arg);
+   return children;
+}
+
 /* =========================== Field Node =========================================== */
 
 /* =============================  ObjectIdentifier ================================== */
@@ -679,65 +1019,39 @@ Type FieldNode::getType() const {
 * ClassNode - Represents a class definition
 */
 std::string ClassNode::toString() const {
-   int cpt = 0;
-   int f_size = fields.size();
-   int m_size = methods.size();
-   // std::cout << "Fiels : " << fields.size() << std::endl;
-   std::string result = "Class(" + name + ", " + parent + ", [";
-   
-   for (auto it = fields.rbegin(); it != fields.rend(); ++it ){
-       cpt++;
-       result += (*it)->toString();
-       if(f_size-cpt>0)
-           result += ", ";
-   }
-
-   if(m_size) result += "], \n\t[";
-   else result += "], [";
-
-   cpt = 0;
+   std::string result;
+   appendHead(result, false);
    for (auto it = methods.rbegin(); it != methods.rend(); ++it) {
-       cpt++;
+       if (it != methods.rbegin())
+           result += methodSeparator;
        result += (*it)->toString();
-       if(m_size - cpt>0)
-           result += ", ";
    }
-   result += "])";
-   
-   // std::cout<< "# methods : " << methods.size() << std::endl;
+   result += end;
    return result;
 }
 
 std::string ClassNode::toString2() const {
-   int cpt = 0;
-   int f_size = fields.size();
-   int m_size = methods.size();
-   // std::cout << "Fiels : " << fields.size() << std::endl;
-   std::string result = "Class(" + name + ", " + parent + ", [";
-   
-   for (auto it = fields.rbegin(); it != fields.rend(); ++it ){
-       cpt++;
-       result += (*it)->toString2();
-       if(f_size-cpt>0)
-           result += ", ";
-   }
-
-   if(m_size) result += "], \n\t[";
-   else result += "], [";
-
-   cpt = 0;
+   std::string result;
+   appendHead(result, true);
    for (auto it = methods.rbegin(); it != methods.rend(); ++it) {
-       cpt++;
+       if (it != methods.rbegin())
+           result += methodSeparator;
        result += (*it)->toString2();
-       if(m_size - cpt>0)
-           result += ", ";
    }
-   result += "])";
-   
-   // std::cout<< "# methods : " << methods.size() << std::endl;
+   result += end;
    return result;
 }
 
+void ClassNode::appendHead(std::string& out, bool typed) const {
+   out += "Class(" + name + ", " + parent + ", [";
+   for (auto it = fields.rbegin(); it != fields.rend(); ++it) {
+       if (it != fields.rbegin())
+           out += ", ";
+       out += typed ? (*it)->toString2() : (*it)->toString();
+   }
+   out += methods.empty() ? "], [" : "], \n\t[";
+}
+
 /**
 * Constructor for ClassNode
 */
@@ -856,38 +1170,39 @@ std::vector<std::unique_ptr<ClassNode>>& Program::getClasses(){
 * Returns a string representation of the entire program
 */
 std::string Program::toString() const {
-   int cpt = 1;
-   int C_size = classes.size();
    std::string str = "[";
-   for (const auto& cls : classes)
-   {
-       cpt++;
-       if (cls->name == "Object") continue;
-       str += cls->toString();
-       if (C_size - cpt > 0) str += ", \n";
-       
+   for (size_t i = 0; i < classes.size(); ++i) {
+       if (!isPrinted(*classes[i]))
+           continue;
+       str += classes[i]->toString();
+       if (isSeparated(i, classes.size()))
+           str += classSeparator;
    }
    str += "]";
-   return str;  
+   return str;
 }
 
 std::string Program::toString2() const {
-   int cpt = 1;
-   int C_size = classes.size();
    std::string str = "[";
-   for (const auto& cls : classes)
-   {
-       cpt++;
-       if (cls->name == "Object") continue;
-       str += cls->toString2();
-       if (C_size - cpt > 0) str += ", \n";
-       
+   for (size_t i = 0; i < classes.size(); ++i) {
+       if (!isPrinted(*classes[i]))
+           continue;
+       str += classes[i]->toString2();
+       if (isSeparated(i, classes.size()))
+           str += classSeparator;
    }
    str += "]";
-   return str;  
+   return str;
 }
 /* ====================================================================================== */
 
+/*=============================== Errors ================================= */
+/**
+* Set by --lsp: the lexical and syntax errors are thrown as CompileError
+*/
+bool throwCompileErrors = false;
+/* ====================================================================================== */
+
 /*========================================================================= *
 * ========================= HERE WE FINISH ================================ *
 * ========================================================================= */
\ No newline at end of file
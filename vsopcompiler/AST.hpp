@@ -18,6 +18,7 @@
 
 #include <iostream>
 #include <memory>
+#include <string_view>
 #include <vector>
 #include <algorithm>
 
@@ -52,8 +53,11 @@ class ASTNode {
     public:
         ASTNode() : column(0), line(0) {};
         ASTNode(unsigned int column, unsigned int line) : column(column), line(line) {};
+        virtual ~ASTNode() = default;
         unsigned int getColumn() const { return column; };
         unsigned int getLine() const { return line; };
+        void setColumn(unsigned int col) { column = col; };
+        void setLine(unsigned int yyline) { line = yyline; };
         virtual std::string toString() const = 0; // Method to be overridden
         virtual std::string toString2() const = 0; // Method to be overridden
 };
@@ -83,7 +87,33 @@ class Expr {
         unsigned int getLine() const { return line; };
         void setColumn(unsigned int col) { column = col; };
         void setLine(unsigned int yyline) { line = yyline; };
-    
+
+        /**
+         * Returns the slots holding the direct sub-expressions, in evaluation order.
+         * Passes use them to walk or rewrite the tree without one dynamic_cast per node kind.
+         */
+        virtual std::vector<std::unique_ptr<Expr>*> getChildren() { return {}; };
+
+        /**
+         * Appends to 'out' the text of toString() (toString2() if 'typed') that comes
+         * before the sub-expression number 'part', advances 'part' and returns that
+         * sub-expression, unprinted; past the last one, appends the end of the text and
+         * returns nullptr. Expressions without children print themselves whole. Lets
+         * toString() print nested expressions without recursion.
+         */
+        virtual const Expr* printPart(bool typed, size_t& part, std::string& out) const {
+            (void) part;
+            out += typed ? toString2() : toString();
+            return nullptr;
+        };
+
+    protected:
+        /**
+         * Destroys the sub-expression in 'child', for the destructors of the nodes that
+         * have children. It is detached and deleted from a worklist rather than by its
+         * destructor in turn, so that the depth of a tree is not limited by the stack.
+         */
+        static void release(std::unique_ptr<Expr>& child);
 };
 
 /*=============================  Integers ============================== */
@@ -105,17 +135,26 @@ class IntegerLiteral : public Expr {
 
 /*=============================  Strings ============================== */
 /**
- * StringLiteral - Represents a string
+ * StringLiteral - Represents a string, by its characters between the quotes in the
+ * program text (which outlives the AST): the lexer copies nothing. With escapes (or
+ * whitespace that the lexer rewrites), they are encoded only when printed and decoded
+ * only when evaluated.
  */
 class StringLiteral : public Expr {
     public:
-        StringLiteral(const std::string &value);
-        StringLiteral(const std::string &value, unsigned int column, unsigned int line) : Expr(Type("string"),column, line), str(value) {};
-        std::string getString() const;
+        StringLiteral(std::string_view text, bool escapes);
+        std::string getString() const; // as printed: \xhh escapes, one space per run of whitespace
+        std::string getValue() const;  // the characters of the string
+        std::string_view getText() const { return text; }
+        bool hasEscapes() const { return escapes; }
+        // Appends the characters 'text' of a literal as printed, as getString()
+        static void appendString(std::string_view text, bool escapes, std::string& out);
         std::string toString() const override;
         std::string toString2() const override;
+        const Expr* printPart(bool typed, size_t& part, std::string& out) const override;
     private:
-        std::string str;
+        std::string_view text;
+        bool escapes;
 };
 /*====================================================================== */
 
@@ -143,11 +182,14 @@ class BinaryOperation : public Expr {
     public:
         BinaryOperation(const std::string &op, std::unique_ptr<Expr> left, std::unique_ptr<Expr> right);
         BinaryOperation(const std::string &op, std::unique_ptr<Expr> left, std::unique_ptr<Expr> right, unsigned int column, unsigned int line);
+        ~BinaryOperation() override;
         std::string getOperator() const;
         Expr* getLeft() const;
         Expr* getRight() const;
         std::string toString() const override;
         std::string toString2() const override;
+        std::vector<std::unique_ptr<Expr>*> getChildren() override;
+        const Expr* printPart(bool typed, size_t& part, std::string& out) const override;
     private:
         std::string op;
         std::unique_ptr<Expr> left;
@@ -163,12 +205,17 @@ class Conditional : public Expr {
     public:
         Conditional(std::unique_ptr<Expr> cond_expr, std::unique_ptr<Expr> then_expr, std::unique_ptr<Expr> else_expr );
         Conditional(std::unique_ptr<Expr> cond_expr, std::unique_ptr<Expr> then_expr);
+        ~Conditional() override;
         std::string toString() const override;
         std::string toString2() const override;
+        std::vector<std::unique_ptr<Expr>*> getChildren() override;
+        const Expr* printPart(bool typed, size_t& part, std::string& out) const override;
 
         Expr* getCond_expr() const;
         Expr* getThen_expr() const;
         Expr* getElse_expr() const;
+        bool hasElse() const { return has_else; };
+        void setHasElse(bool value) { has_else = value; };
 
     private:
         std::unique_ptr<Expr> cond_expr; /**< Pointer to the condition expression. */
@@ -185,8 +232,11 @@ class Conditional : public Expr {
 class WhileLoop : public Expr {
     public:
         WhileLoop(std::unique_ptr<Expr> cond_expr, std::unique_ptr<Expr> body_expr);
+        ~WhileLoop() override;
         std::string toString() const override;
         std::string toString2() const override;
+        std::vector<std::unique_ptr<Expr>*> getChildren() override;
+        const Expr* printPart(bool typed, size_t& part, std::string& out) const override;
 
         Expr* getCond_expr() const;
         Expr* getBody_expr() const;
@@ -205,8 +255,11 @@ class Block : public Expr {
     public:
         Block() = default;
         Block(std::vector<std::unique_ptr<Expr>> exprs);
+        ~Block() override;
         std::string toString() const override;
         std::string toString2() const override;
+        std::vector<std::unique_ptr<Expr>*> getChildren() override;
+        const Expr* printPart(bool typed, size_t& part, std::string& out) const override;
         void addExpr(std::unique_ptr<Expr> expr);
         std::vector<std::unique_ptr<Expr>>& getExprs();
 
@@ -243,8 +296,11 @@ class Let : public Expr {
     public:
         Let(std::string n, Type t, std::unique_ptr<Expr> expr = nullptr, std::unique_ptr<Expr> scope = nullptr);
         Let(std::string n, Type t, unsigned int column, unsigned int line, std::unique_ptr<Expr> expr = nullptr, std::unique_ptr<Expr> scope = nullptr);
+        ~Let() override;
         std::string toString() const override;
         std::string toString2() const override;
+        std::vector<std::unique_ptr<Expr>*> getChildren() override;
+        const Expr* printPart(bool typed, size_t& part, std::string& out) const override;
         std::string getName() const;
         Type getType() const;
         Expr* getInitExpr() const;
@@ -266,10 +322,13 @@ class Assign : public Expr{
     public:
         Assign(std::string n, std::unique_ptr<Expr> expr = nullptr);
         Assign(std::string n, unsigned int column, unsigned int line,std::unique_ptr<Expr> expr = nullptr);
+        ~Assign() override;
         std::string getName();
         Expr* getExpr() const;
         std::string toString() const override;
         std::string toString2() const override;
+        std::vector<std::unique_ptr<Expr>*> getChildren() override;
+        const Expr* printPart(bool typed, size_t& part, std::string& out) const override;
 
     private:
         std::string name;
@@ -284,8 +343,11 @@ class Assign : public Expr{
 class UnOp : public Expr {
     public:
         UnOp(std::string op, std::unique_ptr<Expr> expr);
+        ~UnOp() override;
         std::string toString() const override;
         std::string toString2() const override;
+        std::vector<std::unique_ptr<Expr>*> getChildren() override;
+        const Expr* printPart(bool typed, size_t& part, std::string& out) const override;
         std::string getOp();
         Expr* getExpr();
 
@@ -304,17 +366,24 @@ class Call : public Expr {
         Call(std::string n, std::vector<std::unique_ptr<Expr>> args, std::unique_ptr<Expr> exprobject_ident);
         Call(std::string n, std::vector<std::unique_ptr<Expr>> args, std::unique_ptr<Expr> exprobject_ident, 
             unsigned int column, unsigned int line);
+        ~Call() override;
         std::string toString() const override;
         std::string toString2() const override ;
+        std::vector<std::unique_ptr<Expr>*> getChildren() override;
+        const Expr* printPart(bool typed, size_t& part, std::string& out) const override;
         std::string getMethodName() const;
         std::vector<std::unique_ptr<Expr>>& getArgs();
         std::string getClassName() const;
         Expr* getExprObjectIdentifier() const {return exprobject_ident.get(); };
+        // Index of the call site in the tables of the interpreter, 0 until it is given one
+        unsigned int getSiteId() const { return site_id; };
+        void setSiteId(unsigned int id) { site_id = id; };
 
     private:
         std::string method_name;
         std::vector<std::unique_ptr<Expr>> args;
         std::unique_ptr<Expr> exprobject_ident;
+        unsigned int site_id = 0;
 };
 /* ====================================================================== */
 
@@ -406,11 +475,27 @@ class Parenthesis : public Expr {
  * MethodNode - Represents a method definition in a class
  */
 class MethodNode : public ASTNode {
+    public:
+        /**
+         * SourceRange - Where a body left unparsed is in the program text, from its '{'
+         * to its '}', and the position of that '{'
+         */
+        struct SourceRange {
+            unsigned int offset = 0;
+            unsigned int length = 0;
+            unsigned int line = 0;
+            unsigned int column = 0;
+        };
+
+        // Parses a body left unparsed (set by the parser, which skips bodies for an outline)
+        static std::unique_ptr<Block> (*parseBody)(const SourceRange& body);
+
     private:
         std::string name;
         Type returnType;
         std::vector<std::unique_ptr<Formal>> formals;
-        std::unique_ptr<Block> bloc;
+        mutable std::unique_ptr<Block> bloc; // parsed on demand when the parser left 'body'
+        SourceRange body;
     
     public:
         /**
@@ -444,6 +529,15 @@ class MethodNode : public ASTNode {
             unsigned int column, unsigned int line)
             : ASTNode(column, line), name(std::move(n)), returnType(std::move(rt)), bloc(std::move(b)) {}
 
+        /**
+         * Constructor for a method whose body is parsed the first time it is needed
+         * @param body Where the body is in the program text
+         */
+        MethodNode(std::string n, Type rt,
+            std::vector<std::unique_ptr<Formal>> params,
+            const SourceRange& body,
+            unsigned int column, unsigned int line) : ASTNode(column, line),
+            name(std::move(n)), returnType(std::move(rt)), formals(std::move(params)), body(body) {}
 
             
         std::string toString() const override;
@@ -451,7 +545,9 @@ class MethodNode : public ASTNode {
         std::string getName() { return name; };
         Type getReturnType() { return returnType; };
         std::vector<std::unique_ptr<Formal>>& getFormals() { return formals; };
-        Block* getBlock() { return bloc.get(); };
+        Block* getBlock() const;
+        Block* getParsedBlock() const { return bloc.get(); }; // without parsing the body
+        const SourceRange& getBodyRange() const { return body; };
 };
 /*====================================================================== */
 
@@ -501,6 +597,12 @@ class ClassNode : public ASTNode{
 
         std::string toString() const override;
         std::string toString2() const override;
+
+        // The text of toString() (toString2() if 'typed') is the head, with the name, the
+        // parent and the fields, then the methods, with these separators, then the end
+        void appendHead(std::string& out, bool typed) const;
+        static constexpr const char* methodSeparator = ", ";
+        static constexpr const char* end = "])";
 };
 
 /* ============================ Program ================================ */
@@ -521,10 +623,88 @@ class Program : public ASTNode {
         std::string toString() const override;
         std::string toString2() const override;
 
+        // toString() prints the classes but Object, each followed by this separator unless
+        // it is one of the last two of the 'count' classes (the last being Object)
+        static bool isPrinted(const ClassNode& cls) { return cls.name != "Object"; }
+        static bool isSeparated(size_t index, size_t count) { return index + 2 < count; }
+        static constexpr const char* classSeparator = ", \n";
+
     private :
         std::vector<std::unique_ptr<ClassNode>> classes;
 };
 /* ======================================================================== */
+/* ============================ Errors ================================= */
+/**
+ * CompileError - A lexical or syntax error, thrown instead of ending the program when
+ * throwCompileErrors is set (--lsp, where the documents being edited often have one)
+ */
+struct CompileError {
+    unsigned int line;
+    unsigned int column;
+    std::string message; // as printed after the position: "syntax error: ...", ...
+};
+
+extern bool throwCompileErrors;
+/* ======================================================================== */
+/* ============================ Traversals ============================= */
+/**
+ * Calls visit(expr) on 'root' and on every expression below it, parents before their
+ * children and children in the order of getChildren(). Null slots are skipped. Uses an
+ * explicit stack, so it works at any nesting depth.
+ */
+template <typename Visit>
+void forEachExpr(Expr* root, Visit visit) {
+    std::vector<Expr*> pending;
+    if (root)
+        pending.push_back(root);
+    while (!pending.empty()) {
+        Expr* expr = pending.back();
+        pending.pop_back();
+        visit(expr);
+        auto children = expr->getChildren();
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            if (**it)
+                pending.push_back((*it)->get());
+        }
+    }
+}
+
+/**
+ * Calls rewrite(slot) on the slot 'root' and on every slot below it, children before
+ * their parent and in the order of getChildren(); rewrite may replace the expression of
+ * the slot it is given. If 'locals' is given, the names bound by the lets around a slot
+ * are pushed on it during the call (the name of a let is bound in its scope only).
+ * Uses an explicit stack, so it works at any nesting depth.
+ */
+template <typename Rewrite>
+void rewriteBottomUp(std::unique_ptr<Expr>& root, Rewrite rewrite, std::vector<std::string>* locals = nullptr) {
+    struct Frame {
+        std::unique_ptr<Expr>* slot;
+        std::vector<std::unique_ptr<Expr>*> children;
+        size_t next;
+    };
+    std::vector<Frame> frames;
+    if (root)
+        frames.push_back({&root, root->getChildren(), 0});
+    while (!frames.empty()) {
+        Frame& frame = frames.back();
+        Let* let = locals ? dynamic_cast<Let*>(frame.slot->get()) : nullptr;
+        if (frame.next < frame.children.size()) {
+            std::unique_ptr<Expr>* child = frame.children[frame.next++];
+            if (let && frame.next == frame.children.size())
+                locals->push_back(let->getName());
+            if (*child)
+                frames.push_back({child, (*child)->getChildren(), 0});
+            continue;
+        }
+        if (let)
+            locals->pop_back();
+        std::unique_ptr<Expr>* slot = frame.slot;
+        frames.pop_back();
+        rewrite(*slot);
+    }
+}
+/* ======================================================================== */
 #endif //AST_H
 
 /*========================================================================= *
@@ -0,0 +1,213 @@
+// Compiler throughput benchmark: runs vsopc -l, -p, -c and -o over each program of a corpus
+// (see vsopgen.cpp) and reports MB/s, lines/s and the peak RSS of the compiler. Times are
+// the best of --runs runs, the peak RSS the one of that run (from wait4, stdout discarded).
+//
+// With --arg, the option is given to vsopc before the mode (as --parser=descent).
+//
+// With --results, each measurement is appended to a tab-separated file and compared with
+// the last one stored for the same program and mode: a throughput drop or a peak RSS growth
+// of more than 10% is flagged as a regression, and the exit status is then 2.
+//
+// Usage: compile_bench [--runs N] [--results file] [--label text] [--arg option] vsopc program.vsop...
+//        (make bench)
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Measure {
+    double seconds = 0;
+    long peakRssKb = 0;
+};
+
+struct Result {
+    std::string label;
+    std::string program;
+    std::string mode;
+    uint64_t bytes = 0;
+    uint64_t lines = 0;
+    double seconds = 0;
+    double mbPerSecond = 0;
+    double linesPerSecond = 0;
+    long peakRssKb = 0;
+};
+
+const char* resultsHeader = "label\tprogram\tmode\tbytes\tlines\tseconds\tmb_per_s\tlines_per_s\tpeak_rss_kb";
+
+// One run of 'vsopc [arg] mode program'; false if it could not run or failed
+bool runOnce(const char* vsopc, const char* arg, const char* mode, const std::string& program, Measure& measure) {
+    Clock::time_point start = Clock::now();
+    pid_t child = fork();
+    if (child < 0)
+        return false;
+    if (child == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        if (arg)
+            execl(vsopc, vsopc, arg, mode, program.c_str(), static_cast<char*>(nullptr));
+        else
+            execl(vsopc, vsopc, mode, program.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    int status = 0;
+    struct rusage usage;
+    if (wait4(child, &status, 0, &usage) != child)
+        return false;
+    measure.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    measure.peakRssKb = usage.ru_maxrss;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+std::string baseName(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// The last stored result of each (program, mode)
+std::map<std::pair<std::string, std::string>, Result> loadResults(const std::string& path) {
+    std::map<std::pair<std::string, std::string>, Result> last;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line == resultsHeader)
+            continue;
+        std::istringstream fields(line);
+        Result result;
+        std::getline(fields, result.label, '\t');
+        fields >> result.program >> result.mode >> result.bytes >> result.lines >> result.seconds
+               >> result.mbPerSecond >> result.linesPerSecond >> result.peakRssKb;
+        if (fields)
+            last[{result.program, result.mode}] = result;
+    }
+    return last;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int runs = 3;
+    const char* resultsPath = nullptr;
+    const char* arg = nullptr;
+    std::string label = "unlabeled";
+    int i = 1;
+    for (; i + 1 < argc && std::strncmp(argv[i], "--", 2) == 0; i += 2) {
+        if (std::strcmp(argv[i], "--runs") == 0)
+            runs = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--results") == 0)
+            resultsPath = argv[i + 1];
+        else if (std::strcmp(argv[i], "--label") == 0)
+            label = argv[i + 1];
+        else if (std::strcmp(argv[i], "--arg") == 0)
+            arg = argv[i + 1];
+        else
+            break;
+    }
+    if (argc - i < 2 || runs < 1) {
+        std::fprintf(stderr, "Usage: %s [--runs N] [--results file] [--label text] [--arg option] vsopc program.vsop...\n",
+                     argv[0]);
+        return 1;
+    }
+    const char* vsopc = argv[i++];
+
+    std::map<std::pair<std::string, std::string>, Result> previous;
+    if (resultsPath)
+        previous = loadResults(resultsPath);
+
+    std::vector<Result> results;
+    bool regression = false;
+    std::printf("%-18s %4s %9s %9s %9s %9s %11s %10s  %s\n", "program", "mode", "size (MB)", "lines", "time (s)",
+                "MB/s", "lines/s", "peak (MB)", "vs last stored");
+    for (; i < argc; ++i) {
+        std::string program = argv[i];
+        std::ifstream in(program, std::ios::binary);
+        if (!in) {
+            std::fprintf(stderr, "cannot read %s\n", program.c_str());
+            return 1;
+        }
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        uint64_t lines = 0;
+        for (char c : text)
+            lines += c == '\n';
+
+        for (const char* mode : {"-l", "-p", "-c", "-o"}) {
+            Measure best;
+            for (int run = 0; run < runs; ++run) {
+                Measure measure;
+                if (!runOnce(vsopc, arg, mode, program, measure)) {
+                    std::fprintf(stderr, "%s %s %s %s failed\n", vsopc, arg ? arg : "", mode, program.c_str());
+                    return 1;
+                }
+                if (run == 0 || measure.seconds < best.seconds)
+                    best = measure;
+            }
+
+            Result result;
+            result.label = label;
+            result.program = baseName(program);
+            result.mode = mode;
+            result.bytes = text.size();
+            result.lines = lines;
+            result.seconds = best.seconds;
+            result.mbPerSecond = text.size() / 1e6 / best.seconds;
+            result.linesPerSecond = lines / best.seconds;
+            result.peakRssKb = best.peakRssKb;
+
+            std::string comparison = "-";
+            auto it = previous.find({result.program, result.mode});
+            if (it != previous.end() && it->second.mbPerSecond > 0 && it->second.peakRssKb > 0) {
+                double speed = result.mbPerSecond / it->second.mbPerSecond - 1;
+                double memory = static_cast<double>(result.peakRssKb) / it->second.peakRssKb - 1;
+                char text[96];
+                std::snprintf(text, sizeof(text), "%+.1f%% MB/s, %+.1f%% peak (%s)", 100 * speed, 100 * memory,
+                              it->second.label.c_str());
+                comparison = text;
+                if (speed < -0.10 || memory > 0.10) {
+                    comparison += "  REGRESSION";
+                    regression = true;
+                }
+            }
+            std::printf("%-18s %4s %9.2f %9llu %9.3f %9.2f %11.0f %10.1f  %s\n", result.program.c_str(), mode,
+                        text.size() / 1e6, (unsigned long long) lines, best.seconds, result.mbPerSecond,
+                        result.linesPerSecond, best.peakRssKb / 1024.0, comparison.c_str());
+            results.push_back(result);
+        }
+    }
+
+    if (resultsPath) {
+        bool exists = std::ifstream(resultsPath).good();
+        std::ofstream out(resultsPath, std::ios::app);
+        if (!out) {
+            std::fprintf(stderr, "cannot write %s\n", resultsPath);
+            return 1;
+        }
+        if (!exists)
+            out << resultsHeader << "\n";
+        for (const Result& result : results) {
+            char line[256];
+            std::snprintf(line, sizeof(line), "%s\t%s\t%s\t%llu\t%llu\t%.4f\t%.3f\t%.0f\t%ld\n", result.label.c_str(),
+                          result.program.c_str(), result.mode.c_str(), (unsigned long long) result.bytes,
+                          (unsigned long long) result.lines, result.seconds, result.mbPerSecond,
+                          result.linesPerSecond, result.peakRssKb);
+            out << line;
+        }
+        std::printf("results appended to %s\n", resultsPath);
+    }
+    return regression ? 2 : 0;
+}
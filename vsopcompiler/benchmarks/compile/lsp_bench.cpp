@@ -0,0 +1,445 @@
+// Language server benchmark: starts vsopc --lsp, opens a program, then edits it the way a
+// user would (a line inserted, a space typed after a '{', a character typed then deleted,
+// an unclosed brace, comment or string typed then deleted, an identifier renamed then
+// renamed back) and asks for hovers and definitions. Reports the latency of each kind of
+// request: for an edit, until its diagnostics are published. The time of vsopc -c on the
+// whole program is given for comparison.
+//
+// With --check, the diagnostics published after each edit must be the errors that
+// vsopc -c prints for the text at that point (in any order), and the definition of each
+// class name asked for must be its declaration.
+//
+// Usage: lsp_bench [--check] [--edits N] vsopc program.vsop
+//        (make bench-lsp, make lsp-check)
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// 'text' as a JSON string
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out + "\"";
+}
+
+// The JSON string that starts at 'pos' (on its '"'), decoded; 'pos' is moved after it
+std::string readString(const std::string& json, size_t& pos) {
+    std::string out;
+    for (++pos; pos < json.size() && json[pos] != '"'; ++pos) {
+        if (json[pos] != '\\') {
+            out += json[pos];
+            continue;
+        }
+        char c = json[++pos];
+        if (c == 'n')
+            out += '\n';
+        else if (c == 't')
+            out += '\t';
+        else if (c == 'u') {
+            out += static_cast<char>(std::strtoul(json.substr(pos + 1, 4).c_str(), nullptr, 16));
+            pos += 4;
+        } else
+            out += c;
+    }
+    ++pos;
+    return out;
+}
+
+// The number after "key": from 'pos', -1 if there is none
+long readNumber(const std::string& json, const std::string& key, size_t pos) {
+    size_t found = json.find("\"" + key + "\":", pos);
+    return found == std::string::npos ? -1 : std::strtol(json.c_str() + found + key.size() + 3, nullptr, 10);
+}
+
+class Client {
+public:
+    bool start(const char* vsopc) {
+        int toServer[2], fromServer[2];
+        if (pipe(toServer) != 0 || pipe(fromServer) != 0)
+            return false;
+        server = fork();
+        if (server < 0)
+            return false;
+        if (server == 0) {
+            dup2(toServer[0], STDIN_FILENO);
+            dup2(fromServer[1], STDOUT_FILENO);
+            close(toServer[1]);
+            close(fromServer[0]);
+            execl(vsopc, vsopc, "--lsp", static_cast<char*>(nullptr));
+            _exit(127);
+        }
+        close(toServer[0]);
+        close(fromServer[1]);
+        out = fdopen(toServer[1], "w");
+        in = fdopen(fromServer[0], "r");
+        return out && in;
+    }
+
+    void send(const std::string& json) {
+        fprintf(out, "Content-Length: %zu\r\n\r\n%s", json.size(), json.c_str());
+        fflush(out);
+    }
+
+    void notify(const std::string& method, const std::string& params) {
+        send("{\"jsonrpc\":\"2.0\",\"method\":\"" + method + "\",\"params\":" + params + "}");
+    }
+
+    // Sends a request and returns its response
+    std::string request(const std::string& method, const std::string& params) {
+        int id = ++lastId;
+        send("{\"jsonrpc\":\"2.0\",\"id\":" + std::to_string(id) + ",\"method\":\"" + method + "\",\"params\":" + params + "}");
+        for (;;) {
+            std::string message = receive();
+            if (message.empty() || readNumber(message, "id", 0) == id)
+                return message;
+        }
+    }
+
+    // Waits for the next diagnostics published
+    std::string diagnostics() {
+        for (;;) {
+            std::string message = receive();
+            if (message.empty() || message.find("\"textDocument/publishDiagnostics\"") != std::string::npos)
+                return message;
+        }
+    }
+
+    int stop() {
+        request("shutdown", "null");
+        notify("exit", "null");
+        fclose(out);
+        fclose(in);
+        int status = 0;
+        waitpid(server, &status, 0);
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+private:
+    pid_t server = -1;
+    FILE* out = nullptr;
+    FILE* in = nullptr;
+    int lastId = 0;
+
+    std::string receive() {
+        char line[256];
+        size_t length = 0;
+        while (fgets(line, sizeof(line), in)) {
+            if (strncmp(line, "Content-Length:", 15) == 0)
+                length = std::strtoul(line + 15, nullptr, 10);
+            else if (strcmp(line, "\r\n") == 0)
+                break;
+        }
+        std::string body(length, '\0');
+        if (length == 0 || fread(&body[0], 1, length, in) != length)
+            return "";
+        return body;
+    }
+};
+
+// The diagnostics of a publishDiagnostics notification, as "line:column: message" (from 1)
+std::vector<std::string> parseDiagnostics(const std::string& message) {
+    std::vector<std::string> diagnostics;
+    for (size_t pos = message.find("\"range\":"); pos != std::string::npos; pos = message.find("\"range\":", pos)) {
+        long line = readNumber(message, "line", pos);
+        long column = readNumber(message, "character", pos);
+        pos = message.find("\"message\":", pos) + 10;
+        diagnostics.push_back(std::to_string(line + 1) + ":" + std::to_string(column + 1) + ": " + readString(message, pos));
+    }
+    std::sort(diagnostics.begin(), diagnostics.end());
+    return diagnostics;
+}
+
+// The errors of vsopc -c on 'text', as "line:column: message" (a position 0 as 1, as the
+// protocol has none); false if it did not end within 20 s
+bool batchErrors(const char* vsopc, const std::string& text, const std::string& path, std::vector<std::string>& errors) {
+    std::ofstream(path) << text;
+    std::string errorsPath = path + ".errors";
+    pid_t child = fork();
+    if (child == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        int file = open(errorsPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        dup2(null, STDOUT_FILENO);
+        dup2(file, STDERR_FILENO);
+        alarm(20);
+        execl(vsopc, vsopc, "-c", path.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    remove((path + "_tempo").c_str());
+    if (WIFSIGNALED(status))
+        return false;
+    errors.clear();
+    std::ifstream file(errorsPath);
+    std::string line;
+    std::string prefix = path + ":";
+    while (std::getline(file, line)) {
+        if (line.compare(0, prefix.size(), prefix) != 0)
+            continue;
+        unsigned long number = 0, column = 0;
+        size_t pos = prefix.size();
+        number = std::strtoul(line.c_str() + pos, nullptr, 10);
+        pos = line.find(':', pos) + 1;
+        column = std::strtoul(line.c_str() + pos, nullptr, 10);
+        pos = line.find(':', pos) + 2;
+        errors.push_back(std::to_string(std::max(number, 1UL)) + ":" + std::to_string(std::max(column, 1UL)) + ": " + line.substr(pos));
+    }
+    remove(errorsPath.c_str());
+    std::sort(errors.begin(), errors.end());
+    return true;
+}
+
+struct Latencies {
+    std::vector<double> samples;
+
+    void print(const char* name) const {
+        if (samples.empty())
+            return;
+        std::vector<double> sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        printf("%-12s %6zu  median %8.3f ms  p95 %8.3f ms  max %8.3f ms\n", name, sorted.size(),
+               sorted[sorted.size() / 2], sorted[sorted.size() * 95 / 100], sorted.back());
+    }
+};
+
+bool isIdentifierChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// The line and character (from 0) of 'offset' in 'text'
+std::string position(const std::string& text, size_t offset) {
+    size_t lineStart = text.rfind('\n', offset == 0 ? 0 : offset - 1);
+    lineStart = lineStart == std::string::npos || offset == 0 ? 0 : lineStart + 1;
+    long line = std::count(text.begin(), text.begin() + lineStart, '\n');
+    return "{\"line\":" + std::to_string(line) + ",\"character\":" + std::to_string(offset - lineStart) + "}";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool check = false;
+    int edits = 40;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] == '-'; ++i) {
+        if (strcmp(argv[i], "--check") == 0)
+            check = true;
+        else if (strcmp(argv[i], "--edits") == 0 && i + 1 < argc)
+            edits = std::atoi(argv[++i]);
+    }
+    if (argc - i != 2) {
+        fprintf(stderr, "Usage: %s [--check] [--edits N] vsopc program.vsop\n", argv[0]);
+        return 1;
+    }
+    const char* vsopc = argv[i];
+    std::ifstream input(argv[i + 1]);
+    std::stringstream buffer;
+    buffer << input.rdbuf();
+    std::string text = buffer.str();
+    std::string scratch = std::string(argv[i + 1]) + ".lsp.vsop"; // for vsopc -c
+    const std::string uri = "file:///program.vsop";
+
+    int failures = 0;
+    int compared = 0;
+    auto compare = [&](const std::string& published, const char* step) {
+        std::vector<std::string> expected;
+        if (!check || !batchErrors(vsopc, text, scratch, expected))
+            return;
+        ++compared;
+        std::vector<std::string> actual = parseDiagnostics(published);
+        if (actual == expected)
+            return;
+        ++failures;
+        printf("DIFFERENT after %s:\n", step);
+        for (const auto& error : expected)
+            printf("  -c:  %s\n", error.c_str());
+        for (const auto& error : actual)
+            printf("  lsp: %s\n", error.c_str());
+    };
+
+    Client client;
+    if (!client.start(vsopc)) {
+        fprintf(stderr, "cannot start %s --lsp\n", vsopc);
+        return 1;
+    }
+    client.request("initialize", "{\"processId\":null,\"rootUri\":null,\"capabilities\":{}}");
+    client.notify("initialized", "{}");
+
+    Clock::time_point start = Clock::now();
+    client.notify("textDocument/didOpen", "{\"textDocument\":{\"uri\":\"" + uri
+                  + "\",\"languageId\":\"vsop\",\"version\":1,\"text\":" + jsonString(text) + "}}");
+    std::string published = client.diagnostics();
+    double openTime = millisecondsSince(start);
+    compare(published, "opening");
+
+    // the identifiers of the program, where edits and requests are made
+    std::vector<size_t> identifiers;
+    for (size_t pos = 0; pos < text.size(); ++pos) {
+        if (isIdentifierChar(text[pos]) && (pos == 0 || !isIdentifierChar(text[pos - 1])) && !(text[pos] >= '0' && text[pos] <= '9'))
+            identifiers.push_back(pos);
+    }
+    if (identifiers.empty()) {
+        client.stop();
+        remove(scratch.c_str());
+        printf("no identifier to edit\n");
+        return failures == 0 ? 0 : 1;
+    }
+
+    Latencies editLatencies, hoverLatencies, definitionLatencies;
+    int version = 1;
+    unsigned int seed = 12345;
+    auto random = [&seed](size_t bound) {
+        seed = seed * 1103515245 + 12345;
+        return static_cast<size_t>((seed >> 8) % bound);
+    };
+    // replaces [from, to) with 'replacement', and waits for the diagnostics
+    auto edit = [&](size_t from, size_t to, const std::string& replacement, const char* step) {
+        std::string change = "{\"range\":{\"start\":" + position(text, from) + ",\"end\":" + position(text, to)
+                           + "},\"text\":" + jsonString(replacement) + "}";
+        text.replace(from, to - from, replacement);
+        Clock::time_point sent = Clock::now();
+        client.notify("textDocument/didChange", "{\"textDocument\":{\"uri\":\"" + uri + "\",\"version\":"
+                      + std::to_string(++version) + "},\"contentChanges\":[" + change + "]}");
+        std::string diagnostics = client.diagnostics();
+        editLatencies.samples.push_back(millisecondsSince(sent));
+        compare(diagnostics, step);
+    };
+
+    for (int round = 0; round < edits; ++round) {
+        size_t at = identifiers[random(identifiers.size())];
+        switch (round % 5) {
+        case 0: { // a line inserted before the line of the identifier (the identifiers after it move)
+            size_t lineStart = text.rfind('\n', at);
+            lineStart = lineStart == std::string::npos ? 0 : lineStart + 1;
+            edit(lineStart, lineStart, "\n", "inserting a line");
+            for (size_t& identifier : identifiers)
+                identifier += identifier >= lineStart;
+            break;
+        }
+        case 1: { // a space after the next '{'
+            size_t brace = text.find('{', at);
+            if (brace == std::string::npos)
+                break;
+            edit(brace + 1, brace + 1, " ", "typing a space");
+            for (size_t& identifier : identifiers)
+                identifier += identifier > brace;
+            break;
+        }
+        case 2: // a character typed in an identifier, then deleted
+            edit(at + 1, at + 1, "x", "typing a character");
+            edit(at + 1, at + 2, "", "deleting it");
+            break;
+        case 3: { // an unbalanced brace, comment or string typed (an error), then deleted
+            static const char* typed[] = {"{", "}", "(*", "\"", "class"};
+            std::string piece = typed[random(5)];
+            edit(at, at, piece, "typing an error");
+            edit(at, at + piece.size(), "", "deleting it");
+            break;
+        }
+        default: { // an identifier renamed, then back
+            size_t end = at;
+            while (end < text.size() && isIdentifierChar(text[end]))
+                ++end;
+            std::string name = text.substr(at, end - at);
+            std::string renamed = name + "Renamed";
+            edit(at, end, renamed, "renaming an identifier");
+            edit(at, at + renamed.size(), name, "renaming it back");
+            break;
+        }
+        }
+
+        // a hover and a definition at an identifier
+        size_t asked = identifiers[random(identifiers.size())];
+        std::string params = "{\"textDocument\":{\"uri\":\"" + uri + "\"},\"position\":" + position(text, asked) + "}";
+        Clock::time_point sent = Clock::now();
+        client.request("textDocument/hover", params);
+        hoverLatencies.samples.push_back(millisecondsSince(sent));
+        sent = Clock::now();
+        std::string definition = client.request("textDocument/definition", params);
+        definitionLatencies.samples.push_back(millisecondsSince(sent));
+
+        // a class name must lead to its declaration
+        size_t end = asked;
+        while (end < text.size() && isIdentifierChar(text[end]))
+            ++end;
+        std::string name = text.substr(asked, end - asked);
+        if (check && text[asked] >= 'A' && text[asked] <= 'Z' && name != "Object") {
+            size_t declaration = std::string::npos;
+            for (size_t pos = text.find("class " + name); pos != std::string::npos; pos = text.find("class " + name, pos + 1)) {
+                size_t after = pos + 6 + name.size();
+                if ((pos == 0 || !isIdentifierChar(text[pos - 1])) && (after >= text.size() || !isIdentifierChar(text[after]))) {
+                    declaration = pos + 6;
+                    break;
+                }
+            }
+            if (declaration != std::string::npos && definition.find("\"result\":null") == std::string::npos) {
+                ++compared;
+                std::string expected = position(text, declaration);
+                std::string line = "\"line\":" + std::to_string(readNumber(expected, "line", 0));
+                std::string character = "\"character\":" + std::to_string(readNumber(expected, "character", 0));
+                if (definition.find(line + "," + character) == std::string::npos) {
+                    ++failures;
+                    printf("DIFFERENT definition of %s: %s\n", name.c_str(), definition.c_str());
+                }
+            }
+        }
+    }
+
+    int status = client.stop();
+    remove(scratch.c_str());
+    if (status != 0) {
+        printf("vsopc --lsp exited with %d\n", status);
+        ++failures;
+    }
+
+    if (check) {
+        printf("%d results compared: %d difference(s)\n", compared, failures);
+        return failures == 0 ? 0 : 1;
+    }
+
+    start = Clock::now();
+    std::vector<std::string> ignored;
+    batchErrors(vsopc, text, scratch, ignored);
+    double batchTime = millisecondsSince(start);
+    remove(scratch.c_str());
+
+    printf("%s: %zu bytes\n", argv[i + 1], text.size());
+    printf("%-12s %6d  %8.3f ms\n", "open", 1, openTime);
+    editLatencies.print("edit");
+    hoverLatencies.print("hover");
+    definitionLatencies.print("definition");
+    printf("%-12s %6d  %8.3f ms\n", "vsopc -c", 1, batchTime);
+    return failures == 0 ? 0 : 1;
+}
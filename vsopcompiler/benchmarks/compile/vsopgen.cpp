@@ -0,0 +1,226 @@
+// Generator of synthetic, valid VSOP programs for the compiler throughput benchmark.
+// Classes form a forest of at most 'depth' levels where every class has at most 'fanout'
+// subclasses; every class has two int32 fields, a string field, its own 'methods' methods
+// and an override of value(). Method bodies are a chain of 'lets' lets over int32
+// expressions 'nesting' levels deep (arithmetic, comparisons in conditionals, calls to
+// methods of the class and its ancestors), after 'strings' print() of string literals of
+// 4 to 'words' words, with escapes. The output only depends on the options, and passes
+// vsopc -c.
+//
+// Usage: vsopgen [--classes N] [--depth N] [--fanout N] [--methods N] [--nesting N]
+//                [--lets N] [--strings N] [--words N] [--seed N] > program.vsop
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Shape {
+    int classes = 100;
+    int depth = 4;
+    int fanout = 3;
+    int methods = 5;
+    int nesting = 4;
+    int lets = 3;
+    int strings = 2;
+    int words = 11;
+    unsigned int seed = 1;
+};
+
+struct GeneratedClass {
+    std::string name;
+    int parent;                 // -1 for a root (extends Object)
+    int depth;
+    int children = 0;
+    std::vector<std::string> methods;   // own methods, all (int32, int32) : int32
+};
+
+class Generator {
+public:
+    explicit Generator(const Shape& shape) : shape(shape), random(shape.seed) {}
+
+    void run(std::FILE* out) {
+        buildHierarchy();
+        for (size_t i = 0; i < classes.size(); ++i)
+            emitClass(out, i);
+        emitMain(out);
+    }
+
+private:
+    const Shape& shape;
+    std::mt19937 random;
+    std::vector<GeneratedClass> classes;
+    std::vector<std::string> visible;       // methods callable in the class being emitted
+    std::vector<std::string> variables;     // int32 names in scope
+
+    int pick(int bound) { return std::uniform_int_distribution<int>(0, bound - 1)(random); }
+
+    // Breadth-first: a class extends the oldest class with room for a child, if any
+    void buildHierarchy() {
+        size_t candidate = 0;
+        for (int i = 0; i < shape.classes; ++i) {
+            GeneratedClass cls;
+            cls.name = "C" + std::to_string(i);
+            cls.parent = -1;
+            cls.depth = 1;
+            while (candidate < classes.size()
+                   && (classes[candidate].children >= shape.fanout || classes[candidate].depth >= shape.depth))
+                candidate++;
+            if (candidate < classes.size()) {
+                cls.parent = static_cast<int>(candidate);
+                cls.depth = classes[candidate].depth + 1;
+                classes[candidate].children++;
+            }
+            for (int m = 0; m < shape.methods; ++m)
+                cls.methods.push_back("c" + std::to_string(i) + "m" + std::to_string(m));
+            classes.push_back(cls);
+        }
+    }
+
+    std::string literal() {
+        static const char* words[] = {"lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit"};
+        static const char* escapes[] = {"\\n", "\\t", "\\\"", "\\\\", "\\x41", "\\x7e"};
+        std::string text = "\"";
+        int count = 4 + pick(shape.words > 4 ? shape.words - 3 : 1);
+        for (int i = 0; i < count; ++i) {
+            text += words[pick(8)];
+            text += pick(4) == 0 ? escapes[pick(6)] : " ";
+        }
+        return text + "\"";
+    }
+
+    std::string leaf() {
+        switch (pick(3)) {
+        case 0:
+            return std::to_string(pick(1000));
+        default:
+            return variables[pick(static_cast<int>(variables.size()))];
+        }
+    }
+
+    std::string expression(int depth) {
+        if (depth <= 0)
+            return leaf();
+        static const char* operators[] = {"+", "-", "*", "/"};
+        switch (pick(6)) {
+        case 0:
+            // parenthesized: a trailing operator would otherwise extend the else branch
+            return "(if " + expression(depth - 1) + " < " + expression(depth - 1) + " then " + expression(depth - 1)
+                   + " else " + expression(depth - 1) + ")";
+        case 1:
+            if (!visible.empty())
+                return visible[pick(static_cast<int>(visible.size()))] + "(" + expression(depth - 1) + ", "
+                       + expression(depth - 1) + ")";
+            // fall through
+        case 2:
+            return "(" + expression(depth - 1) + " " + operators[pick(4)] + " " + expression(depth - 1) + ")";
+        default:
+            return expression(depth - 1) + " " + operators[pick(3)] + " " + leaf();
+        }
+    }
+
+    void emitBody(std::FILE* out, int indent) {
+        std::string pad(indent, ' ');
+        std::fprintf(out, "{\n");
+        for (int i = 0; i < shape.strings; ++i)
+            std::fprintf(out, "%s    print(%s);\n", pad.c_str(), literal().c_str());
+        size_t scope = variables.size();
+        for (int i = 0; i < shape.lets; ++i) {
+            std::string name = "v" + std::to_string(i);
+            std::fprintf(out, "%s    let %s : int32 <- %s in\n", pad.c_str(), name.c_str(), expression(shape.nesting).c_str());
+            variables.push_back(name);
+        }
+        std::fprintf(out, "%s    %s\n%s}\n", pad.c_str(), expression(shape.nesting).c_str(), pad.c_str());
+        variables.resize(scope);
+    }
+
+    void emitClass(std::FILE* out, size_t index) {
+        const GeneratedClass& cls = classes[index];
+        std::string fieldA = "a" + std::to_string(index), fieldB = "b" + std::to_string(index);
+        std::string fieldS = "s" + std::to_string(index);
+
+        std::vector<int> ancestry;      // from the root to this class
+        for (int i = static_cast<int>(index); i != -1; i = classes[i].parent)
+            ancestry.insert(ancestry.begin(), i);
+        visible.clear();
+        variables.clear();
+        for (int i : ancestry) {
+            visible.insert(visible.end(), classes[i].methods.begin(), classes[i].methods.end());
+            variables.push_back("a" + std::to_string(i));
+            variables.push_back("b" + std::to_string(i));
+        }
+
+        if (cls.parent < 0)
+            std::fprintf(out, "class %s {\n", cls.name.c_str());
+        else
+            std::fprintf(out, "class %s extends %s {\n", cls.name.c_str(), classes[cls.parent].name.c_str());
+        std::fprintf(out, "    %s : int32 <- %d;\n    %s : int32;\n    %s : string <- %s;\n\n", fieldA.c_str(),
+                     pick(100), fieldB.c_str(), fieldS.c_str(), literal().c_str());
+
+        // a method only calls the methods declared before it, so that nothing recurses
+        std::vector<std::string> callable = visible;
+        visible.resize(visible.size() - cls.methods.size());
+        for (const std::string& method : cls.methods) {
+            variables.push_back("x");
+            variables.push_back("y");
+            std::fprintf(out, "    %s(x : int32, y : int32) : int32 ", method.c_str());
+            emitBody(out, 4);
+            variables.resize(variables.size() - 2);
+            visible.push_back(method);
+        }
+        std::fprintf(out, "    value() : int32 ");
+        emitBody(out, 4);
+        std::fprintf(out, "}\n\n");
+        visible = callable;
+    }
+
+    void emitMain(std::FILE* out) {
+        std::fprintf(out, "class Main {\n    main() : int32 {\n");
+        for (size_t i = 0; i < classes.size() && i < 10; ++i)
+            std::fprintf(out, "        printInt32((new %s).value());\n", classes[i].name.c_str());
+        std::fprintf(out, "        0\n    }\n}\n");
+    }
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Shape shape;
+    struct Option {
+        const char* name;
+        int* value;
+    } options[] = {{"--classes", &shape.classes}, {"--depth", &shape.depth},     {"--fanout", &shape.fanout},
+                   {"--methods", &shape.methods}, {"--nesting", &shape.nesting}, {"--lets", &shape.lets},
+                   {"--strings", &shape.strings}, {"--words", &shape.words}};
+    for (int i = 1; i < argc; ++i) {
+        bool known = false;
+        if (i + 1 < argc && std::strcmp(argv[i], "--seed") == 0) {
+            shape.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+            continue;
+        }
+        for (Option& option : options) {
+            if (i + 1 < argc && std::strcmp(argv[i], option.name) == 0) {
+                *option.value = std::atoi(argv[++i]);
+                known = true;
+                break;
+            }
+        }
+        if (!known) {
+            std::fprintf(stderr, "Usage: %s [--classes N] [--depth N] [--fanout N] [--methods N] [--nesting N]"
+                                 " [--lets N] [--strings N] [--words N] [--seed N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (shape.depth < 1 || shape.fanout < 1 || shape.classes < 0) {
+        std::fprintf(stderr, "%s: --depth and --fanout must be at least 1\n", argv[0]);
+        return 1;
+    }
+
+    Generator generator(shape);
+    generator.run(stdout);
+    return 0;
+}
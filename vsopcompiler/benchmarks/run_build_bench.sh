@@ -0,0 +1,41 @@
+#!/bin/bash
+# Separate compilation of multi-file programs: generates a program with vsopgen, splits it
+# into files of CLASSES_PER_FILE classes, and times vsopc -c on the whole program against
+# -c on the files: cold (empty build directory) with one worker and with one per
+# processor, then warm, with nothing changed and after edits of one file.
+# Usage: benchmarks/run_build_bench.sh [vsopc]   (from the vsopcompiler folder, make bench-build)
+
+VSOPC=${1:-./vsopc}
+CLASSES_PER_FILE=${CLASSES_PER_FILE:-10}
+JOBS=${JOBS:-$(nproc)}
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/vsop-build.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+
+./benchmarks/compile/vsopgen --classes 1000 --depth 2 --fanout 50 --methods 3 --nesting 3 --lets 2 --strings 1 \
+    > "$WORK/program.vsop" || exit 1
+mkdir "$WORK/src"
+awk -v dir="$WORK/src" -v per="$CLASSES_PER_FILE" 'BEGIN { n = 0 } /^class / { n++ }
+    { printf "%s\n", $0 > sprintf("%s/%04d.vsop", dir, int((n + per - 1) / per)) }' "$WORK/program.vsop"
+files=("$WORK"/src/*.vsop)
+
+# 'run <label> <command>...': wall time of the command in ms
+run() {
+    label=$1
+    shift
+    start=$(date +%s%N)
+    "$@" > /dev/null 2> "$WORK/report" || { echo "$label: failed"; cat "$WORK/report"; exit 1; }
+    end=$(date +%s%N)
+    printf "%-36s %8.1f ms   %s\n" "$label" "$(( (end - start) / 1000 ))e-3" "$(grep '^build:' "$WORK/report")"
+}
+export VSOP_BUILD_REPORT=1
+
+echo "$(wc -c < "$WORK/program.vsop") bytes, ${#files[@]} files, $JOBS processors"
+run "-c on the whole program" "$VSOPC" -c "$WORK/program.vsop"
+run "cold, -j1" "$VSOPC" -j1 --build-dir "$WORK/build1" -c "${files[@]}"
+run "cold, -j$JOBS" "$VSOPC" -j"$JOBS" --build-dir "$WORK/build" -c "${files[@]}"
+run "warm, nothing changed" "$VSOPC" -j"$JOBS" --build-dir "$WORK/build" -c "${files[@]}"
+middle=${files[$(( ${#files[@]} / 2 ))]}
+echo "// edited" >> "$middle"
+run "warm, a comment added to a file" "$VSOPC" -j"$JOBS" --build-dir "$WORK/build" -c "${files[@]}"
+sed -i '0,/^class .*{/s//&\n    benchAdded() : int32 { 0 }/' "${files[0]}"
+run "warm, a method added to the root" "$VSOPC" -j"$JOBS" --build-dir "$WORK/build" -c "${files[@]}"
@@ -0,0 +1,36 @@
+#!/bin/bash
+# Generates a corpus of synthetic VSOP programs of different shapes with vsopgen, then
+# measures vsopc -l/-p/-c/-o over it with compile_bench (MB/s, lines/s, peak RSS). Results are
+# appended to benchmarks/compile/results.tsv (not tracked: they are those of this machine)
+# and compared with the previous ones: the exit status is 2 if a regression of more than 10%
+# is found.
+# Usage: benchmarks/run_compile_bench.sh [vsopc]   (from the vsopcompiler folder, make bench)
+
+VSOPC=${1:-./vsopc}
+RUNS=${RUNS:-3}
+RESULTS=${RESULTS:-benchmarks/compile/results.tsv}
+CORPUS=$(mktemp -d "${TMPDIR:-/tmp}/vsop-corpus.XXXXXX")
+trap 'rm -rf "$CORPUS"' EXIT
+
+# name and vsopgen options of each program of the corpus
+while read -r name options; do
+    ./benchmarks/compile/vsopgen $options > "$CORPUS/$name.vsop" || exit 1
+done <<PRESETS
+wide      --classes 1000 --depth 2 --fanout 50 --methods 3 --nesting 3 --lets 2 --strings 1
+deep      --classes 300 --depth 60 --fanout 1 --methods 4 --nesting 4 --lets 3 --strings 1
+nested    --classes 40 --methods 10 --nesting 7 --lets 4 --strings 0
+lets      --classes 200 --methods 5 --nesting 2 --lets 30 --strings 0
+strings   --classes 200 --methods 5 --nesting 2 --lets 1 --strings 20
+text      --classes 100 --methods 3 --nesting 1 --lets 1 --strings 20 --words 300
+PRESETS
+
+# results are labeled with the commit ('+' if the tree has changes) and the date, or $LABEL
+if commit=$(git rev-parse --short HEAD 2>/dev/null); then
+    git diff --quiet HEAD -- . || commit="$commit+"
+else
+    commit=unknown
+fi
+label=${LABEL:-"$commit $(date +%F)"}
+./benchmarks/compile/compile_bench --runs "$RUNS" --results "$RESULTS" --label "$label" "$VSOPC" \
+    "$CORPUS"/wide.vsop "$CORPUS"/deep.vsop "$CORPUS"/nested.vsop "$CORPUS"/lets.vsop "$CORPUS"/strings.vsop \
+    "$CORPUS"/text.vsop
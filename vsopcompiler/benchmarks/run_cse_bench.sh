@@ -0,0 +1,23 @@
+#!/bin/bash
+# Times the common subexpression kernels with and without --cse, under the interpreter (-x)
+# and with --jit.
+# Usage: benchmarks/run_cse_bench.sh [vsopc]   (from the vsopcompiler folder)
+
+VSOPC=${1:-./vsopc}
+TIMEFORMAT=%R
+
+printf "%-24s %10s %10s %10s %10s  %s\n" "program" "interp (s)" "cse (s)" "jit (s)" "jit+cse (s)" "reused"
+for file in benchmarks/cse/*.vsop; do
+    base_out=$($VSOPC -x "$file")
+    times=()
+    for options in "" "--cse" "--jit" "--jit --cse"; do
+        if [ "$($VSOPC $options -x "$file")" != "$base_out" ]; then
+            echo "$file: output differs with $options"
+            exit 1
+        fi
+        times+=("$( { time $VSOPC $options -x "$file" > /dev/null; } 2>&1 )")
+    done
+    reused=$(VSOP_CSE_REPORT=1 $VSOPC --cse -c "$file" 2>&1 > /dev/null | sed -n 's/^cse: //p')
+    printf "%-24s %10s %10s %10s %10s  %s\n" "$(basename "$file")" "${times[@]}" "$reused"
+done
+rm -f benchmarks/cse/*_tempo
@@ -0,0 +1,37 @@
+#!/bin/bash
+# Parallel emission of the tree (emitter.cpp): generates programs of thousands of methods
+# with vsopgen and times vsopc -c on 1, 2, 4 and 8 threads (-j), checking that the output
+# is the same on each. With a compiler built with statistics (make STATS=1), the time of
+# the print phase alone is given too.
+# Usage: benchmarks/run_emit_bench.sh [vsopc]   (from the vsopcompiler folder, make bench-emit)
+
+VSOPC=${1:-./vsopc}
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/vsop-emit.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+
+./benchmarks/compile/vsopgen --classes 1000 --depth 2 --fanout 50 --methods 5 --nesting 3 --lets 2 --strings 1 \
+    > "$WORK/many_classes.vsop" || exit 1
+./benchmarks/compile/vsopgen --classes 40 --depth 1 --fanout 40 --methods 100 --nesting 3 --lets 2 --strings 1 \
+    > "$WORK/large_classes.vsop" || exit 1
+"$VSOPC" --time-passes -c "$WORK/many_classes.vsop" > /dev/null 2>&1 && phases=1
+
+echo "$(nproc) processors"
+printf "%-34s %8s %12s %12s\n" "program" "threads" "-c (ms)" "print (ms)"
+for program in many_classes large_classes; do
+    "$VSOPC" -j 1 -c "$WORK/$program.vsop" > "$WORK/reference" || exit 1
+    for jobs in 1 2 4 8; do
+        start=$(date +%s%N)
+        "$VSOPC" -j $jobs -c "$WORK/$program.vsop" > "$WORK/output" || exit 1
+        end=$(date +%s%N)
+        if ! cmp -s "$WORK/reference" "$WORK/output"; then
+            echo "$program: output differs with -j $jobs"
+            exit 1
+        fi
+        print=-
+        if [ -n "$phases" ]; then
+            print=$("$VSOPC" --time-passes -j $jobs -c "$WORK/$program.vsop" 2>&1 > /dev/null | awk '$1 == "print" { print $2 }')
+        fi
+        printf "%-34s %8d %12.1f %12s\n" "$program ($(grep -c '^    [a-z][A-Za-z0-9_]*(' "$WORK/$program.vsop") methods)" $jobs \
+            "$(( (end - start) / 1000 ))e-3" "$print"
+    done
+done
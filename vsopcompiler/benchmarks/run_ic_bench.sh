@@ -0,0 +1,33 @@
+#!/bin/bash
+# Times dispatch over shape hierarchies under the interpreter (-x), with vtable lookups
+# only and with --inline-caches, and shows the hit rate of the caches. Times are the best
+# of RUNS runs (5 by default), dispatch being a small part of the work of the interpreter.
+# Usage: benchmarks/run_ic_bench.sh [vsopc]   (from the vsopcompiler folder)
+
+VSOPC=${1:-./vsopc}
+RUNS=${RUNS:-5}
+TIMEFORMAT=%R
+
+# best_time <vsopc arguments...>
+best_time() {
+    for _ in $(seq "$RUNS"); do
+        { time $VSOPC "$@" > /dev/null; } 2>&1
+    done | sort -n | head -n 1
+}
+
+printf "%-28s %10s %10s %8s  %s\n" "program" "vtable (s)" "ic (s)" "speedup" "hits"
+for file in benchmarks/inline_caches/*.vsop; do
+    base_out=$($VSOPC -x "$file")
+    base_time=$(best_time -x "$file")
+    ic_out=$($VSOPC --inline-caches -x "$file")
+    ic_time=$(best_time --inline-caches -x "$file")
+    hits=$(VSOP_IC_REPORT=1 $VSOPC --inline-caches -x "$file" 2>&1 > /dev/null | tail -n 1 | sed 's/^ic: //')
+
+    if [ "$base_out" != "$ic_out" ]; then
+        echo "$file: output differs with --inline-caches"
+        exit 1
+    fi
+    speedup=$(awk -v b="$base_time" -v i="$ic_time" 'BEGIN { printf "%.2f", b / i }')
+    printf "%-28s %10s %10s %7sx  %s\n" "$(basename "$file")" "$base_time" "$ic_time" "$speedup" "$hits"
+done
+rm -f benchmarks/inline_caches/*_tempo
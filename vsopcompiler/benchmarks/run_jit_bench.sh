@@ -0,0 +1,23 @@
+#!/bin/bash
+# Times the JIT kernels under the interpreter (-x), with and without --jit.
+# Usage: benchmarks/run_jit_bench.sh [vsopc]   (from the vsopcompiler folder)
+
+VSOPC=${1:-./vsopc}
+TIMEFORMAT=%R
+
+printf "%-24s %10s %10s %8s  %s\n" "program" "interp (s)" "jit (s)" "speedup" "methods"
+for file in benchmarks/jit/*.vsop; do
+    base_out=$($VSOPC -x "$file")
+    base_time=$( { time $VSOPC -x "$file" > /dev/null; } 2>&1 )
+    jit_out=$($VSOPC --jit -x "$file")
+    jit_time=$( { time $VSOPC --jit -x "$file" > /dev/null; } 2>&1 )
+    methods=$(VSOP_JIT_REPORT=1 $VSOPC --jit -x "$file" 2>&1 > /dev/null | sed -n 's/^jit: //p')
+
+    if [ "$base_out" != "$jit_out" ]; then
+        echo "$file: output differs with --jit"
+        exit 1
+    fi
+    speedup=$(awk -v b="$base_time" -v j="$jit_time" 'BEGIN { printf "%.2f", b / j }')
+    printf "%-24s %10s %10s %7sx  %s\n" "$(basename "$file")" "$base_time" "$jit_time" "$speedup" "$methods"
+done
+rm -f benchmarks/jit/*_tempo
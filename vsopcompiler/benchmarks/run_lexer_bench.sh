@@ -0,0 +1,30 @@
+#!/bin/bash
+# Compares flex's scanner with the hand-written one (--lexer=simd): generates programs of
+# different shapes with vsopgen, then measures vsopc -l/-p/-c/-o over them with compile_bench,
+# once per scanner. The MB/s of -l are those of the scanner and of its -l lines; -p and -c
+# read the input twice (the first pass, then the parser's). In the second table, the last
+# column is the change from flex's scanner.
+# Usage: benchmarks/run_lexer_bench.sh [vsopc]   (from the vsopcompiler folder, make bench-lexer)
+
+VSOPC=${1:-./vsopc}
+RUNS=${RUNS:-5}
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/vsop-lexer.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+
+# name and vsopgen options of each program
+while read -r name options; do
+    ./benchmarks/compile/vsopgen $options > "$WORK/$name.vsop" || exit 1
+done <<PRESETS
+wide      --classes 1000 --depth 2 --fanout 50 --methods 3 --nesting 3 --lets 2 --strings 1
+strings   --classes 200 --methods 4 --nesting 1 --lets 1 --strings 40
+nested    --classes 40 --methods 10 --nesting 7 --lets 4 --strings 0
+PRESETS
+
+programs=("$WORK"/wide.vsop "$WORK"/strings.vsop "$WORK"/nested.vsop)
+echo "== flex (--lexer=flex)"
+./benchmarks/compile/compile_bench --runs "$RUNS" --results "$WORK/results.tsv" --label flex \
+    --arg --lexer=flex "$VSOPC" "${programs[@]}" | grep -v "^results appended"
+echo "== simd (--lexer=simd)"
+./benchmarks/compile/compile_bench --runs "$RUNS" --results "$WORK/results.tsv" --label simd \
+    --arg --lexer=simd "$VSOPC" "${programs[@]}" | grep -v "^results appended"
+exit 0
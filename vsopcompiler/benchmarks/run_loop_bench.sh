@@ -0,0 +1,22 @@
+#!/bin/bash
+# Times the loop kernels with and without --loop-opt, under the interpreter (-x).
+# Usage: benchmarks/run_loop_bench.sh [vsopc]   (from the vsopcompiler folder)
+
+VSOPC=${1:-./vsopc}
+TIMEFORMAT=%R
+
+printf "%-24s %10s %10s %8s\n" "program" "base (s)" "opt (s)" "speedup"
+for file in benchmarks/loops/*.vsop; do
+    base_out=$($VSOPC -x "$file")
+    base_time=$( { time $VSOPC -x "$file" > /dev/null; } 2>&1 )
+    opt_out=$($VSOPC --loop-opt -x "$file")
+    opt_time=$( { time $VSOPC --loop-opt -x "$file" > /dev/null; } 2>&1 )
+
+    if [ "$base_out" != "$opt_out" ]; then
+        echo "$file: output differs with --loop-opt"
+        exit 1
+    fi
+    speedup=$(awk -v b="$base_time" -v o="$opt_time" 'BEGIN { printf "%.2f", b / o }')
+    printf "%-24s %10s %10s %7sx\n" "$(basename "$file")" "$base_time" "$opt_time" "$speedup"
+done
+rm -f benchmarks/loops/*_tempo
@@ -0,0 +1,24 @@
+#!/bin/bash
+# Latency of the language server (vsopc --lsp): generates programs with vsopgen, then
+# lsp_bench opens each one, edits it and asks for hovers and definitions. An edit is timed
+# until its diagnostics are published, to compare with vsopc -c on the whole program.
+# Usage: benchmarks/run_lsp_bench.sh [vsopc]   (from the vsopcompiler folder, make bench-lsp)
+
+VSOPC=${1:-./vsopc}
+EDITS=${EDITS:-40}
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/vsop-lsp.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+
+# name and vsopgen options of each program
+while read -r name options; do
+    ./benchmarks/compile/vsopgen $options > "$WORK/$name.vsop" || exit 1
+done <<PRESETS
+small     --classes 20 --methods 4 --nesting 3 --lets 2 --strings 1
+wide      --classes 1000 --depth 2 --fanout 50 --methods 3 --nesting 3 --lets 2 --strings 1
+strings   --classes 200 --methods 4 --nesting 1 --lets 1 --strings 40
+PRESETS
+
+for name in small wide strings; do
+    ./benchmarks/compile/lsp_bench --edits "$EDITS" "$VSOPC" "$WORK/$name.vsop" || exit 1
+    echo
+done
@@ -0,0 +1,30 @@
+#!/bin/bash
+# Compares bison's parser with the hand-written one (--parser=descent): generates programs
+# of different shapes with vsopgen, then measures vsopc -l/-p/-c/-o over them with
+# compile_bench, once per parser. In the second table, the last column is the change from
+# bison's parser (-l does not parse and -o always uses the hand-written parser: they only
+# show the noise of the measure).
+# Usage: benchmarks/run_parser_bench.sh [vsopc]   (from the vsopcompiler folder, make bench-parser)
+
+VSOPC=${1:-./vsopc}
+RUNS=${RUNS:-5}
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/vsop-parser.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+
+# name and vsopgen options of each program
+while read -r name options; do
+    ./benchmarks/compile/vsopgen $options > "$WORK/$name.vsop" || exit 1
+done <<PRESETS
+wide      --classes 1000 --depth 2 --fanout 50 --methods 3 --nesting 3 --lets 2 --strings 1
+nested    --classes 40 --methods 10 --nesting 7 --lets 4 --strings 0
+lets      --classes 200 --methods 5 --nesting 2 --lets 30 --strings 0
+PRESETS
+
+programs=("$WORK"/wide.vsop "$WORK"/nested.vsop "$WORK"/lets.vsop)
+echo "== bison (yyparse)"
+./benchmarks/compile/compile_bench --runs "$RUNS" --results "$WORK/results.tsv" --label bison \
+    "$VSOPC" "${programs[@]}" | grep -v "^results appended"
+echo "== descent (--parser=descent)"
+./benchmarks/compile/compile_bench --runs "$RUNS" --results "$WORK/results.tsv" --label descent \
+    --arg --parser=descent "$VSOPC" "${programs[@]}" | grep -v "^results appended"
+exit 0
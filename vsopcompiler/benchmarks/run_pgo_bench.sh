@@ -0,0 +1,42 @@
+#!/bin/bash
+# Profiles each program once (-x --profile, writes <file>.profdata), then times it without
+# and with --use-profile, under the interpreter and under --jit, and shows what the
+# profile-guided pass did. Times are the best of RUNS runs (5 by default).
+# Usage: benchmarks/run_pgo_bench.sh [vsopc]   (from the vsopcompiler folder)
+
+VSOPC=${1:-./vsopc}
+RUNS=${RUNS:-5}
+TIMEFORMAT=%R
+
+# best_time <vsopc arguments...>
+best_time() {
+    for _ in $(seq "$RUNS"); do
+        { time $VSOPC "$@" > /dev/null; } 2>&1
+    done | sort -n | head -n 1
+}
+
+# speedup <base time> <new time>
+speedup() {
+    awk -v b="$1" -v n="$2" 'BEGIN { printf "%.2f", b / n }'
+}
+
+printf "%-24s %8s %8s %8s %8s %8s %8s  %s\n" "program" "-x (s)" "pgo (s)" "speedup" "jit (s)" "pgo (s)" "speedup" "pgo"
+for file in benchmarks/pgo/*.vsop; do
+    $VSOPC --profile -x "$file" > /dev/null 2>&1
+    profile="$file.profdata"
+    for options in "" "--jit"; do
+        if [ "$($VSOPC $options -x "$file")" != "$($VSOPC $options --use-profile "$profile" -x "$file")" ]; then
+            echo "$file: output differs with $options --use-profile"
+            exit 1
+        fi
+    done
+    base_time=$(best_time -x "$file")
+    pgo_time=$(best_time --use-profile "$profile" -x "$file")
+    jit_time=$(best_time --jit -x "$file")
+    jit_pgo_time=$(best_time --jit --use-profile "$profile" -x "$file")
+    report=$(VSOP_PGO_REPORT=1 $VSOPC --use-profile "$profile" -x "$file" 2>&1 > /dev/null | sed 's/^pgo: //')
+
+    printf "%-24s %8s %8s %7sx %8s %8s %7sx  %s\n" "$(basename "$file")" "$base_time" "$pgo_time" \
+        "$(speedup "$base_time" "$pgo_time")" "$jit_time" "$jit_pgo_time" "$(speedup "$jit_time" "$jit_pgo_time")" "$report"
+done
+rm -f benchmarks/pgo/*_tempo benchmarks/pgo/*.folded benchmarks/pgo/*.profdata
@@ -0,0 +1,34 @@
+#!/bin/bash
+# Times the register allocation kernels under -x --jit, with every local in a stack slot
+# (the baseline) and with --jit-regalloc, and shows where the locals went. Each kernel is
+# called 100 times with a tiny input, until it is compiled, then 100 times for real.
+# Times are the best of RUNS runs (3 by default).
+# Usage: benchmarks/run_regalloc_bench.sh [vsopc]   (from the vsopcompiler folder)
+
+VSOPC=${1:-./vsopc}
+RUNS=${RUNS:-3}
+TIMEFORMAT=%R
+
+# best_time <vsopc arguments...>
+best_time() {
+    for _ in $(seq "$RUNS"); do
+        { time $VSOPC "$@" > /dev/null; } 2>&1
+    done | sort -n | head -n 1
+}
+
+printf "%-24s %10s %10s %8s  %s\n" "program" "stack (s)" "regs (s)" "speedup" "locals"
+for file in benchmarks/regalloc/*.vsop; do
+    base_out=$($VSOPC --jit -x "$file")
+    base_time=$(best_time --jit -x "$file")
+    reg_out=$($VSOPC --jit-regalloc -x "$file")
+    reg_time=$(best_time --jit-regalloc -x "$file")
+    locals=$(VSOP_JIT_REPORT=1 $VSOPC --jit-regalloc -x "$file" 2>&1 > /dev/null | sed -n 's/^jit: .*; //p')
+
+    if [ "$base_out" != "$reg_out" ]; then
+        echo "$file: output differs with --jit-regalloc"
+        exit 1
+    fi
+    speedup=$(awk -v b="$base_time" -v r="$reg_time" 'BEGIN { printf "%.2f", b / r }')
+    printf "%-24s %10s %10s %7sx  %s\n" "$(basename "$file")" "$base_time" "$reg_time" "$speedup" "$locals"
+done
+rm -f benchmarks/regalloc/*_tempo
@@ -0,0 +1,167 @@
+// Allocation micro-benchmarks of the VSOP runtime, with a GC pause-time report for each.
+// The classes are laid out as the compiler lays out tests/testListExample.vsop and a
+// binary tree; every benchmark checks its result so that a collector bug cannot go
+// unnoticed. The shared_ptr baseline is the allocation scheme of the interpreter (-x).
+//
+// Usage: alloc_bench [scale]   (make bench-runtime)
+
+#include "vsop_runtime.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+
+using namespace vsop;
+
+namespace {
+
+const ClassDescriptor listClass("List", &objectClass(), {}, {});
+const ClassDescriptor nilClass("Nil", &listClass, {}, {});
+const ClassDescriptor consClass("Cons", &listClass, {{"head", FieldKind::Int32}, {"tail", FieldKind::Object}}, {});
+const ClassDescriptor treeClass("Tree", &objectClass(),
+    {{"left", FieldKind::Object}, {"right", FieldKind::Object}, {"value", FieldKind::Int32}}, {});
+
+const uint32_t HEAD = consClass.fieldIndex("head");
+const uint32_t TAIL = consClass.fieldIndex("tail");
+const uint32_t LEFT = treeClass.fieldIndex("left");
+const uint32_t RIGHT = treeClass.fieldIndex("right");
+const uint32_t VALUE = treeClass.fieldIndex("value");
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void check(bool condition, const char* benchmark) {
+    if (!condition) {
+        std::fprintf(stderr, "%s: wrong result\n", benchmark);
+        std::exit(1);
+    }
+}
+
+void report(const char* name, size_t allocations, double seconds) {
+    std::printf("%-28s %10zu allocs %8.3f s %9.1f M allocs/s\n", name, allocations, seconds,
+                allocations / seconds / 1e6);
+}
+
+/** Short-lived objects: a Cons per iteration, only the last one survives */
+void shortLived(size_t count) {
+    resetGcStats();
+    Clock::time_point start = Clock::now();
+    Root<Object> nil(allocate(&nilClass));
+    Root<Object> last;
+    for (size_t i = 0; i < count; ++i) {
+        Object* cons = allocate(&consClass);
+        cons->setInt32(HEAD, static_cast<int32_t>(i));
+        cons->setRef(TAIL, nil);
+        last = cons;
+    }
+    double seconds = secondsSince(start);
+    check(last->getInt32(HEAD) == static_cast<int32_t>(count - 1) && last->getRef(TAIL) == nil.get(), "short-lived");
+    report("short-lived cons", count, seconds);
+    printGcReport(stdout);
+}
+
+struct SharedCons {
+    int32_t head;
+    std::shared_ptr<SharedCons> tail;
+};
+
+void shortLivedShared(size_t count) {
+    Clock::time_point start = Clock::now();
+    auto nil = std::make_shared<SharedCons>();
+    std::shared_ptr<SharedCons> last;
+    for (size_t i = 0; i < count; ++i) {
+        auto cons = std::make_shared<SharedCons>();
+        cons->head = static_cast<int32_t>(i);
+        cons->tail = nil;
+        last = std::move(cons);
+    }
+    double seconds = secondsSince(start);
+    check(last->head == static_cast<int32_t>(count - 1), "short-lived shared_ptr");
+    report("short-lived cons, shared_ptr", count, seconds);
+}
+
+/** Long lists kept alive while the next one is built: survivors are copied */
+void lists(size_t length, int rounds) {
+    resetGcStats();
+    Clock::time_point start = Clock::now();
+    Root<Object> previous;
+    for (int round = 0; round < rounds; ++round) {
+        Root<Object> list(allocate(&nilClass));
+        for (size_t i = 0; i < length; ++i) {
+            Object* cons = allocate(&consClass);
+            cons->setInt32(HEAD, static_cast<int32_t>(i));
+            cons->setRef(TAIL, list);
+            list = cons;
+        }
+        previous = list;
+    }
+    double seconds = secondsSince(start);
+
+    int64_t sum = 0;
+    size_t count = 0;
+    for (Object* node = previous; node->vtable == &consClass; node = node->getRef(TAIL)) {
+        sum += node->getInt32(HEAD);
+        count++;
+    }
+    check(count == length && sum == static_cast<int64_t>(length * (length - 1) / 2), "lists");
+    report("lists", rounds * (length + 1), seconds);
+    printGcReport(stdout);
+}
+
+Object* bottomUpTree(int depth) {
+    Root<Object> node(allocate(&treeClass));
+    node->setInt32(VALUE, depth);
+    if (depth > 0) {
+        Object* left = bottomUpTree(depth - 1);
+        storeRef(node, LEFT, left);
+        Object* right = bottomUpTree(depth - 1);
+        storeRef(node, RIGHT, right);
+    }
+    return node;
+}
+
+size_t checkTree(Object* node) {
+    if (!node->getRef(LEFT))
+        return 1;
+    return 1 + checkTree(node->getRef(LEFT)) + checkTree(node->getRef(RIGHT));
+}
+
+/** The binary-trees benchmark: a long-lived tree and many short-lived ones */
+void binaryTrees(int maxDepth) {
+    resetGcStats();
+    Clock::time_point start = Clock::now();
+    size_t allocations = 0;
+
+    Root<Object> longLived(bottomUpTree(maxDepth));
+    allocations += (size_t(2) << maxDepth) - 1;
+    for (int depth = 4; depth <= maxDepth; depth += 2) {
+        size_t iterations = size_t(1) << (maxDepth - depth + 4);
+        size_t nodes = 0;
+        for (size_t i = 0; i < iterations; ++i)
+            nodes += checkTree(bottomUpTree(depth));
+        check(nodes == iterations * ((size_t(2) << depth) - 1), "binary-trees");
+        allocations += nodes;
+    }
+    check(checkTree(longLived) == (size_t(2) << maxDepth) - 1, "binary-trees");
+    report("binary-trees", allocations, secondsSince(start));
+    printGcReport(stdout);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    double scale = argc > 1 ? std::atof(argv[1]) : 1.0;
+    if (scale <= 0) {
+        std::fprintf(stderr, "Usage: %s [scale]\n", argv[0]);
+        return 1;
+    }
+
+    shortLived(static_cast<size_t>(20e6 * scale));
+    shortLivedShared(static_cast<size_t>(20e6 * scale));
+    lists(static_cast<size_t>(1e6 * scale), 10);
+    binaryTrees(scale >= 1 ? 18 : 14);
+    return 0;
+}
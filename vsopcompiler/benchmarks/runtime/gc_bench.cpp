@@ -0,0 +1,107 @@
+// GC pause time and CPU share as the live heap grows, with and without generations.
+// A long-lived list of entries (the object graph of a service) stays alive while the
+// program churns through short-lived temporaries; every 64 temporaries, an entry gets a
+// new value through the write barrier, as a compiled field Assign would.
+//
+// Usage: gc_bench generational|semispace <live MiB> [million allocations]
+// benchmarks/runtime/run_gc_bench.sh runs the whole matrix (make bench-gc).
+
+#include "vsop_runtime.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+
+using namespace vsop;
+
+namespace {
+
+const ClassDescriptor boxClass("Box", &objectClass(), {{"payload", FieldKind::Int32}, {"next", FieldKind::Object}}, {});
+const ClassDescriptor entryClass("Entry", &objectClass(),
+    {{"key", FieldKind::Int32}, {"value", FieldKind::Object}, {"next", FieldKind::Object}}, {});
+
+const uint32_t PAYLOAD = boxClass.fieldIndex("payload");
+const uint32_t BOX_NEXT = boxClass.fieldIndex("next");
+const uint32_t KEY = entryClass.fieldIndex("key");
+const uint32_t VALUE = entryClass.fieldIndex("value");
+const uint32_t NEXT = entryClass.fieldIndex("next");
+
+Object* makeBox(int32_t payload) {
+    Object* box = allocate(&boxClass);
+    box->setInt32(PAYLOAD, payload);
+    return box;
+}
+
+void fail(const char* message) {
+    std::fprintf(stderr, "gc_bench: %s\n", message);
+    std::exit(1);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3 || (std::string(argv[1]) != "generational" && std::string(argv[1]) != "semispace")) {
+        std::fprintf(stderr, "Usage: %s generational|semispace <live MiB> [million allocations]\n", argv[0]);
+        return 1;
+    }
+    bool generational = std::string(argv[1]) == "generational";
+    size_t liveBytes = static_cast<size_t>(std::atof(argv[2]) * 1024 * 1024);
+    size_t allocations = static_cast<size_t>((argc > 3 ? std::atof(argv[3]) : 40) * 1e6);
+    initialize(8 << 20, generational ? 4 << 20 : 0);
+
+    // the long-lived graph: entries with a value each
+    size_t entries = liveBytes / (entryClass.instanceSize + boxClass.instanceSize);
+    Root<Object> head;
+    for (size_t i = 0; i < entries; ++i) {
+        Root<Object> entry(allocate(&entryClass));
+        entry->setInt32(KEY, static_cast<int32_t>(i));
+        entry->setRef(NEXT, head);
+        Object* value = makeBox(static_cast<int32_t>(i));
+        storeRef(entry, VALUE, value);
+        head = entry;
+    }
+
+    // the churn: short chains of temporaries, and updates of the graph, from a steady state
+    collect();
+    resetGcStats();
+    auto start = std::chrono::steady_clock::now();
+    Root<Object> cursor(head.get());
+    Root<Object> chain;
+    int64_t checksum = 0;
+    for (size_t i = 0; i < allocations; ++i) {
+        if (i % 64 == 63 && cursor) {
+            Object* value = makeBox(cursor->getInt32(KEY));
+            storeRef(cursor, VALUE, value);
+            cursor = cursor->getRef(NEXT) ? cursor->getRef(NEXT) : head.get();
+            continue;
+        }
+        Object* box = makeBox(static_cast<int32_t>(i));
+        box->setRef(BOX_NEXT, i % 8 ? chain.get() : nullptr);
+        chain = box;
+        checksum += chain->getInt32(PAYLOAD);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    GcStats stats = gcStats();
+
+    size_t count = 0;
+    for (Object* entry = head; entry; entry = entry->getRef(NEXT), ++count) {
+        if (entry->getRef(VALUE)->getInt32(PAYLOAD) != entry->getInt32(KEY))
+            fail("wrong value in the long-lived graph");
+    }
+    if (count != entries || checksum == 0)
+        fail("wrong long-lived graph");
+
+    std::vector<double> pauses = stats.pauses;
+    std::sort(pauses.begin(), pauses.end());
+    double total = 0;
+    for (double pause : pauses)
+        total += pause;
+    auto percentile = [&](double p) {
+        return pauses.empty() ? 0 : pauses[std::min(pauses.size() - 1, static_cast<size_t>(p * pauses.size()))];
+    };
+    std::printf("%-13s %8.0f %6zu %10.3f %10.3f %10.3f %8.1f%% %8.2f\n", argv[1], liveBytes / (1024.0 * 1024.0),
+                stats.collections, percentile(0.5), percentile(0.99), pauses.empty() ? 0 : pauses.back(),
+                100.0 * total / (seconds * 1000), seconds);
+    return 0;
+}
@@ -0,0 +1,141 @@
+// Throughput of the Object I/O built-ins of the runtime: printing and reading millions of
+// int32 values, against stdio and iostreams (what the interpreter uses) on the same data.
+//
+// Usage: io_bench [million values]   (make bench-io)
+
+#include "vsop_runtime.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+using namespace vsop;
+
+namespace {
+
+const char* dataPath = "/tmp/vsop_io_bench.txt";
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int32_t valueAt(size_t i) {
+    return static_cast<int32_t>(i * 2654435761u); // spread over the whole int32 range
+}
+
+off_t fileSize(const char* path) {
+    int fd = ::open(path, O_RDONLY);
+    off_t size = ::lseek(fd, 0, SEEK_END);
+    ::close(fd);
+    return size;
+}
+
+void report(const char* name, size_t values, double seconds, off_t bytes) {
+    std::printf("%-26s %8.3f s %9.1f M values/s %8.1f MB/s\n", name, seconds, values / seconds / 1e6,
+                bytes / seconds / 1e6);
+}
+
+// Points stdin or stdout at a file, returns the previous descriptor
+int redirect(int fd, const char* path, int flags) {
+    int saved = ::dup(fd);
+    int file = ::open(path, flags, 0644);
+    ::dup2(file, fd);
+    ::close(file);
+    return saved;
+}
+
+void restore(int fd, int saved) {
+    ::dup2(saved, fd);
+    ::close(saved);
+}
+
+void fail(const char* name) {
+    std::fprintf(stderr, "io_bench: %s read wrong values\n", name);
+    std::exit(1);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t count = static_cast<size_t>((argc > 1 ? std::atof(argv[1]) : 10) * 1e6);
+    Root<Object> self(allocate(&objectClass()));
+    Root<String> separator(makeString("\n"));
+    int64_t expected = 0;
+    for (size_t i = 0; i < count; ++i)
+        expected += valueAt(i);
+
+    // printing
+    std::fflush(stdout);
+    int saved = redirect(STDOUT_FILENO, dataPath, O_WRONLY | O_CREAT | O_TRUNC);
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < count; ++i)
+        print(printInt32(self, valueAt(i)), separator);
+    flush();
+    double seconds = secondsSince(start);
+    restore(STDOUT_FILENO, saved);
+    off_t bytes = fileSize(dataPath);
+    report("printInt32 (runtime)", count, seconds, bytes);
+
+    {
+        std::FILE* file = std::fopen(dataPath, "w");
+        start = Clock::now();
+        for (size_t i = 0; i < count; ++i)
+            std::fprintf(file, "%d\n", valueAt(i));
+        std::fclose(file);
+        report("fprintf", count, secondsSince(start), bytes);
+    }
+    {
+        std::ofstream file(dataPath);
+        start = Clock::now();
+        for (size_t i = 0; i < count; ++i)
+            file << valueAt(i) << "\n";
+        file.close();
+        report("ostream <<", count, secondsSince(start), bytes);
+    }
+
+    // reading the file written by the last writer
+    saved = redirect(STDIN_FILENO, dataPath, O_RDONLY);
+    start = Clock::now();
+    int64_t sum = 0;
+    for (size_t i = 0; i < count; ++i)
+        sum += inputInt32(self);
+    seconds = secondsSince(start);
+    restore(STDIN_FILENO, saved);
+    if (sum != expected)
+        fail("inputInt32");
+    report("inputInt32 (runtime)", count, seconds, bytes);
+
+    {
+        std::FILE* file = std::fopen(dataPath, "r");
+        start = Clock::now();
+        sum = 0;
+        int value;
+        for (size_t i = 0; i < count && std::fscanf(file, "%d", &value) == 1; ++i)
+            sum += value;
+        seconds = secondsSince(start);
+        std::fclose(file);
+        if (sum != expected)
+            fail("fscanf");
+        report("fscanf", count, seconds, bytes);
+    }
+    {
+        std::ifstream file(dataPath);
+        start = Clock::now();
+        sum = 0;
+        int value;
+        for (size_t i = 0; i < count && file >> value; ++i)
+            sum += value;
+        seconds = secondsSince(start);
+        if (sum != expected)
+            fail("istream >>");
+        report("istream >>", count, seconds, bytes);
+    }
+
+    std::remove(dataPath);
+    return 0;
+}
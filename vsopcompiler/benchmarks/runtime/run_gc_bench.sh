@@ -0,0 +1,12 @@
+#!/bin/bash
+# Pause time and GC share of the time as the live heap grows, with and without generations.
+# Usage: benchmarks/runtime/run_gc_bench.sh [gc_bench]   (from the vsopcompiler folder)
+
+GC_BENCH=${1:-./benchmarks/runtime/gc_bench}
+
+printf "%-13s %8s %6s %10s %10s %10s %9s %8s\n" "heap" "live MiB" "GCs" "p50 (ms)" "p99 (ms)" "max (ms)" "GC share" "time (s)"
+for live in 16 64 256; do
+    for mode in semispace generational; do
+        $GC_BENCH $mode $live || exit 1
+    done
+done
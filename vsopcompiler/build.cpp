@@ -0,0 +1,569 @@
+#ifndef BUILD_CPP
+#define BUILD_CPP
+
+#include "AST.hpp"
+#include "builtin_registry.cpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Separate compilation of a program in several files (-c with more than one file).
+//
+// Each file first gets its interface: for each of its classes, the name, the parent, the
+// fields with their types and the methods with their signatures, which is all that
+// checkClassInhiretence() and compareMethodsSignature() look at in the classes of other
+// files. It is read with the bodies skipped (as -o does) and kept in the build directory
+// as <file>.vsopi. A file is then checked as its own classes plus stub classes made from
+// the interfaces of the classes it needs: those its text names, and those their
+// declarations name in turn. Interfaces being pure declarations, no file waits for the
+// check of another one: both phases run their files in parallel, in worker processes
+// (the lexer and the parsers keep their state in globals).
+//
+// With --build-dir, the results stay in that directory for the next build: an interface
+// is read again only when its file changed, and a file is checked again only when its
+// text or the interface of a class it needs changed (or it had errors). Whether there is
+// a Main with a main method is checked last, from the interfaces. The output is that of
+// -c on the files put end to end; the errors are given file by file.
+
+extern void restart_lexer(unsigned int offset, unsigned int length, unsigned int line, unsigned int column);
+
+/**
+ * ProjectBuilder - Checks the files of a program separately, against the interfaces of the others
+ */
+class ProjectBuilder {
+public:
+    // The number of interfaces read and files checked by the last run (VSOP_BUILD_REPORT)
+    unsigned int interfacesRead = 0;
+    unsigned int filesChecked = 0;
+
+    ProjectBuilder(std::vector<std::string> paths, std::string buildDir, unsigned int jobs)
+        : buildDir(std::move(buildDir)), jobs(jobs ? jobs : 1) {
+        for (auto& path : paths) {
+            SourceFile file;
+            file.path = std::move(path);
+            files.push_back(std::move(file));
+        }
+    }
+
+    // Checks the program, prints its annotated AST on success, and returns the exit code
+    int run() {
+        for (SourceFile& file : files) {
+            if (!readFile(file.path, file.text)) {
+                std::cerr << "Error: Can't open file " << file.path << std::endl;
+                return EXIT_FAILURE;
+            }
+            file.hash = fnv(file.text);
+            file.key = keyOf(file.path);
+        }
+        bool temporary = buildDir.empty();
+        if (temporary) {
+            char pattern[] = "/tmp/vsopc-build-XXXXXX";
+            if (!mkdtemp(pattern)) {
+                std::cerr << "Error: Can't create a build directory" << std::endl;
+                return EXIT_FAILURE;
+            }
+            buildDir = pattern;
+        } else if (mkdir(buildDir.c_str(), 0755) != 0 && errno != EEXIST) {
+            std::cerr << "Error: Can't create the build directory " << buildDir << std::endl;
+            return EXIT_FAILURE;
+        }
+        int status = build();
+        if (temporary)
+            removeDirectory(buildDir);
+        return status;
+    }
+
+private:
+    /**
+     * Member - A field (no formals) or a method of an interface
+     */
+    struct Member {
+        std::string name;
+        std::string type; // of the field, or returned by the method
+        unsigned int line = 0;
+        unsigned int column = 0;
+        std::vector<std::pair<std::string, std::string>> formals; // names and types
+    };
+
+    /**
+     * Interface - The declarations of a class, without its bodies and initializers
+     */
+    struct Interface {
+        std::string name;
+        std::string parent;
+        unsigned int line = 0;
+        unsigned int column = 0;
+        std::vector<Member> fields;
+        std::vector<Member> methods;
+
+        // The declarations without their positions: what the checks of another file see
+        std::string signature() const {
+            std::string text = name + " extends " + parent + " {";
+            for (const Member& field : fields)
+                text += field.name + ":" + field.type + ";";
+            for (const Member& method : methods) {
+                text += method.name + "(";
+                for (const auto& formal : method.formals)
+                    text += formal.first + ":" + formal.second + ",";
+                text += "):" + method.type + ";";
+            }
+            return text + "}";
+        }
+
+        // The classes named by the declarations
+        std::vector<std::string> declDeps() const {
+            std::vector<std::string> deps{parent};
+            for (const Member& field : fields)
+                deps.push_back(field.type);
+            for (const Member& method : methods) {
+                deps.push_back(method.type);
+                for (const auto& formal : method.formals)
+                    deps.push_back(formal.second);
+            }
+            return deps;
+        }
+    };
+
+    /**
+     * SourceFile - A file of the program, and what the build knows of it
+     */
+    struct SourceFile {
+        std::string path;
+        std::string key; // of its results in the build directory
+        std::string text;
+        uint64_t hash = 0;
+        std::vector<Interface> classes;
+        std::vector<std::string> uses; // the type identifiers of its text
+        uint64_t stamp = 0;            // of its text and the interfaces it needs
+        int status = 0;
+        std::string errors;
+        std::string output;
+    };
+
+    std::vector<SourceFile> files;
+    std::string buildDir;
+    unsigned int jobs;
+    std::unordered_map<std::string, const Interface*> definitions; // the first of each class
+
+    int build() {
+        // Interfaces, of the files that changed
+        std::vector<size_t> tasks;
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (!readInterface(files[i]))
+                tasks.push_back(i);
+        }
+        std::vector<int> statuses = runInParallel(tasks, [this](size_t i) { return writeInterface(files[i]); });
+        interfacesRead = tasks.size();
+        bool failed = false;
+        for (size_t t = 0; t < tasks.size(); ++t) {
+            SourceFile& file = files[tasks[t]];
+            if (statuses[t] != 0 || !readInterface(file)) {
+                file.status = 1;
+                readFile(resultPath(file, ".err"), file.errors);
+                failed = true;
+            }
+        }
+        if (failed) {
+            for (const SourceFile& file : files)
+                std::cerr << file.errors;
+            return EXIT_FAILURE;
+        }
+
+        // The classes of the program: a class defined again is an error of the later file
+        std::string linkErrors;
+        for (const SourceFile& file : files) {
+            std::unordered_set<std::string> defined; // twice in the file: an error of its own check
+            for (const Interface& cls : file.classes) {
+                if (!definitions.emplace(cls.name, &cls).second && !defined.count(cls.name))
+                    linkErrors += error(file, cls.line, cls.column, "Class '" + cls.name + "' is defined more than once.");
+                defined.insert(cls.name);
+            }
+        }
+
+        // Checks, of the files whose text or needed interfaces changed
+        tasks.clear();
+        std::vector<std::vector<const Interface*>> needs(files.size());
+        for (size_t i = 0; i < files.size(); ++i) {
+            SourceFile& file = files[i];
+            std::string stampText = std::to_string(file.hash);
+            needs[i] = needed(file);
+            for (const Interface* cls : needs[i])
+                stampText += "\n" + cls->signature();
+            file.stamp = fnv(stampText);
+            uint64_t stamp = 0;
+            int status = 1;
+            std::string text;
+            if (readFile(resultPath(file, ".stamp"), text))
+                std::istringstream(text) >> stamp >> status;
+            if (stamp != file.stamp || status != 0 || !readFile(resultPath(file, ".out"), file.output))
+                tasks.push_back(i);
+        }
+        statuses = runInParallel(tasks, [this, &needs](size_t i) { return check(files[i], needs[i]); });
+        filesChecked = tasks.size();
+        for (size_t t = 0; t < tasks.size(); ++t) {
+            SourceFile& file = files[tasks[t]];
+            file.status = statuses[t];
+            file.output.clear();
+            if (file.status == 0)
+                readFile(resultPath(file, ".out"), file.output);
+            else
+                readFile(resultPath(file, ".err"), file.errors);
+            writeFile(resultPath(file, ".stamp"), std::to_string(file.stamp) + " " + std::to_string(file.status) + "\n");
+        }
+
+        // The program as a whole: its class Main
+        auto main = definitions.find("Main");
+        if (main == definitions.end())
+            linkErrors += error(files.front(), 0, 0, "No class 'Main' defined.");
+        else if (std::none_of(main->second->methods.begin(), main->second->methods.end(), [](const Member& method) {
+                     return method.name == "main" && method.formals.empty() && method.type == "int32";
+                 }))
+            linkErrors += error(files.front(), 0, 0, "Class 'Main' must have a 'main' method with no arguments and return type 'int32'.");
+
+        if (std::getenv("VSOP_BUILD_REPORT"))
+            std::cerr << "build: " << files.size() << " files, " << interfacesRead << " interfaces read, "
+                      << filesChecked << " files checked (" << files.size() - filesChecked << " up to date)" << std::endl;
+
+        bool accepted = linkErrors.empty();
+        for (const SourceFile& file : files) {
+            std::cerr << file.errors;
+            accepted = accepted && file.status == 0;
+        }
+        std::cerr << linkErrors;
+        if (!accepted)
+            return EXIT_FAILURE;
+        std::string program = "[";
+        for (const SourceFile& file : files) {
+            if (file.output.empty())
+                continue;
+            if (program.size() > 1)
+                program += Program::classSeparator;
+            program += file.output;
+        }
+        std::cout << program << "]" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    /* ======================== Interfaces ======================== */
+
+    // Worker: reads the declarations of a file, and writes them as its interface
+    int writeInterface(SourceFile& file) {
+        programText = file.text;
+        if (!lex(file))
+            return 1;
+        restart_lexer(0, programText.size(), 1, 1);
+        DescentParser parser;
+        parser.skipBodies = true;
+        parser.parse();
+
+        std::string text = "vsop-interface 1 " + std::to_string(file.hash) + "\nuses";
+        for (const std::string& name : typeIdentifiers(file.text))
+            text += " " + name;
+        text += "\n";
+        for (auto& cls : static_cast<Program*>(root.get())->getClasses()) {
+            text += "class " + cls->name + " " + cls->parent + " " + position(cls.get()) + "\n";
+            for (auto& field : cls->getFields())
+                text += "field " + field->getName() + " " + field->getTypeName() + " " + position(field.get()) + "\n";
+            for (auto& method : cls->getMethods()) {
+                text += "method " + method->getName() + " " + method->getReturnType().getName() + " " + position(method.get());
+                for (auto& formal : method->getFormals())
+                    text += " " + formal->getName() + " " + formal->getType().getName();
+                text += "\n";
+            }
+        }
+        return writeFile(resultPath(file, ".vsopi"), text) ? 0 : 1;
+    }
+
+    // Reads the interface of a file from the build directory, false if there is none for its text
+    bool readInterface(SourceFile& file) {
+        std::string text;
+        if (!readFile(resultPath(file, ".vsopi"), text))
+            return false;
+        std::istringstream lines(text);
+        std::string line, word;
+        uint64_t hash = 0;
+        if (!std::getline(lines, line) || !(std::istringstream(line) >> word >> word >> hash) || hash != file.hash)
+            return false;
+        file.classes.clear();
+        file.uses.clear();
+        while (std::getline(lines, line)) {
+            std::istringstream in(line);
+            in >> word;
+            if (word == "uses") {
+                while (in >> word)
+                    file.uses.push_back(word);
+            } else if (word == "class") {
+                Interface cls;
+                in >> cls.name >> cls.parent >> cls.line >> cls.column;
+                file.classes.push_back(std::move(cls));
+            } else if (!file.classes.empty() && (word == "field" || word == "method")) {
+                Member member;
+                in >> member.name >> member.type >> member.line >> member.column;
+                std::string name, type;
+                while (in >> name >> type)
+                    member.formals.emplace_back(name, type);
+                (word == "field" ? file.classes.back().fields : file.classes.back().methods).push_back(std::move(member));
+            }
+        }
+        return true;
+    }
+
+    // The interfaces of the other files that the checks of a file need
+    std::vector<const Interface*> needed(const SourceFile& file) {
+        std::unordered_set<std::string> own, seen;
+        for (const Interface& cls : file.classes)
+            own.insert(cls.name);
+        std::vector<std::string> pending = file.uses;
+        for (const Interface& cls : file.classes) {
+            for (const std::string& dep : cls.declDeps())
+                pending.push_back(dep);
+        }
+        std::vector<const Interface*> result;
+        while (!pending.empty()) {
+            std::string name = std::move(pending.back());
+            pending.pop_back();
+            if (own.count(name) || !seen.insert(name).second)
+                continue;
+            auto found = definitions.find(name);
+            if (found == definitions.end())
+                continue;
+            result.push_back(found->second);
+            for (const std::string& dep : found->second->declDeps())
+                pending.push_back(dep);
+        }
+        // in the order of their names, for the same stamp from one build to the next
+        std::sort(result.begin(), result.end(), [](const Interface* a, const Interface* b) { return a->name < b->name; });
+        return result;
+    }
+
+    /* ======================== Checks ======================== */
+
+    // Worker: checks the classes of a file, and writes their annotated AST
+    int check(SourceFile& file, const std::vector<const Interface*>& needs) {
+        programText = file.text + objectVsopContent;
+        if (!lex(file))
+            return 1;
+        restart_lexer(0, programText.size(), 1, 1);
+        DescentParser().parse();
+        Program* program = static_cast<Program*>(root.get());
+        std::vector<ClassNode*> own;
+        for (auto& cls : program->getClasses()) {
+            if (cls->name != "Object")
+                own.push_back(cls.get());
+        }
+
+        SemanticAnalyzer analyzer{file.path};
+        analyzer.requireMain = false;
+        for (const Interface* cls : needs) {
+            program->addClass(stub(*cls));
+            analyzer.summarized.insert(cls->name);
+        }
+        analyzer.analyzeHierarchy(program);
+        for (ClassNode* cls : own)
+            analyzer.analyzeClass(cls);
+        if (!analyzer.isAccepted)
+            return 1;
+        std::string output;
+        for (ClassNode* cls : own)
+            output += (output.empty() ? "" : Program::classSeparator) + cls->toString2();
+        return writeFile(resultPath(file, ".out"), output) ? 0 : 1;
+    }
+
+    // A class declared as its interface: the methods have empty bodies, which are not checked
+    static std::unique_ptr<ClassNode> stub(const Interface& cls) {
+        std::vector<std::unique_ptr<FieldNode>> fields;
+        for (const Member& field : cls.fields)
+            fields.push_back(std::make_unique<FieldNode>(field.name, Type(field.type), field.column, field.line));
+        std::vector<std::unique_ptr<MethodNode>> methods;
+        for (const Member& method : cls.methods) {
+            std::vector<std::unique_ptr<Formal>> formals;
+            for (const auto& formal : method.formals)
+                formals.push_back(std::make_unique<Formal>(formal.first, Type(formal.second)));
+            methods.push_back(std::make_unique<MethodNode>(method.name, Type(method.type), std::move(formals),
+                                                           std::make_unique<Block>(), method.column, method.line));
+        }
+        return std::make_unique<ClassNode>(cls.name, cls.parent, &fields, &methods, cls.column, cls.line);
+    }
+
+    // The first lexing pass of main(): the first lexical error is that of the file
+    static bool lex(const SourceFile& file) {
+        lexer_debug_mode = false;
+        restart_lexer(0, programText.size(), 1, 1);
+        int token;
+        while ((token = yylex()) != 0) {
+            if (token == ERROR) {
+                std::cerr << file.path << ":" << yylval.error_location.line_error << ":"
+                          << yylval.error_location.column_error << ": lexical error : " << error_message << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* ======================== Workers ======================== */
+
+    // Runs work(i) for each task in worker processes, at most 'jobs' at a time, and returns
+    // their exit codes. What a worker writes on stderr is kept in the .err of its file.
+    std::vector<int> runInParallel(const std::vector<size_t>& tasks, const std::function<int(size_t)>& work) {
+        std::vector<int> statuses(tasks.size(), 1);
+        std::unordered_map<pid_t, size_t> running;
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(nullptr);
+        size_t next = 0;
+        while (next < tasks.size() || !running.empty()) {
+            if (next < tasks.size() && running.size() < jobs) {
+                pid_t pid = fork();
+                if (pid == 0)
+                    _exit(runWorker(files[tasks[next]], [&work, &tasks, next]() { return work(tasks[next]); }));
+                if (pid > 0) {
+                    running[pid] = next++;
+                    continue;
+                }
+                if (running.empty()) { // cannot fork at all: run it here
+                    statuses[next] = runWorker(files[tasks[next]], [&work, &tasks, next]() { return work(tasks[next]); });
+                    ++next;
+                    continue;
+                }
+            }
+            int status;
+            pid_t pid = wait(&status);
+            if (pid < 0)
+                break;
+            auto found = running.find(pid);
+            if (found == running.end())
+                continue;
+            statuses[found->second] = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+            running.erase(found);
+        }
+        return statuses;
+    }
+
+    // The work of a worker on a file, its errors in the .err of the file
+    int runWorker(SourceFile& file, const std::function<int()>& work) {
+        int saved = dup(STDERR_FILENO);
+        int errors = open(resultPath(file, ".err").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (errors >= 0) {
+            dup2(errors, STDERR_FILENO);
+            close(errors);
+        }
+        fileName = const_cast<char*>(file.path.c_str());
+        throwCompileErrors = true;
+        int status;
+        try {
+            status = work();
+        } catch (const CompileError& error) {
+            std::cerr << file.path << ":" << error.line << ":" << error.column << ": " << error.message << std::endl;
+            status = 1;
+        }
+        throwCompileErrors = false;
+        std::cerr.flush();
+        fflush(nullptr);
+        dup2(saved, STDERR_FILENO);
+        close(saved);
+        return status;
+    }
+
+    /* ======================== Files ======================== */
+
+    std::string resultPath(const SourceFile& file, const char* extension) const {
+        return buildDir + "/" + file.key + extension;
+    }
+
+    // The name of the results of a file: its base name, and a hash of its path (for files of the same name)
+    static std::string keyOf(const std::string& path) {
+        std::string key = path.substr(path.find_last_of('/') + 1);
+        for (char& c : key) {
+            if (!isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '_' && c != '-')
+                c = '_';
+        }
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(fnv(path)));
+        return key + "-" + hash;
+    }
+
+    // The type identifiers of a text (a few in comments or strings do no harm)
+    static std::vector<std::string> typeIdentifiers(const std::string& text) {
+        auto isIdentifierChar = [](char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        };
+        std::vector<std::string> names;
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] >= 'A' && text[i] <= 'Z' && (i == 0 || !isIdentifierChar(text[i - 1]))) {
+                size_t j = i;
+                while (j < text.size() && isIdentifierChar(text[j]))
+                    ++j;
+                names.push_back(text.substr(i, j - i));
+                i = j;
+            }
+        }
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+        return names;
+    }
+
+    static std::string position(ASTNode* node) {
+        return std::to_string(node->getLine()) + " " + std::to_string(node->getColumn());
+    }
+
+    static std::string error(const SourceFile& file, unsigned int line, unsigned int column, const std::string& message) {
+        return file.path + ":" + std::to_string(line) + ":" + std::to_string(column) + ": semantic error: " + message + "\n";
+    }
+
+    // FNV-1a, 64 bits
+    static uint64_t fnv(const std::string& text) {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static bool readFile(const std::string& path, std::string& text) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        std::ostringstream content;
+        content << in.rdbuf();
+        text = content.str();
+        return true;
+    }
+
+    static bool writeFile(const std::string& path, const std::string& text) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << text;
+        return static_cast<bool>(out);
+    }
+
+    static void removeDirectory(const std::string& path) {
+        if (DIR* dir = opendir(path.c_str())) {
+            while (dirent* entry = readdir(dir)) {
+                if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+                    unlink((path + "/" + entry->d_name).c_str());
+            }
+            closedir(dir);
+        }
+        rmdir(path.c_str());
+    }
+};
+
+#endif // BUILD_CPP
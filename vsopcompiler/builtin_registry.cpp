@@ -0,0 +1,146 @@
+#ifndef BUILTIN_REGISTRY_CPP
+#define BUILTIN_REGISTRY_CPP
+
+#include "AST.hpp"
+
+#include <array>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// The types and the class that every program has without declaring them.
+//
+// The primitive types and the methods of Object are tables fixed at compile time, which
+// the checks look up without building anything. The class Object itself is that of
+// objectVsopContent: main() parses the program alone and adds the class that
+// prebuiltObjectClass() makes from the table, the nodes that the parser makes of the
+// text, in the same order and at the same positions (found in the text), as if the
+// program ended with it.
+
+// The types which are not classes
+constexpr std::array<std::string_view, 4> primitiveTypes = {"int32", "bool", "string", "unit"};
+
+constexpr bool isPrimitiveType(std::string_view name) {
+    for (std::string_view type : primitiveTypes) {
+        if (type == name)
+            return true;
+    }
+    return false;
+}
+
+// The text of Object, which the program is followed by when it is parsed with it (-o, the
+// multi-file -c, the language server and --object=parsed)
+constexpr const char* objectVsopContent = R""(
+        class Object {
+            print(s : string) : Object { (* print s on stdout, then return self*) self}
+            printBool(b: bool) : Object { (* print b on stdout, then return self *) self}
+            printInt32(i: int32) : Object { (* print i on stdout, then return self *) self}
+            inputLine() : string {
+                (* read one line from stdin, return "" in case of error *) ""}
+            inputBool() : bool {
+                (* read one boolean value from stdin, exit with error message in case of error *) true}
+            inputInt32() : int32 {
+                (* read one integer from stdin, exit with error message in case of error *) 0}
+        })"";
+
+/**
+ * TextPosition - A position in objectVsopContent, its line counted from the last line of
+ * the program, which the text continues
+ */
+struct TextPosition {
+    unsigned int line;
+    unsigned int column;
+};
+
+// The position of the first 'word' of the text followed by 'next', as the lexer counts it
+// (the text has no tab); not a constant if there is none
+constexpr TextPosition objectTextPosition(std::string_view word, char next) {
+    std::string_view text(objectVsopContent);
+    size_t at = text.find(word);
+    while (at != std::string_view::npos && text[at + word.size()] != next)
+        at = text.find(word, at + 1);
+    if (at == std::string_view::npos)
+        throw "not in the text of Object";
+    TextPosition position{0, 1};
+    for (size_t i = 0; i < at; ++i) {
+        if (text[i] == '\n') {
+            ++position.line;
+            position.column = 1;
+        } else {
+            ++position.column;
+        }
+    }
+    return position;
+}
+
+// Where the lexer is after the keyword that begins the text, and the name of the class
+constexpr TextPosition objectKeywordEnd = [] {
+    TextPosition position = objectTextPosition("class", ' ');
+    position.column += std::string_view("class").size();
+    return position;
+}();
+constexpr TextPosition objectNamePosition = objectTextPosition("Object", ' ');
+
+/**
+ * ObjectMethod - A method of Object, as objectVsopContent declares it
+ */
+struct ObjectMethod {
+    enum Body { SelfValue, EmptyString, TrueValue, Zero };
+
+    std::string_view name;
+    std::string_view formal;     // empty if it has none
+    std::string_view formalType;
+    std::string_view returnType;
+    Body body;                   // the only expression of the body
+};
+
+// In the order of the text
+constexpr std::array<ObjectMethod, 6> objectMethods = {{
+    {"print", "s", "string", "Object", ObjectMethod::SelfValue},
+    {"printBool", "b", "bool", "Object", ObjectMethod::SelfValue},
+    {"printInt32", "i", "int32", "Object", ObjectMethod::SelfValue},
+    {"inputLine", "", "", "string", ObjectMethod::EmptyString},
+    {"inputBool", "", "", "bool", ObjectMethod::TrueValue},
+    {"inputInt32", "", "", "int32", ObjectMethod::Zero},
+}};
+
+// The positions of their names in the text
+constexpr std::array<TextPosition, objectMethods.size()> objectMethodPositions = [] {
+    std::array<TextPosition, objectMethods.size()> positions{};
+    for (size_t i = 0; i < objectMethods.size(); ++i)
+        positions[i] = objectTextPosition(objectMethods[i].name, '(');
+    return positions;
+}();
+
+// The class Object after a program whose last line is 'line'
+inline std::unique_ptr<ClassNode> prebuiltObjectClass(unsigned int line) {
+    std::vector<std::unique_ptr<FieldNode>> fields;
+    std::vector<std::unique_ptr<MethodNode>> methods;
+    // class_body adds each method in front of those after it
+    for (size_t i = objectMethods.size(); i-- > 0;) {
+        const ObjectMethod& method = objectMethods[i];
+        const TextPosition& position = objectMethodPositions[i];
+        auto block = std::make_unique<Block>();
+        switch (method.body) {
+        case ObjectMethod::SelfValue:   block->addExpr(std::make_unique<Self>("self")); break;
+        case ObjectMethod::EmptyString: block->addExpr(std::make_unique<StringLiteral>(std::string_view(), false)); break;
+        case ObjectMethod::TrueValue:   block->addExpr(std::make_unique<BooleanLiteral>(true)); break;
+        case ObjectMethod::Zero:        block->addExpr(std::make_unique<IntegerLiteral>(0)); break;
+        }
+        std::string name(method.name);
+        Type returnType{std::string(method.returnType)};
+        if (method.formal.empty()) {
+            methods.push_back(std::make_unique<MethodNode>(name, returnType, std::move(block),
+                                                           position.column, line + position.line));
+        } else {
+            std::vector<std::unique_ptr<Formal>> formals;
+            formals.push_back(std::make_unique<Formal>(std::string(method.formal), Type(std::string(method.formalType))));
+            methods.push_back(std::make_unique<MethodNode>(name, returnType, std::move(formals), std::move(block),
+                                                           position.column, line + position.line));
+        }
+    }
+    return std::make_unique<ClassNode>("Object", "Object", &fields, &methods, objectNamePosition.column,
+                                       line + objectNamePosition.line);
+}
+
+#endif
@@ -0,0 +1,509 @@
+#ifndef CSE_CPP
+#define CSE_CPP
+
+#include "AST.hpp"
+#include "effects.cpp"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <string>
+#include <vector>
+
+// Common subexpression elimination over the typed AST (--cse).
+//
+// Pure expressions are hash-consed: each one gets a value number, the same for the
+// expressions with the same operator and operands of the same value numbers, in either
+// order for the commutative '+', '*', '=' and 'and'. Pure means without effect, runtime
+// error or divergence (Effects::isHoistable): literals, identifiers, self, operations (a
+// division only by a non-zero literal) and calls on self of the methods that
+// EffectAnalyzer finds pure.
+//
+// A method body is walked in evaluation order with the value numbers available there:
+// computed on every path to that point, and since then none of the variables they read
+// assigned, nor fields they read written by a call. What a branch of an if, the right
+// operand of an 'and', or the condition or the body of a loop computes is available only
+// inside it, and a loop first makes unavailable what it assigns. An expression whose
+// value number is available repeats the first one, which dominates it: the first one is
+// bound by a 'let _cseN' around their closest common ancestor (around the statements that
+// contain them, for a block), and both are replaced by the variable. Evaluating it a bit
+// earlier is sound as it is pure.
+// A variable is used only if the repeats on one path cost more than it (see letCost). A
+// pass replaces the smallest repeated expressions; a body is run again until nothing is
+// replaced, for the larger ones that repeat in terms of their variables.
+//
+// Introduced variables start with '_', as those of LoopOptimizer. Must run after
+// SemanticAnalyzer::analyze.
+
+class CommonSubexpressionEliminator {
+public:
+    void run(Program* program) {
+        effects.run(program);
+
+        for (auto& cls : program->getClasses()) {
+            if (cls->name == "Object")
+                continue;
+            for (auto& method : cls->getMethods()) {
+                currentClass = cls->name;
+                Block* body = method->getBlock();
+                while (body && eliminate(body))
+                    passes++;
+            }
+        }
+    }
+
+    // Statistics of the last run
+    size_t reusedExpressions = 0;   // expressions bound to a variable
+    size_t replacedRepeats = 0;     // repeats replaced by that variable
+    size_t passes = 0;              // passes that replaced something
+
+private:
+    static constexpr uint32_t NoValue = UINT32_MAX;
+
+    // Costs in evaluated nodes for the interpreter: a let and a call (its frame) cost about
+    // as much as that many operations on variables. A let also slows down the lookups of
+    // the other variables in its scope, which go through it.
+    static constexpr size_t letCost = 8;
+    static constexpr size_t callCost = 8;
+
+    /**
+     * Node - A node of the body being walked, numbered in evaluation order. Its subtree is
+     * the nodes from its number to 'end' (excluded).
+     */
+    struct Node {
+        Expr* expr;
+        std::unique_ptr<Expr>* slot; // null for the body
+        uint32_t parent;
+        uint32_t position;           // in the children of the parent
+        uint32_t end;
+    };
+
+    /**
+     * Group - The first occurrence of an available value number and its repeats
+     */
+    struct Group {
+        uint32_t value;
+        std::vector<uint32_t> occurrences;
+    };
+
+    /**
+     * Reuse - A group being replaced: 'let temp <- init' around the node 'scope', or
+     * around its statements 'first' to 'last' if it is a block
+     */
+    struct Reuse {
+        std::string temp;
+        std::string type;
+        std::unique_ptr<Expr> init;
+        uint32_t scope;
+        uint32_t first, last;
+    };
+
+    EffectAnalyzer effects;
+    std::unordered_map<std::string, Effects> callEffects; // by receiver type and method
+    std::string currentClass;
+    unsigned int tempCounter = 0;
+
+    // Hash-consing of the pure expressions: the value number of each key, the names read by each value
+    std::unordered_map<std::string, uint32_t> valueOf;
+    std::vector<std::vector<uint32_t>> readsOf;
+    std::unordered_map<std::string, uint32_t> nameIds;
+    std::string keyBuffer;
+
+    // The walk of a body
+    std::vector<Node> nodes;
+    std::vector<Group> groups;
+    std::unordered_map<uint32_t, uint32_t> available;               // value number -> group
+    std::vector<uint32_t> availableLog;                              // value numbers made available, in order
+    std::unordered_map<uint32_t, std::vector<uint32_t>> readersOf;   // name -> available value numbers reading it
+
+    struct PathCount {
+        size_t always = 0, branch = 0;
+        bool touched = false;
+    };
+    std::vector<PathCount> pathCounts; // by node, see onOnePath
+
+    uint32_t nameId(const std::string& name) {
+        return nameIds.emplace(name, (uint32_t)nameIds.size()).first->second;
+    }
+
+    const Effects& effectsOfCall(Call* call) {
+        std::string key = call->getClassName() + "." + call->getMethodName();
+        auto it = callEffects.find(key);
+        if (it == callEffects.end())
+            it = callEffects.emplace(key, effects.callEffects(call->getClassName(), call->getMethodName())).first;
+        return it->second;
+    }
+
+    /* ======================== Value numbers ======================== */
+
+    // The value number of 'expr', whose children have the 'count' value numbers 'operands',
+    // or NoValue if it is not pure
+    uint32_t valueNumber(Expr* expr, const uint32_t* operands, size_t count) {
+        std::string& key = keyBuffer;
+        std::string readName;                  // the variable it reads itself
+        const Effects* callee = nullptr;
+        if (auto integer = dynamic_cast<IntegerLiteral*>(expr)) {
+            key.assign("i").append(std::to_string(integer->getValue()));
+        } else if (auto identifier = dynamic_cast<ObjectIdentifier*>(expr)) {
+            readName = identifier->getName();
+            key.assign("v").append(readName);
+        } else if (auto binOp = dynamic_cast<BinaryOperation*>(expr)) {
+            const std::string& op = binOp->getOperator();
+            if (op == "/") {
+                auto divisor = dynamic_cast<IntegerLiteral*>(binOp->getRight());
+                if (!divisor || divisor->getValue() == 0)
+                    return NoValue;
+            }
+            uint32_t left = operands[0], right = operands[1];
+            if ((op == "+" || op == "*" || op == "=" || op == "and") && right < left)
+                std::swap(left, right);
+            key.assign(op).append(" ").append(std::to_string(left)).append(" ").append(std::to_string(right));
+        } else if (auto call = dynamic_cast<Call*>(expr)) {
+            if (!dynamic_cast<Self*>(call->getExprObjectIdentifier()))
+                return NoValue; // the receiver could be null
+            callee = &effectsOfCall(call);
+            if (!callee->isHoistable())
+                return NoValue;
+            key.assign(".").append(currentClass).append(".").append(call->getMethodName());
+            for (size_t i = 0; i < count; ++i)
+                key.append(" ").append(std::to_string(operands[i]));
+        } else if (auto unOp = dynamic_cast<UnOp*>(expr)) {
+            key.assign(unOp->getOp()).append(" ").append(std::to_string(operands[0]));
+        } else if (auto boolean = dynamic_cast<BooleanLiteral*>(expr)) {
+            key = boolean->getValue() ? "true" : "false";
+        } else if (auto string = dynamic_cast<StringLiteral*>(expr)) {
+            key.assign("\"").append(string->getString());
+        } else if (dynamic_cast<Self*>(expr)) {
+            key = "self";
+        } else if (dynamic_cast<Parenthesis*>(expr)) {
+            key = "()";
+        } else {
+            return NoValue;
+        }
+
+        auto it = valueOf.find(key);
+        if (it != valueOf.end())
+            return it->second;
+        std::vector<uint32_t> reads;
+        if (!readName.empty())
+            reads.push_back(nameId(readName));
+        if (callee) {
+            for (const std::string& field : callee->readFields)
+                reads.push_back(nameId(field));
+        }
+        for (size_t i = 0; i < count; ++i)
+            reads.insert(reads.end(), readsOf[operands[i]].begin(), readsOf[operands[i]].end());
+        std::sort(reads.begin(), reads.end());
+        reads.erase(std::unique(reads.begin(), reads.end()), reads.end());
+        readsOf.push_back(std::move(reads));
+        return valueOf.emplace(key, (uint32_t)readsOf.size() - 1).first->second;
+    }
+
+    // Operations and calls are worth a variable; literals, identifiers and self are not
+    static bool isWorthReusing(Expr* expr) {
+        if (auto unOp = dynamic_cast<UnOp*>(expr))
+            return !dynamic_cast<IntegerLiteral*>(unOp->getExpr()) && !dynamic_cast<BooleanLiteral*>(unOp->getExpr());
+        return dynamic_cast<BinaryOperation*>(expr) || dynamic_cast<Call*>(expr);
+    }
+
+    /* ======================== Availability ======================== */
+
+    void noteOccurrence(uint32_t value, uint32_t node) {
+        auto it = available.find(value);
+        if (it != available.end()) {
+            groups[it->second].occurrences.push_back(node);
+            return;
+        }
+        available[value] = (uint32_t)groups.size();
+        groups.push_back({value, {node}});
+        availableLog.push_back(value);
+        for (uint32_t name : readsOf[value])
+            readersOf[name].push_back(value);
+    }
+
+    // 'name' is assigned (or bound by a let): what reads it is not available anymore
+    void kill(const std::string& name) {
+        auto id = nameIds.find(name);
+        if (id == nameIds.end())
+            return;
+        auto readers = readersOf.find(id->second);
+        if (readers == readersOf.end())
+            return;
+        for (uint32_t value : readers->second)
+            available.erase(value);
+        readers->second.clear();
+    }
+
+    // What was made available since 'mark' (the size of availableLog) is not anymore
+    void unmark(size_t mark) {
+        for (size_t i = mark; i < availableLog.size(); ++i)
+            available.erase(availableLog[i]);
+        availableLog.resize(mark);
+    }
+
+    // Kills what 'expr' itself assigns or writes when it is evaluated
+    void killWrites(Expr* expr) {
+        if (auto assign = dynamic_cast<Assign*>(expr)) {
+            kill(assign->getName());
+        } else if (auto call = dynamic_cast<Call*>(expr)) {
+            for (const std::string& field : effectsOfCall(call).writtenFields)
+                kill(field);
+        } else if (dynamic_cast<New*>(expr)) {
+            // the initializers of the new object may call methods that write fields
+            for (const std::string& field : effects.expressionEffects(expr, {}).writtenFields)
+                kill(field);
+        }
+    }
+
+    /* ======================== Walk ======================== */
+
+    // Whether the child number 'index' of 'expr' starts a part that is not always
+    // evaluated after the preceding ones, or evaluated several times. The condition and
+    // the body of a loop are both parts: a variable around the loop would not be evaluated
+    // again on each iteration.
+    static bool startsBranch(Expr* expr, size_t index) {
+        if (dynamic_cast<Conditional*>(expr))
+            return index >= 1;
+        if (dynamic_cast<WhileLoop*>(expr))
+            return true;
+        auto binOp = dynamic_cast<BinaryOperation*>(expr);
+        return binOp && binOp->getOperator() == "and" && index == 1;
+    }
+
+    // Numbers the nodes of 'body' and finds the groups of the repeated pure expressions
+    void walk(Block* body) {
+        struct Frame {
+            uint32_t node;
+            std::vector<std::unique_ptr<Expr>*> children;
+            size_t next;
+            size_t mark;                  // size of availableLog at the start of the current branch
+            bool pure;                    // all the children so far have a value number
+            size_t values;                // where the value numbers of its children start in 'values'
+        };
+        std::vector<uint32_t> values;
+        const size_t noMark = SIZE_MAX;
+        nodes.clear();
+        groups.clear();
+        available.clear();
+        availableLog.clear();
+        readersOf.clear();
+
+        nodes.push_back({body, nullptr, 0, 0, 0});
+        std::vector<Frame> frames{{0, body->getChildren(), 0, noMark, true, 0}};
+        while (!frames.empty()) {
+            Frame& frame = frames.back();
+            Expr* expr = nodes[frame.node].expr;
+            if (frame.next < frame.children.size()) {
+                size_t index = frame.next++;
+                if (startsBranch(expr, index)) {
+                    if (frame.mark != noMark)
+                        unmark(frame.mark);
+                    frame.mark = availableLog.size();
+                }
+                if (auto let = dynamic_cast<Let*>(expr); let && index + 1 == frame.children.size())
+                    kill(let->getName()); // the scope sees the variable of the let
+                std::unique_ptr<Expr>* child = frame.children[index];
+                if (!*child) {
+                    frame.pure = false;
+                    values.push_back(NoValue);
+                    continue;
+                }
+                if (auto loop = dynamic_cast<WhileLoop*>(child->get()))
+                    killLoopWrites(loop);
+                uint32_t node = (uint32_t)nodes.size();
+                nodes.push_back({child->get(), child, frame.node, (uint32_t)index, 0});
+                frames.push_back({node, (*child)->getChildren(), 0, noMark, true, values.size()});
+                continue;
+            }
+
+            if (frame.mark != noMark)
+                unmark(frame.mark);
+            if (auto let = dynamic_cast<Let*>(expr))
+                kill(let->getName());
+            uint32_t value = frame.pure ? valueNumber(expr, values.data() + frame.values, values.size() - frame.values) : NoValue;
+            if (value != NoValue && isWorthReusing(expr))
+                noteOccurrence(value, frame.node);
+            killWrites(expr);
+            nodes[frame.node].end = (uint32_t)nodes.size();
+            values.resize(frame.values);
+            frames.pop_back();
+            if (!frames.empty()) {
+                frames.back().pure &= value != NoValue;
+                values.push_back(value);
+            }
+        }
+    }
+
+    // A loop evaluates its parts again with what it assigns: none of it is available inside
+    void killLoopWrites(WhileLoop* loop) {
+        forEachExpr(loop, [&](Expr* expr) {
+            if (dynamic_cast<Assign*>(expr) || dynamic_cast<Call*>(expr) || dynamic_cast<New*>(expr))
+                killWrites(expr);
+        });
+    }
+
+    // What evaluating the subtree of 'node' costs, in nodes
+    size_t cost(uint32_t node) const {
+        size_t total = 0;
+        for (uint32_t i = node; i < nodes[node].end; ++i)
+            total += dynamic_cast<Call*>(nodes[i].expr) ? callCost : 1;
+        return total;
+    }
+
+    // How many of 'occurrences' (repeats of one value) the subtree of 'scope' evaluates on
+    // its path that evaluates the most of them: only one branch of an if is taken
+    size_t onOnePath(uint32_t scope, const std::vector<uint32_t>& occurrences) {
+        // for the nodes from the occurrences up to the scope, how many of them are evaluated
+        // always and how many at most in a branch
+        pathCounts.resize(nodes.size());
+        std::vector<uint32_t> touched;
+        for (uint32_t node : occurrences) {
+            pathCounts[node] = {1, 0, true};
+            touched.push_back(node);
+            for (; node != scope && !pathCounts[nodes[node].parent].touched; node = nodes[node].parent) {
+                pathCounts[nodes[node].parent] = {0, 0, true};
+                touched.push_back(nodes[node].parent);
+            }
+        }
+        // the children before their parent
+        std::sort(touched.begin(), touched.end(), std::greater<uint32_t>());
+        for (uint32_t node : touched) {
+            if (node == scope)
+                break;
+            size_t count = pathCounts[node].always + pathCounts[node].branch;
+            PathCount& parent = pathCounts[nodes[node].parent];
+            if (dynamic_cast<Conditional*>(nodes[nodes[node].parent].expr) && nodes[node].position > 0)
+                parent.branch = std::max(parent.branch, count);
+            else
+                parent.always += count;
+        }
+        size_t count = pathCounts[scope].always + pathCounts[scope].branch;
+        for (uint32_t node : touched)
+            pathCounts[node] = {};
+        return count;
+    }
+
+    bool contains(uint32_t node, uint32_t other) const {
+        return node <= other && other < nodes[node].end;
+    }
+
+    // The ancestor of 'node' that is a child of 'ancestor'
+    uint32_t childOf(uint32_t ancestor, uint32_t node) const {
+        while (nodes[node].parent != ancestor)
+            node = nodes[node].parent;
+        return node;
+    }
+
+    /* ======================== Replacement ======================== */
+
+    // Replaces the repeats of one pass over 'body', returns false if there were none
+    bool eliminate(Block* body) {
+        walk(body);
+
+        // the smallest expressions first: once they are replaced, the larger ones that
+        // contain them repeat in terms of their variables, for the next pass
+        std::vector<uint32_t> order;
+        for (uint32_t i = 0; i < groups.size(); ++i) {
+            if (groups[i].occurrences.size() > 1)
+                order.push_back(i);
+        }
+        auto size = [&](uint32_t group) {
+            uint32_t first = groups[group].occurrences[0];
+            return nodes[first].end - first;
+        };
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return size(a) < size(b); });
+
+        std::map<uint32_t, uint32_t> replaced; // subtrees of the occurrences replaced, first node -> end
+        auto overlaps = [&](uint32_t node) {
+            auto next = replaced.lower_bound(node);
+            if (next != replaced.end() && next->first < nodes[node].end)
+                return true;
+            return next != replaced.begin() && std::prev(next)->second > node;
+        };
+        std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, uint32_t>>> blockRanges;
+        std::vector<Reuse> reuses;
+        for (uint32_t group : order) {
+            std::vector<uint32_t> occurrences;
+            for (uint32_t node : groups[group].occurrences) {
+                if (!overlaps(node))
+                    occurrences.push_back(node);
+            }
+            if (occurrences.size() < 2 || occurrences[0] != groups[group].occurrences[0])
+                continue;
+
+            uint32_t first = occurrences.front(), last = occurrences.back();
+            uint32_t scope = nodes[first].parent;
+            while (!contains(scope, last))
+                scope = nodes[scope].parent;
+            if ((onOnePath(scope, occurrences) - 1) * (cost(first) - 1) < letCost)
+                continue; // the repeats are cheaper than the variable
+            Reuse reuse{"", "", nullptr, scope, 0, 0};
+            if (dynamic_cast<Block*>(nodes[scope].expr)) {
+                reuse.first = nodes[childOf(scope, first)].position;
+                reuse.last = nodes[childOf(scope, last)].position;
+                auto& ranges = blockRanges[scope];
+                bool overlaps = std::any_of(ranges.begin(), ranges.end(), [&](const auto& range) {
+                    return range.first <= reuse.last && reuse.first <= range.second;
+                });
+                if (overlaps)
+                    continue; // for the next pass
+                ranges.push_back({reuse.first, reuse.last});
+            }
+
+            for (uint32_t node : occurrences)
+                replaced[node] = nodes[node].end;
+            reuse.temp = "_cse" + std::to_string(tempCounter++);
+            reuse.type = nodes[first].expr->getTypeName();
+            for (uint32_t node : occurrences) {
+                std::unique_ptr<Expr>& slot = *nodes[node].slot;
+                auto identifier = std::make_unique<ObjectIdentifier>(reuse.temp, slot->getColumn(), slot->getLine());
+                identifier->setTypeByName(reuse.type);
+                if (node == first)
+                    reuse.init = std::move(slot);
+                slot = std::move(identifier);
+            }
+            reusedExpressions++;
+            replacedRepeats += occurrences.size() - 1;
+            reuses.push_back(std::move(reuse));
+        }
+        if (reuses.empty())
+            return false;
+
+        // the lets around single nodes, then those around statements, which move them
+        for (Reuse& reuse : reuses) {
+            if (!dynamic_cast<Block*>(nodes[reuse.scope].expr))
+                wrapInLet(*nodes[reuse.scope].slot, reuse.temp, reuse.type, std::move(reuse.init));
+        }
+        std::stable_sort(reuses.begin(), reuses.end(), [](const Reuse& a, const Reuse& b) { return a.first > b.first; });
+        for (Reuse& reuse : reuses) {
+            auto block = dynamic_cast<Block*>(nodes[reuse.scope].expr);
+            if (!block)
+                continue;
+            auto& statements = block->getExprs();
+            std::vector<std::unique_ptr<Expr>> range;
+            for (uint32_t i = reuse.first; i <= reuse.last; ++i)
+                range.push_back(std::move(statements[i]));
+            statements.erase(statements.begin() + reuse.first + 1, statements.begin() + reuse.last + 1);
+            std::string type = range.back()->getTypeName();
+            unsigned int column = range.front()->getColumn(), line = range.front()->getLine();
+            std::unique_ptr<Expr> scope = std::make_unique<Block>(std::move(range));
+            scope->setTypeByName(type);
+            scope->setColumn(column);
+            scope->setLine(line);
+            statements[reuse.first] = std::move(scope);
+            wrapInLet(statements[reuse.first], reuse.temp, reuse.type, std::move(reuse.init));
+        }
+        return true;
+    }
+
+    // Replaces the expression in 'slot' by 'let name : type <- init in <slot>'
+    static void wrapInLet(std::unique_ptr<Expr>& slot, const std::string& name, const std::string& type, std::unique_ptr<Expr> init) {
+        std::string resultType = slot->getTypeName();
+        unsigned int column = slot->getColumn(), line = slot->getLine();
+        auto let = std::make_unique<Let>(name, Type(type), column, line, std::move(init), std::move(slot));
+        let->setTypeByName(resultType);
+        slot = std::move(let);
+    }
+};
+
+#endif // CSE_CPP
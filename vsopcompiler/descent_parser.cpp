@@ -0,0 +1,544 @@
+#ifndef DESCENT_PARSER_CPP
+#define DESCENT_PARSER_CPP
+
+#include "AST.hpp"
+#include "parser.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+// Hand-written parser for the grammar of parser.y (--parser=descent): recursive descent
+// for classes, members and blocks, precedence climbing (Pratt) for expressions.
+//
+// It reads the same yylex() tokens and builds the same AST as yyparse(), owning the
+// nodes through unique_ptr from the start instead of passing void* through %union, and
+// keeping lists in local vectors. The class body being right recursive in parser.y, the
+// fields and methods of a class end up there in reverse order: they are reversed here too.
+//
+// Syntax errors are reported at the same token and with the same message as bison's
+// parser, which calls yyerror("syntax error") on the first token it cannot shift (its
+// 'error' rules are never reached) and runs the actions of a few rules first, through its
+// default reductions: "Invalid Type !" where a type is missing, "Method without
+// implementationt !" and "Unclosed argument list of the Method !". As bison reads a
+// lookahead only when it needs one, so does this parser, so that yyline and yycolumn are
+// the same when an error is reported.
+//
+// Nesting recurses on the call stack: once the stack limit is nearly reached, parsing
+// fails with "memory exhausted", as yyparse() does when its own stack is full.
+//
+// With skipBodies (--lazy-bodies, -o), the tokens of a method body are only brace-matched:
+// the method keeps where the body is in the program text, and the body is parsed from
+// there the first time it is needed (parseMethodBody(), after the class). Without the
+// first lexing pass of main (-o), lexical errors are reported here as they are met.
+
+void reportLexicalError(std::string message, unsigned int line, unsigned int column);
+void restart_lexer(unsigned int offset, unsigned int length, unsigned int line, unsigned int column);
+
+class DescentParser {
+public:
+    bool skipBodies = false;
+
+    /**
+     * ParsedClass - A class parsed by parseClasses(), and where it is in the input
+     */
+    struct ParsedClass {
+        std::unique_ptr<ClassNode> node;
+        unsigned int offset; // of the 'class' keyword
+        unsigned int length; // up to its '}'
+        unsigned int line;
+        unsigned int column;
+    };
+
+    // Parses the whole input; on success 'root' is the program and 0 is returned, as by yyparse()
+    int parse() {
+        measureStack();
+        auto program = std::make_unique<Program>();
+        do {
+            program->addClass(parseClass());
+        } while (peek() == CLASS);
+        if (peek() != 0)
+            yyerror("syntax error");
+        root = std::move(program);
+        return 0;
+    }
+
+    // Parses the classes up to the end of the input, which may have none (--lsp, which
+    // parses again only the part of a document that changed)
+    std::vector<ParsedClass> parseClasses() {
+        measureStack();
+        std::vector<ParsedClass> classes;
+        while (peek() == CLASS) {
+            ParsedClass parsed;
+            parsed.offset = yyoffset - 5;
+            parsed.line = lookahead.location.first_line;
+            parsed.column = lookahead.location.first_column;
+            parsed.node = parseClass();
+            parsed.length = yyoffset - parsed.offset;
+            classes.push_back(std::move(parsed));
+        }
+        if (peek() != 0)
+            yyerror("syntax error");
+        return classes;
+    }
+
+    // Parses a body skipped by parse(), the lexer restarted at its '{'. The stack is
+    // measured from where parse() started: a pass may ask for the body deep in its recursion.
+    std::unique_ptr<Block> parseBody() {
+        return parseBlock();
+    }
+
+private:
+    /**
+     * Token - A token read by yylex(), with its semantic value and location
+     */
+    struct Token {
+        int kind;
+        YYSTYPE value;
+        YYLTYPE location;
+    };
+
+    // Binding powers, from the lowest: those of the %left/%right table of parser.y
+    enum Level { lowest, assignment, conjunction, negation, comparison, additive, multiplicative, unary, power, call };
+
+    static constexpr size_t stackMargin = 256 << 10;
+
+    Token lookahead;
+    bool hasLookahead = false;
+    static inline uintptr_t stackBase = 0;
+    static inline size_t stackBudget = 0;
+
+    void measureStack() {
+        char base;
+        stackBase = reinterpret_cast<uintptr_t>(&base);
+        struct rlimit limit;
+        size_t stackSize = 8 << 20;
+        if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+            stackSize = limit.rlim_cur;
+        stackBudget = stackSize > 2 * stackMargin ? stackSize - stackMargin : stackSize / 2;
+    }
+
+    int peek() {
+        if (!hasLookahead) {
+            lookahead.kind = yylex();
+            lookahead.value = yylval;
+            lookahead.location = yylloc;
+            hasLookahead = true;
+            if (lookahead.kind == ERROR)
+                reportLexicalError(error_message, lookahead.value.error_location.line_error,
+                                   lookahead.value.error_location.column_error);
+        }
+        return lookahead.kind;
+    }
+
+    Token next() {
+        peek();
+        hasLookahead = false;
+        return lookahead;
+    }
+
+    Token expect(int kind) {
+        if (peek() != kind)
+            yyerror("syntax error");
+        return next();
+    }
+
+    // The text of an identifier or string token, strdup()ed by the lexer
+    static std::string take(char* text) {
+        std::string result(text);
+        std::free(text);
+        return result;
+    }
+
+    void checkStack() {
+        char here;
+        if (stackBase - reinterpret_cast<uintptr_t>(&here) > stackBudget)
+            yyerror("memory exhausted");
+    }
+
+    /* ========================== Classes ========================== */
+
+    std::unique_ptr<ClassNode> parseClass() {
+        expect(CLASS);
+        Token name = expect(TYPE_IDENTIFIER);
+        std::string parent = "Object";
+        if (peek() == EXTENDS) {
+            next();
+            parent = take(expect(TYPE_IDENTIFIER).value.str);
+        }
+        expect(LBRACE);
+
+        std::vector<std::unique_ptr<FieldNode>> fields;
+        std::vector<std::unique_ptr<MethodNode>> methods;
+        while (peek() == OBJECT_IDENTIFIER) {
+            Token member = next();
+            if (peek() == COLON)
+                fields.push_back(parseField(member));
+            else if (peek() == LPAR)
+                methods.push_back(parseMethod(member));
+            else
+                yyerror("syntax error");
+        }
+        expect(RBRACE);
+
+        std::reverse(fields.begin(), fields.end());
+        std::reverse(methods.begin(), methods.end());
+        return std::make_unique<ClassNode>(take(name.value.loc.str), parent, &fields, &methods,
+                                           name.value.loc.column, name.value.loc.line);
+    }
+
+    std::unique_ptr<FieldNode> parseField(Token& name) {
+        expect(COLON);
+        std::string type = parseType();
+        std::unique_ptr<Expr> init;
+        if (peek() == ASSIGN) {
+            next();
+            init = parseExpr(lowest);
+        }
+        expect(SEMICOLON);
+        return std::make_unique<FieldNode>(take(name.value.loc.str), Type(type), name.value.loc.column,
+                                           name.value.loc.line, std::move(init));
+    }
+
+    std::unique_ptr<MethodNode> parseMethod(Token& name) {
+        expect(LPAR);
+        if (peek() == RPAR) {
+            next();
+            expect(COLON);
+            std::string returnType = parseType();
+            if (skipBodies)
+                return std::make_unique<MethodNode>(take(name.value.loc.str), Type(returnType),
+                                                    std::vector<std::unique_ptr<Formal>>(), skipBlock(),
+                                                    name.value.loc.column, name.value.loc.line);
+            std::unique_ptr<Block> body = parseBlock();
+            return std::make_unique<MethodNode>(take(name.value.loc.str), Type(returnType), std::move(body),
+                                                name.value.loc.column, name.value.loc.line);
+        }
+
+        std::vector<std::unique_ptr<Formal>> formals;
+        for (;;) {
+            Token formal = expect(OBJECT_IDENTIFIER);
+            expect(COLON);
+            std::string type = parseType();
+            formals.push_back(std::make_unique<Formal>(take(formal.value.loc.str), Type(type)));
+            if (peek() != COMMA)
+                break;
+            next();
+        }
+        if (peek() == COLON) {
+            next();
+            parseType();
+            parseBlock();
+            reportSyntaxError("Unclosed argument list of the Method !", yyline, yycolumn);
+        }
+        expect(RPAR);
+        expect(COLON);
+        std::string returnType = parseType();
+        if (peek() != LBRACE)
+            reportSyntaxError("Method without implementationt !", yyline, yycolumn);
+        if (skipBodies)
+            return std::make_unique<MethodNode>(take(name.value.loc.str), Type(returnType), std::move(formals),
+                                                skipBlock(), name.value.loc.column, name.value.loc.line);
+        std::unique_ptr<Block> body = parseBlock();
+        return std::make_unique<MethodNode>(take(name.value.loc.str), Type(returnType), std::move(formals),
+                                            std::move(body), name.value.loc.column, name.value.loc.line);
+    }
+
+    static bool isType(int kind) {
+        return kind == TYPE_IDENTIFIER || kind == INT32 || kind == BOOL || kind == STRING || kind == UNIT;
+    }
+
+    std::string parseType() {
+        switch (peek()) {
+        case TYPE_IDENTIFIER:
+            return take(next().value.str);
+        case INT32:
+            next();
+            return "int32";
+        case BOOL:
+            next();
+            return "bool";
+        case STRING:
+            next();
+            return "string";
+        case UNIT:
+            next();
+            return "unit";
+        default:
+            reportSyntaxError("Invalid Type !", yyline, yycolumn);
+            return "";
+        }
+    }
+
+    std::unique_ptr<Block> parseBlock() {
+        expect(LBRACE);
+        std::vector<std::unique_ptr<Expr>> exprs;
+        if (peek() != RBRACE) {
+            exprs.push_back(parseExpr(lowest));
+            while (peek() == SEMICOLON) {
+                next();
+                exprs.push_back(parseExpr(lowest));
+            }
+        }
+        expect(RBRACE);
+        return std::make_unique<Block>(std::move(exprs));
+    }
+
+    // Skips a block, its braces matched, and returns where it is. The '{' is the last
+    // token read, so the lexer is just after it.
+    MethodNode::SourceRange skipBlock() {
+        if (peek() != LBRACE)
+            yyerror("syntax error");
+        MethodNode::SourceRange body;
+        body.offset = yyoffset - 1;
+        body.line = yyline;
+        body.column = yycolumn - 1;
+        next();
+        for (unsigned depth = 1; depth > 0;) {
+            Token token = next();
+            switch (token.kind) {
+            case LBRACE:
+                ++depth;
+                break;
+            case RBRACE:
+                --depth;
+                break;
+            case OBJECT_IDENTIFIER:
+                std::free(token.value.loc.str);
+                break;
+            case TYPE_IDENTIFIER:
+                std::free(token.value.str);
+                break;
+            case CLASS: // cannot be in a body: the '}' is missing, as the full parser finds there
+            case 0:
+                yyerror("syntax error");
+                break;
+            }
+        }
+        body.length = yyoffset - body.offset;
+        return body;
+    }
+
+    /* ======================== Expressions ======================== */
+
+    // Binding power of a binary operator token, lowest if it is not one
+    static Level infixLevel(int kind) {
+        switch (kind) {
+        case AND:
+            return conjunction;
+        case EQUAL:
+        case LOWER:
+        case LOWER_EQUAL:
+            return comparison;
+        case PLUS:
+        case MINUS:
+            return additive;
+        case TIMES:
+        case DIV:
+            return multiplicative;
+        case POW:
+            return power;
+        case DOT:
+            return call;
+        default:
+            return lowest;
+        }
+    }
+
+    static const char* infixOperator(int kind) {
+        switch (kind) {
+        case AND: return "and";
+        case EQUAL: return "=";
+        case LOWER: return "<";
+        case LOWER_EQUAL: return "<=";
+        case PLUS: return "+";
+        case MINUS: return "-";
+        case TIMES: return "*";
+        case DIV: return "/";
+        default: return "^";
+        }
+    }
+
+    // An expression whose binary operators bind tighter than 'limit', or as tight for the
+    // right-associative '^': bison shifts exactly those after an operand of that level
+    std::unique_ptr<Expr> parseExpr(Level limit) {
+        checkStack();
+        std::unique_ptr<Expr> left = parsePrefix();
+        for (;;) {
+            int kind = peek();
+            Level level = infixLevel(kind);
+            if (level == lowest || level < limit || (level == limit && kind != POW))
+                return left;
+            next();
+            if (kind == DOT) {
+                Token method = expect(OBJECT_IDENTIFIER);
+                expect(LPAR);
+                std::vector<std::unique_ptr<Expr>> args = parseArgs();
+                left = std::make_unique<Call>(take(method.value.loc.str), std::move(args), std::move(left),
+                                              method.value.loc.column, method.value.loc.line);
+            } else {
+                std::unique_ptr<Expr> right = parseExpr(level);
+                left = std::make_unique<BinaryOperation>(infixOperator(kind), std::move(left), std::move(right));
+            }
+        }
+    }
+
+    // The arguments of a call, after its '(', and its ')'
+    std::vector<std::unique_ptr<Expr>> parseArgs() {
+        std::vector<std::unique_ptr<Expr>> args;
+        if (peek() != RPAR) {
+            args.push_back(parseExpr(lowest));
+            while (peek() == COMMA) {
+                next();
+                args.push_back(parseExpr(lowest));
+            }
+        }
+        expect(RPAR);
+        return args;
+    }
+
+    // An expression that does not start with an operand: the constructs with a keyword,
+    // unary operators (whose operand takes the operators binding tighter), and primaries.
+    // The constructs have their own functions, for a smaller frame per nesting level.
+    std::unique_ptr<Expr> parsePrefix() {
+        switch (peek()) {
+        case IF:
+            return parseConditional();
+        case WHILE:
+            return parseWhile();
+        case LET:
+            return parseLet();
+        case NOT:
+            next();
+            return std::make_unique<UnOp>("not", parseExpr(negation));
+        case MINUS:
+            next();
+            return std::make_unique<UnOp>("-", parseExpr(unary));
+        case ISNULL:
+            next();
+            return std::make_unique<UnOp>("isnull", parseExpr(unary));
+        case OBJECT_IDENTIFIER:
+            return parseIdentifier();
+        case NEW:
+            next();
+            return std::make_unique<New>(take(expect(TYPE_IDENTIFIER).value.str));
+        case SELF:
+            next();
+            return std::make_unique<Self>("self");
+        case NUMBER:
+            return std::make_unique<IntegerLiteral>(next().value.num);
+        case STR: {
+            Token literal = next();
+            return std::make_unique<StringLiteral>(
+                std::string_view(programText).substr(literal.value.literal.offset, literal.value.literal.length),
+                literal.value.literal.escapes);
+        }
+        case TRUE_TYPE:
+            next();
+            return std::make_unique<BooleanLiteral>(true);
+        case FALSE_TYPE:
+            next();
+            return std::make_unique<BooleanLiteral>(false);
+        case LPAR:
+            return parseParenthesis();
+        case LBRACE:
+            return parseBlock();
+        default:
+            yyerror("syntax error");
+            return nullptr;
+        }
+    }
+
+    std::unique_ptr<Expr> parseConditional() {
+        YYLTYPE keyword = next().location;
+        std::unique_ptr<Expr> cond = parseExpr(lowest);
+        expect(THEN);
+        std::unique_ptr<Expr> then = parseExpr(lowest);
+        std::unique_ptr<Conditional> conditional;
+        if (peek() == ELSE) {
+            next();
+            std::unique_ptr<Expr> otherwise = parseExpr(lowest);
+            conditional = std::make_unique<Conditional>(std::move(cond), std::move(then), std::move(otherwise));
+        } else {
+            conditional = std::make_unique<Conditional>(std::move(cond), std::move(then));
+        }
+        conditional->setColumn(keyword.first_column);
+        conditional->setLine(keyword.first_line);
+        return conditional;
+    }
+
+    std::unique_ptr<Expr> parseWhile() {
+        YYLTYPE keyword = next().location;
+        std::unique_ptr<Expr> cond = parseExpr(lowest);
+        expect(DO);
+        std::unique_ptr<Expr> body = parseExpr(lowest);
+        auto loop = std::make_unique<WhileLoop>(std::move(cond), std::move(body));
+        loop->setColumn(keyword.first_column);
+        loop->setLine(keyword.first_line);
+        return loop;
+    }
+
+    std::unique_ptr<Expr> parseLet() {
+        next();
+        Token name = expect(OBJECT_IDENTIFIER);
+        expect(COLON);
+        // parser.y also has 'let x : error in e' here, so that bison only takes the type
+        // as missing before 'in' and '<-'
+        if (!isType(peek()) && peek() != IN && peek() != ASSIGN)
+            yyerror("syntax error");
+        std::string type = parseType();
+        std::unique_ptr<Expr> init;
+        if (peek() == ASSIGN) {
+            next();
+            init = parseExpr(lowest);
+        }
+        expect(IN);
+        std::unique_ptr<Expr> scope = parseExpr(lowest);
+        return std::make_unique<Let>(take(name.value.loc.str), Type(type), name.value.loc.column,
+                                     name.value.loc.line, std::move(init), std::move(scope));
+    }
+
+    // An assignment, a call on self or a variable
+    std::unique_ptr<Expr> parseIdentifier() {
+        Token name = next();
+        if (peek() == ASSIGN) {
+            next();
+            std::unique_ptr<Expr> value = parseExpr(assignment);
+            return std::make_unique<Assign>(take(name.value.loc.str), name.value.loc.column, name.value.loc.line,
+                                            std::move(value));
+        }
+        if (peek() == LPAR) {
+            next();
+            std::vector<std::unique_ptr<Expr>> args = parseArgs();
+            return std::make_unique<Call>(take(name.value.loc.str), std::move(args), std::make_unique<Self>("self"),
+                                          name.value.loc.column, name.value.loc.line);
+        }
+        return std::make_unique<ObjectIdentifier>(take(name.value.loc.str), name.value.loc.column,
+                                                  name.value.loc.line);
+    }
+
+    std::unique_ptr<Expr> parseParenthesis() {
+        next();
+        if (peek() == RPAR) {
+            next();
+            return std::make_unique<Parenthesis>();
+        }
+        std::unique_ptr<Expr> inner = parseExpr(lowest);
+        expect(RPAR);
+        return inner;
+    }
+};
+
+/**
+ * Parses a method body skipped by the parser, the first time it is needed (MethodNode::parseBody)
+ */
+std::unique_ptr<Block> parseMethodBody(const MethodNode::SourceRange& body) {
+    restart_lexer(body.offset, body.length, body.line, body.column);
+    return DescentParser().parseBody();
+}
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef EFFECTS_CPP
+#define EFFECTS_CPP
+
+#include "AST.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <vector>
+#include <functional>
+
+// Side-effect and purity annotations of methods.
+//
+// Every method gets a summary of what a call to it may do: read or write fields (by
+// name), perform I/O, allocate objects, fail at runtime (division by zero, dispatch on
+// null, bad input) or not terminate (loops, recursion). Built-in methods of Object are
+// annotated from a fixed table since their bodies in the prelude are placeholders.
+// Calls are resolved with class hierarchy analysis: a call on a receiver of static type
+// T may reach the implementation seen by T or by any of its subclasses.
+//
+// Must run after SemanticAnalyzer::analyze: receivers are resolved through the types
+// computed by the analyzer.
+
+/**
+ * Effects - Summary of the effects of a method or an expression
+ */
+struct Effects {
+    std::unordered_set<std::string> readFields;
+    std::unordered_set<std::string> writtenFields;
+    bool io = false;            // reads stdin or writes stdout
+    bool allocates = false;     // creates objects
+    bool mayFail = false;       // may stop the program with a runtime error
+    bool mayDiverge = false;    // may not terminate
+
+    // No observable effect besides its result (and possibly reading fields)
+    bool isPure() const { return writtenFields.empty() && !io && !allocates; }
+
+    // Can be evaluated earlier, or once instead of several times, without changing the program
+    bool isHoistable() const { return isPure() && !mayFail && !mayDiverge; }
+
+    // Returns true if 'other' added something
+    bool merge(const Effects& other) {
+        size_t before = readFields.size() + writtenFields.size();
+        bool flagsBefore[] = {io, allocates, mayFail, mayDiverge};
+        readFields.insert(other.readFields.begin(), other.readFields.end());
+        writtenFields.insert(other.writtenFields.begin(), other.writtenFields.end());
+        io |= other.io;
+        allocates |= other.allocates;
+        mayFail |= other.mayFail;
+        mayDiverge |= other.mayDiverge;
+        return before != readFields.size() + writtenFields.size()
+            || flagsBefore[0] != io || flagsBefore[1] != allocates
+            || flagsBefore[2] != mayFail || flagsBefore[3] != mayDiverge;
+    }
+};
+
+class EffectAnalyzer {
+public:
+    void run(Program* program) {
+        classMap.clear();
+        for (auto& cls : program->getClasses())
+            classMap[cls->name] = cls.get();
+
+        for (auto& cls : program->getClasses()) {
+            for (auto& method : cls->getMethods()) {
+                ownerOf[method.get()] = cls.get();
+                methods.push_back(method.get());
+            }
+        }
+
+        // Local effects, ignoring callees, and the call graph
+        for (MethodNode* method : methods) {
+            if (ownerOf[method]->name == "Object") {
+                methodEffects[method] = builtinEffects(method->getName());
+                continue;
+            }
+            std::vector<std::string> locals;
+            for (auto& formal : method->getFormals())
+                locals.push_back(formal->getName());
+            methodEffects[method] = localEffects(method->getBlock(), locals, &callees[method]);
+        }
+
+        // Methods on a call cycle may recurse forever
+        markRecursiveMethods();
+
+        // Propagate the effects of callees until nothing changes
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (MethodNode* method : methods) {
+                for (MethodNode* callee : callees[method]) {
+                    if (callee != method && methodEffects[method].merge(methodEffects[callee]))
+                        changed = true;
+                }
+            }
+        }
+    }
+
+    const Effects& getEffects(MethodNode* method) {
+        return methodEffects[method];
+    }
+
+    // Effects of a call of 'methodName' on a receiver of static type 'receiverType'
+    Effects callEffects(const std::string& receiverType, const std::string& methodName) {
+        Effects effects;
+        for (MethodNode* target : getTargets(receiverType, methodName))
+            effects.merge(methodEffects[target]);
+        return effects;
+    }
+
+    // Effects of evaluating 'expr'; 'locals' are the names bound by formals and lets around it
+    Effects expressionEffects(Expr* expr, const std::vector<std::string>& locals) {
+        std::vector<MethodNode*> targets;
+        Effects effects = localEffects(expr, locals, &targets);
+        for (MethodNode* target : targets)
+            effects.merge(methodEffects[target]);
+        return effects;
+    }
+
+    // Implementations a call on a receiver of static type 'receiverType' may reach
+    std::vector<MethodNode*> getTargets(const std::string& receiverType, const std::string& methodName) {
+        std::vector<MethodNode*> targets;
+        for (auto& entry : classMap) {
+            if (!isSubclassOf(entry.second, receiverType))
+                continue;
+            MethodNode* target = lookupMethod(entry.second, methodName);
+            if (target && std::find(targets.begin(), targets.end(), target) == targets.end())
+                targets.push_back(target);
+        }
+        return targets;
+    }
+
+private:
+    std::unordered_map<std::string, ClassNode*> classMap;
+    std::unordered_map<MethodNode*, ClassNode*> ownerOf;
+    std::vector<MethodNode*> methods;
+    std::unordered_map<MethodNode*, Effects> methodEffects;
+    std::unordered_map<MethodNode*, std::vector<MethodNode*>> callees;
+    std::unordered_set<std::string> expanding; // classes whose initializers are being visited
+
+    // Annotations of the built-in methods of Object
+    Effects builtinEffects(const std::string& name) {
+        Effects effects;
+        effects.io = true;
+        // input methods exit with an error message on malformed input
+        effects.mayFail = (name == "inputBool" || name == "inputInt32");
+        return effects;
+    }
+
+    ClassNode* getParent(ClassNode* cls) {
+        if (cls->parent.empty() || cls->parent == "NULL_PARENT")
+            return nullptr;
+        auto it = classMap.find(cls->parent);
+        return it == classMap.end() ? nullptr : it->second;
+    }
+
+    bool isSubclassOf(ClassNode* cls, const std::string& ancestor) {
+        for (ClassNode* current = cls; current; current = getParent(current)) {
+            if (current->name == ancestor)
+                return true;
+        }
+        return false;
+    }
+
+    MethodNode* lookupMethod(ClassNode* cls, const std::string& methodName) {
+        for (ClassNode* current = cls; current; current = getParent(current)) {
+            for (auto& method : current->getMethods()) {
+                if (method->getName() == methodName)
+                    return method.get();
+            }
+        }
+        return nullptr;
+    }
+
+    // Effects of 'expr' itself, without those of the methods it calls
+    Effects localEffects(Expr* expr, std::vector<std::string> locals, std::vector<MethodNode*>* calls) {
+        Effects effects;
+        std::function<bool(const std::string&)> isLocal = [&](const std::string& name) {
+            return std::find(locals.begin(), locals.end(), name) != locals.end();
+        };
+        // explicit stack, parents first: a let binds its name around the walk of its scope
+        enum class Step { visit, bind, unbind };
+        std::vector<std::pair<Step, Expr*>> pending;
+        if (expr)
+            pending.push_back({Step::visit, expr});
+        while (!pending.empty()) {
+            auto [step, e] = pending.back();
+            pending.pop_back();
+            if (step == Step::bind) {
+                locals.push_back(static_cast<Let*>(e)->getName());
+                continue;
+            }
+            if (step == Step::unbind) {
+                locals.pop_back();
+                continue;
+            }
+            if (auto let = dynamic_cast<Let*>(e)) {
+                pending.push_back({Step::unbind, let});
+                pending.push_back({Step::visit, let->getScopeExpr()});
+                pending.push_back({Step::bind, let});
+                if (let->getInitExpr())
+                    pending.push_back({Step::visit, let->getInitExpr()});
+                continue;
+            }
+            if (auto objIden = dynamic_cast<ObjectIdentifier*>(e)) {
+                if (!isLocal(objIden->getName()))
+                    effects.readFields.insert(objIden->getName());
+            } else if (auto assign = dynamic_cast<Assign*>(e)) {
+                if (!isLocal(assign->getName()))
+                    effects.writtenFields.insert(assign->getName());
+            } else if (auto binOp = dynamic_cast<BinaryOperation*>(e)) {
+                if (binOp->getOperator() == "/") {
+                    auto divisor = dynamic_cast<IntegerLiteral*>(binOp->getRight());
+                    if (!divisor || divisor->getValue() == 0)
+                        effects.mayFail = true;
+                }
+            } else if (dynamic_cast<WhileLoop*>(e)) {
+                effects.mayDiverge = true;
+            } else if (auto newExpr = dynamic_cast<New*>(e)) {
+                effects.allocates = true;
+                // initializers of the new object run now; their own field accesses are not observable
+                if (classMap.count(newExpr->getClassName()) && expanding.insert(newExpr->getClassName()).second) {
+                    for (ClassNode* cls = classMap[newExpr->getClassName()]; cls; cls = getParent(cls)) {
+                        for (auto& field : cls->getFields()) {
+                            Effects init = localEffects(field->getInitExpr().get(), {}, calls);
+                            init.writtenFields.clear();
+                            init.readFields.clear();
+                            effects.merge(init);
+                        }
+                    }
+                    expanding.erase(newExpr->getClassName());
+                }
+            } else if (auto call = dynamic_cast<Call*>(e)) {
+                if (!dynamic_cast<Self*>(call->getExprObjectIdentifier()))
+                    effects.mayFail = true; // the receiver may be null
+                if (calls) {
+                    for (MethodNode* target : getTargets(call->getClassName(), call->getMethodName()))
+                        calls->push_back(target);
+                }
+            }
+            auto children = e->getChildren();
+            for (auto it = children.rbegin(); it != children.rend(); ++it) {
+                if (**it)
+                    pending.push_back({Step::visit, (*it)->get()});
+            }
+        }
+        return effects;
+    }
+
+    // Tarjan's strongly connected components over the call graph
+    void markRecursiveMethods() {
+        std::unordered_map<MethodNode*, int> index, lowlink;
+        std::unordered_set<MethodNode*> onStack;
+        std::vector<MethodNode*> stack;
+        int counter = 0;
+
+        std::function<void(MethodNode*)> strongConnect = [&](MethodNode* method) {
+            index[method] = lowlink[method] = counter++;
+            stack.push_back(method);
+            onStack.insert(method);
+            for (MethodNode* callee : callees[method]) {
+                if (!index.count(callee)) {
+                    strongConnect(callee);
+                    lowlink[method] = std::min(lowlink[method], lowlink[callee]);
+                } else if (onStack.count(callee)) {
+                    lowlink[method] = std::min(lowlink[method], index[callee]);
+                }
+            }
+            if (lowlink[method] != index[method])
+                return;
+
+            std::vector<MethodNode*> component;
+            MethodNode* member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                onStack.erase(member);
+                component.push_back(member);
+            } while (member != method);
+
+            bool selfCall = std::find(callees[method].begin(), callees[method].end(), method) != callees[method].end();
+            if (component.size() > 1 || selfCall) {
+                for (MethodNode* m : component)
+                    methodEffects[m].mayDiverge = true;
+            }
+        };
+
+        for (MethodNode* method : methods) {
+            if (!index.count(method))
+                strongConnect(method);
+        }
+    }
+};
+
+#endif // EFFECTS_CPP
@@ -0,0 +1,117 @@
+#ifndef EMITTER_CPP
+#define EMITTER_CPP
+
+#include "AST.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Parallel emission of the output of -p and -c for one file (-j <n>).
+//
+// Once the tree is built (and checked, for -c), the text of a method depends on nothing
+// else: the head of each class (its name, parent and fields) and each of its methods are
+// units that 'jobs' threads render, each into its own buffer, taking the next unit from a
+// shared counter, so that the methods of one large class spread over the threads too. The
+// buffers are then put end to end in the order of the tree, with the class heads and the
+// separators of Program::toString() and ClassNode::toString() (appendHead, isPrinted...):
+// the output is the same, byte for byte, whatever the number of threads and the order in
+// which they finish. The bodies left to parse by --lazy-bodies are parsed first, on this
+// thread, as the parser keeps its state in globals.
+
+/**
+ * ProgramEmitter - Renders the classes and methods of a program on several threads
+ */
+class ProgramEmitter {
+public:
+    explicit ProgramEmitter(unsigned int jobs) : jobs(std::max(1u, jobs)) {}
+
+    // The text of program->toString(), or of toString2() if 'typed'
+    std::string emit(Program* program, bool typed) {
+        auto& classes = program->getClasses();
+        std::vector<Unit> units;
+        for (auto& cls : classes) {
+            if (!Program::isPrinted(*cls))
+                continue;
+            units.push_back({cls.get(), nullptr, {}});
+            auto& methods = cls->getMethods();
+            for (auto it = methods.rbegin(); it != methods.rend(); ++it) {
+                (*it)->getBlock();
+                units.push_back({cls.get(), it->get(), {}});
+            }
+        }
+
+        std::atomic<size_t> next{0};
+        auto work = [&]() {
+            for (size_t i = next++; i < units.size(); i = next++)
+                render(units[i], typed);
+        };
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < std::min<size_t>(jobs, units.size()); ++i) {
+            try {
+                threads.emplace_back(work);
+            } catch (const std::system_error&) {
+                break; // with the threads there are
+            }
+        }
+        work();
+        for (auto& thread : threads)
+            thread.join();
+        unitCount = units.size();
+        threadCount = (unsigned int)threads.size() + 1;
+
+        // the units in order, with the separators of Program::toString()
+        size_t size = 2;
+        for (const Unit& unit : units)
+            size += unit.text.size() + 4;
+        std::string result;
+        result.reserve(size);
+        result += "[";
+        size_t unit = 0;
+        for (size_t i = 0; i < classes.size(); ++i) {
+            if (!Program::isPrinted(*classes[i]))
+                continue;
+            result += units[unit++].text;
+            for (size_t method = 0; method < classes[i]->getMethods().size(); ++method) {
+                if (method)
+                    result += ClassNode::methodSeparator;
+                result += units[unit++].text;
+            }
+            result += ClassNode::end;
+            if (Program::isSeparated(i, classes.size()))
+                result += Program::classSeparator;
+        }
+        result += "]";
+        return result;
+    }
+
+    // Of the last emit (VSOP_EMIT_REPORT)
+    size_t unitCount = 0;
+    unsigned int threadCount = 0;
+
+private:
+    /**
+     * Unit - The head of a class, or one of its methods, and its text
+     */
+    struct Unit {
+        ClassNode* cls;
+        const MethodNode* method; // null for the head
+        std::string text;
+    };
+
+    unsigned int jobs;
+
+    // The text of a unit as ClassNode::toString() (toString2() if 'typed') has it
+    static void render(Unit& unit, bool typed) {
+        if (unit.method) {
+            unit.text = typed ? unit.method->toString2() : unit.method->toString();
+            return;
+        }
+        unit.cls->appendHead(unit.text, typed);
+    }
+};
+
+#endif
@@ -0,0 +1,648 @@
+#ifndef FLAT_AST_CPP
+#define FLAT_AST_CPP
+
+#include "AST.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Flat form of a program tree (--flat-ast): the nodes are numbered, and what the pointer
+// tree keeps in one heap object per node is kept in parallel arrays indexed by the 32-bit
+// number of the node: its kind, its type, its position, its children and a value. The
+// children of a node have consecutive numbers, so a node has the number of its first child
+// and a count instead of pointers. Names and types are interned: a node holds the number
+// of its name, not a string. Node 0 is the Program.
+//
+// It is built from the tree as the passes leave it and does not change: the analyzer and
+// the optimizations, which annotate and rewrite the tree in place, still run on the
+// pointer tree. What only reads it (the printers, walks over the whole program) can run
+// on the flat form through FlatAst::Node, whose children() can be iterated like those of
+// a pointer node, or on the arrays directly.
+
+class FlatAst {
+public:
+    enum Kind : uint8_t {
+        ProgramKind, ClassKind, FieldKind, MethodKind, FormalKind,
+        IntegerKind, StringKind, BooleanKind, BinaryKind, IfKind, WhileKind, BlockKind,
+        LetKind, AssignKind, UnaryKind, CallKind, IdentifierKind, SelfKind, NewKind, UnitKind,
+        NullKind // an empty slot of the tree (a null expression of a block, a missing body)
+    };
+    enum Flag : uint8_t {
+        HasElse = 1,   // an if whose else was written (the other ones have a () else child)
+        HasInit = 2,   // a let or a field with an initializer (its first child)
+        Escapes = 4    // a string literal with escapes (see StringLiteral)
+    };
+    static constexpr uint32_t None = UINT32_MAX;
+
+    /*
+     * The parallel arrays. 'type' is the static type of an expression (the declared one of
+     * a formal), the declared type of a field, the return type of a method and the parent of
+     * a class, as a number of name(). 'value' is the value of a literal, the number of the
+     * name of a class, field, method, formal, variable, 'new' class or called method, the
+     * number of the operator of an operation, or for a let the number of its binding.
+     */
+    std::vector<Kind> kind;
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> type;
+    std::vector<uint32_t> line;
+    std::vector<uint32_t> column;
+    std::vector<uint32_t> firstChild;
+    std::vector<uint32_t> childCount;
+    std::vector<uint32_t> value;
+
+    std::vector<std::string> names;                         // interned names, types and operators
+    std::vector<std::string_view> literals;                 // text of the string literals, in programText
+    std::vector<std::pair<uint32_t, uint32_t>> bindings;    // name and declared type of the lets
+
+    /**
+     * A node seen through the arrays, with the accessors of a pointer node
+     */
+    class Node {
+    public:
+        Node(const FlatAst* ast, uint32_t index) : ast(ast), index(index) {}
+        uint32_t id() const { return index; }
+        Kind kind() const { return ast->kind[index]; }
+        bool has(Flag flag) const { return ast->flags[index] & flag; }
+        const std::string& typeName() const { return ast->names[ast->type[index]]; }
+        unsigned int getLine() const { return ast->line[index]; }
+        unsigned int getColumn() const { return ast->column[index]; }
+        const std::string& name() const { return ast->nameOf(index); }
+        int intValue() const { return (int)ast->value[index]; }
+        size_t childCount() const { return ast->childCount[index]; }
+        Node child(size_t i) const { return Node(ast, ast->firstChild[index] + (uint32_t)i); }
+
+        class Iterator {
+        public:
+            Iterator(const FlatAst* ast, uint32_t index) : ast(ast), index(index) {}
+            Node operator*() const { return Node(ast, index); }
+            Iterator& operator++() { ++index; return *this; }
+            bool operator!=(const Iterator& other) const { return index != other.index; }
+        private:
+            const FlatAst* ast;
+            uint32_t index;
+        };
+        struct Children {
+            Iterator first, last;
+            Iterator begin() const { return first; }
+            Iterator end() const { return last; }
+        };
+        Children children() const {
+            uint32_t first = ast->firstChild[index];
+            return {Iterator(ast, first), Iterator(ast, first + ast->childCount[index])};
+        }
+
+    private:
+        const FlatAst* ast;
+        uint32_t index;
+    };
+
+    explicit FlatAst(Program* program) { build(program); }
+
+    Node root() const { return Node(this, 0); }
+    size_t size() const { return kind.size(); }
+
+    // The name of a node that has one (see 'value'), "" for the others
+    const std::string& nameOf(uint32_t node) const {
+        switch (kind[node]) {
+        case ClassKind: case FieldKind: case MethodKind: case FormalKind: case BinaryKind: case UnaryKind:
+        case AssignKind: case CallKind: case IdentifierKind: case NewKind:
+            return names[value[node]];
+        case LetKind:
+            return names[bindings[value[node]].first];
+        default:
+            return names[emptyName];
+        }
+    }
+
+    /**
+     * Calls visit(node) on 'from' and on every node below it, parents before their
+     * children and children in order, as forEachExpr. Null slots are visited too.
+     */
+    template <typename Visit>
+    void forEachNode(Node from, Visit visit) const {
+        std::vector<uint32_t> pending{from.id()};
+        while (!pending.empty()) {
+            uint32_t node = pending.back();
+            pending.pop_back();
+            visit(Node(this, node));
+            for (uint32_t i = childCount[node]; i-- > 0;)
+                pending.push_back(firstChild[node] + i);
+        }
+    }
+
+    /**
+     * The text of Program::toString2() (toString() if not 'typed')
+     */
+    std::string print(bool typed) const {
+        std::string out;
+        std::vector<std::pair<uint32_t, uint32_t>> stack{{0, 0}};
+        while (!stack.empty()) {
+            auto& [node, part] = stack.back();
+            uint32_t child = printPart(typed, node, part, out);
+            if (child != None)
+                stack.push_back({child, 0});
+            else
+                stack.pop_back();
+        }
+        return out;
+    }
+
+    // Bytes of the arrays and of the tables they refer to
+    size_t memoryBytes() const {
+        size_t bytes = kind.capacity() * sizeof(Kind) + flags.capacity()
+                     + (type.capacity() + line.capacity() + column.capacity() + firstChild.capacity()
+                        + childCount.capacity() + value.capacity()) * sizeof(uint32_t)
+                     + names.capacity() * sizeof(std::string) + literals.capacity() * sizeof(std::string_view)
+                     + bindings.capacity() * sizeof(std::pair<uint32_t, uint32_t>);
+        for (const std::string& name : names)
+            bytes += heapBytes(name);
+        return bytes;
+    }
+
+    // Bytes of the nodes of the pointer tree under 'program' and the number of nodes
+    static std::pair<size_t, size_t> pointerBytes(Program* program) {
+        size_t bytes = sizeof(Program) + program->getClasses().capacity() * sizeof(void*);
+        size_t nodes = 1;
+        auto expressionBytes = [&](Expr* root) {
+            forEachExpr(root, [&](Expr* expr) {
+                nodes++;
+                bytes += exprBytes(expr);
+            });
+        };
+        for (auto& cls : program->getClasses()) {
+            nodes++;
+            bytes += sizeof(ClassNode) + heapBytes(cls->name) + heapBytes(cls->parent)
+                   + (cls->getFields().capacity() + cls->getMethods().capacity()) * sizeof(void*);
+            for (auto& field : cls->getFields()) {
+                nodes++;
+                bytes += sizeof(FieldNode) + heapBytes(field->getName()) + heapBytes(field->getTypeName());
+                expressionBytes(field->getInitExpr().get());
+            }
+            for (auto& method : cls->getMethods()) {
+                nodes++;
+                bytes += sizeof(MethodNode) + heapBytes(method->getName()) + heapBytes(method->getReturnType().getName())
+                       + method->getFormals().capacity() * sizeof(void*);
+                for (auto& formal : method->getFormals())
+                    expressionBytes(formal.get());
+                expressionBytes(method->getBlock());
+            }
+        }
+        return {bytes, nodes};
+    }
+
+    /**
+     * VSOP_FLAT_REPORT: on stderr, the bytes per node of both forms of 'program', and the
+     * time of a walk over all nodes and of printing the program with each
+     */
+    void report(Program* program) const {
+        const int rounds = 20;
+        auto [treeBytes, treeNodes] = pointerBytes(program);
+        auto milliseconds = [&](auto run) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < rounds; ++i)
+                run();
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / rounds;
+        };
+        uint64_t treeSum = 0, flatSum = 0;
+        double treeWalk = milliseconds([&]() {
+            for (auto& cls : program->getClasses()) {
+                treeSum += cls->getLine();
+                for (auto& field : cls->getFields()) {
+                    treeSum += field->getLine();
+                    forEachExpr(field->getInitExpr().get(), [&](Expr* expr) { treeSum += expr->getLine(); });
+                }
+                for (auto& method : cls->getMethods()) {
+                    treeSum += method->getLine();
+                    for (auto& formal : method->getFormals())
+                        treeSum += formal->getLine();
+                    forEachExpr(method->getBlock(), [&](Expr* expr) { treeSum += expr->getLine(); });
+                }
+            }
+        });
+        double flatWalk = milliseconds([&]() { forEachNode(root(), [&](Node node) { flatSum += node.getLine(); }); });
+        size_t printed = 0;
+        double treePrint = milliseconds([&]() { printed += program->toString2().size(); });
+        double flatPrint = milliseconds([&]() { printed -= print(true).size(); });
+        std::cerr << "flat ast: " << size() << " nodes (" << treeNodes << " in the tree), "
+                  << (double)memoryBytes() / size() << " bytes per node (tree: " << (double)treeBytes / treeNodes << ")\n"
+                  << "flat ast: walk " << flatWalk << " ms (tree: " << treeWalk << " ms), print "
+                  << flatPrint << " ms (tree: " << treePrint << " ms)"
+                  << (treeSum == flatSum && printed == 0 ? "" : ", DIFFERENT") << std::endl;
+    }
+
+private:
+    std::unordered_map<std::string, uint32_t> nameIndex; // while building: the number of each name
+    uint32_t emptyName = 0, objectName = 0;
+    std::vector<const void*> source;                     // while building: the node of the tree of each node
+
+    // Bytes of a string outside of it (the strings of libstdc++ keep up to 15 characters inside)
+    static size_t heapBytes(const std::string& text) {
+        return text.capacity() > 15 ? text.capacity() + 1 : 0;
+    }
+
+    static size_t exprBytes(Expr* expr) {
+        size_t bytes = heapBytes(expr->getTypeName());
+        if (dynamic_cast<IntegerLiteral*>(expr)) return bytes + sizeof(IntegerLiteral);
+        if (dynamic_cast<StringLiteral*>(expr)) return bytes + sizeof(StringLiteral);
+        if (dynamic_cast<BooleanLiteral*>(expr)) return bytes + sizeof(BooleanLiteral);
+        if (auto binary = dynamic_cast<BinaryOperation*>(expr)) return bytes + sizeof(BinaryOperation) + heapBytes(binary->getOperator());
+        if (dynamic_cast<Conditional*>(expr)) return bytes + sizeof(Conditional);
+        if (dynamic_cast<WhileLoop*>(expr)) return bytes + sizeof(WhileLoop);
+        if (auto block = dynamic_cast<Block*>(expr)) return bytes + sizeof(Block) + block->getExprs().capacity() * sizeof(void*);
+        if (auto formal = dynamic_cast<Formal*>(expr)) return bytes + sizeof(Formal) + heapBytes(formal->getName()) + heapBytes(formal->getType().getName());
+        if (auto let = dynamic_cast<Let*>(expr)) return bytes + sizeof(Let) + heapBytes(let->getName()) + heapBytes(let->getType().getName());
+        if (auto assign = dynamic_cast<Assign*>(expr)) return bytes + sizeof(Assign) + heapBytes(assign->getName());
+        if (auto unary = dynamic_cast<UnOp*>(expr)) return bytes + sizeof(UnOp) + heapBytes(unary->getOp());
+        if (auto call = dynamic_cast<Call*>(expr))
+            return bytes + sizeof(Call) + heapBytes(call->getMethodName()) + call->getArgs().capacity() * sizeof(void*);
+        if (auto identifier = dynamic_cast<ObjectIdentifier*>(expr)) return bytes + sizeof(ObjectIdentifier) + heapBytes(identifier->getName());
+        if (dynamic_cast<Self*>(expr)) return bytes + sizeof(Self);
+        if (auto created = dynamic_cast<New*>(expr)) return bytes + sizeof(New) + heapBytes(created->getClassName());
+        return bytes + sizeof(Parenthesis);
+    }
+
+    uint32_t intern(const std::string& name) {
+        auto [it, added] = nameIndex.emplace(name, (uint32_t)names.size());
+        if (added)
+            names.push_back(name);
+        return it->second;
+    }
+
+    // Numbers 'count' new nodes of kind 'of' (NullKind for an expression, until expanded)
+    uint32_t allocate(size_t count, Kind of) {
+        uint32_t first = (uint32_t)kind.size();
+        size_t size = first + count;
+        kind.resize(size, of);
+        flags.resize(size, 0);
+        type.resize(size, emptyName);
+        line.resize(size, 0);
+        column.resize(size, 0);
+        firstChild.resize(size, first);
+        childCount.resize(size, 0);
+        value.resize(size, 0);
+        source.resize(size, nullptr);
+        return first;
+    }
+
+    // Gives 'node' the children 'slots' (expressions), returns the number of the first one
+    template <typename Slots>
+    uint32_t addExpressions(uint32_t node, const Slots& slots) {
+        uint32_t first = allocate(slots.size(), NullKind);
+        firstChild[node] = first;
+        childCount[node] = (uint32_t)slots.size();
+        for (size_t i = 0; i < slots.size(); ++i)
+            source[first + i] = slots[i]->get();
+        return first;
+    }
+
+    void build(Program* program) {
+        emptyName = intern("");
+        objectName = intern("Object");
+        allocate(1, ProgramKind);
+        source[0] = program;
+        // the nodes are numbered when their parent is expanded; they are expanded depth first
+        std::vector<uint32_t> pending{0};
+        while (!pending.empty()) {
+            uint32_t node = pending.back();
+            pending.pop_back();
+            expand(node);
+            for (uint32_t i = childCount[node]; i-- > 0;) {
+                if (source[firstChild[node] + i])
+                    pending.push_back(firstChild[node] + i);
+            }
+        }
+        std::vector<const void*>().swap(source);
+        nameIndex = {};
+        for (auto* array : {&type, &line, &column, &firstChild, &childCount, &value})
+            array->shrink_to_fit();
+        kind.shrink_to_fit();
+        flags.shrink_to_fit();
+    }
+
+    // Sets the arrays of 'node' from its node in the tree, and numbers its children
+    void expand(uint32_t node) {
+        switch (kind[node]) {
+        case ProgramKind: {
+            auto& classes = static_cast<Program*>(const_cast<void*>(source[node]))->getClasses();
+            uint32_t first = allocate(classes.size(), ClassKind);
+            firstChild[node] = first;
+            childCount[node] = (uint32_t)classes.size();
+            for (size_t i = 0; i < classes.size(); ++i)
+                source[first + i] = classes[i].get();
+            return;
+        }
+        case ClassKind: {
+            ClassNode* cls = static_cast<ClassNode*>(const_cast<void*>(source[node]));
+            setPosition(node, cls);
+            value[node] = intern(cls->name);
+            type[node] = intern(cls->parent);
+            // the parser keeps the members in reverse order
+            auto& fields = cls->getFields();
+            auto& methods = cls->getMethods();
+            uint32_t first = allocate(fields.size(), FieldKind);
+            allocate(methods.size(), MethodKind);
+            firstChild[node] = first;
+            childCount[node] = (uint32_t)(fields.size() + methods.size());
+            for (size_t i = 0; i < fields.size(); ++i)
+                source[first + i] = fields[fields.size() - 1 - i].get();
+            first += (uint32_t)fields.size();
+            for (size_t i = 0; i < methods.size(); ++i)
+                source[first + i] = methods[methods.size() - 1 - i].get();
+            return;
+        }
+        case FieldKind: {
+            FieldNode* field = static_cast<FieldNode*>(const_cast<void*>(source[node]));
+            setPosition(node, field);
+            value[node] = intern(field->getName());
+            type[node] = intern(field->getTypeName());
+            if (field->getInitExpr()) {
+                flags[node] = HasInit;
+                addExpressions(node, std::vector<std::unique_ptr<Expr>*>{&field->getInitExpr()});
+            }
+            return;
+        }
+        case MethodKind: {
+            MethodNode* method = static_cast<MethodNode*>(const_cast<void*>(source[node]));
+            setPosition(node, method);
+            value[node] = intern(method->getName());
+            type[node] = intern(method->getReturnType().getName());
+            auto& formals = method->getFormals();
+            uint32_t first = allocate(formals.size(), FormalKind);
+            allocate(1, NullKind);
+            firstChild[node] = first;
+            childCount[node] = (uint32_t)formals.size() + 1;
+            for (size_t i = 0; i < formals.size(); ++i)
+                source[first + i] = formals[i].get();
+            source[first + formals.size()] = method->getBlock();
+            return;
+        }
+        default:
+            expandExpression(node, static_cast<Expr*>(const_cast<void*>(source[node])));
+        }
+    }
+
+    void expandExpression(uint32_t node, Expr* expr) {
+        line[node] = expr->getLine();
+        column[node] = expr->getColumn();
+        type[node] = intern(expr->getTypeName());
+        if (auto formal = dynamic_cast<Formal*>(expr)) {
+            kind[node] = FormalKind;
+            value[node] = intern(formal->getName());
+            type[node] = intern(formal->getType().getName());
+            return;
+        }
+        if (auto identifier = dynamic_cast<ObjectIdentifier*>(expr)) {
+            kind[node] = IdentifierKind;
+            value[node] = intern(identifier->getName());
+        } else if (auto call = dynamic_cast<Call*>(expr)) {
+            kind[node] = CallKind;
+            value[node] = intern(call->getMethodName());
+        } else if (auto integer = dynamic_cast<IntegerLiteral*>(expr)) {
+            kind[node] = IntegerKind;
+            value[node] = (uint32_t)integer->getValue();
+        } else if (auto binary = dynamic_cast<BinaryOperation*>(expr)) {
+            kind[node] = BinaryKind;
+            value[node] = intern(binary->getOperator());
+        } else if (dynamic_cast<Block*>(expr)) {
+            kind[node] = BlockKind;
+        } else if (auto string = dynamic_cast<StringLiteral*>(expr)) {
+            kind[node] = StringKind;
+            value[node] = (uint32_t)literals.size();
+            literals.push_back(string->getText());
+            if (string->hasEscapes())
+                flags[node] = Escapes;
+        } else if (auto conditional = dynamic_cast<Conditional*>(expr)) {
+            kind[node] = IfKind;
+            if (conditional->hasElse())
+                flags[node] = HasElse;
+        } else if (auto let = dynamic_cast<Let*>(expr)) {
+            kind[node] = LetKind;
+            value[node] = (uint32_t)bindings.size();
+            bindings.push_back({intern(let->getName()), intern(let->getType().getName())});
+            if (let->getInitExpr())
+                flags[node] = HasInit;
+        } else if (auto boolean = dynamic_cast<BooleanLiteral*>(expr)) {
+            kind[node] = BooleanKind;
+            value[node] = boolean->getValue();
+        } else if (dynamic_cast<Self*>(expr)) {
+            kind[node] = SelfKind;
+        } else if (auto assign = dynamic_cast<Assign*>(expr)) {
+            kind[node] = AssignKind;
+            value[node] = intern(assign->getName());
+        } else if (dynamic_cast<WhileLoop*>(expr)) {
+            kind[node] = WhileKind;
+        } else if (auto unary = dynamic_cast<UnOp*>(expr)) {
+            kind[node] = UnaryKind;
+            value[node] = intern(unary->getOp());
+        } else if (auto created = dynamic_cast<New*>(expr)) {
+            kind[node] = NewKind;
+            value[node] = intern(created->getClassName());
+        } else {
+            kind[node] = UnitKind;
+        }
+        auto children = expr->getChildren();
+        if (!children.empty())
+            addExpressions(node, children);
+    }
+
+    void setPosition(uint32_t node, const ASTNode* from) {
+        line[node] = from->getLine();
+        column[node] = from->getColumn();
+    }
+
+    // Ends the text of 'node' with 'close', then its type if 'typed' (closeText of AST.cpp)
+    void close(bool typed, const char* text, uint32_t node, std::string& out) const {
+        out += text;
+        if (typed) {
+            out += " : ";
+            out += names[type[node]];
+        }
+    }
+
+    /**
+     * Appends the text of 'node' up to its child number 'part', advances 'part' and returns
+     * that child, or the end of the text and None: Expr::printPart, for all the kinds.
+     */
+    uint32_t printPart(bool typed, uint32_t node, uint32_t& part, std::string& out) const {
+        uint32_t first = firstChild[node], count = childCount[node];
+        uint32_t at = part++;
+        switch (kind[node]) {
+        case ProgramKind:
+            // as Program::toString2, the built-in Object left out
+            if (at == 0)
+                out += "[";
+            else if (Program::isSeparated(at - 1, count))
+                out += Program::classSeparator;
+            for (; at < count; at = part++) {
+                if (value[first + at] != objectName)
+                    return first + at;
+            }
+            out += "]";
+            return None;
+        case ClassKind:
+            if (at == 0) {
+                out += "Class(";
+                out += names[value[node]];
+                out += ", ";
+                out += names[type[node]];
+                out += ", [";
+            }
+            if (at < count) {
+                if (kind[first + at] == MethodKind && (at == 0 || kind[first + at - 1] == FieldKind))
+                    out += "], \n\t[";
+                else if (at > 0)
+                    out += ", ";
+                return first + at;
+            }
+            if (count == 0 || kind[first + count - 1] == FieldKind)
+                out += "], [";
+            out += "])";
+            return None;
+        case FieldKind:
+            if (at == 0) {
+                out += "Field(";
+                out += names[value[node]];
+                out += ", ";
+                out += names[type[node]];
+                if (count > 0) {
+                    out += ", ";
+                    return first;
+                }
+            }
+            out += ")";
+            return None;
+        case MethodKind:
+            if (at == 0) {
+                out += "Method(";
+                out += names[value[node]];
+                out += ", [";
+            } else if (at + 1 < count) {
+                out += ", ";
+            }
+            if (at + 1 == count) {
+                out += "], ";
+                out += names[type[node]];
+                out += ", ";
+            }
+            if (at < count)
+                return first + at;
+            out += ")";
+            return None;
+        case FormalKind:
+            out += names[value[node]];
+            out += " : ";
+            out += names[type[node]];
+            return None;
+        case IntegerKind:
+            out += std::to_string((int)value[node]);
+            close(typed, "", node, out);
+            return None;
+        case StringKind:
+            out += '"';
+            StringLiteral::appendString(literals[value[node]], flags[node] & Escapes, out);
+            close(typed, "\"", node, out);
+            return None;
+        case BooleanKind:
+            close(typed, value[node] ? "true" : "false", node, out);
+            return None;
+        case IdentifierKind:
+            close(typed, names[value[node]].c_str(), node, out);
+            return None;
+        case SelfKind:
+            close(typed, "self", node, out);
+            return None;
+        case NewKind:
+            out += "New(";
+            out += names[value[node]];
+            close(typed, ")", node, out);
+            return None;
+        case UnitKind:
+            close(typed, "()", node, out);
+            return None;
+        case NullKind:
+            out += "null";
+            return None;
+        case BinaryKind:
+        case UnaryKind:
+            if (at == 0) {
+                out += kind[node] == BinaryKind ? "BinOp(" : "UnOp(";
+                out += names[value[node]];
+                out += ", ";
+            } else if (at < count) {
+                out += ", ";
+            }
+            break;
+        case IfKind:
+            if (at == 2 && !(flags[node] & HasElse))
+                at = count;
+            // fall through
+        case WhileKind:
+            if (at == 0)
+                out += kind[node] == IfKind ? "If(" : "While(";
+            else if (at < count)
+                out += ", ";
+            break;
+        case BlockKind:
+            if (at == 0)
+                out += count > 0 ? "\n\t[" : "[";
+            else if (at < count)
+                out += ", ";
+            if (at == count) {
+                // a null expression leaves a separator after the last one, as Block::printPart
+                for (uint32_t i = first; i < first + count; ++i) {
+                    if (kind[i] == NullKind) {
+                        out += ", ";
+                        break;
+                    }
+                }
+                close(typed, "]", node, out);
+                return None;
+            }
+            return first + at;
+        case LetKind:
+            if (at == 0) {
+                out += "Let(";
+                out += names[bindings[value[node]].first];
+                out += ", ";
+                out += names[bindings[value[node]].second];
+                out += ", ";
+            } else if (at < count) {
+                out += ", ";
+            }
+            break;
+        case AssignKind:
+            if (at == 0) {
+                out += "Assign(";
+                out += names[value[node]];
+                out += ", ";
+            }
+            break;
+        case CallKind:
+            if (at == 0)
+                out += "Call(";
+            else if (at == 1) {
+                out += ", ";
+                out += names[value[node]];
+                out += ", [";
+            } else if (at < count) {
+                out += ", ";
+            }
+            if (at < count)
+                return first + at;
+            close(typed, "])", node, out);
+            return None;
+        }
+        if (at < count)
+            return first + at;
+        close(typed, ")", node, out);
+        return None;
+    }
+};
+
+#endif
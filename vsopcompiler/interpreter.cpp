@@ -0,0 +1,662 @@
+#include "AST.hpp"
+#include "jit.cpp"
+#include "profiler.cpp"
+
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+
+// Tree-walking interpreter over the typed AST (mode -x).
+//
+// It executes the Program produced by the parser, once SemanticAnalyzer::analyze has
+// accepted it and the optional optimization passes have run: Main is instantiated and
+// its main method is called, its result becomes the exit code of vsopc.
+// Arithmetic on int32 wraps around; runtime errors (division by zero, dispatch on a
+// null object) are reported like the other errors of the compiler and stop the program.
+//
+// With --jit, a method called jitThreshold times is compiled to machine code by
+// JitCompiler (jit.cpp) and later calls run that code; methods the JIT rejects stay
+// interpreted; --jit-regalloc gives the locals of compiled code registers. VSOP_JIT_REPORT
+// in the environment prints what was compiled at exit.
+//
+// With --inline-caches, each call site remembers the methods it dispatched to, keyed on
+// the class ID of the receiver: up to InlineCache::maxEntries classes, after which the
+// site is megamorphic and goes back to the vtable. VSOP_IC_REPORT prints their hit rates.
+//
+// With --profile, every method activation goes through a Profiler (profiler.cpp): its
+// report is printed on stderr at exit, the folded stacks written to <file>.folded and the
+// profile for --use-profile to <file>.profdata. With --use-profile, a call site whose
+// receivers were nearly all of one class first checks for that class and calls its method
+// (guarded devirtualization), before the inline cache or the vtable.
+
+struct Instance;
+struct ClassInfo;
+
+/**
+ * Value - A runtime value: unit, int32, bool, string or a (possibly null) object
+ */
+struct Value {
+    enum Kind { UNIT, INT, BOOL, STRING, OBJECT };
+    Kind kind = UNIT;
+    int32_t num = 0;                    // int32 and bool values
+    std::shared_ptr<const std::string> str;
+    std::shared_ptr<Instance> obj;      // empty for the null object
+
+    static Value unit() { return Value(); }
+    static Value integer(int32_t i) { Value v; v.kind = INT; v.num = i; return v; }
+    static Value boolean(bool b) { Value v; v.kind = BOOL; v.num = b; return v; }
+    static Value string(std::shared_ptr<const std::string> s) { Value v; v.kind = STRING; v.str = std::move(s); return v; }
+    static Value object(std::shared_ptr<Instance> o) { Value v; v.kind = OBJECT; v.obj = std::move(o); return v; }
+};
+
+/**
+ * JitState - Tiering state of a method, shared by all the vtables containing it
+ */
+struct JitState {
+    unsigned int calls = 0;
+    bool rejected = false;              // the JIT does not support the method
+    std::unique_ptr<JitCode> code;
+};
+
+/**
+ * MethodInfo - A vtable entry: the implementation and the class defining it
+ */
+struct MethodInfo {
+    MethodNode* method = nullptr;
+    ClassInfo* owner = nullptr;
+    JitState* jit = nullptr;
+    bool builtin = false;               // defined by Object, run by invokeBuiltin
+};
+
+/**
+ * ClassInfo - Runtime description of a class: field layout and vtable
+ */
+struct ClassInfo {
+    unsigned int id = 0;                // in order of creation
+    ClassNode* node = nullptr;
+    ClassInfo* parent = nullptr;
+    std::vector<FieldNode*> fields; // inherited fields first, each class in source order
+    std::unordered_map<std::string, size_t> fieldIndex;
+    std::unordered_map<std::string, MethodInfo> vtable;
+};
+
+/**
+ * InlineCache - Dispatch cache of a call site: receiver class ID to method
+ */
+struct InlineCache {
+    static const size_t maxEntries = 4;
+
+    struct Entry {
+        unsigned int classId;
+        const MethodInfo* target;
+    };
+    Entry entries[maxEntries];
+    size_t size = 0;
+    bool megamorphic = false;           // more receiver classes than entries
+    bool guarded = false;               // from the profile: checked before the entries
+    unsigned int guardClassId = 0;
+    const MethodInfo* guardTarget = nullptr;
+    uint64_t hits = 0;
+    uint64_t misses = 0;                // including all the lookups once megamorphic
+};
+
+/**
+ * InterpreterOptions - Execution strategies selected on the command line
+ */
+struct InterpreterOptions {
+    bool jit = false;                   // --jit
+    bool jitRegisters = false;          // --jit-regalloc
+    bool inlineCaches = false;          // --inline-caches
+    bool profile = false;               // --profile
+    const ProfileData* profileData = nullptr;   // --use-profile
+};
+
+/**
+ * Instance - An object: its dynamic class and its field values
+ */
+struct Instance {
+    ClassInfo* cls;
+    std::vector<Value> fields;
+};
+
+class Interpreter {
+public:
+    static const unsigned int jitThreshold = 100;
+
+    Interpreter(std::string fileName, const InterpreterOptions& options = InterpreterOptions())
+        : fileName(std::move(fileName)), jit(options.jit), jitRegisters(options.jitRegisters),
+          inlineCaches(options.inlineCaches), profileData(options.profileData) {
+        if (options.profile)
+            profiler = std::make_unique<Profiler>();
+    }
+
+    // Runs Main.main and returns its result
+    int run(Program* program) {
+        for (auto& cls : program->getClasses())
+            classNodes[cls->name] = cls.get();
+        for (auto& cls : program->getClasses())
+            getClassInfo(cls->name);
+
+        Value mainObject = instantiate(getClassInfo("Main"));
+        Value result = invoke(mainObject, "main", {}, 0, 0);
+        std::cout.flush();
+        if (jit && std::getenv("VSOP_JIT_REPORT"))
+            reportJit();
+        if (inlineCaches && std::getenv("VSOP_IC_REPORT"))
+            reportInlineCaches();
+        if (profiler) {
+            profiler->report(std::cerr, fileName);
+            std::string foldedPath = fileName + ".folded";
+            if (profiler->writeFoldedStacks(foldedPath))
+                std::cerr << "folded stacks written to " << foldedPath << std::endl;
+            else
+                std::cerr << "cannot write the folded stacks to " << foldedPath << std::endl;
+            std::string profilePath = fileName + ".profdata";
+            if (profiler->saveProfile(profilePath))
+                std::cerr << "profile written to " << profilePath << std::endl;
+            else
+                std::cerr << "cannot write the profile to " << profilePath << std::endl;
+        }
+        return result.num;
+    }
+
+private:
+    /**
+     * Frame - Activation of a method: the receiver and the local bindings (formals, lets)
+     */
+    struct Frame {
+        std::shared_ptr<Instance> self;
+        std::vector<std::pair<std::string, Value>> locals;
+    };
+
+    std::string fileName;
+    std::unordered_map<std::string, ClassNode*> classNodes;
+    std::unordered_map<std::string, std::unique_ptr<ClassInfo>> classInfos;
+    std::unordered_map<const StringLiteral*, std::shared_ptr<const std::string>> stringLiterals;
+    std::shared_ptr<const std::string> emptyString = std::make_shared<const std::string>();
+
+    bool jit;
+    bool jitRegisters;
+    JitCompiler::Stats jitTotals;                           // over the compiled methods
+    std::unordered_map<MethodNode*, std::unique_ptr<JitState>> jitStates;
+    unsigned int jitCompiled = 0;
+    unsigned int jitRejected = 0;
+
+    bool inlineCaches;
+    std::vector<std::pair<Call*, InlineCache>> callSites; // by site ID - 1
+
+    std::unique_ptr<Profiler> profiler;
+    const ProfileData* profileData;
+
+    void reportRuntimeError(std::string message, unsigned int column = 0, unsigned int line = 0) {
+        std::cout.flush();
+        std::cerr << fileName << ":" << line << ":" << column
+                  << ": runtime error: " << message << std::endl;
+        exit(1);
+    }
+
+    ClassInfo* getClassInfo(const std::string& className) {
+        auto it = classInfos.find(className);
+        if (it != classInfos.end())
+            return it->second.get();
+
+        ClassNode* node = classNodes.at(className);
+        auto info = std::make_unique<ClassInfo>();
+        info->id = classInfos.size();
+        info->node = node;
+        if (!node->parent.empty() && node->parent != "NULL_PARENT" && classNodes.count(node->parent)) {
+            info->parent = getClassInfo(node->parent);
+            info->fields = info->parent->fields;
+            info->fieldIndex = info->parent->fieldIndex;
+            info->vtable = info->parent->vtable;
+        }
+        // the parser stores fields and methods in reverse source order
+        for (auto it = node->getFields().rbegin(); it != node->getFields().rend(); ++it) {
+            info->fieldIndex[(*it)->getName()] = info->fields.size();
+            info->fields.push_back(it->get());
+        }
+        for (auto& method : node->getMethods()) {
+            auto& state = jitStates[method.get()];
+            state = std::make_unique<JitState>();
+            info->vtable[method->getName()] = MethodInfo{method.get(), info.get(), state.get(), node->name == "Object"};
+        }
+
+        ClassInfo* result = info.get();
+        classInfos[className] = std::move(info);
+        return result;
+    }
+
+    Value defaultValue(const std::string& typeName) {
+        if (typeName == "int32")
+            return Value::integer(0);
+        if (typeName == "bool")
+            return Value::boolean(false);
+        if (typeName == "string")
+            return Value::string(emptyString);
+        if (typeName == "unit")
+            return Value::unit();
+        return Value::object(nullptr);
+    }
+
+    Value instantiate(ClassInfo* cls) {
+        auto object = std::make_shared<Instance>();
+        object->cls = cls;
+        object->fields.reserve(cls->fields.size());
+        for (FieldNode* field : cls->fields)
+            object->fields.push_back(defaultValue(field->getTypeName()));
+
+        // initializers run in layout order, without access to the object under construction
+        Frame frame{object, {}};
+        for (size_t i = 0; i < cls->fields.size(); ++i) {
+            if (cls->fields[i]->getInitExpr())
+                object->fields[i] = eval(cls->fields[i]->getInitExpr().get(), frame);
+        }
+        return Value::object(object);
+    }
+
+    Value* lookup(const std::string& name, Frame& frame) {
+        for (auto it = frame.locals.rbegin(); it != frame.locals.rend(); ++it) {
+            if (it->first == name)
+                return &it->second;
+        }
+        if (frame.self) {
+            auto fieldIt = frame.self->cls->fieldIndex.find(name);
+            if (fieldIt != frame.self->cls->fieldIndex.end())
+                return &frame.self->fields[fieldIt->second];
+        }
+        return nullptr;
+    }
+
+    // The characters of a string literal, decoded once
+    std::shared_ptr<const std::string> decodeLiteral(const StringLiteral* literal) {
+        auto it = stringLiterals.find(literal);
+        if (it != stringLiterals.end())
+            return it->second;
+
+        auto result = std::make_shared<const std::string>(literal->getValue());
+        stringLiterals[literal] = result;
+        return result;
+    }
+
+    static int32_t power(int32_t base, int32_t exponent) {
+        if (exponent < 0)
+            return base == 1 ? 1 : (base == -1 ? (exponent % 2 ? -1 : 1) : 0);
+        uint32_t result = 1;
+        uint32_t factor = (uint32_t) base;
+        while (exponent) {
+            if (exponent & 1)
+                result *= factor;
+            factor *= factor;
+            exponent >>= 1;
+        }
+        return (int32_t) result;
+    }
+
+    Value evalBinary(BinaryOperation* binOp, Frame& frame) {
+        const std::string& op = binOp->getOperator();
+        Value left = eval(binOp->getLeft(), frame);
+
+        if (op == "and") {
+            if (!left.num)
+                return Value::boolean(false);
+            return Value::boolean(eval(binOp->getRight(), frame).num);
+        }
+
+        Value right = eval(binOp->getRight(), frame);
+        uint32_t l = (uint32_t) left.num;
+        uint32_t r = (uint32_t) right.num;
+
+        if (op == "+") return Value::integer((int32_t) (l + r));
+        if (op == "-") return Value::integer((int32_t) (l - r));
+        if (op == "*") return Value::integer((int32_t) (l * r));
+        if (op == "<") return Value::boolean(left.num < right.num);
+        if (op == "<=") return Value::boolean(left.num <= right.num);
+        if (op == "^") return Value::integer(power(left.num, right.num));
+        if (op == "/") {
+            if (right.num == 0)
+                reportRuntimeError("division by zero", binOp->getColumn(), binOp->getLine());
+            if (left.num == INT32_MIN && right.num == -1)
+                return Value::integer(INT32_MIN);
+            return Value::integer(left.num / right.num);
+        }
+        if (op == "=") {
+            switch (left.kind) {
+                case Value::STRING: return Value::boolean(*left.str == *right.str);
+                case Value::OBJECT: return Value::boolean(left.obj == right.obj);
+                case Value::UNIT: return Value::boolean(true);
+                default: return Value::boolean(left.num == right.num);
+            }
+        }
+        reportRuntimeError("unknown binary operator '" + op + "'", binOp->getColumn(), binOp->getLine());
+        return Value::unit();
+    }
+
+    // Built-in methods of Object
+    Value invokeBuiltin(const std::string& name, Value& receiver, std::vector<Value>& args) {
+        if (name == "print") {
+            std::cout << *args[0].str;
+        } else if (name == "printInt32") {
+            std::cout << args[0].num;
+        } else if (name == "printBool") {
+            std::cout << (args[0].num ? "true" : "false");
+        } else if (name == "inputLine") {
+            std::cout.flush();
+            std::string line;
+            if (!std::getline(std::cin, line))
+                return Value::string(emptyString);
+            return Value::string(std::make_shared<const std::string>(std::move(line)));
+        } else if (name == "inputBool") {
+            std::cout.flush();
+            std::string word;
+            if (!(std::cin >> word) || (word != "true" && word != "false"))
+                reportRuntimeError("inputBool: expected 'true' or 'false'");
+            return Value::boolean(word == "true");
+        } else if (name == "inputInt32") {
+            std::cout.flush();
+            std::string word;
+            if (!(std::cin >> word))
+                reportRuntimeError("inputInt32: expected an integer");
+            try {
+                size_t used = 0;
+                long long number = std::stoll(word, &used, 0);
+                if (used != word.size() || number < INT32_MIN || number > INT32_MAX)
+                    throw std::out_of_range(word);
+                return Value::integer((int32_t) number);
+            } catch (const std::exception&) {
+                reportRuntimeError("inputInt32: invalid integer '" + word + "'");
+            }
+        }
+        return receiver;
+    }
+
+    void compile(const MethodInfo& target) {
+        Value probe;
+        JitLayout layout{sizeof(Value), static_cast<size_t>(reinterpret_cast<char*>(&probe.num) - reinterpret_cast<char*>(&probe))};
+        JitHelpers helpers{&Interpreter::jitInvoke, &Interpreter::jitDivisionByZero, &Interpreter::power};
+        JitCompiler compiler(layout, helpers, target.owner->fieldIndex, jitRegisters);
+        target.jit->code = compiler.compile(target.method);
+        if (target.jit->code) {
+            jitCompiled++;
+            jitTotals.locals += compiler.getStats().locals;
+            jitTotals.inRegisters += compiler.getStats().inRegisters;
+            jitTotals.spilled += compiler.getStats().spilled;
+            jitTotals.spillSlots += compiler.getStats().spillSlots;
+        } else {
+            target.jit->rejected = true;
+            jitRejected++;
+        }
+    }
+
+    void reportJit() {
+        std::cerr << "jit: " << jitCompiled << " methods compiled, " << jitRejected << " rejected";
+        if (jitRegisters) {
+            std::cerr << "; " << jitTotals.locals << " locals, " << jitTotals.inRegisters << " in registers, "
+                      << jitTotals.spilled << " spilled to " << jitTotals.spillSlots << " slots";
+        }
+        std::cerr << std::endl;
+    }
+
+    Value runCompiled(const MethodInfo& target, Value& receiver, std::vector<Value>& args) {
+        std::vector<int64_t> values(args.size());
+        for (size_t i = 0; i < args.size(); ++i)
+            values[i] = args[i].num;
+        JitFrame frame{receiver.obj->fields.data(), values.data(), this, &receiver.obj};
+        int64_t result = target.jit->code->entry()(&frame);
+
+        std::string returnType = target.method->getReturnType().getName();
+        if (returnType == "int32")
+            return Value::integer(static_cast<int32_t>(result));
+        if (returnType == "bool")
+            return Value::boolean(result != 0);
+        return Value::unit();
+    }
+
+    // Calls from compiled code: the receiver is self, arguments are int32 or bool
+    static int64_t jitInvoke(JitFrame* frame, Call* call, const int64_t* args) {
+        auto interpreter = static_cast<Interpreter*>(frame->interpreter);
+        auto& self = *static_cast<const std::shared_ptr<Instance>*>(frame->self);
+        auto& argExprs = call->getArgs();
+        std::vector<Value> values;
+        values.reserve(argExprs.size());
+        for (size_t i = 0; i < argExprs.size(); ++i) {
+            if (argExprs[i]->getTypeName() == "bool")
+                values.push_back(Value::boolean(args[i] != 0));
+            else
+                values.push_back(Value::integer(static_cast<int32_t>(args[i])));
+        }
+        Value receiver = Value::object(self);
+        const MethodInfo& target = interpreter->dispatch(call, receiver);
+        return interpreter->invokeMethod(target, std::move(receiver), std::move(values), call).num;
+    }
+
+    static void jitDivisionByZero(JitFrame* frame, BinaryOperation* site) {
+        auto interpreter = static_cast<Interpreter*>(frame->interpreter);
+        interpreter->reportRuntimeError("division by zero", site->getColumn(), site->getLine());
+    }
+
+    // Method 'name' in the vtable of the receiver
+    const MethodInfo& lookupMethod(const Value& receiver, const std::string& name,
+                                   unsigned int column, unsigned int line) {
+        if (!receiver.obj)
+            reportRuntimeError("dispatch of '" + name + "' on a null object", column, line);
+
+        auto it = receiver.obj->cls->vtable.find(name);
+        if (it == receiver.obj->cls->vtable.end())
+            reportRuntimeError("method '" + name + "' not found", column, line);
+        return it->second;
+    }
+
+    // Method called by 'call' on the receiver, through the inline cache of the call site
+    const MethodInfo& dispatch(Call* call, const Value& receiver) {
+        if ((!inlineCaches && !profileData) || !receiver.obj)
+            return lookupMethod(receiver, call->getMethodName(), call->getColumn(), call->getLine());
+
+        if (call->getSiteId() == 0) {
+            callSites.emplace_back(call, InlineCache());
+            call->setSiteId(callSites.size());
+            if (profileData)
+                guardCallSite(call, callSites.back().second);
+        }
+        InlineCache& cache = callSites[call->getSiteId() - 1].second;
+        unsigned int classId = receiver.obj->cls->id;
+        if (cache.guarded && cache.guardClassId == classId) {
+            cache.hits++;
+            return *cache.guardTarget;
+        }
+        if (!inlineCaches)
+            return lookupMethod(receiver, call->getMethodName(), call->getColumn(), call->getLine());
+
+        if (!cache.megamorphic) {
+            for (size_t i = 0; i < cache.size; ++i) {
+                if (cache.entries[i].classId == classId) {
+                    cache.hits++;
+                    return *cache.entries[i].target;
+                }
+            }
+        }
+
+        cache.misses++;
+        const MethodInfo& target = lookupMethod(receiver, call->getMethodName(), call->getColumn(), call->getLine());
+        if (cache.megamorphic)
+            return target;
+        if (cache.size < InlineCache::maxEntries)
+            cache.entries[cache.size++] = {receiver.obj->cls->id, &target};
+        else
+            cache.megamorphic = true;
+        return target;
+    }
+
+    // Guarded devirtualization: the method of the class the profile saw at this site
+    void guardCallSite(const Call* call, InlineCache& cache) {
+        const std::string* className = profileData->dominantReceiver(call);
+        if (!className || !classNodes.count(*className))
+            return;
+        ClassInfo* cls = getClassInfo(*className);
+        auto it = cls->vtable.find(call->getMethodName());
+        if (it == cls->vtable.end())
+            return;
+        cache.guarded = true;
+        cache.guardClassId = cls->id;
+        cache.guardTarget = &it->second;
+    }
+
+    void reportInlineCaches() {
+        std::vector<std::pair<const Call*, const InlineCache*>> sites;
+        for (auto& [call, cache] : callSites)
+            sites.emplace_back(call, &cache);
+        std::sort(sites.begin(), sites.end(), [](const auto& a, const auto& b) {
+            if (a.first->getLine() != b.first->getLine())
+                return a.first->getLine() < b.first->getLine();
+            return a.first->getColumn() < b.first->getColumn();
+        });
+
+        uint64_t hits = 0;
+        uint64_t calls = 0;
+        for (auto& [call, cache] : sites) {
+            uint64_t siteCalls = cache->hits + cache->misses;
+            std::string state = cache->megamorphic ? "megamorphic"
+                              : cache->size > 1 ? "polymorphic (" + std::to_string(cache->size) + ")" : "monomorphic";
+            if (cache->guarded)
+                state += ", guarded";
+            char rate[16];
+            std::snprintf(rate, sizeof(rate), "%.2f%%", 100.0 * cache->hits / siteCalls);
+            std::cerr << "ic: " << fileName << ":" << call->getLine() << ":" << call->getColumn() << " "
+                      << call->getMethodName() << ": " << state << ", " << rate << " hits of " << siteCalls << " calls\n";
+            hits += cache->hits;
+            calls += siteCalls;
+        }
+        char rate[16];
+        std::snprintf(rate, sizeof(rate), "%.2f%%", calls ? 100.0 * hits / calls : 0.0);
+        std::cerr << "ic: " << sites.size() << " call sites, " << rate << " hits of " << calls << " calls" << std::endl;
+    }
+
+    Value invoke(Value receiver, const std::string& name, std::vector<Value> args,
+                 unsigned int column, unsigned int line) {
+        const MethodInfo& target = lookupMethod(receiver, name, column, line);
+        return invokeMethod(target, std::move(receiver), std::move(args));
+    }
+
+    // 'site' is the Call dispatching to the method, if any
+    Value invokeMethod(const MethodInfo& target, Value receiver, std::vector<Value> args, const Call* site = nullptr) {
+        if (!profiler)
+            return invokeTarget(target, std::move(receiver), std::move(args));
+        profiler->enter(target.method, target.owner->node->name, site, receiver.obj->cls->node->name);
+        Value result = invokeTarget(target, std::move(receiver), std::move(args));
+        profiler->exit();
+        return result;
+    }
+
+    Value invokeTarget(const MethodInfo& target, Value receiver, std::vector<Value> args) {
+        if (target.builtin)
+            return invokeBuiltin(target.method->getName(), receiver, args);
+
+        if (jit) {
+            JitState& state = *target.jit;
+            if (!state.code && !state.rejected && ++state.calls >= jitThreshold)
+                compile(target);
+            if (state.code)
+                return runCompiled(target, receiver, args);
+        }
+
+        Frame frame{receiver.obj, {}};
+        auto& formals = target.method->getFormals();
+        frame.locals.reserve(formals.size() + 4);
+        for (size_t i = 0; i < formals.size(); ++i)
+            frame.locals.emplace_back(formals[i]->getName(), std::move(args[i]));
+        return eval(target.method->getBlock(), frame);
+    }
+
+    Value eval(Expr* expr, Frame& frame) {
+        if (auto objIden = dynamic_cast<ObjectIdentifier*>(expr)) {
+            Value* slot = lookup(objIden->getName(), frame);
+            if (!slot)
+                reportRuntimeError("unbound identifier '" + objIden->getName() + "'", objIden->getColumn(), objIden->getLine());
+            return *slot;
+        }
+        else if (auto intLiteral = dynamic_cast<IntegerLiteral*>(expr)) {
+            return Value::integer(intLiteral->getValue());
+        }
+        else if (auto binOp = dynamic_cast<BinaryOperation*>(expr)) {
+            return evalBinary(binOp, frame);
+        }
+        else if (auto call = dynamic_cast<Call*>(expr)) {
+            Value receiver = eval(call->getExprObjectIdentifier(), frame);
+            std::vector<Value> args;
+            args.reserve(call->getArgs().size());
+            for (auto& arg : call->getArgs())
+                args.push_back(eval(arg.get(), frame));
+            const MethodInfo& target = dispatch(call, receiver);
+            return invokeMethod(target, std::move(receiver), std::move(args), call);
+        }
+        else if (auto block = dynamic_cast<Block*>(expr)) {
+            Value result;
+            for (auto& inner : block->getExprs())
+                result = eval(inner.get(), frame);
+            return result;
+        }
+        else if (auto cond = dynamic_cast<Conditional*>(expr)) {
+            bool taken = eval(cond->getCond_expr(), frame).num;
+            if (profiler)
+                profiler->branch(cond, taken);
+            if (taken)
+                return eval(cond->getThen_expr(), frame);
+            return eval(cond->getElse_expr(), frame);
+        }
+        else if (auto whileLoop = dynamic_cast<WhileLoop*>(expr)) {
+            uint64_t iterations = 0;
+            while (eval(whileLoop->getCond_expr(), frame).num) {
+                eval(whileLoop->getBody_expr(), frame);
+                iterations++;
+            }
+            if (profiler)
+                profiler->loop(whileLoop, iterations);
+            return Value::unit();
+        }
+        else if (auto assign = dynamic_cast<Assign*>(expr)) {
+            Value value = eval(assign->getExpr(), frame);
+            Value* slot = lookup(assign->getName(), frame);
+            if (!slot)
+                reportRuntimeError("unbound identifier '" + assign->getName() + "'", assign->getColumn(), assign->getLine());
+            *slot = value;
+            return value;
+        }
+        else if (auto let = dynamic_cast<Let*>(expr)) {
+            Value init = let->getInitExpr() ? eval(let->getInitExpr(), frame) : defaultValue(let->getType().getName());
+            frame.locals.emplace_back(let->getName(), std::move(init));
+            Value result = eval(let->getScopeExpr(), frame);
+            frame.locals.pop_back();
+            return result;
+        }
+        else if (auto unOp = dynamic_cast<UnOp*>(expr)) {
+            Value operand = eval(unOp->getExpr(), frame);
+            if (unOp->getOp() == "-")
+                return Value::integer((int32_t) (0u - (uint32_t) operand.num));
+            if (unOp->getOp() == "not")
+                return Value::boolean(!operand.num);
+            return Value::boolean(operand.kind == Value::OBJECT && !operand.obj);
+        }
+        else if (dynamic_cast<Self*>(expr)) {
+            return Value::object(frame.self);
+        }
+        else if (auto newExpr = dynamic_cast<New*>(expr)) {
+            return instantiate(getClassInfo(newExpr->getClassName()));
+        }
+        else if (auto boolLiteral = dynamic_cast<BooleanLiteral*>(expr)) {
+            return Value::boolean(boolLiteral->getValue());
+        }
+        else if (auto strLiteral = dynamic_cast<StringLiteral*>(expr)) {
+            return Value::string(decodeLiteral(strLiteral));
+        }
+        else if (dynamic_cast<Parenthesis*>(expr)) {
+            return Value::unit();
+        }
+        reportRuntimeError("cannot evaluate expression", expr->getColumn(), expr->getLine());
+        return Value::unit();
+    }
+};
@@ -0,0 +1,756 @@
+#ifndef JIT_CPP
+#define JIT_CPP
+
+#include "AST.hpp"
+
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define VSOP_JIT_SUPPORTED 1
+#else
+#define VSOP_JIT_SUPPORTED 0
+#endif
+
+// Template JIT from typed method bodies to x86-64 machine code (used by -x with --jit).
+//
+// Each construct is translated by a fixed template, as a stack machine: the value of
+// an expression ends up in eax, the left operand of a binary operation waits on the
+// machine stack while the right one is computed. Locals (formals and lets) live in
+// the frame, rbx points to the first field of self and r12 to the JitFrame.
+// Calls and the runtime errors go back to the interpreter through JitHelpers.
+//
+// By default every local has a stack slot. With register allocation, the locals get
+// registers by linear scan over their live intervals in the order of the generated code
+// (a local used in a loop is live around it): those live across a call (Call, ^) may only
+// take callee-saved registers, saved in the frame by the prologue; the others take the
+// caller-saved ones first. Spilled locals share stack slots when their intervals are disjoint.
+//
+// Only int32, bool and unit values are handled: a method whose formals, locals or used
+// values have another type, or that uses New, strings, isnull or a call on another
+// receiver than self, is rejected and stays interpreted.
+
+/**
+ * JitFrame - What compiled code receives from the interpreter
+ */
+struct JitFrame {
+    void* fields;               // first field slot of self
+    const int64_t* args;        // values of the formals
+    void* interpreter;
+    const void* self;           // the receiver, as the interpreter holds it
+};
+
+using JitFunction = int64_t (*)(JitFrame*);
+
+/**
+ * JitHelpers - Entry points of the interpreter called by compiled code
+ */
+struct JitHelpers {
+    int64_t (*invoke)(JitFrame* frame, Call* call, const int64_t* args);
+    void (*divisionByZero)(JitFrame* frame, BinaryOperation* site);
+    int32_t (*power)(int32_t base, int32_t exponent);
+};
+
+/**
+ * JitLayout - Where compiled code finds the int32 or bool value of a field
+ */
+struct JitLayout {
+    size_t fieldStride;         // bytes from one field slot to the next
+    size_t valueOffset;         // offset of the value in a slot
+};
+
+/**
+ * JitCode - Machine code of a method in its own executable pages
+ */
+class JitCode {
+public:
+    // Copies the code to fresh pages, made executable once written; nullptr on failure
+    static std::unique_ptr<JitCode> install(const std::vector<uint8_t>& bytes) {
+#if VSOP_JIT_SUPPORTED
+        size_t pageSize = 4096;
+        size_t size = (bytes.size() + pageSize - 1) / pageSize * pageSize;
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            return nullptr;
+        std::memcpy(memory, bytes.data(), bytes.size());
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, size);
+            return nullptr;
+        }
+        return std::unique_ptr<JitCode>(new JitCode(memory, size));
+#else
+        (void) bytes;
+        return nullptr;
+#endif
+    }
+
+    ~JitCode() {
+#if VSOP_JIT_SUPPORTED
+        munmap(memory, size);
+#endif
+    }
+
+    JitFunction entry() const { return reinterpret_cast<JitFunction>(memory); }
+
+private:
+    JitCode(void* memory, size_t size) : memory(memory), size(size) {}
+
+    void* memory;
+    size_t size;
+};
+
+class JitCompiler {
+public:
+    /**
+     * Stats - What register allocation did for the last compiled method
+     */
+    struct Stats {
+        size_t locals = 0;
+        size_t inRegisters = 0;
+        size_t spilled = 0;
+        size_t spillSlots = 0;          // after spilled locals share slots
+    };
+
+    JitCompiler(const JitLayout& layout, const JitHelpers& helpers,
+                const std::unordered_map<std::string, size_t>& fieldIndex, bool allocateRegisters = false)
+        : layout(layout), helpers(helpers), fieldIndex(fieldIndex), allocateRegisters(allocateRegisters) {}
+
+    const Stats& getStats() const { return stats; }
+
+    // Compiles 'method' of the class whose fields are 'fieldIndex'; nullptr if unsupported
+    std::unique_ptr<JitCode> compile(MethodNode* method) {
+        if (!VSOP_JIT_SUPPORTED)
+            return nullptr;
+        code.clear();
+        scope.clear();
+        locations.clear();
+        calleeSaved.clear();
+        localCount = 0;
+        slotCount = 0;
+        pushDepth = 0;
+        supported = true;
+        stats = Stats();
+
+        std::string returnType = method->getReturnType().getName();
+        bool returnsValue = isScalar(returnType);
+        if (!returnsValue && returnType != "unit")
+            return nullptr;
+        auto& formals = method->getFormals();
+        for (auto& formal : formals) {
+            if (!isScalar(formal->getType().getName()))
+                return nullptr;
+        }
+
+        // push rbp; mov rbp, rsp; push rbx; push r12; sub rsp, <frame>
+        emit({0x55, 0x48, 0x89, 0xE5, 0x53, 0x41, 0x54, 0x48, 0x81, 0xEC});
+        size_t frameSizePatch = code.size();
+        emit32(0);
+        emit({0x49, 0x89, 0xFC});                   // mov r12, rdi
+        emit({0x48, 0x8B, 0x5F, 0x00});             // mov rbx, [rdi + fields]
+        emit({0x48, 0x8B, 0x47, 0x08});             // mov rax, [rdi + args]
+
+        if (allocateRegisters)
+            allocate(method);
+        std::vector<size_t> saveSlots;
+        for (int reg : calleeSaved) {
+            saveSlots.push_back(newSlot());
+            emit({0x4C, 0x89, static_cast<uint8_t>(0x85 | (reg & 7) << 3)});    // mov [rbp + slot], reg
+            emit32(slotOffset(saveSlots.back()));
+        }
+        size_t spillBase = slotCount;
+        slotCount += stats.spillSlots;
+        for (auto& location : locations) {
+            if (location.reg < 0)
+                location.slot += spillBase;
+        }
+
+        for (size_t i = 0; i < formals.size(); ++i) {
+            size_t local = newLocal();
+            const Location& location = locations[local];
+            if (location.reg >= 0) {
+                if (location.reg >= 8)
+                    emit({0x44});
+                emit({0x8B, static_cast<uint8_t>(0x80 | (location.reg & 7) << 3)});  // mov reg, [rax + 8 * i]
+                emit32(static_cast<int32_t>(8 * i));
+            } else {
+                emit({0x48, 0x8B, 0x88});           // mov rcx, [rax + 8 * i]
+                emit32(static_cast<int32_t>(8 * i));
+                emit({0x48, 0x89, 0x8D});           // mov [rbp + slot], rcx
+                emit32(slotOffset(location.slot));
+            }
+            scope.emplace_back(formals[i]->getName(), local);
+        }
+
+        compileExpr(method->getBlock(), returnsValue);
+        if (!supported)
+            return nullptr;
+        if (returnsValue)
+            emit({0x48, 0x63, 0xC0});               // movsxd rax, eax
+        else
+            emit({0x31, 0xC0});                     // xor eax, eax
+        for (size_t i = 0; i < calleeSaved.size(); ++i) {
+            emit({0x4C, 0x8B, static_cast<uint8_t>(0x85 | (calleeSaved[i] & 7) << 3)});  // mov reg, [rbp + slot]
+            emit32(slotOffset(saveSlots[i]));
+        }
+        emit({0x48, 0x8D, 0x65, 0xF0});             // lea rsp, [rbp - 16]
+        emit({0x41, 0x5C, 0x5B, 0x5D, 0xC3});       // pop r12; pop rbx; pop rbp; ret
+
+        // keeps rsp 16-byte aligned: rbx and r12 take 16 bytes below rbp
+        int32_t frameSize = static_cast<int32_t>((slotCount * 8 + 15) / 16 * 16);
+        std::memcpy(&code[frameSizePatch], &frameSize, 4);
+        return JitCode::install(code);
+    }
+
+private:
+    JitLayout layout;
+    JitHelpers helpers;
+    const std::unordered_map<std::string, size_t>& fieldIndex;
+    bool allocateRegisters;
+
+    /**
+     * Location - Where a local lives: a register, or a stack slot when reg < 0
+     */
+    struct Location {
+        int reg = -1;
+        size_t slot = 0;
+    };
+
+    /**
+     * Interval - Positions of the generated code where a local is live
+     */
+    struct Interval {
+        size_t local;
+        size_t start;
+        size_t end;
+        bool acrossCall = false;
+    };
+
+    // registers not used by the templates: rax, rcx and rdx are scratch, rbx and r12 taken
+    static constexpr int callerSavedRegisters[] = {6, 7, 8, 9, 10, 11};    // rsi, rdi, r8-r11
+    static constexpr int calleeSavedRegisters[] = {13, 14, 15};
+
+    std::vector<uint8_t> code;
+    std::vector<std::pair<std::string, size_t>> scope;     // names of the locals, innermost last
+    std::vector<Location> locations;                        // by local, in order of declaration
+    std::vector<int> calleeSaved;                           // used, so saved by the prologue
+    size_t localCount = 0;
+    size_t slotCount = 0;
+    size_t pushDepth = 0;       // values pushed on the machine stack
+    bool supported = true;
+    Stats stats;
+
+    static bool isScalar(const std::string& type) {
+        return type == "int32" || type == "bool";
+    }
+
+    void emit(std::initializer_list<uint8_t> bytes) {
+        code.insert(code.end(), bytes);
+    }
+
+    void emit32(int32_t value) {
+        uint8_t bytes[4];
+        std::memcpy(bytes, &value, 4);
+        code.insert(code.end(), bytes, bytes + 4);
+    }
+
+    void emit64(uint64_t value) {
+        uint8_t bytes[8];
+        std::memcpy(bytes, &value, 8);
+        code.insert(code.end(), bytes, bytes + 8);
+    }
+
+    size_t newSlot() {
+        return slotCount++;
+    }
+
+    // Formals, then lets in the order of the code: the same as in collectIntervals
+    size_t newLocal() {
+        if (!allocateRegisters)
+            locations.push_back(Location{-1, newSlot()});
+        else if (localCount >= locations.size())
+            supported = false;
+        return localCount++;
+    }
+
+    /* Register allocation */
+
+    /**
+     * LivenessWalk - Numbers the code of a method body in the order it is generated
+     */
+    struct LivenessWalk {
+        std::vector<Interval> intervals;
+        std::vector<std::pair<std::string, size_t>> scope;
+        std::vector<std::pair<size_t, size_t>> loops;
+        std::vector<size_t> calls;
+        size_t position = 1;
+
+        size_t newLocal(const std::string& name, size_t at) {
+            intervals.push_back(Interval{intervals.size(), at, at});
+            scope.emplace_back(name, intervals.size() - 1);
+            return intervals.size() - 1;
+        }
+
+        void touch(const std::string& name) {
+            for (auto it = scope.rbegin(); it != scope.rend(); ++it) {
+                if (it->first == name) {
+                    intervals[it->second].end = position++;
+                    return;
+                }
+            }
+        }
+
+        void walk(Expr* expr) {
+            if (auto let = dynamic_cast<Let*>(expr)) {
+                if (let->getInitExpr())
+                    walk(let->getInitExpr());
+                newLocal(let->getName(), position++);
+                walk(let->getScopeExpr());
+                scope.pop_back();
+            } else if (auto objIden = dynamic_cast<ObjectIdentifier*>(expr)) {
+                touch(objIden->getName());
+            } else if (auto assign = dynamic_cast<Assign*>(expr)) {
+                walk(assign->getExpr());
+                touch(assign->getName());
+            } else if (auto whileLoop = dynamic_cast<WhileLoop*>(expr)) {
+                size_t start = position++;
+                walk(whileLoop->getCond_expr());
+                walk(whileLoop->getBody_expr());
+                loops.emplace_back(start, position++);
+            } else if (auto call = dynamic_cast<Call*>(expr)) {
+                for (auto& arg : call->getArgs())
+                    walk(arg.get());
+                calls.push_back(position++);
+            } else {
+                for (auto child : expr->getChildren())
+                    walk(child->get());
+                auto binOp = dynamic_cast<BinaryOperation*>(expr);
+                if (binOp && binOp->getOperator() == "^")
+                    calls.push_back(position++);
+            }
+        }
+    };
+
+    void allocate(MethodNode* method) {
+        LivenessWalk liveness;
+        for (auto& formal : method->getFormals())
+            liveness.newLocal(formal->getName(), 0);
+        liveness.walk(method->getBlock());
+        std::vector<Interval> intervals = liveness.intervals;
+
+        // a local live when a loop starts, and used in it, is live until the loop ends
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto& [start, end] : liveness.loops) {
+                for (auto& interval : intervals) {
+                    if (interval.start < start && interval.end > start && interval.end < end) {
+                        interval.end = end;
+                        changed = true;
+                    }
+                }
+            }
+        }
+        for (auto& interval : intervals) {
+            for (size_t call : liveness.calls)
+                interval.acrossCall |= interval.start < call && call < interval.end;
+        }
+
+        locations.assign(intervals.size(), Location());
+        stats.locals = intervals.size();
+        std::sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b) {
+            return a.start < b.start || (a.start == b.start && a.local < b.local);
+        });
+
+        std::vector<const Interval*> active;
+        std::vector<const Interval*> spilled;
+        std::vector<int> freeRegisters(std::begin(callerSavedRegisters), std::end(callerSavedRegisters));
+        freeRegisters.insert(freeRegisters.end(), std::begin(calleeSavedRegisters), std::end(calleeSavedRegisters));
+        auto isCalleeSaved = [](int reg) { return reg >= 12; };
+
+        for (const Interval& current : intervals) {
+            for (auto it = active.begin(); it != active.end();) {
+                if ((*it)->end < current.start) {
+                    freeRegisters.push_back(locations[(*it)->local].reg);
+                    it = active.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            // caller-saved registers first, unless the local must survive a call
+            auto best = freeRegisters.end();
+            for (auto it = freeRegisters.begin(); it != freeRegisters.end(); ++it) {
+                if (current.acrossCall && !isCalleeSaved(*it))
+                    continue;
+                if (best == freeRegisters.end() || isCalleeSaved(*best) > isCalleeSaved(*it))
+                    best = it;
+            }
+            if (best != freeRegisters.end()) {
+                locations[current.local].reg = *best;
+                freeRegisters.erase(best);
+                active.push_back(&current);
+                continue;
+            }
+
+            // no register: spill whichever of the candidates ends last
+            auto victim = active.end();
+            for (auto it = active.begin(); it != active.end(); ++it) {
+                if (current.acrossCall && !isCalleeSaved(locations[(*it)->local].reg))
+                    continue;
+                if (victim == active.end() || (*it)->end > (*victim)->end)
+                    victim = it;
+            }
+            if (victim != active.end() && (*victim)->end > current.end) {
+                locations[current.local].reg = locations[(*victim)->local].reg;
+                locations[(*victim)->local].reg = -1;
+                spilled.push_back(*victim);
+                *victim = &current;
+            } else {
+                spilled.push_back(&current);
+            }
+        }
+
+        // spill slots, shared by locals whose intervals do not overlap
+        std::sort(spilled.begin(), spilled.end(), [](const Interval* a, const Interval* b) {
+            return a->start < b->start;
+        });
+        std::vector<size_t> slotEnds;
+        for (const Interval* interval : spilled) {
+            size_t slot = 0;
+            while (slot < slotEnds.size() && slotEnds[slot] >= interval->start)
+                slot++;
+            if (slot == slotEnds.size())
+                slotEnds.push_back(0);
+            slotEnds[slot] = interval->end;
+            locations[interval->local].slot = slot;
+        }
+
+        for (const Location& location : locations) {
+            if (location.reg >= 12 &&
+                std::find(calleeSaved.begin(), calleeSaved.end(), location.reg) == calleeSaved.end())
+                calleeSaved.push_back(location.reg);
+        }
+        std::sort(calleeSaved.begin(), calleeSaved.end());
+        stats.spilled = spilled.size();
+        stats.inRegisters = stats.locals - stats.spilled;
+        stats.spillSlots = slotEnds.size();
+    }
+
+    // Locals are below the saved rbx and r12
+    static int32_t slotOffset(size_t slot) {
+        return -16 - 8 * static_cast<int32_t>(slot + 1);
+    }
+
+    int32_t fieldOffset(size_t index) const {
+        return static_cast<int32_t>(index * layout.fieldStride + layout.valueOffset);
+    }
+
+    // Emits a jump with a 32-bit displacement to patch later, returns where it is
+    size_t jumpForward(std::initializer_list<uint8_t> opcode) {
+        emit(opcode);
+        emit32(0);
+        return code.size() - 4;
+    }
+
+    void bind(size_t patch) {
+        int32_t displacement = static_cast<int32_t>(code.size() - (patch + 4));
+        std::memcpy(&code[patch], &displacement, 4);
+    }
+
+    void jumpBack(size_t target) {
+        emit({0xE9});                               // jmp rel32
+        emit32(static_cast<int32_t>(target - (code.size() + 4)));
+    }
+
+    void push() {
+        emit({0x50});                               // push rax
+        pushDepth++;
+    }
+
+    void pop() {
+        emit({0x58});                               // pop rax
+        pushDepth--;
+    }
+
+    // Calls an absolute address with the arguments already in place
+    void callHelper(const void* target) {
+        bool realign = pushDepth % 2 != 0;
+        if (realign)
+            emit({0x48, 0x83, 0xEC, 0x08});         // sub rsp, 8
+        emit({0x48, 0xB8});                         // mov rax, imm64
+        emit64(reinterpret_cast<uint64_t>(target));
+        emit({0xFF, 0xD0});                         // call rax
+        if (realign)
+            emit({0x48, 0x83, 0xC4, 0x08});         // add rsp, 8
+    }
+
+    const size_t* lookupLocal(const std::string& name) const {
+        for (auto it = scope.rbegin(); it != scope.rend(); ++it) {
+            if (it->first == name)
+                return &it->second;
+        }
+        return nullptr;
+    }
+
+    void loadLocal(size_t local) {
+        const Location& location = locations[local];
+        if (location.reg >= 0) {
+            if (location.reg >= 8)
+                emit({0x44});
+            emit({0x89, static_cast<uint8_t>(0xC0 | (location.reg & 7) << 3)});  // mov eax, reg
+        } else {
+            emit({0x8B, 0x85});                     // mov eax, [rbp + slot]
+            emit32(slotOffset(location.slot));
+        }
+    }
+
+    void storeLocal(size_t local) {
+        const Location& location = locations[local];
+        if (location.reg >= 0) {
+            if (location.reg >= 8)
+                emit({0x41});
+            emit({0x89, static_cast<uint8_t>(0xC0 | (location.reg & 7))});       // mov reg, eax
+        } else {
+            emit({0x89, 0x85});                     // mov [rbp + slot], eax
+            emit32(slotOffset(location.slot));
+        }
+    }
+
+    void loadVariable(const std::string& name) {
+        if (const size_t* local = lookupLocal(name)) {
+            loadLocal(*local);
+        } else if (fieldIndex.count(name)) {
+            emit({0x8B, 0x83});                     // mov eax, [rbx + field]
+            emit32(fieldOffset(fieldIndex.at(name)));
+        } else {
+            supported = false;
+        }
+    }
+
+    void storeVariable(const std::string& name) {
+        if (const size_t* local = lookupLocal(name)) {
+            storeLocal(*local);
+        } else if (fieldIndex.count(name)) {
+            emit({0x89, 0x83});                     // mov [rbx + field], eax
+            emit32(fieldOffset(fieldIndex.at(name)));
+        } else {
+            supported = false;
+        }
+    }
+
+    // Loads a literal or a variable straight into ecx, false for other expressions
+    bool loadOperand(Expr* expr) {
+        if (auto intLiteral = dynamic_cast<IntegerLiteral*>(expr)) {
+            emit({0xB9});                           // mov ecx, imm32
+            emit32(intLiteral->getValue());
+            return true;
+        }
+        auto objIden = dynamic_cast<ObjectIdentifier*>(expr);
+        if (!objIden || !isScalar(objIden->getTypeName()))
+            return false;
+        if (const size_t* local = lookupLocal(objIden->getName())) {
+            const Location& location = locations[*local];
+            if (location.reg >= 0) {
+                if (location.reg >= 8)
+                    emit({0x44});
+                emit({0x89, static_cast<uint8_t>(0xC1 | (location.reg & 7) << 3)});  // mov ecx, reg
+            } else {
+                emit({0x8B, 0x8D});                 // mov ecx, [rbp + slot]
+                emit32(slotOffset(location.slot));
+            }
+            return true;
+        }
+        if (!fieldIndex.count(objIden->getName()))
+            return false;
+        emit({0x8B, 0x8B});                         // mov ecx, [rbx + field]
+        emit32(fieldOffset(fieldIndex.at(objIden->getName())));
+        return true;
+    }
+
+    // Leaves the value in eax when 'needValue'; otherwise only its effects matter
+    void compileExpr(Expr* expr, bool needValue) {
+        if (!supported)
+            return;
+
+        if (auto intLiteral = dynamic_cast<IntegerLiteral*>(expr)) {
+            emit({0xB8});                           // mov eax, imm32
+            emit32(intLiteral->getValue());
+        } else if (auto boolLiteral = dynamic_cast<BooleanLiteral*>(expr)) {
+            emit({0xB8});
+            emit32(boolLiteral->getValue() ? 1 : 0);
+        } else if (dynamic_cast<Parenthesis*>(expr)) {
+            emit({0x31, 0xC0});                     // xor eax, eax
+        } else if (auto objIden = dynamic_cast<ObjectIdentifier*>(expr)) {
+            if (isScalar(objIden->getTypeName()))
+                loadVariable(objIden->getName());
+            else if (needValue)
+                supported = false;
+        } else if (dynamic_cast<Self*>(expr) || dynamic_cast<StringLiteral*>(expr)) {
+            if (needValue)
+                supported = false;
+        } else if (auto binOp = dynamic_cast<BinaryOperation*>(expr)) {
+            compileBinary(binOp);
+        } else if (auto unOp = dynamic_cast<UnOp*>(expr)) {
+            compileExpr(unOp->getExpr(), true);
+            if (unOp->getOp() == "-")
+                emit({0xF7, 0xD8});                 // neg eax
+            else if (unOp->getOp() == "not")
+                emit({0x83, 0xF0, 0x01});           // xor eax, 1
+            else
+                supported = false;
+        } else if (auto block = dynamic_cast<Block*>(expr)) {
+            auto& exprs = block->getExprs();
+            for (size_t i = 0; i < exprs.size(); ++i)
+                compileExpr(exprs[i].get(), needValue && i + 1 == exprs.size());
+        } else if (auto cond = dynamic_cast<Conditional*>(expr)) {
+            // 'if not c' (e.g. a branch inverted by the profile) tests c and jumps the other way
+            Expr* test = cond->getCond_expr();
+            auto notOp = dynamic_cast<UnOp*>(test);
+            bool negated = notOp && notOp->getOp() == "not";
+            compileExpr(negated ? notOp->getExpr() : test, true);
+            emit({0x85, 0xC0});                     // test eax, eax
+            size_t toElse = jumpForward({0x0F, static_cast<uint8_t>(negated ? 0x85 : 0x84)});  // jne/je else
+            compileExpr(cond->getThen_expr(), needValue);
+            size_t toEnd = jumpForward({0xE9});     // jmp end
+            bind(toElse);
+            compileExpr(cond->getElse_expr(), needValue);
+            bind(toEnd);
+        } else if (auto whileLoop = dynamic_cast<WhileLoop*>(expr)) {
+            size_t top = code.size();
+            compileExpr(whileLoop->getCond_expr(), true);
+            emit({0x85, 0xC0});
+            size_t toEnd = jumpForward({0x0F, 0x84});
+            compileExpr(whileLoop->getBody_expr(), false);
+            jumpBack(top);
+            bind(toEnd);
+            if (needValue)
+                emit({0x31, 0xC0});
+        } else if (auto let = dynamic_cast<Let*>(expr)) {
+            if (!isScalar(let->getType().getName())) {
+                supported = false;
+                return;
+            }
+            if (let->getInitExpr())
+                compileExpr(let->getInitExpr(), true);
+            else
+                emit({0x31, 0xC0});
+            size_t local = newLocal();
+            if (!supported)
+                return;
+            storeLocal(local);
+            scope.emplace_back(let->getName(), local);
+            compileExpr(let->getScopeExpr(), needValue);
+            scope.pop_back();
+        } else if (auto assign = dynamic_cast<Assign*>(expr)) {
+            if (!isScalar(assign->getExpr()->getTypeName())) {
+                supported = false;
+                return;
+            }
+            compileExpr(assign->getExpr(), true);
+            storeVariable(assign->getName());
+        } else if (auto call = dynamic_cast<Call*>(expr)) {
+            compileCall(call, needValue);
+        } else {
+            supported = false;                      // New, or a construct added later
+        }
+    }
+
+    void compileBinary(BinaryOperation* binOp) {
+        const std::string& op = binOp->getOperator();
+        if (op == "and") {
+            compileExpr(binOp->getLeft(), true);
+            emit({0x85, 0xC0});
+            size_t toEnd = jumpForward({0x0F, 0x84});   // false: eax is already 0
+            compileExpr(binOp->getRight(), true);
+            bind(toEnd);
+            return;
+        }
+        if (!isScalar(binOp->getLeft()->getTypeName())) {
+            supported = false;                      // = on strings, objects or units
+            return;
+        }
+
+        compileExpr(binOp->getLeft(), true);
+        if (!loadOperand(binOp->getRight())) {
+            push();
+            compileExpr(binOp->getRight(), true);
+            emit({0x89, 0xC1});                     // mov ecx, eax: right in ecx
+            pop();                                  // left in eax
+        }
+
+        if (op == "+") {
+            emit({0x01, 0xC8});                     // add eax, ecx
+        } else if (op == "-") {
+            emit({0x29, 0xC8});                     // sub eax, ecx
+        } else if (op == "*") {
+            emit({0x0F, 0xAF, 0xC1});               // imul eax, ecx
+        } else if (op == "<" || op == "<=" || op == "=") {
+            emit({0x39, 0xC8});                     // cmp eax, ecx
+            uint8_t condition = op == "<" ? 0x9C : (op == "<=" ? 0x9E : 0x94);
+            emit({0x0F, condition, 0xC0});          // setl / setle / sete al
+            emit({0x0F, 0xB6, 0xC0});               // movzx eax, al
+        } else if (op == "/") {
+            emit({0x85, 0xC9});                     // test ecx, ecx
+            size_t nonZero = jumpForward({0x0F, 0x85});
+            emit({0x4C, 0x89, 0xE7});               // mov rdi, r12
+            emit({0x48, 0xBE});                     // mov rsi, imm64
+            emit64(reinterpret_cast<uint64_t>(binOp));
+            callHelper(reinterpret_cast<const void*>(helpers.divisionByZero));
+            bind(nonZero);
+            emit({0x83, 0xF9, 0xFF});               // cmp ecx, -1: idiv traps on INT32_MIN / -1
+            size_t notMinusOne = jumpForward({0x0F, 0x85});
+            emit({0xF7, 0xD8});                     // neg eax
+            size_t toEnd = jumpForward({0xE9});
+            bind(notMinusOne);
+            emit({0x99, 0xF7, 0xF9});               // cdq; idiv ecx
+            bind(toEnd);
+        } else if (op == "^") {
+            emit({0x89, 0xC7, 0x89, 0xCE});         // mov edi, eax; mov esi, ecx
+            callHelper(reinterpret_cast<const void*>(helpers.power));
+        } else {
+            supported = false;
+        }
+    }
+
+    void compileCall(Call* call, bool needValue) {
+        if (!dynamic_cast<Self*>(call->getExprObjectIdentifier())) {
+            supported = false;                      // the receiver would be an object
+            return;
+        }
+        std::string resultType = call->getTypeName();
+        if (needValue && !isScalar(resultType) && resultType != "unit") {
+            supported = false;
+            return;
+        }
+
+        // arguments go to consecutive slots, the first one at the lowest address
+        auto& args = call->getArgs();
+        size_t base = slotCount;
+        slotCount += args.size();
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (!isScalar(args[i]->getTypeName())) {
+                supported = false;
+                return;
+            }
+            compileExpr(args[i].get(), true);
+            emit({0x48, 0x63, 0xC0});               // movsxd rax, eax
+            emit({0x48, 0x89, 0x85});               // mov [rbp + slot], rax
+            emit32(slotOffset(base + args.size() - 1 - i));
+        }
+
+        emit({0x4C, 0x89, 0xE7});                   // mov rdi, r12
+        emit({0x48, 0xBE});                         // mov rsi, imm64
+        emit64(reinterpret_cast<uint64_t>(call));
+        emit({0x48, 0x8D, 0x95});                   // lea rdx, [rbp + first argument]
+        emit32(slotOffset(base + (args.empty() ? 0 : args.size() - 1)));
+        callHelper(reinterpret_cast<const void*>(helpers.invoke));
+    }
+};
+
+#endif // JIT_CPP
@@ -0,0 +1,237 @@
+#include "AST.hpp"
+#include "effects.cpp"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <vector>
+#include <functional>
+
+// Loop optimizations on WhileLoop, over the typed AST.
+//
+//  - loop-invariant code motion: maximal invariant subexpressions of a loop that can be
+//    evaluated early (field reads not written in the loop, arithmetic, calls on self of
+//    hoistable methods, see Effects::isHoistable) are bound by a 'let' wrapping the loop.
+//
+// Introduced variables start with '_', which no VSOP identifier can, so they never
+// clash with user names. Must run after SemanticAnalyzer::analyze.
+
+class LoopOptimizer {
+public:
+    // When set, only the loops it accepts are transformed (e.g. the hot loops of a profile)
+    std::function<bool(const WhileLoop*)> loopFilter;
+
+    void run(Program* program) {
+        effects.run(program);
+
+        for (auto& cls : program->getClasses()) {
+            if (cls->name == "Object")
+                continue;
+            for (auto& method : cls->getMethods()) {
+                std::vector<std::string> locals;
+                for (auto& formal : method->getFormals())
+                    locals.push_back(formal->getName());
+                for (auto* child : method->getBlock()->getChildren())
+                    optimize(*child, locals);
+            }
+        }
+    }
+
+    // Statistics of the last run
+    size_t hoistedExpressions = 0;
+
+private:
+    EffectAnalyzer effects;
+    unsigned int tempCounter = 0;
+
+    /**
+     * LoopInfo - What a loop modifies
+     */
+    struct LoopInfo {
+        std::unordered_map<std::string, int> assignCount;   // names assigned in the loop
+        std::unordered_set<std::string> declared;           // names bound by lets inside the loop
+        std::unordered_set<std::string> writtenFields;      // fields possibly written while looping
+    };
+
+    std::string newTemp(const std::string& prefix) {
+        return "_" + prefix + std::to_string(tempCounter++);
+    }
+
+    static bool contains(const std::vector<std::string>& names, const std::string& name) {
+        return std::find(names.begin(), names.end(), name) != names.end();
+    }
+
+    static std::unique_ptr<Expr> makeIdentifier(const std::string& name, const std::string& type,
+                                                unsigned int column = 0, unsigned int line = 0) {
+        auto identifier = std::make_unique<ObjectIdentifier>(name, column, line);
+        identifier->setTypeByName(type);
+        return identifier;
+    }
+
+    // Replaces the expression in 'slot' by 'let name : type <- init in <slot>'
+    static void wrapInLet(std::unique_ptr<Expr>& slot, const std::string& name, const std::string& type, std::unique_ptr<Expr> init) {
+        std::string resultType = slot->getTypeName();
+        unsigned int column = slot->getColumn(), line = slot->getLine();
+        auto let = std::make_unique<Let>(name, Type(type), column, line, std::move(init), std::move(slot));
+        let->setTypeByName(resultType);
+        slot = std::move(let);
+    }
+
+    // Inner loops first, so that what they hoist can move out of the outer ones
+    void optimize(std::unique_ptr<Expr>& root, std::vector<std::string>& locals) {
+        rewriteBottomUp(root, [&](std::unique_ptr<Expr>& slot) {
+            if (auto loop = dynamic_cast<WhileLoop*>(slot.get())) {
+                if (!loopFilter || loopFilter(loop))
+                    optimizeLoop(slot, locals);
+            }
+        }, &locals);
+    }
+
+    /* ======================== Loop analysis ======================== */
+
+    void collectLoopInfo(Expr* expr, LoopInfo& info) {
+        forEachExpr(expr, [&](Expr* e) {
+            if (auto assign = dynamic_cast<Assign*>(e))
+                info.assignCount[assign->getName()]++;
+            else if (auto let = dynamic_cast<Let*>(e))
+                info.declared.insert(let->getName());
+        });
+    }
+
+    LoopInfo analyzeLoop(WhileLoop* loop, const std::vector<std::string>& locals) {
+        LoopInfo info;
+        collectLoopInfo(loop, info);
+        info.writtenFields = effects.expressionEffects(loop, locals).writtenFields;
+        return info;
+    }
+
+    /* ======================== Invariant code motion ======================== */
+
+    // Returns true if the expression in 'slot' is invariant and hoistable; maximal hoistable
+    // subexpressions of a non-invariant expression are moved to 'hoisted'
+    bool markInvariants(std::unique_ptr<Expr>& root, const LoopInfo& info, const std::vector<std::string>& locals,
+                        std::vector<std::unique_ptr<Expr>*>& hoisted) {
+        // children before their parent, with an explicit stack
+        struct Frame {
+            Expr* expr;
+            std::vector<std::unique_ptr<Expr>*> children;
+            std::vector<bool> invariantChildren;
+        };
+        if (!root)
+            return true;
+        std::vector<Frame> frames{{root.get(), root->getChildren(), {}}};
+        bool invariant = true;
+        while (!frames.empty()) {
+            Frame& frame = frames.back();
+            if (frame.invariantChildren.size() < frame.children.size()) {
+                Expr* child = frame.children[frame.invariantChildren.size()]->get();
+                if (child)
+                    frames.push_back({child, child->getChildren(), {}});
+                else
+                    frame.invariantChildren.push_back(true);
+                continue;
+            }
+
+            bool allInvariant = std::find(frame.invariantChildren.begin(), frame.invariantChildren.end(), false)
+                                == frame.invariantChildren.end();
+            invariant = allInvariant && isInvariantNode(frame.expr, info, locals);
+            if (!invariant) {
+                for (size_t i = 0; i < frame.children.size(); ++i) {
+                    if (frame.invariantChildren[i] && isWorthHoisting(frame.children[i]->get(), locals))
+                        hoisted.push_back(frame.children[i]);
+                }
+            }
+            frames.pop_back();
+            if (!frames.empty())
+                frames.back().invariantChildren.push_back(invariant);
+        }
+        return invariant;
+    }
+
+    // Whether the node itself allows its (invariant) operands to be evaluated before the loop
+    bool isInvariantNode(Expr* expr, const LoopInfo& info, const std::vector<std::string>& locals) {
+        if (dynamic_cast<IntegerLiteral*>(expr) || dynamic_cast<BooleanLiteral*>(expr)
+            || dynamic_cast<StringLiteral*>(expr) || dynamic_cast<Self*>(expr) || dynamic_cast<Parenthesis*>(expr))
+            return true;
+
+        if (auto objIden = dynamic_cast<ObjectIdentifier*>(expr)) {
+            const std::string& name = objIden->getName();
+            if (info.declared.count(name) || info.assignCount.count(name))
+                return false;
+            return contains(locals, name) || !info.writtenFields.count(name);
+        }
+        if (auto binOp = dynamic_cast<BinaryOperation*>(expr)) {
+            if (binOp->getOperator() != "/")
+                return true;
+            auto divisor = dynamic_cast<IntegerLiteral*>(binOp->getRight());
+            return divisor && divisor->getValue() != 0;
+        }
+        if (dynamic_cast<UnOp*>(expr))
+            return true;
+        if (auto call = dynamic_cast<Call*>(expr)) {
+            if (!dynamic_cast<Self*>(call->getExprObjectIdentifier()))
+                return false; // the receiver could be null
+            Effects callee = effects.callEffects(call->getClassName(), call->getMethodName());
+            if (!callee.isHoistable())
+                return false;
+            for (const std::string& field : callee.readFields) {
+                if (info.writtenFields.count(field) || info.assignCount.count(field))
+                    return false;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // Literals, self and locals are as cheap as the variable that would replace them
+    bool isWorthHoisting(Expr* expr, const std::vector<std::string>& locals) {
+        if (auto objIden = dynamic_cast<ObjectIdentifier*>(expr))
+            return !contains(locals, objIden->getName()); // field read
+        if (auto unOp = dynamic_cast<UnOp*>(expr))
+            return !dynamic_cast<IntegerLiteral*>(unOp->getExpr()) && !dynamic_cast<BooleanLiteral*>(unOp->getExpr());
+        return dynamic_cast<BinaryOperation*>(expr) || dynamic_cast<Call*>(expr);
+    }
+
+    void hoistInvariants(std::unique_ptr<Expr>& loopSlot, std::vector<std::string>& locals) {
+        auto loop = static_cast<WhileLoop*>(loopSlot.get());
+        LoopInfo info = analyzeLoop(loop, locals);
+
+        std::vector<std::unique_ptr<Expr>*> hoisted;
+        for (auto* child : loop->getChildren()) {
+            if (markInvariants(*child, info, locals, hoisted) && isWorthHoisting(child->get(), locals))
+                hoisted.push_back(child);
+        }
+        if (hoisted.empty())
+            return;
+
+        // identical expressions share one variable
+        std::unordered_map<std::string, std::string> tempOf;
+        std::vector<std::pair<std::string, std::unique_ptr<Expr>>> bindings;
+        for (auto* slot : hoisted) {
+            std::string key = (*slot)->toString2();
+            std::string type = (*slot)->getTypeName();
+            unsigned int column = (*slot)->getColumn(), line = (*slot)->getLine();
+            auto it = tempOf.find(key);
+            if (it == tempOf.end()) {
+                std::string temp = newTemp("licm");
+                it = tempOf.emplace(key, temp).first;
+                bindings.emplace_back(temp, std::move(*slot));
+                hoistedExpressions++;
+            }
+            *slot = makeIdentifier(it->second, type, column, line);
+        }
+
+        for (auto it = bindings.rbegin(); it != bindings.rend(); ++it) {
+            std::string type = it->second->getTypeName();
+            wrapInLet(loopSlot, it->first, type, std::move(it->second));
+        }
+        for (auto& binding : bindings)
+            locals.push_back(binding.first);
+    }
+
+    void optimizeLoop(std::unique_ptr<Expr>& loopSlot, std::vector<std::string>& locals) {
+        size_t scopeSize = locals.size();
+        hoistInvariants(loopSlot, locals);
+        locals.resize(scopeSize);
+    }
+};
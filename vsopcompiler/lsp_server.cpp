@@ -0,0 +1,985 @@
+#ifndef LSP_SERVER_CPP
+#define LSP_SERVER_CPP
+
+#include "AST.hpp"
+#include "builtin_registry.cpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Language server (--lsp): the Language Server Protocol on stdin and stdout, for editors.
+// The errors that -c would print are published as diagnostics while a document is edited,
+// and the server answers hover (what a name is) and go-to-definition requests.
+//
+// A document is kept as its classes, each with where it is in the text. An edit parses
+// again only the classes it touches (and the text between them); a class that did not
+// change keeps its AST. The semantic checks then run again on the classes whose result
+// may have changed: the new ones, those that had errors, and those that name a class whose
+// declarations changed, directly or through the declarations of other classes (parent,
+// field, formal and return types). The hierarchy is checked whole, it is small.
+//
+// Positions are those of VSOP (columns count bytes), from 0 in the protocol.
+
+extern void restart_lexer(unsigned int offset, unsigned int length, unsigned int line, unsigned int column);
+
+/**
+ * JsonValue - A JSON value, as read from the messages of the client
+ */
+struct JsonValue {
+    enum Kind { Null, Boolean, Number, String, Array, Object };
+    Kind kind = Null;
+    bool boolean = false;
+    double number = 0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    // The member of that name, null if there is none
+    const JsonValue& operator[](const char* key) const {
+        static const JsonValue none;
+        for (const auto& member : members) {
+            if (member.first == key)
+                return member.second;
+        }
+        return none;
+    }
+
+    bool has(const char* key) const { return (*this)[key].kind != Null; }
+    unsigned int toUnsigned() const { return number > 0 ? static_cast<unsigned int>(number) : 0; }
+
+    // The value as JSON text (to send back the id of a request)
+    std::string dump() const;
+
+    // Parses 'json' from 'pos'; throws std::runtime_error if it is not valid
+    static JsonValue parse(const std::string& json, size_t& pos);
+};
+
+// 'text' as a JSON string
+static std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                out += escape;
+            } else {
+                out += static_cast<char>(c);
+            }
+        }
+    }
+    return out + "\"";
+}
+
+std::string JsonValue::dump() const {
+    switch (kind) {
+    case Null:
+        return "null";
+    case Boolean:
+        return boolean ? "true" : "false";
+    case Number: {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.17g", number);
+        return buffer;
+    }
+    case String:
+        return jsonString(text);
+    case Array: {
+        std::string out = "[";
+        for (size_t i = 0; i < items.size(); ++i)
+            out += (i ? "," : "") + items[i].dump();
+        return out + "]";
+    }
+    default: {
+        std::string out = "{";
+        for (size_t i = 0; i < members.size(); ++i)
+            out += (i ? "," : "") + jsonString(members[i].first) + ":" + members[i].second.dump();
+        return out + "}";
+    }
+    }
+}
+
+JsonValue JsonValue::parse(const std::string& json, size_t& pos) {
+    auto skipSpaces = [&]() {
+        while (pos < json.size() && strchr(" \t\r\n", json[pos]) && json[pos])
+            ++pos;
+    };
+    auto fail = [&]() -> JsonValue { throw std::runtime_error("invalid JSON at " + std::to_string(pos)); };
+    auto parseString = [&]() {
+        std::string out;
+        ++pos; // '"'
+        while (pos < json.size() && json[pos] != '"') {
+            char c = json[pos++];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos >= json.size())
+                fail();
+            c = json[pos++];
+            switch (c) {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                auto hex = [&]() {
+                    if (pos + 4 > json.size())
+                        fail();
+                    unsigned long code = std::strtoul(json.substr(pos, 4).c_str(), nullptr, 16);
+                    pos += 4;
+                    return code;
+                };
+                unsigned long code = hex();
+                if (code >= 0xD800 && code < 0xDC00 && json.compare(pos, 2, "\\u") == 0) {
+                    pos += 2;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (hex() - 0xDC00);
+                }
+                // UTF-8
+                if (code < 0x80) {
+                    out += static_cast<char>(code);
+                } else if (code < 0x800) {
+                    out += static_cast<char>(0xC0 | (code >> 6));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                } else if (code < 0x10000) {
+                    out += static_cast<char>(0xE0 | (code >> 12));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                } else {
+                    out += static_cast<char>(0xF0 | (code >> 18));
+                    out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: out += c; break; // '"', '\\' and '/'
+            }
+        }
+        if (pos >= json.size())
+            fail();
+        ++pos; // '"'
+        return out;
+    };
+
+    skipSpaces();
+    if (pos >= json.size())
+        fail();
+    JsonValue value;
+    char c = json[pos];
+    if (c == '{') {
+        value.kind = Object;
+        ++pos;
+        skipSpaces();
+        if (pos < json.size() && json[pos] == '}') {
+            ++pos;
+            return value;
+        }
+        for (;;) {
+            skipSpaces();
+            if (pos >= json.size() || json[pos] != '"')
+                fail();
+            std::string key = parseString();
+            skipSpaces();
+            if (pos >= json.size() || json[pos] != ':')
+                fail();
+            ++pos;
+            value.members.emplace_back(std::move(key), parse(json, pos));
+            skipSpaces();
+            if (pos < json.size() && json[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            if (pos >= json.size() || json[pos] != '}')
+                fail();
+            ++pos;
+            return value;
+        }
+    }
+    if (c == '[') {
+        value.kind = Array;
+        ++pos;
+        skipSpaces();
+        if (pos < json.size() && json[pos] == ']') {
+            ++pos;
+            return value;
+        }
+        for (;;) {
+            value.items.push_back(parse(json, pos));
+            skipSpaces();
+            if (pos < json.size() && json[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            if (pos >= json.size() || json[pos] != ']')
+                fail();
+            ++pos;
+            return value;
+        }
+    }
+    if (c == '"') {
+        value.kind = String;
+        value.text = parseString();
+        return value;
+    }
+    if (json.compare(pos, 4, "true") == 0 || json.compare(pos, 5, "false") == 0) {
+        value.kind = Boolean;
+        value.boolean = json[pos] == 't';
+        pos += value.boolean ? 4 : 5;
+        return value;
+    }
+    if (json.compare(pos, 4, "null") == 0) {
+        pos += 4;
+        return value;
+    }
+    char* end;
+    value.number = std::strtod(json.c_str() + pos, &end);
+    if (end == json.c_str() + pos)
+        fail();
+    value.kind = Number;
+    pos = end - json.c_str();
+    return value;
+}
+
+/**
+ * LanguageServer - Serves the requests of one client, until it asks to exit
+ */
+class LanguageServer {
+public:
+    LanguageServer(FILE* in, FILE* out) : in(in), out(out) {}
+
+    // Reads and answers the messages; returns the exit code
+    int run() {
+        std::string body;
+        while (readMessage(body)) {
+            JsonValue message;
+            try {
+                size_t pos = 0;
+                message = JsonValue::parse(body, pos);
+            } catch (const std::runtime_error&) {
+                sendError("null", -32700, "Parse error");
+                continue;
+            }
+            const std::string method = message["method"].text;
+            if (method == "exit")
+                return shutdownRequested ? 0 : 1;
+            handle(method, message);
+        }
+        return shutdownRequested ? 0 : 1;
+    }
+
+private:
+    // An error to publish, at a VSOP position (0 for none, as the errors of -c about the
+    // whole program)
+    struct Diagnostic {
+        unsigned int line;
+        unsigned int column;
+        std::string message;
+    };
+
+    // A class of a document
+    struct Entry {
+        std::unique_ptr<ClassNode> node;
+        size_t offset;                       // of its 'class' keyword in the text
+        size_t length;                       // up to its '}'
+        unsigned int line;                   // of its 'class' keyword
+        std::shared_ptr<std::string> source; // the text it was parsed from (its string literals point into it)
+        int pendingShift = 0;                // lines to add to the positions of its members
+        bool checked = false;                // whether 'diagnostics' are those of its checks
+        bool annotated = false;              // whether its AST was checked (and has types)
+        std::vector<Diagnostic> diagnostics;
+        std::string signature;               // its declarations, without the bodies
+        std::vector<std::string> declDeps;   // the classes its declarations name
+        std::vector<std::string> mentions;   // the classes its text names
+    };
+
+    // An open document
+    struct Document {
+        std::string uri;
+        std::string text;       // the document, then Object (parsed after it, as by -c)
+        size_t userLength = 0;  // of the document in 'text'
+        std::vector<size_t> lineStarts;
+        std::vector<Entry> entries; // by offset
+        std::unordered_map<std::string, size_t> classIndex; // first entry of each name
+        bool dirty = false;     // whether [dirtyStart, dirtyEnd) must be parsed again
+        size_t dirtyStart = 0;
+        size_t dirtyEnd = 0;
+        std::vector<std::pair<std::string, std::string>> removed; // (name, signature) of the classes dropped since the last checks
+        bool linesMoved = false; // whether classes moved to other lines since the last checks
+        bool parseFailed = false;
+        std::vector<Diagnostic> errors; // the lexical or syntax error, else those of the hierarchy
+    };
+
+    // What a name at some position is
+    struct Target {
+        unsigned int line = 0;
+        unsigned int column = 0;
+        std::string description;
+    };
+
+    FILE* in;
+    FILE* out;
+    bool shutdownRequested = false;
+    std::unordered_map<std::string, Document> documents;
+
+    /* ======================== Transport ======================== */
+
+    bool readMessage(std::string& body) {
+        size_t length = 0;
+        bool sized = false;
+        char line[1024];
+        for (;;) {
+            if (!fgets(line, sizeof(line), in))
+                return false;
+            if (strcmp(line, "\r\n") == 0 || strcmp(line, "\n") == 0) {
+                if (sized)
+                    break;
+                continue;
+            }
+            if (strncasecmp(line, "Content-Length:", 15) == 0) {
+                length = std::strtoul(line + 15, nullptr, 10);
+                sized = true;
+            }
+        }
+        body.resize(length);
+        return fread(&body[0], 1, length, in) == length;
+    }
+
+    void send(const std::string& json) {
+        fprintf(out, "Content-Length: %zu\r\n\r\n", json.size());
+        fwrite(json.data(), 1, json.size(), out);
+        fflush(out);
+    }
+
+    void sendResult(const std::string& id, const std::string& result) {
+        send("{\"jsonrpc\":\"2.0\",\"id\":" + id + ",\"result\":" + result + "}");
+    }
+
+    void sendError(const std::string& id, int code, const std::string& message) {
+        send("{\"jsonrpc\":\"2.0\",\"id\":" + id + ",\"error\":{\"code\":" + std::to_string(code)
+             + ",\"message\":" + jsonString(message) + "}}");
+    }
+
+    void handle(const std::string& method, const JsonValue& message) {
+        const JsonValue& params = message["params"];
+        const std::string id = message["id"].dump();
+        if (method == "initialize") {
+            sendResult(id, "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+                           "\"hoverProvider\":true,\"definitionProvider\":true},"
+                           "\"serverInfo\":{\"name\":\"vsopc\"}}");
+        } else if (method == "shutdown") {
+            shutdownRequested = true;
+            sendResult(id, "null");
+        } else if (method == "textDocument/didOpen") {
+            const JsonValue& item = params["textDocument"];
+            Document& doc = documents[item["uri"].text];
+            doc = Document();
+            doc.uri = item["uri"].text;
+            doc.text = item["text"].text + objectVsopContent;
+            doc.userLength = item["text"].text.size();
+            indexLines(doc);
+            doc.dirty = true;
+            doc.dirtyStart = 0;
+            doc.dirtyEnd = doc.text.size();
+            update(doc);
+            publish(doc);
+        } else if (method == "textDocument/didChange") {
+            auto found = documents.find(params["textDocument"]["uri"].text);
+            if (found == documents.end())
+                return;
+            Document& doc = found->second;
+            for (const JsonValue& change : params["contentChanges"].items) {
+                if (change.has("range")) {
+                    size_t start = offsetOf(doc, change["range"]["start"]);
+                    size_t end = std::max(start, offsetOf(doc, change["range"]["end"]));
+                    edit(doc, start, end, change["text"].text);
+                } else {
+                    edit(doc, 0, doc.userLength, change["text"].text);
+                }
+            }
+            update(doc);
+            publish(doc);
+        } else if (method == "textDocument/didClose") {
+            std::string uri = params["textDocument"]["uri"].text;
+            documents.erase(uri);
+            send("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":"
+                 + jsonString(uri) + ",\"diagnostics\":[]}}");
+        } else if (method == "textDocument/hover" || method == "textDocument/definition") {
+            auto found = documents.find(params["textDocument"]["uri"].text);
+            Target target;
+            if (found == documents.end() || !resolve(found->second, offsetOf(found->second, params["position"]), target))
+                sendResult(id, "null");
+            else if (method == "textDocument/hover")
+                sendResult(id, "{\"contents\":{\"kind\":\"plaintext\",\"value\":" + jsonString(target.description) + "}}");
+            else if (found->second.lineStarts[target.line - 1] >= found->second.userLength)
+                sendResult(id, "null"); // in Object, which is not in the document
+            else
+                sendResult(id, "{\"uri\":" + jsonString(found->first) + ",\"range\":" + range(target.line, target.column) + "}");
+        } else if (message.has("id")) {
+            sendError(id, -32601, "Method not found: " + method);
+        }
+        // other notifications are ignored
+    }
+
+    static std::string range(unsigned int line, unsigned int column) {
+        std::string position = "{\"line\":" + std::to_string(line > 0 ? line - 1 : 0)
+                             + ",\"character\":" + std::to_string(column > 0 ? column - 1 : 0) + "}";
+        return "{\"start\":" + position + ",\"end\":" + position + "}";
+    }
+
+    void publish(const Document& doc) {
+        std::string diagnostics;
+        auto add = [&](const Diagnostic& diagnostic) {
+            if (!diagnostics.empty())
+                diagnostics += ',';
+            diagnostics += "{\"range\":" + range(diagnostic.line, diagnostic.column)
+                         + ",\"severity\":1,\"source\":\"vsopc\",\"message\":" + jsonString(diagnostic.message) + "}";
+        };
+        for (const Diagnostic& diagnostic : doc.errors)
+            add(diagnostic);
+        if (!doc.parseFailed) {
+            for (const Entry& entry : doc.entries) {
+                for (const Diagnostic& diagnostic : entry.diagnostics)
+                    add(diagnostic);
+            }
+        }
+        send("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":"
+             + jsonString(doc.uri) + ",\"diagnostics\":[" + diagnostics + "]}}");
+    }
+
+    /* ======================== Text ======================== */
+
+    static void indexLines(Document& doc) {
+        doc.lineStarts.assign(1, 0);
+        const char* text = doc.text.data();
+        const char* end = text + doc.text.size();
+        for (const char* p = text; (p = static_cast<const char*>(memchr(p, '\n', end - p))); ++p)
+            doc.lineStarts.push_back(p + 1 - text);
+    }
+
+    // The line of 'offset', from 0
+    static size_t lineOf(const Document& doc, size_t offset) {
+        return std::upper_bound(doc.lineStarts.begin(), doc.lineStarts.end(), offset) - doc.lineStarts.begin() - 1;
+    }
+
+    // The offset of a position of the protocol, in the document (not in Object)
+    static size_t offsetOf(const Document& doc, const JsonValue& position) {
+        size_t line = position["line"].toUnsigned();
+        if (line >= doc.lineStarts.size())
+            return doc.userLength;
+        size_t lineEnd = line + 1 < doc.lineStarts.size() ? doc.lineStarts[line + 1] - 1 : doc.text.size();
+        return std::min({doc.lineStarts[line] + position["character"].toUnsigned(), lineEnd, doc.userLength});
+    }
+
+    // Replaces [start, end) of the text with 'replacement'. The classes that may have
+    // changed are dropped and the text from the class before to the class after is left
+    // to parse again; the classes after are moved.
+    void edit(Document& doc, size_t start, size_t end, const std::string& replacement) {
+        size_t from = start, to = end;
+        if (doc.dirty) {
+            from = std::min(from, doc.dirtyStart);
+            to = std::max(to, doc.dirtyEnd);
+        }
+        // A class is kept if it ends before, or starts on a line after the end (its
+        // columns do not change; a class just after could be the end of a token)
+        size_t endLine = lineOf(doc, to);
+        auto first = std::partition_point(doc.entries.begin(), doc.entries.end(),
+                                          [&](const Entry& entry) { return entry.offset + entry.length <= from; });
+        auto last = first;
+        while (last != doc.entries.end() && (last->offset <= to || lineOf(doc, last->offset) <= endLine)) {
+            doc.removed.emplace_back(last->node->name, last->signature);
+            ++last;
+        }
+        size_t index = doc.entries.erase(first, last) - doc.entries.begin();
+
+        long byteDelta = static_cast<long>(replacement.size()) - static_cast<long>(end - start);
+        long lineDelta = std::count(replacement.begin(), replacement.end(), '\n')
+                       - std::count(doc.text.begin() + start, doc.text.begin() + end, '\n');
+        doc.text.replace(start, end - start, replacement);
+        doc.userLength += byteDelta;
+        indexLines(doc);
+        for (size_t i = index; i < doc.entries.size(); ++i) {
+            Entry& entry = doc.entries[i];
+            entry.offset += byteDelta;
+            if (lineDelta != 0) {
+                doc.linesMoved = true;
+                entry.line += lineDelta;
+                entry.node->setLine(entry.node->getLine() + lineDelta);
+                entry.pendingShift += lineDelta;
+            }
+        }
+
+        doc.dirty = true;
+        doc.dirtyStart = index > 0 ? doc.entries[index - 1].offset + doc.entries[index - 1].length : 0;
+        doc.dirtyEnd = index < doc.entries.size() ? doc.entries[index].offset : doc.text.size();
+    }
+
+    // Moves the members of a class to the lines of its text, after the edits above it
+    static void settle(Entry& entry) {
+        if (entry.pendingShift == 0)
+            return;
+        int delta = entry.pendingShift;
+        entry.pendingShift = 0;
+        auto shift = [delta](Expr* expr) {
+            if (expr->getLine() != 0)
+                expr->setLine(expr->getLine() + delta);
+        };
+        for (auto& field : entry.node->getFields()) {
+            field->setLine(field->getLine() + delta);
+            forEachExpr(field->getInitExpr().get(), shift);
+        }
+        for (auto& method : entry.node->getMethods()) {
+            method->setLine(method->getLine() + delta);
+            for (auto& formal : method->getFormals())
+                shift(formal.get());
+            forEachExpr(method->getBlock(), shift);
+        }
+    }
+
+    /* ======================== Parsing ======================== */
+
+    // Parses the text left by the edits again, then checks what may have changed
+    void update(Document& doc) {
+        if (!doc.dirty)
+            return;
+        std::vector<Entry> parsed;
+        bool atEnd = false;
+        bool whole = doc.dirtyStart == 0 && doc.dirtyEnd == doc.text.size();
+        if (!parse(doc, doc.dirtyStart, doc.dirtyEnd, parsed, atEnd) && atEnd && !whole) {
+            // the error may be in how the text goes on after (an unclosed comment or class):
+            // the whole text is parsed again, as by -c
+            for (Entry& entry : doc.entries)
+                doc.removed.emplace_back(entry.node->name, entry.signature);
+            doc.entries.clear();
+            doc.dirtyStart = 0;
+            doc.dirtyEnd = doc.text.size();
+            parse(doc, doc.dirtyStart, doc.dirtyEnd, parsed, atEnd);
+        }
+        if (doc.parseFailed)
+            return;
+
+        std::vector<std::pair<std::string, std::string>> added;
+        for (const Entry& entry : parsed)
+            added.emplace_back(entry.node->name, entry.signature);
+        auto at = std::partition_point(doc.entries.begin(), doc.entries.end(),
+                                       [&](const Entry& entry) { return entry.offset < doc.dirtyStart; });
+        doc.entries.insert(at, std::make_move_iterator(parsed.begin()), std::make_move_iterator(parsed.end()));
+        doc.dirty = false;
+        doc.classIndex.clear();
+        for (size_t i = 0; i < doc.entries.size(); ++i)
+            doc.classIndex.emplace(doc.entries[i].node->name, i);
+        check(doc, added);
+    }
+
+    // Parses [begin, end) of the text into 'parsed' (the lexical errors first, as -c);
+    // on an error, sets it as the only one of the document and tells whether it is at the
+    // end of that text
+    bool parse(Document& doc, size_t begin, size_t end, std::vector<Entry>& parsed, bool& atEnd) {
+        parsed.clear();
+        auto source = std::make_shared<std::string>(doc.text, begin, end - begin);
+        source->reserve(32); // on the heap, so that the string literals can point into it
+        unsigned int length = source->size();
+        unsigned int line = lineOf(doc, begin) + 1;
+        unsigned int column = begin - doc.lineStarts[line - 1] + 1;
+        std::swap(programText, *source);
+        doc.parseFailed = false;
+        try {
+            restart_lexer(0, length, line, column);
+            int token;
+            while ((token = yylex()) != 0) {
+                if (token == ERROR)
+                    throw CompileError{unsigned(yylval.error_location.line_error), unsigned(yylval.error_location.column_error),
+                                       std::string("lexical error : ") + error_message};
+                if (token == OBJECT_IDENTIFIER || token == TYPE_IDENTIFIER)
+                    std::free(yylval.str);
+            }
+            restart_lexer(0, length, line, column);
+            for (auto& cls : DescentParser().parseClasses()) {
+                Entry entry;
+                entry.node = std::move(cls.node);
+                entry.offset = begin + cls.offset;
+                entry.length = cls.length;
+                entry.line = cls.line;
+                entry.source = source;
+                describe(doc, entry);
+                parsed.push_back(std::move(entry));
+            }
+        } catch (const CompileError& error) {
+            doc.errors.assign(1, Diagnostic{error.line, error.column, error.message});
+            doc.parseFailed = true;
+        } catch (const std::out_of_range&) { // an integer literal too large for std::stoi
+            doc.errors.assign(1, Diagnostic{unsigned(yyline), unsigned(yycolumn), "lexical error : integer literal out of range"});
+            doc.parseFailed = true;
+        }
+        atEnd = yyoffset >= length;
+        std::swap(programText, *source);
+        if (doc.parseFailed)
+            parsed.clear();
+        return !doc.parseFailed;
+    }
+
+    // Replaces the AST of a class with a new one, from its text (which is unchanged)
+    void reparse(Document& doc, Entry& entry) {
+        std::vector<Entry> parsed;
+        bool atEnd;
+        if (parse(doc, entry.offset, entry.offset + entry.length, parsed, atEnd) && parsed.size() == 1) {
+            entry.node = std::move(parsed[0].node);
+            entry.source = std::move(parsed[0].source);
+            entry.pendingShift = 0;
+            entry.annotated = false;
+        }
+    }
+
+    // Sets the signature and the names used by a class just parsed
+    static void describe(const Document& doc, Entry& entry) {
+        ClassNode* cls = entry.node.get();
+        auto isClass = [](const std::string& type) { return !type.empty() && type[0] >= 'A' && type[0] <= 'Z'; };
+        std::string& signature = entry.signature;
+        signature = cls->name + " extends " + cls->parent + " {";
+        entry.declDeps.push_back(cls->parent);
+        for (auto& field : cls->getFields()) {
+            signature += field->getName() + ":" + field->getTypeName() + ";";
+            if (isClass(field->getTypeName()))
+                entry.declDeps.push_back(field->getTypeName());
+        }
+        for (auto& method : cls->getMethods()) {
+            signature += method->getName() + "(";
+            for (auto& formal : method->getFormals()) {
+                signature += formal->getType().getName() + ",";
+                if (isClass(formal->getType().getName()))
+                    entry.declDeps.push_back(formal->getType().getName());
+            }
+            signature += "):" + method->getReturnType().getName() + ";";
+            if (isClass(method->getReturnType().getName()))
+                entry.declDeps.push_back(method->getReturnType().getName());
+        }
+        std::sort(entry.declDeps.begin(), entry.declDeps.end());
+        entry.declDeps.erase(std::unique(entry.declDeps.begin(), entry.declDeps.end()), entry.declDeps.end());
+
+        // the type identifiers of its text (a few in comments or strings do no harm)
+        const char* text = doc.text.data();
+        for (size_t i = entry.offset, end = entry.offset + entry.length; i < end; ++i) {
+            if (text[i] >= 'A' && text[i] <= 'Z' && (i == 0 || !isIdentifierChar(text[i - 1]))) {
+                size_t j = i;
+                while (j < end && isIdentifierChar(text[j]))
+                    ++j;
+                entry.mentions.emplace_back(text + i, j - i);
+                i = j;
+            }
+        }
+        entry.mentions.push_back(cls->name);
+        std::sort(entry.mentions.begin(), entry.mentions.end());
+        entry.mentions.erase(std::unique(entry.mentions.begin(), entry.mentions.end()), entry.mentions.end());
+    }
+
+    static bool isIdentifierChar(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    /* ======================== Checks ======================== */
+
+    // The parent of a class, nullptr if it has none or it is not declared
+    Entry* parentOf(Document& doc, const Entry& entry) {
+        if (entry.node->name == "Object")
+            return nullptr;
+        auto found = doc.classIndex.find(entry.node->parent);
+        return found != doc.classIndex.end() ? &doc.entries[found->second] : nullptr;
+    }
+
+    // Checks the hierarchy, then the classes that may have another result than before, given
+    // the (name, signature) of the classes parsed again
+    void check(Document& doc, const std::vector<std::pair<std::string, std::string>>& added) {
+        // the names whose declarations changed, then those whose declarations name them
+        std::unordered_map<std::string, std::string> before, after;
+        for (const auto& removed : doc.removed)
+            before[removed.first] += removed.second + '\n';
+        for (const auto& entry : added)
+            after[entry.first] += entry.second + '\n';
+        bool changed = !doc.removed.empty() || !added.empty();
+        // errors are at positions, and can name those of other classes: moved, they are found again
+        bool moved = doc.linesMoved;
+        doc.removed.clear();
+        doc.linesMoved = false;
+        std::unordered_set<std::string> affected;
+        std::vector<std::string> pending;
+        for (const auto& name : before) {
+            auto found = after.find(name.first);
+            if (found == after.end() || found->second != name.second)
+                pending.push_back(name.first);
+        }
+        for (const auto& name : after) {
+            if (!before.count(name.first))
+                pending.push_back(name.first);
+        }
+        if (!pending.empty()) {
+            std::unordered_map<std::string, std::vector<const std::string*>> dependents;
+            for (const Entry& entry : doc.entries) {
+                for (const std::string& dep : entry.declDeps)
+                    dependents[dep].push_back(&entry.node->name);
+            }
+            while (!pending.empty()) {
+                std::string name = std::move(pending.back());
+                pending.pop_back();
+                if (!affected.insert(name).second)
+                    continue;
+                for (const std::string* dependent : dependents[name])
+                    pending.push_back(*dependent);
+            }
+        }
+
+        std::vector<Entry*> recheck;
+        for (Entry& entry : doc.entries) {
+            bool mentionsAffected = false;
+            for (const std::string& name : entry.mentions) {
+                if (affected.count(name)) {
+                    mentionsAffected = true;
+                    break;
+                }
+            }
+            if (!entry.checked || ((changed || moved) && !entry.diagnostics.empty()) || mentionsAffected)
+                recheck.push_back(&entry);
+        }
+        // the checks set the types of the expressions but do not clear those an earlier
+        // check set: a class checked again is parsed again from its text. The members
+        // of the ancestors, which the checks read, have to be at their lines (the count
+        // bounds the walk on a cyclic hierarchy).
+        for (Entry* entry : recheck) {
+            if (entry->annotated)
+                reparse(doc, *entry);
+            Entry* ancestor = parentOf(doc, *entry);
+            for (size_t steps = 0; ancestor && ancestor->pendingShift != 0 && steps < doc.entries.size();
+                 ++steps, ancestor = parentOf(doc, *ancestor))
+                settle(*ancestor);
+        }
+
+        Program program;
+        for (Entry& entry : doc.entries)
+            program.addClass(std::move(entry.node));
+        SemanticAnalyzer analyzer{doc.uri};
+        std::vector<Diagnostic>* diagnostics = &doc.errors;
+        analyzer.report = [&diagnostics](unsigned int line, unsigned int column, const std::string& message) {
+            diagnostics->push_back(Diagnostic{line, column, message});
+        };
+        doc.errors.clear();
+        analyzer.analyzeHierarchy(&program);
+        auto& classes = program.getClasses();
+        for (size_t i = 0; i < classes.size(); ++i)
+            doc.entries[i].node = std::move(classes[i]);
+        for (Entry* entry : recheck) {
+            entry->diagnostics.clear();
+            diagnostics = &entry->diagnostics;
+            analyzer.analyzeClass(entry->node.get());
+            entry->checked = entry->annotated = true;
+        }
+    }
+
+    /* ======================== Names ======================== */
+
+    Entry* classNamed(Document& doc, const std::string& name) {
+        auto found = doc.classIndex.find(name);
+        if (found == doc.classIndex.end())
+            return nullptr;
+        settle(doc.entries[found->second]);
+        return &doc.entries[found->second];
+    }
+
+    // The method 'name' of a class or of its closest ancestor that has one
+    MethodNode* findMethod(Document& doc, const std::string& className, const std::string& name, std::string& owner) {
+        Entry* entry = classNamed(doc, className);
+        for (size_t steps = 0; entry && steps <= doc.entries.size(); ++steps) {
+            for (auto& method : entry->node->getMethods()) {
+                if (method->getName() == name) {
+                    owner = entry->node->name;
+                    return method.get();
+                }
+            }
+            entry = parentOf(doc, *entry);
+            if (entry)
+                settle(*entry);
+        }
+        return nullptr;
+    }
+
+    FieldNode* findField(Document& doc, const std::string& className, const std::string& name) {
+        Entry* entry = classNamed(doc, className);
+        for (size_t steps = 0; entry && steps <= doc.entries.size(); ++steps) {
+            for (auto& field : entry->node->getFields()) {
+                if (field->getName() == name)
+                    return field.get();
+            }
+            entry = parentOf(doc, *entry);
+            if (entry)
+                settle(*entry);
+        }
+        return nullptr;
+    }
+
+    static std::string describeMethod(const std::string& owner, MethodNode* method) {
+        std::string text = owner + "." + method->getName() + "(";
+        auto& formals = method->getFormals();
+        for (size_t i = 0; i < formals.size(); ++i)
+            text += (i ? ", " : "") + formals[i]->getName() + " : " + formals[i]->getType().getName();
+        return text + ") : " + method->getReturnType().getName();
+    }
+
+    // Where the formal 'name' of a method is declared: its header is the text from the
+    // name of the method to the '{' of its body
+    bool findFormal(const Document& doc, MethodNode* method, const std::string& name, Target& target) {
+        for (auto& formal : method->getFormals()) {
+            if (formal->getName() != name)
+                continue;
+            size_t start = doc.lineStarts[method->getLine() - 1] + method->getColumn() - 1;
+            size_t end = doc.text.find('{', start);
+            for (size_t i = start + method->getName().size(); i < end; ++i) {
+                if (doc.text.compare(i, name.size(), name) != 0 || isIdentifierChar(doc.text[i - 1])
+                    || isIdentifierChar(doc.text[i + name.size()]))
+                    continue;
+                size_t line = lineOf(doc, i);
+                target.line = line + 1;
+                target.column = i - doc.lineStarts[line] + 1;
+                target.description = name + " : " + formal->getType().getName();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // What the identifier at 'offset' is, and where it is declared
+    bool resolve(Document& doc, size_t offset, Target& target) {
+        if (doc.parseFailed && doc.entries.empty())
+            return false;
+        size_t start = offset, end = offset;
+        while (start > 0 && isIdentifierChar(doc.text[start - 1]))
+            --start;
+        while (end < doc.userLength && isIdentifierChar(doc.text[end]))
+            ++end;
+        if (start == end)
+            return false;
+        std::string word = doc.text.substr(start, end - start);
+        size_t lineIndex = lineOf(doc, start);
+        unsigned int line = lineIndex + 1;
+        unsigned int column = start - doc.lineStarts[lineIndex] + 1;
+
+        if (word[0] >= 'A' && word[0] <= 'Z') {
+            Entry* entry = classNamed(doc, word);
+            if (!entry)
+                return false;
+            target.line = entry->node->getLine();
+            target.column = entry->node->getColumn();
+            target.description = "class " + word + (word == "Object" ? "" : " extends " + entry->node->parent);
+            return true;
+        }
+
+        auto in = std::partition_point(doc.entries.begin(), doc.entries.end(),
+                                       [&](const Entry& entry) { return entry.offset <= start; });
+        if (in == doc.entries.begin())
+            return false;
+        Entry& entry = *(in - 1);
+        if (start >= entry.offset + entry.length)
+            return false;
+        settle(entry);
+        ClassNode* cls = entry.node.get();
+
+        // the member the position is in: the last that starts before
+        auto position = [](const ASTNode* node) { return std::make_pair(node->getLine(), node->getColumn()); };
+        const auto cursor = std::make_pair(line, column);
+        FieldNode* field = nullptr;
+        MethodNode* method = nullptr;
+        const ASTNode* member = nullptr;
+        for (auto& candidate : cls->getFields()) {
+            if (position(candidate.get()) <= cursor && (!member || position(member) < position(candidate.get()))) {
+                member = field = candidate.get();
+                method = nullptr;
+            }
+        }
+        for (auto& candidate : cls->getMethods()) {
+            if (position(candidate.get()) <= cursor && (!member || position(member) < position(candidate.get()))) {
+                member = method = candidate.get();
+                field = nullptr;
+            }
+        }
+        if (!member)
+            return false;
+        if (position(member) == cursor) {
+            target.line = line;
+            target.column = column;
+            target.description = field ? cls->name + "." + word + " : " + field->getTypeName()
+                                       : describeMethod(cls->name, method);
+            return true;
+        }
+
+        // an expression named at that position, and the expressions above it
+        Expr* root = field ? field->getInitExpr().get() : method->getBlock();
+        std::unordered_map<Expr*, Expr*> parents;
+        Expr* named = nullptr;
+        forEachExpr(root, [&](Expr* expr) {
+            for (auto* child : expr->getChildren()) {
+                if (*child)
+                    parents[child->get()] = expr;
+            }
+            if (!named && expr->getLine() == line && expr->getColumn() == column
+                && (dynamic_cast<ObjectIdentifier*>(expr) || dynamic_cast<Assign*>(expr)
+                    || dynamic_cast<Call*>(expr) || dynamic_cast<Let*>(expr)))
+                named = expr;
+        });
+        if (!named)
+            return method && findFormal(doc, method, word, target);
+
+        if (auto let = dynamic_cast<Let*>(named)) {
+            target.line = line;
+            target.column = column;
+            target.description = word + " : " + let->getType().getName();
+            return true;
+        }
+        if (auto call = dynamic_cast<Call*>(named)) {
+            Expr* receiver = call->getExprObjectIdentifier();
+            std::string type = !receiver || dynamic_cast<Self*>(receiver) ? cls->name : receiver->getTypeName();
+            std::string owner;
+            MethodNode* called = findMethod(doc, type, word, owner);
+            if (!called)
+                return false;
+            target.line = called->getLine();
+            target.column = called->getColumn();
+            target.description = describeMethod(owner, called);
+            return true;
+        }
+        // a variable: the innermost let in whose scope it is, a formal, or a field
+        for (Expr* child = named, *parent = parents[named]; parent; child = parent, parent = parents[parent]) {
+            auto let = dynamic_cast<Let*>(parent);
+            if (let && let->getName() == word && let->getScopeExpr() == child) {
+                target.line = let->getLine();
+                target.column = let->getColumn();
+                target.description = word + " : " + let->getType().getName();
+                return true;
+            }
+        }
+        if (method && findFormal(doc, method, word, target))
+            return true;
+        std::string className = cls->name;
+        if (FieldNode* declared = findField(doc, className, word)) {
+            target.line = declared->getLine();
+            target.column = declared->getColumn();
+            target.description = word + " : " + declared->getTypeName();
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef OUTLINE_CPP
+#define OUTLINE_CPP
+
+#include "AST.hpp"
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Outline of a program (-o): its declarations, one per line, for tools that need the
+// signatures but not the method bodies, which are not parsed. As the lines of -l, each
+// starts with the line and column of the name:
+//   line,column,class,<name>,<parent>
+//   line,column,field,<name>,<type>
+//   line,column,method,<name>,<return type>,[<formal> : <type>, ...],<body line>:<body column>
+// where the body position is that of its '{'. Classes, fields and methods come in the order
+// of the program.
+
+class OutlinePrinter {
+public:
+    explicit OutlinePrinter(std::ostream& out) : out(out) {}
+
+    void print(Program* program) {
+        std::string text;
+        for (const auto& cls : program->getClasses()) {
+            if (cls->name == "Object") // as -p and -c, which leave the built-in class out
+                continue;
+            text += position(cls.get()) + ",class," + cls->name + ",";
+            text += cls->parent + '\n';
+
+            // the parser keeps the members in reverse order: they are sorted by position
+            std::vector<std::pair<ASTNode*, std::string>> members;
+            for (const auto& field : cls->getFields())
+                members.emplace_back(field.get(), ",field," + field->getName() + "," + field->getTypeName());
+            for (const auto& method : cls->getMethods()) {
+                std::string member = ",method," + method->getName() + "," + method->getReturnType().getName() + ",[";
+                auto& formals = method->getFormals();
+                for (size_t i = 0; i < formals.size(); ++i) {
+                    if (i > 0)
+                        member += ", ";
+                    member += formals[i]->toString();
+                }
+                const MethodNode::SourceRange& body = method->getBodyRange();
+                member += "]," + std::to_string(body.line) + ":" + std::to_string(body.column);
+                members.emplace_back(method.get(), member);
+            }
+            std::sort(members.begin(), members.end(), [](const auto& a, const auto& b) {
+                return std::make_pair(a.first->getLine(), a.first->getColumn())
+                     < std::make_pair(b.first->getLine(), b.first->getColumn());
+            });
+            for (const auto& member : members)
+                text += position(member.first) + member.second + '\n';
+        }
+        out << text;
+    }
+
+private:
+    std::ostream& out;
+
+    static std::string position(const ASTNode* node) {
+        return std::to_string(node->getLine()) + "," + std::to_string(node->getColumn());
+    }
+};
+
+#endif
@@ -17,23 +17,63 @@
 #include <iostream>
 #include <memory>
 #include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <string>
 #include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "AST.hpp"
 #include "semantic_analyzer.cpp"
+#include "tree_shaker.cpp"
+#include "loop_optimizer.cpp"
+#include "cse.cpp"
+#include "tail_calls.cpp"
+#include "pgo.cpp"
+#include "stats.cpp"
+#include "interpreter.cpp"
+#include "outline.cpp"
+#include "flat_ast.cpp"
+#include "emitter.cpp"
+
+// The parser stack grows on the heap (semantic values and locations are trivially
+// copyable): let it hold the deeply nested expressions of generated programs
+#define YYMAXDEPTH 100000000
 
 // External functions and variables declarations
 void yyerror(const char *s);
 int yylex(void);
 std::unique_ptr<ASTNode> root;  // Root of the AST
+std::string programText;        // The input (then Object.vsop), as read by the lexer (string literals point into it)
 extern FILE *yyin;              // Input file
 extern char* yytext;            // Current lexeme
 extern char *fileName;          // Name of the input file
 extern void initialize_dict();  // Initialize dictionary of tokens
 extern bool lexer_debug_mode;   // Debug mode flag for lexer
+extern bool simd_scanner_mode;  // --lexer=simd: hand-written scanner instead of flex's
 extern int yyline;              // Current line number
 extern int yycolumn;            // Current column number
+extern unsigned yyoffset;       // Offset of the next token in the input
 extern char* error_message;     // Error message from lexer
 
+// Options given on the command line, besides the mode and the input file
+struct CompilerOptions {
+    bool treeShake = false;         // --tree-shake : prune code unreachable from Main.main
+    bool loopOpt = false;           // --loop-opt : loop-invariant code motion
+    bool tailCalls = false;         // --tail-calls : turn self-recursive tail calls into loops
+    bool cse = false;               // --cse : common subexpression elimination of pure expressions
+    const char* profilePath = nullptr; // --use-profile <file> : profile-guided optimizations
+    bool descentParser = false;     // --parser=descent : the hand-written parser instead of yyparse
+    bool lazyBodies = false;        // --lazy-bodies : method bodies parsed when first needed (descent parser)
+    bool flatAst = false;           // --flat-ast : -p and -c print the tree from its flat form (flat_ast.cpp)
+    bool parsedObject = false;      // --object=parsed : Object parsed from its text after the program, not prebuilt
+    bool lsp = false;               // --lsp : language server on stdin and stdout, instead of a mode and a file
+    const char* buildDir = nullptr; // --build-dir <dir> : results of a multi-file -c kept for the next build
+    unsigned int jobs = 0;          // -j <n> : workers of a multi-file -c (one per processor by default),
+                                    // threads printing the tree of one file (emitter.cpp, one by default)
+    InterpreterOptions interpreter; // --jit, --jit-regalloc, --inline-caches, --profile : execution with -x
+};
+
 // structure to hold a list of expressions
 struct ExprList {
     std::vector<std::unique_ptr<Expr>> exprs;
@@ -44,6 +84,21 @@ struct FormalList {
     std::vector<std::unique_ptr<Formal>> formals;
 };
 
+// Whether the program is parsed alone, Object being added prebuilt after it (see parseProgram)
+bool objectPrebuilt = false;
+extern bool lexer_at_end;
+
+// The position of an error met by the parser at 'line' and 'column'. When the program is
+// parsed alone, the end of the input is where the parse of the program followed by
+// objectVsopContent would read the keyword 'class' that begins that text, which a state
+// that cannot end the program does not accept either: the error is the same, after it.
+static void errorPosition(unsigned int& line, unsigned int& column) {
+    if (objectPrebuilt && lexer_at_end) {
+        line += objectKeywordEnd.line;
+        column = objectKeywordEnd.column;
+    }
+}
+
 /**
  * Reports a syntax error with file, line and column information
  * @param message Error message to display
@@ -51,6 +106,9 @@ struct FormalList {
  * @param column Column number where the error occurred
  */
 void reportSyntaxError(std::string message, unsigned int line, unsigned int column) {
+        errorPosition(line, column);
+        if (throwCompileErrors)
+            throw CompileError{line, column, "syntax error: " + message};
         std::cerr << fileName << ":" << line << ":" << column 
                   << ": syntax error: "<< message << std::endl;
         exit(1); // Exit the program with an error code
@@ -77,6 +135,11 @@ void reportSyntaxError(std::string message, unsigned int line, unsigned int colu
         unsigned int line;
         unsigned int column;
     } loc;
+    struct {
+        unsigned int offset;      // of the first character after the opening quote, in programText
+        unsigned int length;      // up to the closing quote
+        bool escapes;             // escapes or whitespace to rewrite: not printed as is
+    } literal;
 }
 
 %debug
@@ -94,7 +157,8 @@ void reportSyntaxError(std::string message, unsigned int line, unsigned int colu
 %nterm <str> type extends_or_not
 %token <loc> OBJECT_IDENTIFIER
 %token <loc> TYPE_IDENTIFIER
-%token <str> STR TRUE_TYPE FALSE_TYPE
+%token <literal> STR
+%token <str> TRUE_TYPE FALSE_TYPE
 
 // Operator precedence and associativity rules
 %precedence IF THEN WHILE DO LET IN
@@ -278,18 +342,24 @@ type:
 expr: 
     /* If-then construct */
     IF expr THEN expr {
-        $$ = static_cast<Expr*>(new Conditional(
+        Conditional* cond = new Conditional(
             std::unique_ptr<Expr>(static_cast<Expr*>($2)),
             std::unique_ptr<Expr>(static_cast<Expr*>($4))
-        ));
+        );
+        cond->setColumn(@1.first_column);
+        cond->setLine(@1.first_line);
+        $$ = static_cast<Expr*>(cond);
     }
     /* If-then-else construct */
     | IF expr THEN expr ELSE expr {
-        $$ = static_cast<Expr*>(new Conditional(
+        Conditional* cond = new Conditional(
             std::unique_ptr<Expr>(static_cast<Expr*>($2)),
             std::unique_ptr<Expr>(static_cast<Expr*>($4)),
             std::unique_ptr<Expr>(static_cast<Expr*>($6))
-        ));
+        );
+        cond->setColumn(@1.first_column);
+        cond->setLine(@1.first_line);
+        $$ = static_cast<Expr*>(cond);
     }
     /* Error handling for conditional expressions */
     | IF error THEN expr {
@@ -306,10 +376,13 @@ expr:
     }
     /* While loop */
     | WHILE expr DO expr {
-        $$ = static_cast<Expr*>(new WhileLoop(
+        WhileLoop* loop = new WhileLoop(
             std::unique_ptr<Expr>(static_cast<Expr*>($2)),
             std::unique_ptr<Expr>(static_cast<Expr*>($4))
-        ));
+        );
+        loop->setColumn(@1.first_column);
+        loop->setLine(@1.first_line);
+        $$ = static_cast<Expr*>(loop);
     }
     /* Error handling for while loops */
     | WHILE error DO expr {
@@ -446,7 +519,7 @@ expr:
         $$ = static_cast<Expr*>(new IntegerLiteral($1));
     }
     | STR {
-        $$ = static_cast<Expr*>(new StringLiteral($1));
+        $$ = static_cast<Expr*>(new StringLiteral(std::string_view(programText).substr($1.offset, $1.length), $1.escapes));
     }
     | TRUE_TYPE {
         $$ = static_cast<Expr*>(new BooleanLiteral(true));
@@ -495,112 +568,243 @@ expr_list:
 
 %%
 
+// The hand-written parser, selected by --parser=descent (needs the token kinds defined above)
+#include "descent_parser.cpp"
+
+// The language server, for --lsp (uses the descent parser)
+#include "lsp_server.cpp"
+
+// The separate compilation of multi-file programs, for -c with several files
+#include "build.cpp"
+
 /**
  * Function called when a syntax error is detected
  * @param s Error message
  */
 void yyerror(const char *s) {
-    std::cerr << fileName << ":" << yyline << ":" << yycolumn
+    unsigned int line = yyline, column = yycolumn;
+    errorPosition(line, column);
+    if (throwCompileErrors)
+        throw CompileError{line, column, std::string("Syntax error: ") + s};
+    std::cerr << fileName << ":" << line << ":" << column
               << ": Syntax error: " << s << std::endl;
     exit(1);
 }
 
+/**
+ * Prints the tree of -p, or of -c if 'typed', on 'jobs' threads (on this one if 0 or 1,
+ * without -j)
+ */
+static void printProgram(Program* program, bool typed, unsigned int jobs) {
+    if (jobs <= 1) {
+        std::cout << (typed ? program->toString2() : program->toString()) << std::endl;
+        return;
+    }
+    ProgramEmitter emitter(jobs);
+    std::cout << emitter.emit(program, typed) << std::endl;
+    if (std::getenv("VSOP_EMIT_REPORT"))
+        std::cerr << "emit: " << emitter.unitCount << " units on " << emitter.threadCount << " threads" << std::endl;
+}
+
+/**
+ * Lexes the program text for its lexical errors, then parses it into root, with the class
+ * Object last: prebuilt, or parsed from its text after the program with --object=parsed
+ */
+static int parseProgram(const CompilerOptions& options) {
+    objectPrebuilt = !options.parsedObject;
+    if (!objectPrebuilt)
+        programText += objectVsopContent;
+    lexer_debug_mode = false;
+    int token;
+    bool empty = true;
+    unsigned int offset = 0, line = 1, column = 1; // after the last token
+
+    // First pass: ensure lexing is done without errors
+    VSOP_PHASE_BEGIN(lexing, "lex (first pass)");
+    restart_lexer(0, programText.size(), 1, 1);
+    while ((token = yylex()) != 0) {
+        if (token == ERROR && objectPrebuilt) {
+            // The error may be one only because the program ends there (a string or a
+            // comment left open): what follows the last token is read again followed by
+            // the text of Object, and the program is parsed with that text
+            objectPrebuilt = false;
+            programText += objectVsopContent;
+            restart_lexer(offset, programText.size() - offset, line, column);
+            continue;
+        }
+        if (token == ERROR) {
+            std::cerr << fileName << ":" << yylval.error_location.line_error << ":" 
+                      << yylval.error_location.column_error << ": lexical error : " 
+                      << error_message << std::endl;
+            exit(1);
+        }
+        empty = false;
+        offset = yyoffset;
+        line = yyline;
+        column = yycolumn;
+    }
+    VSOP_PHASE_END(lexing);
+    int parseResult;
+    if (objectPrebuilt && empty) {
+        // only Object, which the grammar cannot parse alone
+        root = std::make_unique<Program>();
+        parseResult = 0;
+    } else {
+        // Second pass: syntactic analysis
+        restart_lexer(0, programText.size(), 1, 1);
+        if (options.lazyBodies) {
+            VSOP_PHASE("parse (bodies skipped)");
+            DescentParser parser;
+            parser.skipBodies = true;
+            parseResult = parser.parse();
+        } else {
+            VSOP_PHASE_BEGIN(parsing, options.descentParser ? "parse (lex + descent)" : "parse (lex + yyparse)");
+            parseResult = options.descentParser ? DescentParser().parse() : yyparse();
+            VSOP_PHASE_END(parsing);
+        }
+    }
+    // the lexer is at the end of the program, on its last line
+    if (!parseResult && root && objectPrebuilt)
+        static_cast<Program*>(root.get())->addClass(prebuiltObjectClass(yyline));
+    objectPrebuilt = false; // the bodies left by --lazy-bodies are parsed later
+    return parseResult;
+}
+
 /**
  * Main function 
  */
 int main(int argc, char **argv) {
-    // Check command line arguments
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " -p|-l|-c <source_code_file>\n";
+    // Check command line arguments: options, then the mode, then the file
+    CompilerOptions options;
+    const char* mode = nullptr;
+    const char* inputPath = nullptr;
+    std::vector<std::string> inputPaths;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--tree-shake") == 0)
+            options.treeShake = true;
+        else if (strcmp(argv[i], "--loop-opt") == 0)
+            options.loopOpt = true;
+        else if (strcmp(argv[i], "--tail-calls") == 0)
+            options.tailCalls = true;
+        else if (strcmp(argv[i], "--cse") == 0)
+            options.cse = true;
+        else if (strcmp(argv[i], "--jit") == 0)
+            options.interpreter.jit = true;
+        else if (strcmp(argv[i], "--jit-regalloc") == 0)
+            options.interpreter.jit = options.interpreter.jitRegisters = true;
+        else if (strcmp(argv[i], "--inline-caches") == 0)
+            options.interpreter.inlineCaches = true;
+        else if (strcmp(argv[i], "--profile") == 0)
+            options.interpreter.profile = true;
+        else if (strcmp(argv[i], "--use-profile") == 0 && i + 1 < argc)
+            options.profilePath = argv[++i];
+        else if (strcmp(argv[i], "--parser=descent") == 0)
+            options.descentParser = true;
+        else if (strcmp(argv[i], "--parser=bison") == 0)
+            options.descentParser = false;
+        else if (strcmp(argv[i], "--lazy-bodies") == 0)
+            options.lazyBodies = true;
+        else if (strcmp(argv[i], "--lexer=simd") == 0)
+            simd_scanner_mode = true;
+        else if (strcmp(argv[i], "--lexer=flex") == 0)
+            simd_scanner_mode = false;
+        else if (strcmp(argv[i], "--object=parsed") == 0)
+            options.parsedObject = true;
+        else if (strcmp(argv[i], "--object=prebuilt") == 0)
+            options.parsedObject = false;
+        else if (strcmp(argv[i], "--lsp") == 0)
+            options.lsp = true;
+        else if (strcmp(argv[i], "--flat-ast") == 0)
+            options.flatAst = true;
+        else if (strcmp(argv[i], "--build-dir") == 0 && i + 1 < argc)
+            options.buildDir = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            options.jobs = atoi(argv[++i]);
+        else if (strncmp(argv[i], "-j", 2) == 0 && isdigit((unsigned char)argv[i][2]))
+            options.jobs = atoi(argv[i] + 2);
+        else if (strncmp(argv[i], "--time-passes", 13) == 0 || strncmp(argv[i], "--stats", 7) == 0) {
+            if (!enableStats(argv[i]))
+                return 1;
+        }
+        else if (!mode)
+            mode = argv[i];
+        else
+            inputPaths.push_back(argv[i]);
+    }
+    if (!inputPaths.empty())
+        inputPath = inputPaths[0].c_str();
+    if (options.lsp && !mode) {
+        // Language server: the protocol on stdout, anything else the lexer prints on stderr
+        FILE* protocol = fdopen(dup(STDOUT_FILENO), "w");
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        throwCompileErrors = true;
+        fileName = (char*)"<lsp>";
+        initialize_dict();
+        return LanguageServer(stdin, protocol).run();
+    }
+    if (!mode || !inputPath) {
+        std::cerr << "Usage: " << argv[0] << " [--tree-shake] [--loop-opt] [--tail-calls] [--cse] [--jit] [--jit-regalloc] [--inline-caches] [--profile] [--use-profile <file>] [--parser=bison|descent] [--lazy-bodies] [--lexer=flex|simd] [--object=parsed|prebuilt] [--flat-ast] [-j <n>] [--time-passes[=json]] [--stats[=json]] -p|-l|-c|-x|-o <source_code_file>\n"
+                  << "       " << argv[0] << " [--lexer=flex|simd] [--build-dir <dir>] [-j <n>] -c <source_code_file>...\n"
+                  << "       " << argv[0] << " [--lexer=flex|simd] --lsp\n";
         return 1;
     }
+    if (inputPaths.size() > 1) {
+        // Several files: each one checked against the interfaces of the classes of the others
+        if (strcmp(mode, "-c") != 0) {
+            std::cerr << "Error: only -c takes several files" << std::endl;
+            return 1;
+        }
+        initialize_dict();
+        unsigned int jobs = options.jobs ? options.jobs : (unsigned int)std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+        VSOP_PHASE("separate compilation");
+        return ProjectBuilder(inputPaths, options.buildDir ? options.buildDir : "", jobs).run();
+    }
     
-    fileName = argv[2];
+    fileName = (char*)inputPath;
     initialize_dict();
+    MethodNode::parseBody = parseMethodBody;
     
-    // Directly append the content of "Object.vsop" to the input file
-    std::string tempFileName = std::string(argv[2]) + "_tempo";
-    FILE* tempFile = fopen(tempFileName.c_str(), "w+"); // Open in write mode and truncate if it exists
-    if (!tempFile) {
-        std::cerr << "Error: Can't create temporary file " << tempFileName << std::endl;
-        return 1;
-    }
-
-    // Copy the content of the input file to the temporary file
-    FILE* inputFile = fopen(argv[2], "r");
+    // Read the input file: the program text, which the lexer scans from memory
+    VSOP_PHASE_BEGIN(prepareInput, "prepare input");
+    FILE* inputFile = fopen(inputPath, "r");
     if (!inputFile) {
-        std::cerr << "Error: Can't open file " << argv[2] << std::endl;
-        fclose(tempFile);
+        std::cerr << "Error: Can't open file " << inputPath << std::endl;
         return 1;
     }
-    char buffer[1024];
+    struct stat inputStat;
+    if (fstat(fileno(inputFile), &inputStat) == 0)
+        programText.reserve(inputStat.st_size + 1024);
+    char buffer[1 << 16];
     size_t bytesRead;
     while ((bytesRead = fread(buffer, 1, sizeof(buffer), inputFile)) > 0) {
-        fwrite(buffer, 1, bytesRead, tempFile);
+        programText.append(buffer, bytesRead);
     }
     fclose(inputFile);
+    VSOP_PHASE_END(prepareInput);
 
-    // Append the hardcoded content of "Object.vsop" to the temporary file
-    const char* objectVsopContent = R""(
-        class Object {
-            print(s : string) : Object { (* print s on stdout, then return self*) self}
-            printBool(b: bool) : Object { (* print b on stdout, then return self *) self}
-            printInt32(i: int32) : Object { (* print i on stdout, then return self *) self}
-            inputLine() : string {
-                (* read one line from stdin, return "" in case of error *) ""}
-            inputBool() : bool {
-                (* read one boolean value from stdin, exit with error message in case of error *) true}
-            inputInt32() : int32 {
-                (* read one integer from stdin, exit with error message in case of error *) 0}
-        })"";
-    fwrite(objectVsopContent, 1, strlen(objectVsopContent), tempFile);
-    fclose(tempFile);
-
-    // Reopen the temporary file as the input file
-    yyin = fopen(tempFileName.c_str(), "r");
-    if (!yyin) {
-        std::cerr << "Error: Can't open temporary file " << tempFileName << std::endl;
-        return 1;
-    }
-
-    // Process based on the mode argument (-p, -l, or -c)
-    if (strcmp(argv[1], "-l") == 0) {
+    // Process based on the mode argument (-p, -l, -c, -x or -o)
+    if (strcmp(mode, "-l") == 0) {
 
-        yyin = fopen(argv[2], "r");
+        yyin = fopen(inputPath, "r");
         if (!yyin) {
-            std::cerr << "Error: Can't open temporary file " << tempFileName << std::endl;
+            std::cerr << "Error: Can't open file " << inputPath << std::endl;
             return 1;
         }
 
-        // Lexical analysis mode only
+        // Lexical analysis mode only: no AST, so no need for the program text
+        std::string().swap(programText);
         lexer_debug_mode = true;
         int token;
+        VSOP_PHASE("lex");
         while ((token = yylex()) != 0) { } // No need to print anything, printing is done during lexing
+        fclose(yyin);
     }
-    else if (strcmp(argv[1], "-c") == 0 || strcmp(argv[1], "-p") == 0) {
-        yyin = fopen(tempFileName.c_str(), "r");
-        if (!yyin) {
-            std::cerr << "Error: Can't open temporary file " << tempFileName << std::endl;
-            return 1;
-        }
-        lexer_debug_mode = false;
-        int token;
-        
-        // First pass: ensure lexing is done without errors
-        while ((token = yylex()) != 0) {
-            if (token == ERROR) {
-                std::cerr << fileName << ":" << yylval.error_location.line_error << ":" 
-                          << yylval.error_location.column_error << ": lexical error : " 
-                          << error_message << std::endl;
-                exit(1);
-            }
-        }
-        // Second pass: syntactic analysis
-        yycolumn = 1; yyline = 1;
-        rewind(yyin);
-        if (!yyparse()) {
+    else if (strcmp(mode, "-c") == 0 || strcmp(mode, "-p") == 0 || strcmp(mode, "-x") == 0) {
+        int parseResult = parseProgram(options);
+        if (!parseResult) {
             // Successful parsing
             if (root) {
+                VSOP_COUNT_NODES(root.get());
                 // Load Object.vsop and extend the AST
                 // FILE* objectFile = fopen("Object.vsop", "r");
                 // if (objectFile) {
@@ -619,19 +823,90 @@ int main(int argc, char **argv) {
                 //     return EXIT_FAILURE;
                 // }
 
-                if (strcmp(argv[1], "-c") == 0) {
+                if (strcmp(mode, "-c") == 0 || strcmp(mode, "-x") == 0) {
 
                     // add 
                     SemanticAnalyzer* analyzer = new SemanticAnalyzer(std::string(fileName));
+                    VSOP_PHASE_BEGIN(analysis, "semantic analysis");
                     analyzer->analyze(static_cast<Program*>(root.get()));
+                    VSOP_PHASE_END(analysis);
                     // std::cout << "analyzer->isAccepted : "<< analyzer->isAccepted << std::endl;
                     
-                    if (analyzer->isAccepted == true)
-                        std::cout << root->toString2() << std::endl;
+                    if (analyzer->isAccepted == true) {
+                        Program* program = static_cast<Program*>(root.get());
+                        // first, so that the other passes only see the code that can run
+                        if (options.treeShake) {
+                            VSOP_PHASE("tree shaking");
+                            TreeShaker shaker;
+                            shaker.run(program);
+                        }
+                        ProfileData profile;
+                        if (options.profilePath) {
+                            VSOP_PHASE("profile-guided optimization");
+                            if (!profile.load(options.profilePath)) {
+                                std::cerr << "Error: Can't read the profile " << options.profilePath << std::endl;
+                                return EXIT_FAILURE;
+                            }
+                            ProfileGuidedOptimizer pgo{profile};
+                            pgo.run(program);
+                            if (std::getenv("VSOP_PGO_REPORT"))
+                                std::cerr << "pgo: " << pgo.inlinedCalls << " inlined calls, " << pgo.invertedBranches << " inverted branches" << std::endl;
+                            options.interpreter.profileData = &profile;
+                        }
+                        if (options.tailCalls) {
+                            VSOP_PHASE("tail calls");
+                            TailCallEliminator eliminator;
+                            eliminator.run(program);
+                        }
+                        if (options.loopOpt) {
+                            VSOP_PHASE("loop optimization");
+                            LoopOptimizer optimizer;
+                            if (options.profilePath)
+                                optimizer.loopFilter = [&profile](const WhileLoop* loop) { return profile.isHotLoop(loop); };
+                            optimizer.run(program);
+                        }
+                        if (options.cse) {
+                            VSOP_PHASE("common subexpression elimination");
+                            CommonSubexpressionEliminator eliminator;
+                            eliminator.run(program);
+                            if (std::getenv("VSOP_CSE_REPORT"))
+                                std::cerr << "cse: " << eliminator.reusedExpressions << " expressions reused, "
+                                          << eliminator.replacedRepeats << " repeats replaced, "
+                                          << eliminator.passes << " passes" << std::endl;
+                        }
+
+                        if (strcmp(mode, "-x") == 0) {
+                            // Execute Main.main, its result is the exit code
+                            VSOP_PHASE("execution");
+                            Interpreter interpreter{std::string(fileName), options.interpreter};
+                            return interpreter.run(program);
+                        }
+                        if (options.flatAst) {
+                            VSOP_PHASE_BEGIN(flattening, "flatten");
+                            FlatAst flat{program};
+                            VSOP_PHASE_END(flattening);
+                            if (std::getenv("VSOP_FLAT_REPORT"))
+                                flat.report(program);
+                            root.reset();
+                            VSOP_PHASE("print (flat)");
+                            std::cout << flat.print(true) << std::endl;
+                        } else {
+                            VSOP_PHASE("print");
+                            printProgram(program, true, options.jobs);
+                        }
+                    }
                     else
                         return EXIT_FAILURE;
-                } else if (strcmp(argv[1], "-p") == 0) {
-                    std::cout << root->toString() << std::endl;
+                } else if (strcmp(mode, "-p") == 0 && options.flatAst) {
+                    VSOP_PHASE_BEGIN(flattening, "flatten");
+                    FlatAst flat{static_cast<Program*>(root.get())};
+                    VSOP_PHASE_END(flattening);
+                    root.reset();
+                    VSOP_PHASE("print (flat)");
+                    std::cout << flat.print(false) << std::endl;
+                } else if (strcmp(mode, "-p") == 0) {
+                    VSOP_PHASE("print");
+                    printProgram(static_cast<Program*>(root.get()), false, options.jobs);
                 }
             } else {
                 std::cerr << "Error: AST is empty!" << std::endl;
@@ -642,13 +917,33 @@ int main(int argc, char **argv) {
             return EXIT_FAILURE;
         }
     }
+    else if (strcmp(mode, "-o") == 0) {
+        // Outline: the declarations, in one pass (lexical errors are reported by the
+        // parser), the method bodies skipped, and only the checks of the declarations
+        programText += objectVsopContent;
+        lexer_debug_mode = false;
+        VSOP_PHASE_BEGIN(parsing, "parse (outline)");
+        restart_lexer(0, programText.size(), 1, 1);
+        DescentParser parser;
+        parser.skipBodies = true;
+        parser.parse();
+        VSOP_PHASE_END(parsing);
+        Program* program = static_cast<Program*>(root.get());
+        VSOP_COUNT_NODES(program);
+        SemanticAnalyzer analyzer{std::string(fileName)};
+        VSOP_PHASE_BEGIN(analysis, "declaration checks");
+        analyzer.analyzeOutline(program);
+        VSOP_PHASE_END(analysis);
+        if (!analyzer.isAccepted)
+            return EXIT_FAILURE;
+        VSOP_PHASE("print");
+        OutlinePrinter(std::cout).print(program);
+    }
     else {
-        std::cerr << "Invalid Option: " << argv[1] << "\nUsage: " << argv[0] 
-                  << " -l|-p|-c <source_code_file>\n";  
+        std::cerr << "Invalid Option: " << mode << "\nUsage: " << argv[0] 
+                  << " -l|-p|-c|-x|-o <source_code_file>\n";  
     }
     
-    // Clean up
-    fclose(yyin);
     return EXIT_SUCCESS;
 }
 
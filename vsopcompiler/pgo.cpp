@@ -0,0 +1,252 @@
+#include "AST.hpp"
+#include "effects.cpp"
+#include "profiler.cpp"
+
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Profile-guided optimizations on the typed AST (--use-profile <file>).
+//
+// The profile is the ProfileData written by -x --profile (<file>.profdata); call sites,
+// conditionals and loops are found in it by their line and column.
+//
+//  - inlining: a call on self run at least hotCalls times, in a method itself called at
+//    least hotCalls times, whose only possible target (class hierarchy analysis, see
+//    EffectAnalyzer::getTargets) is another method with a body of at most maxInlineNodes
+//    nodes, is replaced by a copy of that body, its formals bound by lets to the arguments.
+//    Calls whose body reads a field hidden by a local of the caller are left alone. Callers
+//    run once (Main.main) are skipped: the JIT compiles methods by call count, so inlining
+//    into them would take hot code away from compiled callees;
+//  - block layout: a conditional whose else branch ran at least twice as often as its then
+//    branch is inverted ('if not c then else-branch else then-branch'), so that compiled
+//    code falls through to the hot branch.
+//
+// The profile also drives guarded devirtualization in the interpreter and the choice of
+// the loops LoopOptimizer transforms (ProfileData::dominantReceiver, ProfileData::isHotLoop).
+// Formals of inlined bodies are renamed with a leading '_', which no VSOP identifier can
+// have. Must run after SemanticAnalyzer::analyze.
+
+class ProfileGuidedOptimizer {
+public:
+    static const uint64_t hotCalls = 1000;
+    static const size_t maxInlineNodes = 40;
+
+    explicit ProfileGuidedOptimizer(const ProfileData& profile) : profile(profile) {}
+
+    void run(Program* program) {
+        effects.run(program);
+        methodCalls.clear();
+        for (auto& site : profile.calls)
+            methodCalls[site.second.method] += site.second.calls();
+        owners.clear();
+        for (auto& cls : program->getClasses()) {
+            for (auto& method : cls->getMethods())
+                owners[method.get()] = cls.get();
+        }
+
+        for (auto& cls : program->getClasses()) {
+            if (cls->name == "Object")
+                continue;
+            for (auto& method : cls->getMethods()) {
+                std::vector<std::string> locals;
+                for (auto& formal : method->getFormals())
+                    locals.push_back(formal->getName());
+                current = method.get();
+                hotCaller = methodCalls[method->getName()] >= hotCalls;
+                for (auto* child : method->getBlock()->getChildren())
+                    optimize(*child, locals);
+            }
+        }
+    }
+
+    // Statistics of the last run
+    size_t inlinedCalls = 0;
+    size_t invertedBranches = 0;
+
+private:
+    const ProfileData& profile;
+    EffectAnalyzer effects;
+    std::unordered_map<MethodNode*, ClassNode*> owners;
+    std::unordered_map<std::string, uint64_t> methodCalls;  // calls to methods of each name
+    MethodNode* current = nullptr;
+    bool hotCaller = false;
+    unsigned int tempCounter = 0;
+
+    using Renames = std::unordered_map<std::string, std::string>;
+
+    void optimize(std::unique_ptr<Expr>& root, std::vector<std::string>& locals) {
+        rewriteBottomUp(root, [&](std::unique_ptr<Expr>& slot) {
+            if (auto call = dynamic_cast<Call*>(slot.get()))
+                inlineCall(slot, call, locals);
+            else if (auto cond = dynamic_cast<Conditional*>(slot.get()))
+                layOut(cond);
+        }, &locals);
+    }
+
+    /* ======================== Inlining ======================== */
+
+    static size_t countNodes(Expr* expr) {
+        size_t count = 0;
+        forEachExpr(expr, [&](Expr*) { count++; });
+        return count;
+    }
+
+    // Names 'expr' uses without binding them: fields, and the formals in 'bound'
+    static void collectFreeNames(Expr* expr, std::vector<std::string>& bound, std::vector<std::string>& free) {
+        std::string name;
+        if (auto objIden = dynamic_cast<ObjectIdentifier*>(expr))
+            name = objIden->getName();
+        else if (auto assign = dynamic_cast<Assign*>(expr))
+            name = assign->getName();
+        if (!name.empty() && std::find(bound.begin(), bound.end(), name) == bound.end())
+            free.push_back(name);
+
+        if (auto let = dynamic_cast<Let*>(expr)) {
+            if (let->getInitExpr())
+                collectFreeNames(let->getInitExpr(), bound, free);
+            bound.push_back(let->getName());
+            collectFreeNames(let->getScopeExpr(), bound, free);
+            bound.pop_back();
+            return;
+        }
+        for (auto* child : expr->getChildren()) {
+            if (*child)
+                collectFreeNames(child->get(), bound, free);
+        }
+    }
+
+    void inlineCall(std::unique_ptr<Expr>& slot, Call* call, const std::vector<std::string>& locals) {
+        if (!hotCaller || !dynamic_cast<Self*>(call->getExprObjectIdentifier()))
+            return;
+        const ProfileData::CallSite* site = profile.callSite(call);
+        if (!site || site->calls() < hotCalls)
+            return;
+        std::vector<MethodNode*> targets = effects.getTargets(call->getClassName(), call->getMethodName());
+        if (targets.size() != 1 || targets[0] == current)
+            return;
+        MethodNode* target = targets[0];
+        if (!owners.count(target) || owners[target]->name == "Object")
+            return;
+        if (countNodes(target->getBlock()) > maxInlineNodes)
+            return;
+
+        std::vector<std::string> bound;
+        for (auto& formal : target->getFormals())
+            bound.push_back(formal->getName());
+        std::vector<std::string> free;
+        collectFreeNames(target->getBlock(), bound, free);
+        for (auto& name : free) {
+            if (std::find(locals.begin(), locals.end(), name) != locals.end())
+                return; // the field would be read through a local of the caller
+        }
+
+        Renames renames;
+        std::vector<std::string> temps;
+        for (auto& formal : target->getFormals()) {
+            temps.push_back("_inl" + std::to_string(tempCounter++) + "_" + formal->getName());
+            renames[formal->getName()] = temps.back();
+        }
+        std::unique_ptr<Expr> body = clone(target->getBlock(), renames);
+
+        // innermost let for the last argument, so that arguments are evaluated in order
+        auto& formals = target->getFormals();
+        auto& args = call->getArgs();
+        std::string resultType = call->getTypeName();
+        for (size_t i = formals.size(); i-- > 0;) {
+            auto let = std::make_unique<Let>(temps[i], formals[i]->getType(), call->getColumn(), call->getLine(),
+                                             std::move(args[i]), std::move(body));
+            let->setTypeByName(resultType);
+            body = std::move(let);
+        }
+        body->setTypeByName(resultType);
+        slot = std::move(body);
+        inlinedCalls++;
+    }
+
+    // Deep copy of 'expr', with the identifiers in 'renames' renamed
+    std::unique_ptr<Expr> clone(Expr* expr, const Renames& renames) {
+        auto rename = [&](const std::string& name) {
+            auto it = renames.find(name);
+            return it != renames.end() ? it->second : name;
+        };
+        std::unique_ptr<Expr> copy;
+
+        if (auto intLiteral = dynamic_cast<IntegerLiteral*>(expr)) {
+            copy = std::make_unique<IntegerLiteral>(intLiteral->getValue());
+        } else if (auto strLiteral = dynamic_cast<StringLiteral*>(expr)) {
+            copy = std::make_unique<StringLiteral>(strLiteral->getText(), strLiteral->hasEscapes());
+        } else if (auto boolLiteral = dynamic_cast<BooleanLiteral*>(expr)) {
+            copy = std::make_unique<BooleanLiteral>(boolLiteral->getValue());
+        } else if (auto binOp = dynamic_cast<BinaryOperation*>(expr)) {
+            copy = std::make_unique<BinaryOperation>(binOp->getOperator(), clone(binOp->getLeft(), renames),
+                                                     clone(binOp->getRight(), renames));
+        } else if (auto unOp = dynamic_cast<UnOp*>(expr)) {
+            copy = std::make_unique<UnOp>(unOp->getOp(), clone(unOp->getExpr(), renames));
+        } else if (auto cond = dynamic_cast<Conditional*>(expr)) {
+            auto conditional = std::make_unique<Conditional>(clone(cond->getCond_expr(), renames),
+                                                             clone(cond->getThen_expr(), renames),
+                                                             clone(cond->getElse_expr(), renames));
+            conditional->setHasElse(cond->hasElse());
+            copy = std::move(conditional);
+        } else if (auto whileLoop = dynamic_cast<WhileLoop*>(expr)) {
+            copy = std::make_unique<WhileLoop>(clone(whileLoop->getCond_expr(), renames),
+                                               clone(whileLoop->getBody_expr(), renames));
+        } else if (auto block = dynamic_cast<Block*>(expr)) {
+            auto blockCopy = std::make_unique<Block>();
+            for (auto& inner : block->getExprs())
+                blockCopy->addExpr(clone(inner.get(), renames));
+            copy = std::move(blockCopy);
+        } else if (auto let = dynamic_cast<Let*>(expr)) {
+            std::unique_ptr<Expr> init = let->getInitExpr() ? clone(let->getInitExpr(), renames) : nullptr;
+            Renames inner = renames;
+            inner.erase(let->getName()); // the let hides a renamed formal
+            copy = std::make_unique<Let>(let->getName(), let->getType(), std::move(init), clone(let->getScopeExpr(), inner));
+        } else if (auto assign = dynamic_cast<Assign*>(expr)) {
+            copy = std::make_unique<Assign>(rename(assign->getName()), clone(assign->getExpr(), renames));
+        } else if (auto call = dynamic_cast<Call*>(expr)) {
+            std::vector<std::unique_ptr<Expr>> args;
+            for (auto& arg : call->getArgs())
+                args.push_back(clone(arg.get(), renames));
+            copy = std::make_unique<Call>(call->getMethodName(), std::move(args),
+                                          clone(call->getExprObjectIdentifier(), renames));
+        } else if (auto objIden = dynamic_cast<ObjectIdentifier*>(expr)) {
+            copy = std::make_unique<ObjectIdentifier>(rename(objIden->getName()));
+        } else if (dynamic_cast<Self*>(expr)) {
+            copy = std::make_unique<Self>(std::string("self"));
+        } else if (auto newExpr = dynamic_cast<New*>(expr)) {
+            copy = std::make_unique<New>(newExpr->getClassName());
+        } else {
+            copy = std::make_unique<Parenthesis>();
+        }
+
+        copy->setType(Type(expr->getTypeName()));
+        copy->setColumn(expr->getColumn());
+        copy->setLine(expr->getLine());
+        return copy;
+    }
+
+    /* ======================== Block layout ======================== */
+
+    void layOut(Conditional* cond) {
+        const ProfileData::Branch* branch = profile.branch(cond);
+        if (!branch || branch->elseCount < 100 || branch->elseCount < 2 * branch->thenCount)
+            return;
+
+        auto children = cond->getChildren();
+        std::unique_ptr<Expr>& test = *children[0];
+        if (auto unOp = dynamic_cast<UnOp*>(test.get()); unOp && unOp->getOp() == "not") {
+            test = std::move(*unOp->getChildren()[0]);
+        } else {
+            unsigned int column = test->getColumn(), line = test->getLine();
+            test = std::make_unique<UnOp>("not", std::move(test));
+            test->setTypeByName("bool");
+            test->setColumn(column);
+            test->setLine(line);
+        }
+        std::swap(*children[1], *children[2]);
+        cond->setHasElse(true);
+        invertedBranches++;
+    }
+};
@@ -0,0 +1,356 @@
+#ifndef PROFILER_CPP
+#define PROFILER_CPP
+
+#include "AST.hpp"
+
+#include <unordered_map>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <ostream>
+#include <fstream>
+
+// Method-level profiler of the interpreter (-x --profile).
+//
+// The interpreter reports each method activation, built-ins included, with enter() and
+// exit(). For every method the profiler counts the calls and measures the inclusive time
+// (outermost activations only, so that recursion is not counted twice) and the exclusive
+// time (minus the callees). For every call site it keeps a histogram of the dynamic
+// classes of the receivers. Activations also build a calling context tree, written as
+// folded stacks ("Main.main;A.f;B.g <microseconds>") for flame graph tools; frames deeper
+// than maxFoldedDepth are charged to their ancestor at that depth.
+//
+// It also counts the outcomes of conditionals and the iterations of loops run by the
+// interpreter (not those of JIT-compiled code), and saves them with the receivers of the
+// call sites as a ProfileData file, the input of the profile-guided optimizations.
+
+/**
+ * ProfileData - Call sites, conditionals and loops of a profiled run, by source position
+ *
+ * The file is text: a "vsop-profile 1" header, then one line per site:
+ *   call <line> <column> <method> <class>:<count>...
+ *   branch <line> <column> <then count> <else count>
+ *   loop <line> <column> <entries> <iterations>
+ */
+struct ProfileData {
+    using Position = std::pair<unsigned int, unsigned int>;    // line, column
+
+    struct CallSite {
+        std::string method;
+        std::vector<std::pair<std::string, uint64_t>> receivers;    // most frequent first
+
+        uint64_t calls() const {
+            uint64_t total = 0;
+            for (auto& receiver : receivers)
+                total += receiver.second;
+            return total;
+        }
+    };
+
+    struct Branch {
+        uint64_t thenCount = 0;
+        uint64_t elseCount = 0;
+    };
+
+    struct Loop {
+        uint64_t entries = 0;
+        uint64_t iterations = 0;
+    };
+
+    std::map<Position, CallSite> calls;
+    std::map<Position, Branch> branches;
+    std::map<Position, Loop> loops;
+
+    const CallSite* callSite(const Call* call) const {
+        auto it = calls.find({call->getLine(), call->getColumn()});
+        return it != calls.end() && it->second.method == call->getMethodName() ? &it->second : nullptr;
+    }
+
+    const Branch* branch(const Conditional* cond) const {
+        auto it = branches.find({cond->getLine(), cond->getColumn()});
+        return it != branches.end() ? &it->second : nullptr;
+    }
+
+    // A loop that ran often enough, and long enough each time, to pay for its optimization
+    bool isHotLoop(const WhileLoop* loop) const {
+        auto it = loops.find({loop->getLine(), loop->getColumn()});
+        return it != loops.end() && it->second.iterations >= 1000 && it->second.iterations >= 4 * it->second.entries;
+    }
+
+    // The class of at least 90% of the receivers of a call site run at least 100 times
+    const std::string* dominantReceiver(const Call* call) const {
+        const CallSite* site = callSite(call);
+        if (!site || site->receivers.empty())
+            return nullptr;
+        uint64_t total = site->calls();
+        if (total < 100 || site->receivers.front().second * 10 < total * 9)
+            return nullptr;
+        return &site->receivers.front().first;
+    }
+
+    bool save(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        out << "vsop-profile 1\n";
+        for (auto& [position, site] : calls) {
+            out << "call " << position.first << " " << position.second << " " << site.method;
+            for (auto& [className, count] : site.receivers)
+                out << " " << className << ":" << count;
+            out << "\n";
+        }
+        for (auto& [position, branch] : branches)
+            out << "branch " << position.first << " " << position.second << " " << branch.thenCount << " " << branch.elseCount << "\n";
+        for (auto& [position, loop] : loops)
+            out << "loop " << position.first << " " << position.second << " " << loop.entries << " " << loop.iterations << "\n";
+        return static_cast<bool>(out);
+    }
+
+    // False if the file cannot be read or is not a profile
+    bool load(const std::string& path) {
+        std::ifstream in(path);
+        std::string line;
+        if (!std::getline(in, line) || line != "vsop-profile 1")
+            return false;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string kind;
+            Position position;
+            if (!(fields >> kind >> position.first >> position.second))
+                return false;
+            if (kind == "call") {
+                CallSite& site = calls[position];
+                if (!(fields >> site.method))
+                    return false;
+                std::string receiver;
+                while (fields >> receiver) {
+                    size_t colon = receiver.rfind(':');
+                    if (colon == std::string::npos)
+                        return false;
+                    site.receivers.emplace_back(receiver.substr(0, colon), std::stoull(receiver.substr(colon + 1)));
+                }
+            } else if (kind == "branch") {
+                Branch& branch = branches[position];
+                if (!(fields >> branch.thenCount >> branch.elseCount))
+                    return false;
+            } else if (kind == "loop") {
+                Loop& loop = loops[position];
+                if (!(fields >> loop.entries >> loop.iterations))
+                    return false;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+class Profiler {
+public:
+    static const size_t maxFoldedDepth = 256;
+
+    Profiler() : contexts(1), epoch(Clock::now()) {}
+
+    // 'site' is null for the call of Main.main
+    void enter(MethodNode* method, const std::string& owner, const Call* site, const std::string& receiverClass) {
+        auto it = methodIds.find(method);
+        if (it == methodIds.end()) {
+            it = methodIds.emplace(method, methods.size()).first;
+            methods.push_back(MethodStats{owner + "." + method->getName()});
+        }
+        size_t id = it->second;
+        MethodStats& stats = methods[id];
+        stats.calls++;
+        stats.active++;
+        if (site)
+            sites[site][&receiverClass]++;
+
+        size_t context = stack.empty() ? 0 : stack.back().context;
+        if (stack.size() < maxFoldedDepth)
+            context = childContext(context, id);
+        stack.push_back(Activation{id, context, now(), 0});
+    }
+
+    void exit() {
+        Activation activation = stack.back();
+        stack.pop_back();
+        int64_t elapsed = now() - activation.start;
+        int64_t exclusive = elapsed - activation.childTime;
+
+        MethodStats& stats = methods[activation.method];
+        if (--stats.active == 0)
+            stats.inclusive += elapsed;
+        stats.exclusive += exclusive;
+        contexts[activation.context].exclusive += exclusive;
+        if (!stack.empty())
+            stack.back().childTime += elapsed;
+    }
+
+    void branch(const Conditional* cond, bool taken) {
+        ProfileData::Branch& counts = branchCounts[cond];
+        (taken ? counts.thenCount : counts.elseCount)++;
+    }
+
+    void loop(const WhileLoop* loop, uint64_t iterations) {
+        ProfileData::Loop& counts = loopCounts[loop];
+        counts.entries++;
+        counts.iterations += iterations;
+    }
+
+    // Sites sharing a position (copies of inlined code) add up
+    bool saveProfile(const std::string& path) const {
+        ProfileData data;
+        for (auto& [call, histogram] : sites) {
+            ProfileData::CallSite& site = data.calls[{call->getLine(), call->getColumn()}];
+            site.method = call->getMethodName();
+            for (auto& [className, count] : histogram) {
+                auto it = std::find_if(site.receivers.begin(), site.receivers.end(),
+                                       [&](const auto& receiver) { return receiver.first == *className; });
+                if (it == site.receivers.end())
+                    site.receivers.emplace_back(*className, count);
+                else
+                    it->second += count;
+            }
+        }
+        for (auto& [position, site] : data.calls) {
+            std::sort(site.receivers.begin(), site.receivers.end(), [](const auto& a, const auto& b) {
+                return a.second > b.second || (a.second == b.second && a.first < b.first);
+            });
+        }
+        for (auto& [cond, counts] : branchCounts) {
+            ProfileData::Branch& branch = data.branches[{cond->getLine(), cond->getColumn()}];
+            branch.thenCount += counts.thenCount;
+            branch.elseCount += counts.elseCount;
+        }
+        for (auto& [loop, counts] : loopCounts) {
+            ProfileData::Loop& total = data.loops[{loop->getLine(), loop->getColumn()}];
+            total.entries += counts.entries;
+            total.iterations += counts.iterations;
+        }
+        return data.save(path);
+    }
+
+    // Methods by exclusive time, then the receiver classes of each call site
+    void report(std::ostream& out, const std::string& fileName) const {
+        std::vector<const MethodStats*> sorted;
+        int64_t total = 0;
+        for (const MethodStats& stats : methods) {
+            sorted.push_back(&stats);
+            total += stats.exclusive;
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const MethodStats* a, const MethodStats* b) {
+            return a->exclusive > b->exclusive || (a->exclusive == b->exclusive && a->name < b->name);
+        });
+
+        char line[256];
+        out << "profile of " << fileName << "\n";
+        std::snprintf(line, sizeof(line), "%12s %12s %12s %7s  %s\n", "calls", "incl (ms)", "excl (ms)", "excl %", "method");
+        out << line;
+        for (const MethodStats* stats : sorted) {
+            std::snprintf(line, sizeof(line), "%12llu %12.3f %12.3f %6.1f%%  ", (unsigned long long) stats->calls,
+                          stats->inclusive / 1e6, stats->exclusive / 1e6, total ? 100.0 * stats->exclusive / total : 0.0);
+            out << line << stats->name << "\n";
+        }
+
+        std::vector<std::pair<const Call*, const Histogram*>> sortedSites;
+        for (auto& site : sites)
+            sortedSites.emplace_back(site.first, &site.second);
+        std::sort(sortedSites.begin(), sortedSites.end(), [](const auto& a, const auto& b) {
+            if (a.first->getLine() != b.first->getLine())
+                return a.first->getLine() < b.first->getLine();
+            return a.first->getColumn() < b.first->getColumn();
+        });
+        out << "receivers by call site\n";
+        for (auto& [call, histogram] : sortedSites) {
+            std::vector<std::pair<const std::string*, uint64_t>> classes(histogram->begin(), histogram->end());
+            std::sort(classes.begin(), classes.end(), [](const auto& a, const auto& b) {
+                return a.second > b.second || (a.second == b.second && *a.first < *b.first);
+            });
+            uint64_t calls = 0;
+            for (auto& entry : classes)
+                calls += entry.second;
+            out << "  " << call->getLine() << ":" << call->getColumn() << " " << call->getMethodName() << ":";
+            for (auto& [className, count] : classes) {
+                std::snprintf(line, sizeof(line), " %llu (%.1f%%)", (unsigned long long) count, 100.0 * count / calls);
+                out << " " << *className << line;
+            }
+            out << "\n";
+        }
+    }
+
+    // One line per calling context with exclusive time, in microseconds
+    bool writeFoldedStacks(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        std::vector<std::pair<size_t, std::string>> pending;
+        for (auto& [id, child] : contexts[0].children)
+            pending.emplace_back(child, methods[id].name);
+        while (!pending.empty()) {
+            auto [context, frames] = std::move(pending.back());
+            pending.pop_back();
+            int64_t micros = contexts[context].exclusive / 1000;
+            if (micros > 0)
+                out << frames << " " << micros << "\n";
+            for (auto& [id, child] : contexts[context].children)
+                pending.emplace_back(child, frames + ";" + methods[id].name);
+        }
+        return static_cast<bool>(out);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    using Histogram = std::unordered_map<const std::string*, uint64_t>;
+
+    struct MethodStats {
+        std::string name;               // Class.method, the class defining it
+        uint64_t calls = 0;
+        int64_t inclusive = 0;          // nanoseconds
+        int64_t exclusive = 0;
+        size_t active = 0;              // activations on the stack
+    };
+
+    struct Activation {
+        size_t method;
+        size_t context;
+        int64_t start;
+        int64_t childTime;
+    };
+
+    /**
+     * Context - Node of the calling context tree: a method called along one path
+     */
+    struct Context {
+        std::unordered_map<size_t, size_t> children;    // method to context
+        int64_t exclusive = 0;
+    };
+
+    std::unordered_map<MethodNode*, size_t> methodIds;
+    std::vector<MethodStats> methods;
+    std::unordered_map<const Call*, Histogram> sites;
+    std::unordered_map<const Conditional*, ProfileData::Branch> branchCounts;
+    std::unordered_map<const WhileLoop*, ProfileData::Loop> loopCounts;
+    std::vector<Context> contexts;                      // the root first
+    std::vector<Activation> stack;
+    Clock::time_point epoch;
+
+    int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+    }
+
+    size_t childContext(size_t parent, size_t method) {
+        auto it = contexts[parent].children.find(method);
+        if (it != contexts[parent].children.end())
+            return it->second;
+        contexts[parent].children.emplace(method, contexts.size());
+        contexts.emplace_back();
+        return contexts.size() - 1;
+    }
+};
+
+#endif // PROFILER_CPP
@@ -0,0 +1,294 @@
+#include "vsop_runtime.hpp"
+
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+
+// Built-in methods of Object, as declared by the prelude in parser.y. Their behaviour
+// matches the interpreter (-x): inputs are whitespace-separated words, except for
+// inputLine, and malformed input stops the program with a runtime error.
+//
+// Output goes to a large buffer written to stdout when full, at exit, before input has
+// to wait for more bytes, on a runtime error or on flush(); on a terminal it is also
+// written at the end of each line. Input is read from stdin in large blocks. Numbers
+// are formatted and parsed by hand, without locale.
+
+namespace vsop {
+
+const ClassDescriptor& objectClass() {
+    static const ClassDescriptor descriptor("Object", nullptr, {}, {
+        {"print", reinterpret_cast<void*>(&print)},
+        {"printBool", reinterpret_cast<void*>(&printBool)},
+        {"printInt32", reinterpret_cast<void*>(&printInt32)},
+        {"inputLine", reinterpret_cast<void*>(&inputLine)},
+        {"inputBool", reinterpret_cast<void*>(&inputBool)},
+        {"inputInt32", reinterpret_cast<void*>(&inputInt32)},
+    });
+    return descriptor;
+}
+
+namespace {
+
+constexpr size_t bufferBytes = 64 << 10;
+
+void writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return; // nowhere to report it: stdout is gone
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+struct OutputBuffer {
+    char data[bufferBytes];
+    size_t used = 0;
+    bool started = false;
+    bool lineBuffered = false;
+
+    void start() {
+        started = true;
+        lineBuffered = ::isatty(STDOUT_FILENO);
+        std::atexit([] { vsop::flush(); });
+    }
+
+    void flush() {
+        writeAll(STDOUT_FILENO, data, used);
+        used = 0;
+    }
+
+    // Room for 'size' more bytes, unless they do not fit in the buffer at all
+    char* reserve(size_t size) {
+        if (!started)
+            start();
+        if (bufferBytes - used < size)
+            flush();
+        return data + used;
+    }
+
+    void write(const char* bytes, size_t size) {
+        if (size > bufferBytes / 2) {
+            reserve(bufferBytes);
+            writeAll(STDOUT_FILENO, bytes, size);
+            return;
+        }
+        std::memcpy(reserve(size), bytes, size);
+        used += size;
+        if (lineBuffered && std::memchr(bytes, '\n', size))
+            flush();
+    }
+};
+
+OutputBuffer output;
+
+struct InputBuffer {
+    char data[bufferBytes];
+    size_t position = 0;
+    size_t size = 0;
+    bool atEnd = false;
+
+    // Next byte without consuming it, EOF at end of input
+    int peek() {
+        if (position == size && !refill())
+            return EOF;
+        return static_cast<unsigned char>(data[position]);
+    }
+
+    int get() {
+        int c = peek();
+        if (c != EOF)
+            position++;
+        return c;
+    }
+
+    bool refill() {
+        if (atEnd)
+            return false;
+        output.flush(); // the program may be waiting for an answer to what it printed
+        ssize_t count;
+        do {
+            count = ::read(STDIN_FILENO, data, bufferBytes);
+        } while (count < 0 && errno == EINTR);
+        if (count <= 0) {
+            atEnd = true;
+            return false;
+        }
+        position = 0;
+        size = static_cast<size_t>(count);
+        return true;
+    }
+};
+
+InputBuffer input;
+
+bool isSpace(int c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+struct Word {
+    const char* data;
+    size_t size;
+
+    bool operator==(const char* other) const { return size == std::strlen(other) && !std::memcmp(data, other, size); }
+    std::string str() const { return std::string(data, size); }
+};
+
+// Next whitespace-separated word of stdin, empty at end of input. It points into the input
+// buffer when it lies there entirely, into 'storage' otherwise.
+Word readWord(std::string& storage) {
+    while (isSpace(input.peek()))
+        input.get();
+    if (input.peek() == EOF)
+        return {nullptr, 0};
+
+    const char* begin = input.data + input.position;
+    const char* limit = input.data + input.size;
+    const char* end = begin;
+    while (end < limit && !isSpace(*end))
+        ++end;
+    if (end < limit) {
+        input.position = end - input.data;
+        return {begin, static_cast<size_t>(end - begin)};
+    }
+
+    // the word goes on in the next block
+    storage.clear();
+    int c;
+    while ((c = input.peek()) != EOF && !isSpace(c))
+        storage.push_back(static_cast<char>(input.get()));
+    return {storage.data(), storage.size()};
+}
+
+const char digitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Writes the decimal digits of 'value' ending at 'end', returns where they start
+char* formatDecimal(uint32_t value, char* end) {
+    while (value >= 100) {
+        const char* pair = digitPairs + 2 * (value % 100);
+        value /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+    if (value >= 10) {
+        *--end = digitPairs[2 * value + 1];
+        *--end = digitPairs[2 * value];
+    } else {
+        *--end = static_cast<char>('0' + value);
+    }
+    return end;
+}
+
+int digitValue(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return 99;
+}
+
+// Integer in the syntax of strtoll with base 0: sign, then decimal, 0x hexadecimal or 0 octal
+bool parseInt32(Word word, int32_t& result) {
+    const char* text = word.data;
+    size_t i = 0;
+    bool negative = false;
+    if (i < word.size && (text[i] == '+' || text[i] == '-'))
+        negative = text[i++] == '-';
+
+    int base = 10;
+    if (i + 1 < word.size && text[i] == '0' && (text[i + 1] == 'x' || text[i + 1] == 'X')) {
+        base = 16;
+        i += 2;
+    } else if (i + 1 < word.size && text[i] == '0') {
+        base = 8;
+        i += 1;
+    }
+    if (i == word.size)
+        return false;
+
+    const int64_t limit = negative ? -static_cast<int64_t>(INT32_MIN) : INT32_MAX;
+    int64_t value = 0;
+    for (; i < word.size; ++i) {
+        int digit = digitValue(text[i]);
+        if (digit >= base)
+            return false;
+        value = value * base + digit;
+        if (value > limit)
+            return false;
+    }
+    result = static_cast<int32_t>(negative ? -value : value);
+    return true;
+}
+
+} // namespace
+
+void flush() {
+    output.flush();
+}
+
+void runtimeError(const std::string& message) {
+    output.flush();
+    std::fprintf(stderr, "runtime error: %s\n", message.c_str());
+    std::exit(1);
+}
+
+Object* print(Object* self, String* s) {
+    output.write(s->chars(), s->length);
+    return self;
+}
+
+Object* printBool(Object* self, bool b) {
+    if (b)
+        output.write("true", 4);
+    else
+        output.write("false", 5);
+    return self;
+}
+
+Object* printInt32(Object* self, int32_t i) {
+    char digits[12];
+    char* end = digits + sizeof(digits);
+    uint32_t magnitude = i < 0 ? 0u - static_cast<uint32_t>(i) : static_cast<uint32_t>(i);
+    char* begin = formatDecimal(magnitude, end);
+    if (i < 0)
+        *--begin = '-';
+    output.write(begin, end - begin);
+    return self;
+}
+
+String* inputLine(Object*) {
+    std::string line;
+    int c;
+    while ((c = input.get()) != EOF && c != '\n')
+        line.push_back(static_cast<char>(c));
+    return makeString(line);
+}
+
+bool inputBool(Object*) {
+    std::string storage;
+    Word word = readWord(storage);
+    if (!(word == "true") && !(word == "false"))
+        runtimeError("inputBool: expected 'true' or 'false'");
+    return word == "true";
+}
+
+int32_t inputInt32(Object*) {
+    std::string storage;
+    Word word = readWord(storage);
+    if (word.size == 0)
+        runtimeError("inputInt32: expected an integer");
+    int32_t value;
+    if (!parseInt32(word, value))
+        runtimeError("inputInt32: invalid integer '" + word.str() + "'");
+    return value;
+}
+
+} // namespace vsop
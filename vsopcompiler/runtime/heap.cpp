@@ -0,0 +1,434 @@
+#include "vsop_runtime.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+
+// Generational heap: a nursery in front of a semispace old generation.
+//
+// Threads allocate from their own buffer (Tlab) without synchronization; a buffer is
+// refilled from the nursery under the heap lock. When the nursery is full, a minor
+// collection promotes every survivor to the old generation: roots and remembered cards
+// are forwarded, then the promoted objects are scanned breadth-first (Cheney) until no
+// reference to the nursery is left, so the nursery starts empty again and no card stays
+// remembered. Its cost depends on the survivors and the mutated cards, not on the size
+// of the old generation.
+//
+// Cards mark object headers rather than slots: a remembered card is scanned by visiting
+// every object that starts in it, found from the first object start recorded per card.
+//
+// When the old generation cannot take the whole nursery, a major collection copies both
+// generations to the other semispace. With a nursery of 0 bytes, buffers come from the
+// old generation and every collection is major.
+//
+// The thread that needs memory collects; the collector assumes that no other thread runs
+// VSOP code meanwhile, which holds for VSOP programs (single-threaded).
+
+namespace vsop {
+
+thread_local Tlab tlab;
+NurseryBounds nursery;
+CardTable cardTable;
+
+namespace {
+
+constexpr size_t defaultSemispaceBytes = 8 << 20;
+constexpr size_t defaultNurseryBytes = 4 << 20;
+constexpr size_t tlabBytes = 32 << 10;
+constexpr size_t largeObjectBytes = tlabBytes / 4;   // allocated directly in the old generation
+
+using Clock = std::chrono::steady_clock;
+
+struct Space {
+    char* begin = nullptr;
+    char* end = nullptr;
+    std::vector<uint8_t> cards;             // old generation only
+    std::vector<char*> firstObjects;        // first object starting in each card
+
+    size_t size() const { return end - begin; }
+    bool contains(const void* address) const {
+        auto value = reinterpret_cast<uintptr_t>(address);
+        return value >= reinterpret_cast<uintptr_t>(begin) && value < reinterpret_cast<uintptr_t>(end);
+    }
+    size_t cardOf(const void* address) const {
+        return (reinterpret_cast<uintptr_t>(address) - reinterpret_cast<uintptr_t>(begin)) >> cardShift;
+    }
+};
+
+/** A thread that allocates or holds roots */
+struct Mutator {
+    Tlab* tlab;
+    std::vector<Object**>* roots;
+};
+
+struct Heap {
+    std::mutex lock;
+    Space current;                  // old generation
+    Space reserve;                  // survivors of major collections are copied here
+    Space young;                    // nursery
+    char* cursor = nullptr;         // first byte of 'current' not handed out yet
+    char* youngCursor = nullptr;    // first byte of the nursery not handed out yet
+    char* copyCursor = nullptr;     // end of the copies while collecting
+    size_t targetBytes = defaultSemispaceBytes;
+    size_t nurseryBytes = defaultNurseryBytes;
+    std::vector<size_t> rememberedCards;
+    std::vector<Mutator> mutators;
+    std::vector<Object**> globalRoots;
+    GcStats stats;
+    Clock::time_point start = Clock::now();
+
+    bool generational() const { return nurseryBytes != 0; }
+};
+
+// Never destroyed: threads may still exit after the static destructors have run
+Heap& heap() {
+    static Heap* instance = new Heap;
+    return *instance;
+}
+
+/** Registers the thread with the heap for its lifetime */
+struct MutatorRegistration {
+    std::vector<Object**> roots;
+
+    MutatorRegistration() {
+        std::lock_guard<std::mutex> guard(heap().lock);
+        heap().mutators.push_back({&tlab, &roots});
+    }
+
+    ~MutatorRegistration() {
+        Heap& h = heap();
+        std::lock_guard<std::mutex> guard(h.lock);
+        h.stats.bytesAllocated += tlab.top - tlab.start;
+        tlab = Tlab();
+        h.mutators.erase(std::remove_if(h.mutators.begin(), h.mutators.end(),
+            [&](const Mutator& mutator) { return mutator.roots == &roots; }), h.mutators.end());
+    }
+};
+
+MutatorRegistration& registration() {
+    thread_local MutatorRegistration instance;
+    return instance;
+}
+
+Space allocateSpace(size_t bytes, bool withCards) {
+    char* memory = static_cast<char*>(std::malloc(bytes));
+    if (!memory)
+        runtimeError("out of memory");
+    Space space;
+    space.begin = memory;
+    space.end = memory + bytes;
+    if (withCards) {
+        space.cards.assign((bytes >> cardShift) + 1, 0);
+        space.firstObjects.assign(space.cards.size(), nullptr);
+    }
+    return space;
+}
+
+void publishCardTable(Heap& h) {
+    cardTable.cards = h.current.cards.data();
+    cardTable.base = reinterpret_cast<uintptr_t>(h.current.begin);
+}
+
+void reportAtExit() {
+    printGcReport(stderr);
+}
+
+void ensureInitialized(Heap& h) {
+    if (h.current.begin)
+        return;
+    h.current = allocateSpace(h.targetBytes, h.generational());
+    h.cursor = h.current.begin;
+    if (h.generational()) {
+        h.young = allocateSpace(h.nurseryBytes, false);
+        h.youngCursor = h.young.begin;
+        nursery.begin = reinterpret_cast<uintptr_t>(h.young.begin);
+        nursery.size = h.young.size();
+        publishCardTable(h);
+    }
+    h.stats.heapBytes = h.current.size();
+    if (std::getenv("VSOP_GC_REPORT"))
+        std::atexit(reportAtExit);
+}
+
+// Gives back the unused end of a thread's buffer
+void retire(Heap& h, Tlab& buffer) {
+    h.stats.bytesAllocated += buffer.top - buffer.start;
+    buffer = Tlab();
+}
+
+void recordObjectStart(Space& space, char* address) {
+    if (space.firstObjects.empty())
+        return;
+    size_t card = space.cardOf(address);
+    if (!space.firstObjects[card])
+        space.firstObjects[card] = address;
+}
+
+void rememberObject(Heap& h, Object* object) {
+    size_t card = h.current.cardOf(object);
+    if (!h.current.cards[card]) {
+        h.current.cards[card] = 1;
+        h.rememberedCards.push_back(card);
+    }
+}
+
+// Copies 'object' to 'target' unless it is already there or outside of the collected space
+Object* evacuate(Heap& h, Object* object, Space& target, bool major) {
+    if (!object)
+        return object;
+    if (!isYoung(object) && !(major && h.current.contains(object)))
+        return object; // old during a minor collection, or a constant outside of the heap
+    if (object->header & 1)
+        return reinterpret_cast<Object*>(object->header & ~static_cast<uintptr_t>(1));
+
+    size_t size = object->header;
+    Object* copy = reinterpret_cast<Object*>(h.copyCursor);
+    std::memcpy(copy, object, size);
+    recordObjectStart(target, h.copyCursor);
+    h.copyCursor += size;
+    object->header = reinterpret_cast<uintptr_t>(copy) | 1;
+    return copy;
+}
+
+void scanObject(Heap& h, Object* object, Space& target, bool major) {
+    Slot* fields = object->fields();
+    for (uint32_t slot : object->vtable->referenceSlots)
+        fields[slot].ref = evacuate(h, fields[slot].ref, target, major);
+}
+
+void evacuateRoots(Heap& h, Space& target, bool major) {
+    for (Object** slot : h.globalRoots)
+        *slot = evacuate(h, *slot, target, major);
+    for (Mutator& mutator : h.mutators) {
+        for (Object** slot : *mutator.roots)
+            *slot = evacuate(h, *slot, target, major);
+    }
+}
+
+// Cheney scan of the copies, from 'scan' until no copy is left unscanned
+void scanCopies(Heap& h, char* scan, Space& target, bool major) {
+    while (scan < h.copyCursor) {
+        Object* object = reinterpret_cast<Object*>(scan);
+        scanObject(h, object, target, major);
+        scan += object->header;
+    }
+}
+
+void emptyNursery(Heap& h) {
+    h.youngCursor = h.young.begin;
+    for (size_t card : h.rememberedCards)
+        h.current.cards[card] = 0;
+    h.rememberedCards.clear();
+}
+
+void recordPause(Heap& h, Clock::time_point begin) {
+    h.stats.collections++;
+    h.stats.heapBytes = h.current.size();
+    h.stats.pauses.push_back(std::chrono::duration<double, std::milli>(Clock::now() - begin).count());
+}
+
+void collectMajor(Heap& h, size_t needed) {
+    Clock::time_point begin = Clock::now();
+    ensureInitialized(h);
+    for (Mutator& mutator : h.mutators)
+        retire(h, *mutator.tlab);
+
+    // survivors take at most what was used, grow the reserve to the target size
+    size_t used = (h.cursor - h.current.begin) + (h.youngCursor - h.young.begin);
+    size_t reserveBytes = std::max(h.targetBytes, used);
+    if (h.reserve.size() < reserveBytes) {
+        std::free(h.reserve.begin);
+        h.reserve = allocateSpace(reserveBytes, h.generational());
+    } else {
+        std::fill(h.reserve.cards.begin(), h.reserve.cards.end(), 0);
+        std::fill(h.reserve.firstObjects.begin(), h.reserve.firstObjects.end(), nullptr);
+    }
+    h.copyCursor = h.reserve.begin;
+
+    evacuateRoots(h, h.reserve, true);
+    scanCopies(h, h.reserve.begin, h.reserve, true);
+
+    std::swap(h.current, h.reserve);
+    h.cursor = h.copyCursor;
+    h.rememberedCards.clear();
+    h.youngCursor = h.young.begin;
+    if (h.generational())
+        publishCardTable(h);
+    size_t live = h.cursor - h.current.begin;
+
+    // keep the old generation at most half full, with room to promote a whole nursery
+    size_t wanted = live + needed + h.nurseryBytes;
+    if (wanted > h.current.size() / 2)
+        h.targetBytes = std::max(h.current.size() * 2, wanted * 2);
+
+    h.stats.bytesCopied += live;
+    recordPause(h, begin);
+}
+
+void collectMinor(Heap& h) {
+    // promotion must not run out of room in the old generation
+    size_t youngUsed = h.youngCursor - h.young.begin;
+    if (static_cast<size_t>(h.current.end - h.cursor) < youngUsed) {
+        collectMajor(h, 0);
+        return;
+    }
+
+    Clock::time_point begin = Clock::now();
+    for (Mutator& mutator : h.mutators)
+        retire(h, *mutator.tlab);
+
+    char* promoted = h.cursor;
+    h.copyCursor = h.cursor;
+    evacuateRoots(h, h.current, false);
+
+    // objects starting in a remembered card may reference the nursery
+    for (size_t card : h.rememberedCards) {
+        char* cardEnd = h.current.begin + ((card + 1) << cardShift);
+        char* scan = h.current.firstObjects[card];
+        while (scan && scan < cardEnd && scan < promoted) {
+            Object* object = reinterpret_cast<Object*>(scan);
+            scanObject(h, object, h.current, false);
+            scan += object->header;
+        }
+    }
+    scanCopies(h, promoted, h.current, false);
+
+    h.cursor = h.copyCursor;
+    emptyNursery(h);
+
+    h.stats.minorCollections++;
+    h.stats.bytesPromoted += h.cursor - promoted;
+    recordPause(h, begin);
+}
+
+char* reserveOld(Heap& h, size_t size) {
+    ensureInitialized(h);
+    while (static_cast<size_t>(h.current.end - h.cursor) < size)
+        collectMajor(h, size);
+    char* memory = h.cursor;
+    h.cursor += size;
+    return memory;
+}
+
+char* reserveYoung(Heap& h, size_t size) {
+    ensureInitialized(h);
+    if (static_cast<size_t>(h.young.end - h.youngCursor) < size)
+        collectMinor(h);
+    char* memory = h.youngCursor;
+    h.youngCursor += size;
+    return memory;
+}
+
+} // namespace
+
+void initialize(size_t semispaceBytes, size_t nurseryBytes) {
+    Heap& h = heap();
+    std::lock_guard<std::mutex> guard(h.lock);
+    if (h.current.begin)
+        return; // too late, the heap is in use
+    h.targetBytes = std::max(semispaceBytes, 2 * tlabBytes);
+    h.nurseryBytes = nurseryBytes ? std::max(nurseryBytes, 2 * tlabBytes) : 0;
+    ensureInitialized(h);
+}
+
+Object* allocateSlow(const ClassDescriptor* cls, size_t size) {
+    registration();
+    Heap& h = heap();
+    std::lock_guard<std::mutex> guard(h.lock);
+
+    if (size >= largeObjectBytes) {
+        char* memory = reserveOld(h, size);
+        h.stats.bytesAllocated += size;
+        Object* object = initializeObject(memory, cls, size);
+        if (h.generational()) {
+            // its initializing stores bypass the barrier
+            recordObjectStart(h.current, memory);
+            if (!cls->referenceSlots.empty())
+                rememberObject(h, object);
+        }
+        return object;
+    }
+
+    retire(h, tlab);
+    char* chunk = h.generational() ? reserveYoung(h, tlabBytes) : reserveOld(h, tlabBytes);
+    tlab.start = chunk;
+    tlab.top = chunk + size;
+    tlab.end = chunk + tlabBytes;
+    return initializeObject(chunk, cls, size);
+}
+
+void rememberCard(size_t card) {
+    Heap& h = heap();
+    h.current.cards[card] = 1;
+    h.rememberedCards.push_back(card);
+}
+
+std::vector<Object**>& rootStack() {
+    return registration().roots;
+}
+
+void addRoot(Object** slot) {
+    std::lock_guard<std::mutex> guard(heap().lock);
+    heap().globalRoots.push_back(slot);
+}
+
+void removeRoot(Object** slot) {
+    Heap& h = heap();
+    std::lock_guard<std::mutex> guard(h.lock);
+    auto it = std::find(h.globalRoots.begin(), h.globalRoots.end(), slot);
+    if (it != h.globalRoots.end())
+        h.globalRoots.erase(it);
+}
+
+void collect() {
+    registration();
+    Heap& h = heap();
+    std::lock_guard<std::mutex> guard(h.lock);
+    collectMajor(h, 0);
+}
+
+GcStats gcStats() {
+    Heap& h = heap();
+    std::lock_guard<std::mutex> guard(h.lock);
+    GcStats stats = h.stats;
+    stats.bytesAllocated += tlab.top - tlab.start;
+    return stats;
+}
+
+void resetGcStats() {
+    Heap& h = heap();
+    std::lock_guard<std::mutex> guard(h.lock);
+    size_t heapBytes = h.stats.heapBytes;
+    h.stats = GcStats();
+    h.stats.heapBytes = heapBytes;
+    h.start = Clock::now();
+    tlab.start = tlab.top;
+}
+
+void printGcReport(std::FILE* out) {
+    GcStats stats = gcStats();
+    double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - heap().start).count();
+    std::vector<double> pauses = stats.pauses;
+    std::sort(pauses.begin(), pauses.end());
+    double total = 0;
+    for (double pause : pauses)
+        total += pause;
+
+    const double mib = 1024.0 * 1024.0;
+    std::fprintf(out, "GC: %zu collections (%zu minor), %.2f ms paused, %.1f%% of %.1f ms\n",
+                 stats.collections, stats.minorCollections, total,
+                 elapsed > 0 ? 100.0 * total / elapsed : 0.0, elapsed);
+    if (!pauses.empty()) {
+        auto percentile = [&](double p) {
+            return pauses[std::min(pauses.size() - 1, static_cast<size_t>(p * pauses.size()))];
+        };
+        std::fprintf(out, "    pause (ms)  mean %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+                     total / pauses.size(), percentile(0.5), percentile(0.9), percentile(0.99), pauses.back());
+    }
+    std::fprintf(out, "    heap        %.1f MiB semispace, %.1f MiB allocated, %.1f MiB promoted, %.1f MiB copied\n",
+                 stats.heapBytes / mib, stats.bytesAllocated / mib, stats.bytesPromoted / mib,
+                 stats.bytesCopied / mib);
+}
+
+} // namespace vsop
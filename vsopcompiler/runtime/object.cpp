@@ -0,0 +1,98 @@
+#include "vsop_runtime.hpp"
+
+namespace vsop {
+
+/**
+ * Computes the layout of the class: the parent's fields and method table, extended
+ * with the fields and methods declared by the class
+ */
+ClassDescriptor::ClassDescriptor(const char* name, const ClassDescriptor* parent,
+                                 std::vector<FieldDescriptor> ownFields,
+                                 std::vector<std::pair<const char*, void*>> ownMethods)
+    : name(name), parent(parent) {
+    if (parent) {
+        fields = parent->fields;
+        methodNames = parent->methodNames;
+        methods = parent->methods;
+    }
+    fields.insert(fields.end(), ownFields.begin(), ownFields.end());
+
+    for (auto& method : ownMethods) {
+        int index = methodIndex(method.first);
+        if (index >= 0) {
+            methods[index] = method.second;
+        } else {
+            methodNames.push_back(method.first);
+            methods.push_back(method.second);
+        }
+    }
+
+    for (uint32_t slot = 0; slot < fields.size(); ++slot) {
+        if (fields[slot].kind == FieldKind::String) {
+            referenceSlots.push_back(slot);
+            stringSlots.push_back(slot);
+        } else if (fields[slot].kind == FieldKind::Object) {
+            referenceSlots.push_back(slot);
+        }
+    }
+    instanceSize = static_cast<uint32_t>(sizeof(Object) + fields.size() * sizeof(Slot));
+}
+
+int ClassDescriptor::fieldIndex(const std::string& fieldName) const {
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (fieldName == fields[i].name)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+int ClassDescriptor::methodIndex(const std::string& methodName) const {
+    for (size_t i = 0; i < methodNames.size(); ++i) {
+        if (methodName == methodNames[i])
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+bool ClassDescriptor::isSubclassOf(const ClassDescriptor* ancestor) const {
+    for (const ClassDescriptor* current = this; current; current = current->parent) {
+        if (current == ancestor)
+            return true;
+    }
+    return false;
+}
+
+/** Strings have no field: their size is in their header, their bytes follow 'length' */
+const ClassDescriptor& stringClass() {
+    static const ClassDescriptor descriptor("string", nullptr, {}, {});
+    return descriptor;
+}
+
+String* emptyString() {
+    static String* constant = [] {
+        static uint64_t storage[(sizeof(String) + sizeof(uint64_t)) / sizeof(uint64_t)] = {};
+        String* string = reinterpret_cast<String*>(storage);
+        string->header = sizeof(storage);
+        string->vtable = &stringClass();
+        string->length = 0;
+        return string;
+    }();
+    return constant;
+}
+
+/** 'data' must not point into the heap, the allocation may move it */
+String* makeString(const char* data, size_t length) {
+    if (length == 0)
+        return emptyString();
+    size_t size = (sizeof(String) + length + 1 + 7) & ~static_cast<size_t>(7);
+    String* string = static_cast<String*>(allocateRaw(&stringClass(), size));
+    string->length = length;
+    std::memcpy(string->chars(), data, length);
+    return string;
+}
+
+String* makeString(const std::string& value) {
+    return makeString(value.data(), value.size());
+}
+
+} // namespace vsop
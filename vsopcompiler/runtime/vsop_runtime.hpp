@@ -0,0 +1,288 @@
+/**
+ * Runtime library of compiled VSOP programs: object model, allocation, garbage
+ * collection and the built-in methods of Object.
+ *
+ * Objects live in a garbage-collected heap and are laid out as
+ *
+ *     +--------+--------+---------+---------+-----
+ *     | header | vtable | field 0 | field 1 | ...
+ *     +--------+--------+---------+---------+-----
+ *
+ * The header holds the size of the object for the collector. The vtable pointer leads to
+ * the ClassDescriptor of the object, which holds the method table and the field layout.
+ * Every field takes one 8-byte slot: the fields of the parent class come first, then the
+ * fields of the class in declaration order. A slot holds an int32, a bool or a reference
+ * to a heap object; strings are heap objects. The descriptors are made by the code that
+ * uses the library (the benchmarks of benchmarks/runtime): vsopc does not generate them
+ * from its classes, nor any code calling the library, yet.
+ *
+ * Allocation bumps a pointer in a thread-local buffer carved from the nursery. The heap
+ * is generational: a minor collection promotes the survivors of the nursery to the old
+ * generation, finding the old objects that reference the nursery through a card table
+ * kept by the write barrier (storeRef). When the old generation fills up, a major
+ * collection copies both generations with a Cheney-style semispace collector. Both only
+ * follow precisely registered roots (Root<T> for locals, addRoot for globals) and the
+ * reference slots listed by each class, so no conservative scanning is ever needed.
+ */
+
+#ifndef VSOP_RUNTIME_H
+#define VSOP_RUNTIME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vsop {
+
+struct Object;
+struct String;
+
+/** Kind of value held by a field slot */
+enum class FieldKind : uint8_t { Unit, Bool, Int32, String, Object };
+
+struct FieldDescriptor {
+    const char* name;
+    FieldKind kind;
+};
+
+/**
+ * ClassDescriptor - Method table and field layout of a class
+ */
+class ClassDescriptor {
+    public:
+        /**
+         * @param name The class name
+         * @param parent The parent class, nullptr for Object
+         * @param ownFields Fields declared by the class itself, in declaration order
+         * @param ownMethods Methods declared by the class; those already in the parent's
+         *        table override their slot, the others are appended
+         */
+        ClassDescriptor(const char* name, const ClassDescriptor* parent,
+                        std::vector<FieldDescriptor> ownFields,
+                        std::vector<std::pair<const char*, void*>> ownMethods);
+
+        int fieldIndex(const std::string& fieldName) const;
+        int methodIndex(const std::string& methodName) const;
+        bool isSubclassOf(const ClassDescriptor* ancestor) const;
+
+        const char* name;
+        const ClassDescriptor* parent;
+        std::vector<FieldDescriptor> fields;    // inherited fields first
+        std::vector<const char*> methodNames;
+        std::vector<void*> methods;             // vtable, inherited slots first
+        std::vector<uint32_t> referenceSlots;   // fields scanned by the collector
+        std::vector<uint32_t> stringSlots;      // fields initialized to ""
+        uint32_t instanceSize;                  // in bytes, header included
+};
+
+/** One field slot */
+union Slot {
+    int64_t value;
+    Object* ref;
+};
+
+/**
+ * Object - Header of every heap object, followed by its field slots
+ */
+struct Object {
+    uintptr_t header;                   // size in bytes, or forwarding address | 1 while collecting
+    const ClassDescriptor* vtable;
+
+    Slot* fields() { return reinterpret_cast<Slot*>(this + 1); }
+
+    int32_t getInt32(uint32_t slot) { return static_cast<int32_t>(fields()[slot].value); }
+    void setInt32(uint32_t slot, int32_t value) { fields()[slot].value = value; }
+    bool getBool(uint32_t slot) { return fields()[slot].value != 0; }
+    void setBool(uint32_t slot, bool value) { fields()[slot].value = value; }
+    Object* getRef(uint32_t slot) { return fields()[slot].ref; }
+    // Without write barrier: only to initialize the object last allocated, see storeRef
+    void setRef(uint32_t slot, Object* value) { fields()[slot].ref = value; }
+};
+
+/**
+ * String - Immutable byte string, NUL-terminated for convenience
+ */
+struct String : Object {
+    uint64_t length;
+
+    char* chars() { return reinterpret_cast<char*>(this + 1); }
+    std::string str() { return std::string(chars(), length); }
+};
+
+/** Descriptors of the built-in classes */
+const ClassDescriptor& objectClass();
+const ClassDescriptor& stringClass();
+
+/*=========================  Allocation  ================================ */
+
+/** Thread-local allocation buffer */
+struct Tlab {
+    char* start = nullptr;
+    char* top = nullptr;
+    char* end = nullptr;
+};
+
+extern thread_local Tlab tlab;
+
+/**
+ * Sets the initial size of each semispace of the old generation and the size of the
+ * nursery, before the first allocation; a nursery of 0 bytes disables generations.
+ * Optional, the heap starts with default sizes. Setting VSOP_GC_REPORT in the
+ * environment prints printGcReport to stderr at exit.
+ */
+void initialize(size_t semispaceBytes, size_t nurseryBytes);
+
+Object* allocateSlow(const ClassDescriptor* cls, size_t size);
+
+inline Object* initializeObject(char* memory, const ClassDescriptor* cls, size_t size) {
+    Object* object = reinterpret_cast<Object*>(memory);
+    object->header = size;
+    object->vtable = cls;
+    std::memset(object->fields(), 0, size - sizeof(Object));
+    return object;
+}
+
+inline Object* allocateRaw(const ClassDescriptor* cls, size_t size) {
+    if (static_cast<size_t>(tlab.end - tlab.top) >= size) {
+        char* memory = tlab.top;
+        tlab.top += size;
+        return initializeObject(memory, cls, size);
+    }
+    return allocateSlow(cls, size);
+}
+
+String* makeString(const char* data, size_t length);
+String* makeString(const std::string& value);
+
+/** The "" constant, outside of the heap */
+String* emptyString();
+
+/*=========================  Roots  ===================================== */
+
+/** Slots of the current thread that hold references, innermost last */
+std::vector<Object**>& rootStack();
+
+/** Registers a slot living outside of the heap (a global), until removeRoot */
+void addRoot(Object** slot);
+void removeRoot(Object** slot);
+
+/**
+ * Root - A local reference kept up to date by the collector
+ *
+ * Roots must be destroyed in reverse order of creation, as automatic variables are.
+ */
+template <typename T>
+class Root {
+    public:
+        explicit Root(T* object = nullptr) : object(object) {
+            rootStack().push_back(reinterpret_cast<Object**>(&this->object));
+        }
+        ~Root() { rootStack().pop_back(); }
+        Root(const Root&) = delete;
+        Root& operator=(const Root& other) { object = other.object; return *this; }
+
+        Root& operator=(T* value) { object = value; return *this; }
+        T* get() const { return object; }
+        T* operator->() const { return object; }
+        operator T*() const { return object; }
+
+    private:
+        T* object;
+};
+
+/*=========================  Write barrier  ============================= */
+
+constexpr unsigned int cardShift = 9;  // 512-byte cards
+
+/** Address range of the nursery, empty when generations are disabled */
+struct NurseryBounds {
+    uintptr_t begin = 0;
+    uintptr_t size = 0;
+};
+
+extern NurseryBounds nursery;
+
+/** One byte per card of the old generation, set while the card is remembered */
+struct CardTable {
+    uint8_t* cards = nullptr;
+    uintptr_t base = 0;
+};
+
+extern CardTable cardTable;
+
+inline bool isYoung(const void* address) {
+    return reinterpret_cast<uintptr_t>(address) - nursery.begin < nursery.size;
+}
+
+void rememberCard(size_t card);
+
+/**
+ * Stores a reference in a field, with the generational write barrier. No backend of the
+ * compiler emits it yet (the JIT of -x leaves out objects and strings): it is the store
+ * that code generated for an Assign to a field of class or string type has to use. An
+ * old object that gets a reference to a young one has the card of its header marked, and
+ * the card is added to the remembered set scanned by the next minor collection.
+ */
+inline void storeRef(Object* object, uint32_t slot, Object* value) {
+    object->setRef(slot, value);
+    if (isYoung(value) && !isYoung(object)) {
+        size_t card = (reinterpret_cast<uintptr_t>(object) - cardTable.base) >> cardShift;
+        if (!cardTable.cards[card])
+            rememberCard(card);
+    }
+}
+
+/*=========================  Collection  ================================ */
+
+struct GcStats {
+    size_t collections = 0;
+    size_t minorCollections = 0;
+    size_t bytesAllocated = 0;          // handed out to the program
+    size_t bytesCopied = 0;             // survivors copied by major collections
+    size_t bytesPromoted = 0;           // survivors of the nursery
+    size_t heapBytes = 0;               // current size of one semispace
+    std::vector<double> pauses;         // milliseconds, one per collection
+};
+
+/** Collects both generations now */
+void collect();
+
+GcStats gcStats();
+void resetGcStats();
+
+/** Prints the collections, pause-time distribution and GC share of the elapsed time */
+void printGcReport(std::FILE* out);
+
+/*=========================  Built-in methods of Object  ================ */
+
+Object* print(Object* self, String* s);
+Object* printBool(Object* self, bool b);
+Object* printInt32(Object* self, int32_t i);
+String* inputLine(Object* self);
+bool inputBool(Object* self);
+int32_t inputInt32(Object* self);
+
+/** Writes the buffered output of the print methods to stdout */
+void flush();
+
+/** Prints "runtime error: message" and exits with status 1 */
+[[noreturn]] void runtimeError(const std::string& message);
+
+/**
+ * Allocates an instance of 'cls' with default field values. May collect: references not
+ * registered as roots are invalid afterwards.
+ */
+inline Object* allocate(const ClassDescriptor* cls) {
+    Object* object = allocateRaw(cls, cls->instanceSize);
+    for (uint32_t slot : cls->stringSlots)
+        object->setRef(slot, emptyString());
+    return object;
+}
+
+} // namespace vsop
+
+#endif // VSOP_RUNTIME_H
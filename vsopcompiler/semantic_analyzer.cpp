@@ -1,7 +1,11 @@
 #include "AST.hpp"
 #include "symbol_table.cpp"
+#include "builtin_registry.cpp"
 
+#include <algorithm>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <iostream>
 #include <functional>
@@ -31,6 +35,85 @@ public:
             // exit(1); // do not print syntax if semantic error is detected
 
     }
+    // The checks of the declarations only, which need no method body (-o): the classes and
+    // their inheritance, then the signatures of the overriding methods, once the hierarchy is sound
+    void analyzeOutline(Program* program) {
+        checkClassInhiretence(program->getClasses());
+        if (!isAccepted)
+            return;
+        for (const auto& cls : program->getClasses()) {
+            if (ClassNode* parentClass = parentOf(cls.get()))
+                compareMethodsSignature(cls.get(), parentClass);
+        }
+    }
+
+    // For --lsp, which checks again only the classes that may have changed: the hierarchy,
+    // then each of those classes (once the hierarchy has no error)
+    void analyzeHierarchy(Program* program) {
+        checkClassInhiretence(program->getClasses());
+    }
+
+    void analyzeClass(ClassNode* cls) {
+        checkClass(cls);
+    }
+
+    // When set, gets the errors instead of stderr
+    std::function<void(unsigned int line, unsigned int column, const std::string& message)> report;
+
+    // For the separate compilation of a file (build.cpp): the classes of the other files it
+    // uses are given by their interfaces, whose errors are reported with their own file, and
+    // whether there is a class Main is checked once all the files are known
+    std::unordered_set<std::string> summarized;
+    bool requireMain = true;
+
+    struct ClassLayout;
+    // fields by name: the layout that defines each one, and the index of the field in its fields
+    using FieldTable = std::unordered_map<std::string, std::pair<const ClassLayout*, unsigned int>>;
+
+    /**
+     * ClassLayout - A class in the hierarchy, and its fields: those of its parent come
+     * first in its objects, then its own (in source order), from offset 'firstOffset'
+     */
+    struct ClassLayout {
+        ClassNode* cls = nullptr;
+        ClassLayout* parent = nullptr;  // none for Object, an undeclared parent, or in a cycle
+        unsigned int depth = 0;         // from the root of its hierarchy
+        unsigned int firstOffset = 0;   // the number of inherited fields
+        std::vector<FieldNode*> fields; // its own, but for those redefining an inherited one
+        // all the fields of its objects, its parent's then its own. The only child of a
+        // class shares its table, which then also has the fields of descendants (the
+        // entries whose layout is not an ancestor), so that a chain of classes needs one
+        std::shared_ptr<FieldTable> visible;
+        unsigned int enter = 0;         // the interval of the walk of the hierarchy in which
+        unsigned int exit = 0;          // the class is open (see isAncestorOf)
+
+        unsigned int size() const { return firstOffset + fields.size(); }
+
+        // Whether this class is 'other' or one of its ancestors
+        bool isAncestorOf(const ClassLayout& other) const { return enter <= other.enter && other.exit <= exit; }
+    };
+
+    // The layout of a class, built by the hierarchy checks; nullptr if there is no such class
+    const ClassLayout* layoutOf(const std::string& name) const {
+        auto found = layouts.find(name);
+        return found != layouts.end() ? &found->second : nullptr;
+    }
+
+    // The field 'name' of the objects of a class (its own or inherited), and its offset in
+    // them; nullptr if they have none
+    FieldNode* findField(const ClassLayout& layout, const std::string& name, unsigned int* offset = nullptr,
+                         const ClassLayout** owner = nullptr) const {
+        auto found = layout.visible->find(name);
+        if (found == layout.visible->end() || !found->second.first->isAncestorOf(layout))
+            return nullptr;
+        const ClassLayout* definer = found->second.first;
+        if (offset)
+            *offset = definer->firstOffset + found->second.second;
+        if (owner)
+            *owner = definer;
+        return definer->fields[found->second.second];
+    }
+
     bool isAccepted = true;
     std::string fileName;
     SemanticAnalyzer(std::string fileName) : fileName(std::move(fileName)) {isAccepted = true;}
@@ -38,10 +121,39 @@ public:
 private:
     ClassNode* class_in_question = nullptr;
     MethodNode* method_in_question = nullptr;
+    const ClassLayout* inherited_in_question = nullptr; // the layout of the parent of class_in_question
     SymbolTable symb_tab = SymbolTable();
     std::unordered_map<std::string, ClassNode*> classMap; ///TODO to be curfull here
+    std::unordered_map<std::string, ClassLayout> layouts;  // of the classes of classMap
 
 
+    // The class of that name, nullptr if none is declared (without adding it to classMap)
+    ClassNode* findClass(const std::string& name) {
+        auto found = classMap.find(name);
+        return found != classMap.end() ? found->second : nullptr;
+    }
+
+    // The type of a name in scope: a local, a formal, a field of the class or an inherited
+    // field; "" if none
+    std::string lookup(const std::string& name) {
+        std::string type = symb_tab.lookup(name);
+        if (type.empty() && inherited_in_question) {
+            if (FieldNode* field = findField(*inherited_in_question, name))
+                type = field->getTypeName();
+        }
+        return type;
+    }
+
+    // The parent of a class in the hierarchy: nullptr for Object, an undeclared parent, or
+    // a class in a cycle, so that walking up from any class ends
+    ClassNode* parentOf(ClassNode* cls) {
+        auto found = layouts.find(cls->name);
+        if (found != layouts.end() && found->second.cls == cls)
+            return found->second.parent ? found->second.parent->cls : nullptr;
+        // a class defined again: its parent, with the parents of the first definitions from there
+        return cls->parent != "NULL_PARENT" ? findClass(cls->parent) : nullptr;
+    }
+
     void checkClassInhiretence(const std::vector<std::unique_ptr<ClassNode>>& classes) {
         /***
          * check wether all the extended (parent) class exists ........... Done
@@ -53,10 +165,14 @@ private:
          *  and check main args (signature) if are good .................. Done
          ***/
 
-        std::unordered_map<std::string, bool> visited;
-
         // Populate class map and check for duplicate class definitions
+        std::vector<ClassNode*> declared; // in classMap, in the order of the program
         for (auto& cls : classes) {
+            if (summarized.count(cls->name)) {
+                classMap[cls->name] = cls.get();
+                declared.push_back(cls.get());
+                continue;
+            }
             if (classMap.find(cls->name) != classMap.end()) {
                 reportSemanticError("Class '" + cls->name + "' is defined more than once.", cls->getColumn(), cls->getLine());
                 continue;
@@ -65,47 +181,26 @@ private:
                 // reportSemanticError("Class cannot be named 'Object'.");
                 // continue;
             }
-            for (const std::string& s : {"int32", "bool", "string", "unit"}) {//TODO this is additional from my mind
-                if (s == cls->name)
+            if (isPrimitiveType(cls->name))
                 reportSemanticError("Class cannot be named 'int32', 'bool', 'string', or 'unit'.", cls->getColumn(), cls->getLine());
-                continue;
-            }
             classMap[cls->name] = cls.get();
-            visited[cls->name] = false;
+            declared.push_back(cls.get());
         }
 
-        // Check for cyclic inheritance
-        std::function<bool(const std::string&)> isCyclic = [&](const std::string& className) {
-            if (visited[className]) return true;
-            visited[className] = true;
-
-            auto cls = classMap[className];
-            if (cls->parent != "" && classMap.find(cls->parent) != classMap.end()) {
-                if (isCyclic(cls->parent)) {
-                    reportSemanticError("Cyclic inheritance detected, class " + className + " cannot extend child class ", cls->getColumn(), cls->getLine());
-                    return true;
-                }
-            }
-
-            visited[className] = false;
-            return false;
-        };
-
-        for (auto& cls : classes) {
-            if (isCyclic(cls->name)) {
-                // Already reported in the recursive function
-                continue;
-            }
-        }
+        // Check for cyclic inheritance, and lay the classes out
+        buildHierarchy(declared);
 
         // Check for undefined parent classes
         for (auto& cls : classes) {
-            if (!cls->parent.empty() && cls->parent != "NULL_PARENT" && classMap.find(cls->parent) == classMap.end()) {
+            if (!cls->parent.empty() && cls->parent != "NULL_PARENT" && classMap.find(cls->parent) == classMap.end()
+                && !summarized.count(cls->name)) {
                 reportSemanticError("Parent class " + cls->parent + " of class " + cls->name + " is not declared.");
             }
         }
 
         // Check for the existence of class Main
+        if (!requireMain)
+            return;
         auto mainIt = classMap.find("Main");
         if (mainIt == classMap.end()) {
             reportSemanticError("No class 'Main' defined.");
@@ -130,12 +225,130 @@ private:
         }
     }
     
+    // Reports the cycles of the hierarchy, then builds the layouts of the classes, parents
+    // first. In time linear in the number of classes and fields.
+    void buildHierarchy(const std::vector<ClassNode*>& declared) {
+        size_t count = declared.size();
+        std::unordered_map<std::string, size_t> indexOf;
+        for (size_t i = 0; i < count; ++i)
+            indexOf[declared[i]->name] = i;
+        const size_t none = count;
+        std::vector<size_t> parent(count, none);
+        for (size_t i = 0; i < count; ++i) {
+            auto found = indexOf.find(declared[i]->parent);
+            if (declared[i]->parent != "NULL_PARENT" && found != indexOf.end())
+                parent[i] = found->second;
+        }
+
+        // Tarjan's algorithm, on a graph where each class has at most one edge (to its parent):
+        // a depth-first walk is a path, and an edge back into the current path closes the
+        // only component of more than one class the walk can find, a cycle. Each class is
+        // walked once.
+        std::vector<size_t> walk(count, none); // the walk that reached the class
+        std::vector<bool> cyclic(count, false);
+        std::vector<std::vector<size_t>> cycles;
+        for (size_t start = 0; start < count; ++start) {
+            std::vector<size_t> path;
+            size_t current = start;
+            while (current != none && walk[current] == none) {
+                walk[current] = start;
+                path.push_back(current);
+                current = parent[current];
+            }
+            if (current != none && walk[current] == start) {
+                // back in the path: from 'current' to its end is a cycle
+                auto first = std::find(path.begin(), path.end(), current);
+                cycles.emplace_back(first, path.end());
+                for (auto member = first; member != path.end(); ++member)
+                    cyclic[*member] = true;
+            }
+        }
+
+        // Each cycle once, at its first class in the order of the program, from there
+        std::vector<std::pair<size_t, size_t>> firsts; // the first class of each cycle, the cycle
+        for (size_t c = 0; c < cycles.size(); ++c)
+            firsts.emplace_back(*std::min_element(cycles[c].begin(), cycles[c].end()), c);
+        std::sort(firsts.begin(), firsts.end());
+        for (const auto& first : firsts) {
+            const std::vector<size_t>& cycle = cycles[first.second];
+            ClassNode* cls = declared[first.first];
+            if (summarized.count(cls->name))
+                continue;
+            size_t at = std::find(cycle.begin(), cycle.end(), first.first) - cycle.begin();
+            std::string path;
+            for (size_t i = 0; i <= cycle.size(); ++i)
+                path += (i ? " -> " : "") + declared[cycle[(at + i) % cycle.size()]]->name;
+            reportSemanticError("Class '" + cls->name + "' is in an inheritance cycle: " + path + ".", cls->getColumn(), cls->getLine());
+        }
+
+        // A depth-first walk of the hierarchy from its roots (the classes of a cycle are
+        // roots): its preorder puts the parents first, each layout is made from its parent's
+        std::vector<std::vector<size_t>> children(count);
+        std::vector<size_t> roots;
+        for (size_t i = 0; i < count; ++i) {
+            if (parent[i] != none && !cyclic[i])
+                children[parent[i]].push_back(i);
+            else
+                roots.push_back(i);
+        }
+        layouts.clear();
+        layouts.reserve(count);
+        std::vector<ClassLayout*> layoutAt(count, nullptr);
+        unsigned int clock = 0;
+        auto open = [&](size_t i, ClassLayout* parentLayout, bool onlyChild) {
+            ClassLayout& layout = layouts[declared[i]->name];
+            layoutAt[i] = &layout;
+            layout.cls = declared[i];
+            layout.parent = parentLayout;
+            layout.depth = parentLayout ? parentLayout->depth + 1 : 0;
+            layout.firstOffset = parentLayout ? parentLayout->size() : 0;
+            layout.enter = clock++;
+            // the table of the parent has only the fields of the open classes, the ancestors
+            if (!parentLayout)
+                layout.visible = std::make_shared<FieldTable>();
+            else if (onlyChild)
+                layout.visible = parentLayout->visible;
+            else
+                layout.visible = std::make_shared<FieldTable>(*parentLayout->visible);
+            // the parser stores the fields in reverse source order; a field defined again, in
+            // the class or in an ancestor (an error of checkClass), keeps the offset it has
+            auto& fields = declared[i]->getFields();
+            for (auto field = fields.rbegin(); field != fields.rend(); ++field) {
+                if (!layout.visible->emplace((*field)->getName(), std::make_pair(&layout, (unsigned int)layout.fields.size())).second)
+                    continue;
+                layout.fields.push_back(field->get());
+            }
+        };
+        std::vector<std::pair<size_t, size_t>> stack; // a class, and its next child to walk
+        for (size_t root : roots) {
+            open(root, nullptr, false);
+            stack.emplace_back(root, 0);
+            while (!stack.empty()) {
+                auto& top = stack.back();
+                if (top.second < children[top.first].size()) {
+                    size_t child = children[top.first][top.second++];
+                    open(child, layoutAt[top.first], children[top.first].size() == 1);
+                    stack.emplace_back(child, 0);
+                } else {
+                    layoutAt[top.first]->exit = clock++;
+                    stack.pop_back();
+                }
+            }
+        }
+    }
+
     // Check class-level semantics: fields and method cannot be redeclared twice ... Done
     void checkClass(ClassNode* cls) {
 
         class_in_question = cls; // 
 
         symb_tab.enterScope();
+
+        // the fields of the ancestors are in the scope of its methods, as its own: found in
+        // the layout of its parent by lookup() (scopes are copied, they are kept small)
+        ClassNode* parentClass = parentOf(cls);
+        const ClassLayout* inherited = parentClass ? layoutOf(parentClass->name) : nullptr;
+        inherited_in_question = inherited;
         
         // std::cout << "Checking class: " << cls->name << std::endl;
 
@@ -156,17 +369,9 @@ private:
             fieldNames[field->getName()] = true;
 
             // Check cannot redefine its ancestor fields (no different type)
-            if (cls->parent != "NULL_PARENT") {
-                std::string currentAncestor = cls->parent;
-                while (!currentAncestor.empty() && currentAncestor != "NULL_PARENT") {
-                    const auto& ancestorClass = classMap[currentAncestor];
-                    for (auto& ancestorField : ancestorClass->getFields()) {
-                        if (ancestorField->getName() == field->getName()) {
-                            reportSemanticError("The inherited field '" + ancestorField->getName() + "' of type '" + ancestorField->getTypeName() + "' in position (" + std::to_string(ancestorField->getLine()) +":"+std::to_string(ancestorField->getColumn())+") from the superior class '"+ancestorClass->name+"' cannot be redefined with a different type '" + field->getTypeName() + "' in the child class'"+cls->name+"'", field->getColumn(), field->getLine());
-                        }
-                    }
-                    currentAncestor = ancestorClass->parent;
-                }
+            const ClassLayout* owner = nullptr;
+            if (FieldNode* ancestorField = inherited ? findField(*inherited, field->getName(), nullptr, &owner) : nullptr) {
+                reportSemanticError("The inherited field '" + ancestorField->getName() + "' of type '" + ancestorField->getTypeName() + "' in position (" + std::to_string(ancestorField->getLine()) +":"+std::to_string(ancestorField->getColumn())+") from the superior class '"+owner->cls->name+"' cannot be redefined with a different type '" + field->getTypeName() + "' in the child class'"+cls->name+"'", field->getColumn(), field->getLine());
             }
 
             symb_tab.declare(field->getName(), field->getTypeName());
@@ -188,13 +393,14 @@ private:
             methodNames[method->getName()] = true;
 
             // Must have parent class same methods args and return ....... //TODO check ancestors not only parent
-            if (cls->parent != "NULL_PARENT") {
-            compareMethodsSignature(cls, classMap[cls->parent]);
+            if (parentClass) {
+            compareMethodsSignature(cls, parentClass);
             }
 
             checkMethod(method.get());
         }
-        symb_tab.enterScope();
+        symb_tab.exitScope();
+        inherited_in_question = nullptr;
     }
 
     // Check field-level semantics (e.g., type validity) .................. Done
@@ -220,10 +426,8 @@ private:
             // std::cout << "Field name: " << field->getName() << ", Field type: " << ftype << std::endl;
         }
 
-        for (const std::string& s : {"int32", "bool", "string", "unit"}) {
-            if (s == ftype)
-                return;
-        }
+        if (isPrimitiveType(ftype))
+            return;
 
         // std::cout << "Checking field: " + field->getName() << std::endl;
         if (classMap.count(ftype) == 0)
@@ -259,10 +463,7 @@ private:
                 }
             }
             }
-            if (currentAncestor->parent.empty() || currentAncestor->parent == "NULL_PARENT") {
-            break;
-            }
-            currentAncestor = classMap[currentAncestor->parent];
+            currentAncestor = parentOf(currentAncestor);
         }
     }
 
@@ -279,7 +480,7 @@ private:
             std::string ftype = formal->getType().getName();
 
             // Check if the type of the formal exists or is a primitive type
-            if (!isInArray(ftype, {"int32", "bool", "string", "unit"}) && classMap.count(ftype) == 0) {
+            if (!isPrimitiveType(ftype) && classMap.count(ftype) == 0) {
             reportSemanticError("The type '" + ftype + "' of formal parameter '" + fname + "' in method '" + method->getName() + "' does not exist.", formal->getColumn(), formal->getLine());
             continue;
             }
@@ -308,11 +509,8 @@ private:
     // Helper function to get the ancestry chain of a class
     std::vector<std::string> getAncestry(const std::string& className) {
         std::vector<std::string> ancestry;
-        std::string currentClass = className;
-        while (!currentClass.empty() && currentClass != "NULL_PARENT" && classMap.count(currentClass)) {
-            ancestry.push_back(currentClass);
-            currentClass = classMap[currentClass]->parent;
-        }
+        for (ClassNode* cls = findClass(className); cls; cls = parentOf(cls))
+            ancestry.push_back(cls->name);
         return ancestry;
     }
 
@@ -337,15 +535,42 @@ private:
         return commonAncestor;
     }
 
-    bool isInArray(const std::string& str, const std::vector<std::string>& arr) {
-        return std::find(arr.begin(), arr.end(), str) != arr.end();
+    /**
+     * CheckFrame - An expression being checked, 'stage' being the number of times its
+     * step has run: each step checks the node up to its next sub-expression, if any
+     */
+    struct CheckFrame {
+        Expr* expr;
+        size_t stage;
+        MethodNode* method; // Call: the method called, once resolved
+    };
+
+    // Checks 'root' and its sub-expressions with an explicit stack of frames rather than
+    // by recursion, so that the depth of the program is only limited by the heap. The
+    // checks and error messages come in the same order as in a depth-first walk.
+    void checkExpression(Expr* root) {
+        std::vector<CheckFrame> frames{{root, 0, nullptr}};
+        while (!frames.empty()) {
+            Expr* next = checkStep(frames.back());
+            if (next)
+                frames.push_back({next, 0, nullptr});
+            else
+                frames.pop_back();
+        }
     }
 
-    void checkExpression(Expr* expr) {
+    // Runs the next step of 'frame'; returns the sub-expression to check before the next
+    // one, or nullptr when the expression is checked
+    Expr* checkStep(CheckFrame& frame) {
+        Expr* expr = frame.expr;
+        size_t stage = frame.stage++;
+
         // check operands are of the same type given operator .............. Done
         if (auto binOp = dynamic_cast<BinaryOperation*>(expr)) {
-            checkExpression(binOp->getLeft());
-            checkExpression(binOp->getRight());
+            if (stage == 0)
+                return binOp->getLeft();
+            if (stage == 1)
+                return binOp->getRight();
             std::string op = binOp->getOperator();
             std::string left_type = binOp->getLeft()->getTypeName();
             std::string right_type = binOp->getRight()->getTypeName();
@@ -380,27 +605,31 @@ private:
         }
         // same branches type and bool condition ........................... Done 
         else if (auto cond = dynamic_cast<Conditional*>(expr)) {
-            checkExpression(cond->getCond_expr());
-            checkExpression(cond->getThen_expr());
-            
-            // check condition is Bool type  .............................. Done
-            if (cond->getCond_expr()->getTypeName() != "bool") {
-                reportSemanticError("Condition must be of type bool.");
+            if (stage == 0)
+                return cond->getCond_expr();
+            if (stage == 1)
+                return cond->getThen_expr();
+            if (stage == 2) {
+                // check condition is Bool type  .......................... Done
+                if (cond->getCond_expr()->getTypeName() != "bool") {
+                    reportSemanticError("Condition must be of type bool.");
+                }
+                if (cond->getElse_expr())
+                    return cond->getElse_expr();
             }
 
             // Check both branches are of the same types .................. Done
             std::string then_type = cond->getThen_expr()->getTypeName();
             if (cond->getElse_expr()) {
-                checkExpression(cond->getElse_expr());
                 std::string else_type = cond->getElse_expr()->getTypeName();
 
                 if (then_type == "unit" || else_type == "unit"){
                     cond->setTypeByName("unit");
-                    return;
+                    return nullptr;
                 }else if (classMap.count(then_type) && classMap.count(else_type)) {
                     std::string first_ancestor = getMostCommonAncestor(then_type, else_type);
                     cond->setTypeByName(first_ancestor);
-                    return;
+                    return nullptr;
                 }else if (then_type != else_type) {
                     reportSemanticError("semantic error: then and else branches must be of the same return types.");
                 }
@@ -410,120 +639,35 @@ private:
         }
         // call method, verify recursively existence and signature ......... Done
         else if (auto call = dynamic_cast<Call*>(expr)) {
-
-            // verify if the called method exists in the class hierarchy .... Done
-            ClassNode* currentClass = nullptr;
-            MethodNode* method = nullptr;
-
             //calling a method inside the same class ==> self, omit checking class existance
-            checkExpression(call->getExprObjectIdentifier());
-            if (call->getClassName() == "self"){ //NOTE class_in_question is updated in 'checkClass'
-                for (const auto& mt : class_in_question->getMethods()) {
-                    if (mt->getName() == call->getMethodName()) {
-                        method = mt.get();
-                        break;
-                    }
-                }
-                if (!method) {
-                    reportSemanticError("method '" + call->getMethodName() 
-                        + "' not found in class hierarchy of 'self'.", call->getColumn(), call->getLine());
-                    return;
-                }
-                call->setTypeByName(method->getReturnType().getName());
-            
+            if (stage == 0)
+                return call->getExprObjectIdentifier();
+            if (stage == 1) {
+                frame.method = resolveCall(call);
+                if (!frame.method)
+                    return nullptr;
             } else {
-
-                currentClass = classMap[call->getClassName()]; // getClassName only possible if ExprObjIden is evaluated
-                while (currentClass) {
-                    for (auto &m : currentClass->getMethods()) {
-                        if (m->getName() == call->getMethodName()) {
-                            method = m.get();
-                            break;
-                        }
-                    }
-                    if (method)
-                        break;
-                    if (currentClass->parent.empty())
-                        break;
-                    if(currentClass->parent == "NULL_PARENT")
-                        break; //TODO problem is we use Object methods like print()...
-                    
-                    currentClass = classMap[currentClass->parent];
-                }
+                checkArgument(call, frame.method, stage - 2);
             }
-            
-            // verify if the method is a built-in method ..................... Done
-            std::unordered_map<std::string, std::string> ObjectMethods = {
-                {"print", "string"}, {"inputLine", "string"}, {"printInt32", "int32"},
-                {"printBool", "bool"}, {"inputBool", "bool"}, {"inputInt32", "int32"}
-            };
 
-            if (!method) {
-                reportSemanticError("method '" + call->getMethodName() 
-                      + "' not found in class hierarchy of '" + call->getClassName() + "'.", call->getColumn(), call->getLine());
-                return;
-            }
-
-            // && ObjectMethods.find(call->getMethodName()) == ObjectMethods.end()
-            // if (ObjectMethods.find(call->getMethodName()) != ObjectMethods.end()) {
-            //     if (call->getArgs().size() != 1) {
-            //         reportSemanticError("method '" + call->getMethodName() 
-            //         + "' expects 1 argument, but " + std::to_string(call->getArgs().size()) + " were provided.");
-            //         return;
-            //     }
-            //     checkExpression(call->getArgs()[0].get());
-            //     const std::string& expectedType = ObjectMethods[call->getMethodName()];
-            //     if (call->getArgs()[0]->getTypeName() != expectedType) {
-            //         reportSemanticError("method '" + call->getMethodName() 
-            //             + "' expects argument of type '" + expectedType + "', but got type '" + call->getArgs()[0]->getTypeName() + "'.");
-            //         return;
-            //     }
-            //     return;
-            // }
-            // verify the arguments match the method's signature ............. Done
-            const auto& formals = method->getFormals();
+            // the arguments, one per step
             const auto& args = call->getArgs();
+            if (stage - 1 < args.size())
+                return args[stage - 1].get();
 
-            if (formals.size() != args.size()) {
-                reportSemanticError("method '" + call->getMethodName() 
-                    + "' expects " + std::to_string(formals.size()) + " arguments, but " 
-                    + std::to_string(args.size()) + " were provided.");
-                return;
-            }
-
-            for (size_t i = 0; i < args.size(); ++i) {
-                checkExpression(args[i].get());
-                // Check if the argument type is a class
-                if (classMap.count(args[i]->getTypeName()) != 0) { // Check if the argument type is a class
-                    // Check if the argument type is a subclass of the formal parameter type
-                    if (getMostCommonAncestor(formals[i]->getTypeName(), args[i]->getTypeName()) != formals[i]->getTypeName()) {
-                        reportSemanticError("Argument in position " + std::to_string(i+1)  
-                            + " of method '" + call->getMethodName() 
-                            + "' expects type '" + formals[i]->getTypeName() 
-                            + "', but got type '" + args[i]->getTypeName() + "', the argument type must be a subclass of the formal parameter type.", call->getColumn(), call->getLine());
-                    }
-                } else { // Primitive types, compare directly
-                    if (formals[i]->getTypeName() != args[i]->getTypeName()) {
-                        reportSemanticError("Argument in position " + std::to_string(i+1)  
-                            + " of method '" + call->getMethodName() 
-                            + "' expects type '" + formals[i]->getTypeName() 
-                            + "', but got type '" + args[i]->getTypeName() + "'.");
-                    }
-                }
-            }
-
-            call->setTypeByName(method->getReturnType().getName());
+            call->setTypeByName(frame.method->getReturnType().getName());
         }
         // verify variable exists and the type of the assigned expression matches its type ....... Done
         else if (auto assign = dynamic_cast<Assign*>(expr)) {
-            checkExpression(assign->getExpr());
+            if (stage == 0)
+                return assign->getExpr();
             // verify if the variable exists ............................... Done
-            if (symb_tab.lookup(assign->getName()).empty()) {
+            if (lookup(assign->getName()).empty()) {
                 reportSemanticError("You must to declare the variable '"+ assign->getName()
                 + "' before assignment.");
             }
             // verify if the type of expression matches the variable type ... Done
-            std::string varType = symb_tab.lookup(assign->getName());
+            std::string varType = lookup(assign->getName());
             std::string exprType = assign->getExpr()->getTypeName();
 
             if (classMap.count(varType) != 0) { // Check if the variable type is a class
@@ -554,24 +698,27 @@ private:
 
         // check if condition epression returns bool ......................... Done
         else if (auto whileLoop = dynamic_cast<WhileLoop*>(expr)) {
-            // check if condition epression returns bool ..................... Done
-            checkExpression(whileLoop->getCond_expr());
-            if (whileLoop->getCond_expr()->getTypeName() != "bool") {
-                reportSemanticError("While loop condition must be of type bool.", whileLoop->getCond_expr()->getColumn(), whileLoop->getCond_expr()->getLine());
+            if (stage == 0)
+                return whileLoop->getCond_expr();
+            if (stage == 1) {
+                // check if condition epression returns bool ................. Done
+                if (whileLoop->getCond_expr()->getTypeName() != "bool") {
+                    reportSemanticError("While loop condition must be of type bool.", whileLoop->getCond_expr()->getColumn(), whileLoop->getCond_expr()->getLine());
+                }
+                return whileLoop->getBody_expr();
             }
-            checkExpression(whileLoop->getBody_expr());
             whileLoop->setTypeByName("unit"); //TODO always unit or the return type of last expr in block?
         }
         
         // just set the return type to thetype of the last expression ........ Done
         else if (auto block = dynamic_cast<Block*>(expr)) {
-            
-            symb_tab.enterScope();
+            if (stage == 0)
+                symb_tab.enterScope();
+
+            // the expressions, one per step
+            if (stage < block->getExprs().size())
+                return block->getExprs()[stage].get();
 
-            for (auto& innerExpr : block->getExprs()) {
-                checkExpression(innerExpr.get());
-                
-            }
             if (!block->getExprs().empty()) {
                 block->setTypeByName(block->getExprs().back()->getTypeName());
             } else {
@@ -584,17 +731,19 @@ private:
         
         //TODO see vsop manual for let .. in
         else if (auto let = dynamic_cast<Let*>(expr)) {
-
-            if(!isInArray(let->getType().getName(), {"int32", "bool", "string", "unit"}) 
-            && classMap.count(let->getType().getName()) == 0){
-                reportSemanticError("the type of let must be one of the following types: int32, bool, string, unit or a declared class.", let->getColumn(), let->getLine());
+            if (stage == 0) {
+                if(!isPrimitiveType(let->getType().getName())
+                && classMap.count(let->getType().getName()) == 0){
+                    reportSemanticError("the type of let must be one of the following types: int32, bool, string, unit or a declared class.", let->getColumn(), let->getLine());
+                }
+                //TODO determine in which on the scope
+                symb_tab.declare(let->getName(), let->getType().getName());
+                return let->getScopeExpr();
             }
-            //TODO determine in which on the scope
-            symb_tab.declare(let->getName(), let->getType().getName());
-            checkExpression(let->getScopeExpr());
             
             if (let->getInitExpr()) {
-                checkExpression(let->getInitExpr());
+                if (stage == 1)
+                    return let->getInitExpr();
                 if (let->getType().getName() != let->getInitExpr()->getTypeName()) {
                     if(classMap.count(let->getType().getName()) != 0){
                         if(getMostCommonAncestor(let->getType().getName(), let->getInitExpr()->getTypeName()) != let->getType().getName()){
@@ -617,7 +766,8 @@ private:
 
         // TODO 
         else if (auto unOp = dynamic_cast<UnOp*>(expr)) {
-            checkExpression(unOp->getExpr());
+            if (stage == 0)
+                return unOp->getExpr();
             if(unOp->getOp() == "isnull")
                 unOp->setTypeByName("bool");
             else if(unOp->getOp() == "-")
@@ -626,10 +776,9 @@ private:
                 unOp->setTypeByName(unOp->getExpr()->getTypeName());
             // Verify the type of the operand and set the result type
         }
-        
         // Verify if the object identifier is declared and set its type
         else if (auto objIden = dynamic_cast<ObjectIdentifier*>(expr)) {
-            std::string objType = symb_tab.lookup(objIden->getName());
+            std::string objType = lookup(objIden->getName());
             // std::cout << "objType ----------> "+objType<< std::endl;
             // std::cout << "obobjIden->getName()jType ----------> "+objIden->getName()<< std::endl;
             
@@ -662,9 +811,96 @@ private:
         else {
             reportSemanticError("Unknown expression type.");
         }
+        return nullptr;
+    }
+
+    // The method called by 'call', whose receiver is checked; nullptr (error reported)
+    // if there is none or the number of arguments does not match
+    MethodNode* resolveCall(Call* call) {
+        // verify if the called method exists in the class hierarchy .... Done
+        ClassNode* currentClass = nullptr;
+        MethodNode* method = nullptr;
+
+        if (call->getClassName() == "self"){ //NOTE class_in_question is updated in 'checkClass'
+            for (const auto& mt : class_in_question->getMethods()) {
+                if (mt->getName() == call->getMethodName()) {
+                    method = mt.get();
+                    break;
+                }
+            }
+            if (!method) {
+                reportSemanticError("method '" + call->getMethodName() 
+                    + "' not found in class hierarchy of 'self'.", call->getColumn(), call->getLine());
+                return nullptr;
+            }
+            call->setTypeByName(method->getReturnType().getName());
+        
+        } else {
+
+            currentClass = findClass(call->getClassName()); // getClassName only possible if ExprObjIden is evaluated
+            while (currentClass) {
+                for (auto &m : currentClass->getMethods()) {
+                    if (m->getName() == call->getMethodName()) {
+                        method = m.get();
+                        break;
+                    }
+                }
+                if (method)
+                    break;
+                currentClass = parentOf(currentClass); //TODO problem is we use Object methods like print()...
+            }
+        }
+        
+        // the built-in methods are those of Object, found in the hierarchy as any other
+        if (!method) {
+            reportSemanticError("method '" + call->getMethodName() 
+                  + "' not found in class hierarchy of '" + call->getClassName() + "'.", call->getColumn(), call->getLine());
+            return nullptr;
+        }
+
+        // verify the arguments match the method's signature ............. Done
+        const auto& formals = method->getFormals();
+        const auto& args = call->getArgs();
+
+        if (formals.size() != args.size()) {
+            reportSemanticError("method '" + call->getMethodName() 
+                + "' expects " + std::to_string(formals.size()) + " arguments, but " 
+                + std::to_string(args.size()) + " were provided.");
+            return nullptr;
+        }
+        return method;
+
+    }
+
+    // Compares the type of the checked argument 'i' of 'call' with the formal of 'method'
+    void checkArgument(Call* call, MethodNode* method, size_t i) {
+        const auto& formals = method->getFormals();
+        const auto& args = call->getArgs();
+        // Check if the argument type is a class
+        if (classMap.count(args[i]->getTypeName()) != 0) { // Check if the argument type is a class
+            // Check if the argument type is a subclass of the formal parameter type
+            if (getMostCommonAncestor(formals[i]->getTypeName(), args[i]->getTypeName()) != formals[i]->getTypeName()) {
+                reportSemanticError("Argument in position " + std::to_string(i+1)  
+                    + " of method '" + call->getMethodName() 
+                    + "' expects type '" + formals[i]->getTypeName() 
+                    + "', but got type '" + args[i]->getTypeName() + "', the argument type must be a subclass of the formal parameter type.", call->getColumn(), call->getLine());
+            }
+        } else { // Primitive types, compare directly
+            if (formals[i]->getTypeName() != args[i]->getTypeName()) {
+                reportSemanticError("Argument in position " + std::to_string(i+1)  
+                    + " of method '" + call->getMethodName() 
+                    + "' expects type '" + formals[i]->getTypeName() 
+                    + "', but got type '" + args[i]->getTypeName() + "'.");
+            }
+        }
     }
 
     void reportSemanticError(std::string message,  unsigned int column=0, unsigned int line=0) {
+        if (report) {
+            report(line, column, "semantic error: " + message);
+            isAccepted = false;
+            return;
+        }
         std::cerr << fileName << ":" << line << ":" << column 
                   << ": semantic error: "<< message << std::endl;
         isAccepted = false;
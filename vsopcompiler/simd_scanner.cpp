@@ -0,0 +1,573 @@
+#ifndef SIMD_SCANNER_CPP
+#define SIMD_SCANNER_CPP
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Hand-written scanner (--lexer=simd), included by lexer.l: yylex() hands its calls to
+// simdScanner.next() when simd_scanner_mode is set.
+//
+// It reads the whole input at once and skips whitespace, the bodies of comments and the
+// plain runs of string literals a block at a time: 32 bytes with AVX2 (-mavx2), 16 with
+// SSE2, one byte at a time elsewhere. Keywords are found through a perfect hash of their
+// length, first and last characters.
+//
+// The tokens, semantic values, yylloc, yyline and yycolumn, the -l lines and the errors
+// are those of the rules of lexer.l, longest match included, with their quirks:
+//   - a '//' comment sets yycolumn to 1, and a line continuation in a string to yyleng - 1;
+//   - a run of whitespace in a string becomes one space;
+//   - in a comment, '"*"+[^)]' eats the character after a run of stars, even a newline
+//     (the line is not counted) or the '(' of a nested comment, and a run of two stars or
+//     more before ')' does not close the comment;
+//   - a lone '*' just before the end of a comment is echoed on stdout (flex's default rule);
+//   - a NUL byte is a character like any other, but it ends yytext for the actions (a
+//     string literal drops it);
+//   - std::stoi throws on literals that do not fit in an int32.
+// The -l lines are buffered, and written before any error message and at the end.
+
+class SimdScanner {
+public:
+    // Next token, as yylex(); 0 at the end of the input, after which the next call reads
+    // yyin again from its current position (as flex's scanner, so that rewind(yyin) works)
+    int next() {
+        if (!loaded)
+            read();
+        const char* p = cursor;
+        unsigned line = yyline, column = yycolumn;
+        auto done = [&](int token) {
+            cursor = p;
+            yyline = line;
+            yycolumn = column;
+            yyoffset = base + (p - input.data());
+            return token;
+        };
+
+        for (;;) {
+            const char* start = p;
+            switch (*p) {
+            case '\n':
+                ++line;
+                column = 1;
+                ++p;
+                break;
+            case ' ': case '\t': case '\f': case '\r':
+                p = find<SpaceEnd>(p);
+                column += p - start;
+                break;
+            case '\0':
+                if (p != end)
+                    return done(unknownCharacter(p, line, column));
+                loaded = false;
+                flushOutput();
+                return done(0);
+            case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i':
+            case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p': case 'q': case 'r':
+            case 's': case 't': case 'u': case 'v': case 'w': case 'x': case 'y': case 'z': {
+                p = identifierEnd(p + 1);
+                size_t length = p - start;
+                if (const Keyword* keyword = findKeyword(start, length)) {
+                    if (lexer_debug_mode)
+                        printLine(line, column, keyword->text);
+                    yylloc.first_line = line;
+                    yylloc.first_column = column;
+                    column += length;
+                    return done(keyword->token);
+                }
+                if (lexer_debug_mode)
+                    printLine(line, column, "object-identifier", start, length);
+                yylval.loc.str = strndup(start, length);
+                yylval.loc.line = line;
+                yylval.loc.column = column;
+                column += length;
+                return done(OBJECT_IDENTIFIER);
+            }
+            case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': case 'H': case 'I':
+            case 'J': case 'K': case 'L': case 'M': case 'N': case 'O': case 'P': case 'Q': case 'R':
+            case 'S': case 'T': case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z':
+                p = identifierEnd(p + 1);
+                if (lexer_debug_mode)
+                    printLine(line, column, "type-identifier", start, p - start);
+                yylval.str = strndup(start, p - start);
+                yylval.loc.line = line;
+                yylval.loc.column = column;
+                column += p - start;
+                return done(TYPE_IDENTIFIER);
+            case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8':
+            case '9': {
+                // {INTEGER_LITERAL_DIGITS}, {INTEGER_LITERAL_HEX} or, if longer, {INTEGER_LITERAL_HEX_ERROR}
+                while (isDigit(*p))
+                    ++p;
+                const char* hexEnd = nullptr;
+                if (p == start + 1 && *start == '0' && p[0] == 'x' && isHexDigit(p[1])) {
+                    hexEnd = p + 2;
+                    while (isHexDigit(*hexEnd))
+                        ++hexEnd;
+                }
+                if (isLetter(*p)) {
+                    const char* wrongEnd = identifierEnd(p + 1);
+                    if (wrongEnd != hexEnd) {
+                        p = wrongEnd;
+                        return done(error("Integral Literal Hexa Error !",
+                                          std::string(start, p - start) + "Integral Literal Hexa Error !", line, column));
+                    }
+                    p = hexEnd;
+                }
+                std::string text(start, p - start);
+                if (lexer_debug_mode && text.size() > 9)
+                    flushOutput(); // std::stoi may throw: the lines before are printed
+                yylval.num = std::stoi(text, nullptr, hexEnd ? 16 : 10);
+                if (lexer_debug_mode)
+                    printNumber(line, column, yylval.num);
+                column += p - start;
+                return done(NUMBER);
+            }
+            case '"':
+                return done(stringLiteral(p, line, column));
+            case '/':
+                if (p[1] != '/')
+                    return done(operatorToken(p, 1, line, column));
+                // '//' comment: up to the end of the line, NUL bytes included
+                p = find<LineEnd>(p + 2);
+                while (*p == '\0' && p != end)
+                    p = find<LineEnd>(p + 1);
+                column = 1;
+                break;
+            case '(':
+                if (p[1] != '*')
+                    return done(operatorToken(p, 1, line, column));
+                if (int token = comment(p, line, column))
+                    return done(token);
+                break;
+            case '*':
+                if (p[1] == ')')
+                    return done(error("Unexpected closing comment", "Unexpected closing comment", line, column));
+                return done(operatorToken(p, 1, line, column));
+            case '<':
+                return done(operatorToken(p, p[1] == '-' || p[1] == '=' ? 2 : 1, line, column));
+            case '{': case '}': case ')': case ':': case ';': case ',': case '+': case '-': case '^': case '.':
+            case '=':
+                return done(operatorToken(p, 1, line, column));
+            default:
+                return done(unknownCharacter(p, line, column));
+            }
+        }
+    }
+
+    // Scans 'text' next, which is at 'offset' in the input (a method body parsed on demand)
+    void restart(const char* text, size_t length, size_t offset) {
+        input.assign(text, length);
+        input.append(blockSize + 1, '\0');
+        cursor = input.data();
+        end = cursor + length;
+        base = offset;
+        loaded = true;
+        openings.clear();
+    }
+
+private:
+    struct Keyword {
+        const char* text;
+        int token;
+    };
+
+#if defined(__AVX2__)
+#define SIMD_SCANNER_BLOCKS
+    typedef __m256i Block;
+    static constexpr size_t blockSize = 32;
+    static Block load(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static Block equal(Block block, char c) { return _mm256_cmpeq_epi8(block, _mm256_set1_epi8(c)); }
+    static Block either(Block a, Block b) { return _mm256_or_si256(a, b); }
+    static unsigned mask(Block block) { return unsigned(_mm256_movemask_epi8(block)); }
+#elif defined(__SSE2__)
+#define SIMD_SCANNER_BLOCKS
+    typedef __m128i Block;
+    static constexpr size_t blockSize = 16;
+    static Block load(const char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static Block equal(Block block, char c) { return _mm_cmpeq_epi8(block, _mm_set1_epi8(c)); }
+    static Block either(Block a, Block b) { return _mm_or_si128(a, b); }
+    static unsigned mask(Block block) { return unsigned(_mm_movemask_epi8(block)); }
+#else
+    static constexpr size_t blockSize = 1;
+#endif
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\f' || c == '\r'; }
+
+#ifdef SIMD_SCANNER_BLOCKS
+    static Block spaces(Block block) {
+        return either(either(equal(block, ' '), equal(block, '\t')), either(equal(block, '\f'), equal(block, '\r')));
+    }
+#endif
+
+    // Sets of bytes where find() stops: stop(c) for one byte, in(p) for the block at p (bit i
+    // set if p[i] is in the set). All stop at the NUL which ends the input.
+    struct SpaceEnd {
+        static bool stop(char c) { return !isSpace(c); }
+#ifdef SIMD_SCANNER_BLOCKS
+        static unsigned in(const char* p) { return ~mask(spaces(load(p))) & allBits; }
+#endif
+    };
+    struct LineEnd {
+        static bool stop(char c) { return c == '\n' || c == '\0'; }
+#ifdef SIMD_SCANNER_BLOCKS
+        static unsigned in(const char* p) {
+            Block block = load(p);
+            return mask(either(equal(block, '\n'), equal(block, '\0')));
+        }
+#endif
+    };
+    struct CommentStop {
+        static bool stop(char c) { return c == '\n' || c == '(' || c == '*' || c == '\0'; }
+#ifdef SIMD_SCANNER_BLOCKS
+        static unsigned in(const char* p) {
+            Block block = load(p);
+            return mask(either(either(equal(block, '\n'), equal(block, '(')), either(equal(block, '*'), equal(block, '\0'))));
+        }
+#endif
+    };
+    struct StringStop {
+        static bool stop(char c) { return c == '"' || c == '\\' || c == '\n' || c == '\0' || isSpace(c); }
+#ifdef SIMD_SCANNER_BLOCKS
+        static unsigned in(const char* p) {
+            Block block = load(p);
+            Block special = either(either(equal(block, '"'), equal(block, '\\')), either(equal(block, '\n'), equal(block, '\0')));
+            return mask(either(special, spaces(block)));
+        }
+#endif
+    };
+
+#ifdef SIMD_SCANNER_BLOCKS
+    static constexpr unsigned allBits = blockSize == 32 ? 0xffffffffu : 0xffffu;
+#endif
+
+    // First byte from p in the set of Stop; the padding after the input keeps the blocks
+    // read inside the buffer
+    template <typename Stop> static const char* find(const char* p) {
+#ifdef SIMD_SCANNER_BLOCKS
+        for (;; p += blockSize)
+            if (unsigned found = Stop::in(p))
+                return p + __builtin_ctz(found);
+#else
+        while (!Stop::stop(*p))
+            ++p;
+        return p;
+#endif
+    }
+
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+    static bool isLetter(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+    static bool isHexDigit(char c) { return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+
+    static const char* identifierEnd(const char* p) {
+        while (isLetter(*p) || isDigit(*p) || *p == '_')
+            ++p;
+        return p;
+    }
+
+    // The keywords of lexer.l, in the slots of their perfect hash
+    static unsigned keywordHash(const char* text, size_t length) {
+        return (2 * length + 12 * (unsigned char)text[0] + 5 * (unsigned char)text[length - 1]) & 31;
+    }
+    static const Keyword* findKeyword(const char* text, size_t length) {
+        static const std::vector<Keyword> slots = [] {
+            const Keyword keywords[] = {
+                {"class", CLASS}, {"extends", EXTENDS}, {"if", IF}, {"then", THEN}, {"else", ELSE},
+                {"while", WHILE}, {"do", DO}, {"let", LET}, {"in", IN}, {"new", NEW}, {"not", NOT},
+                {"true", TRUE_TYPE}, {"false", FALSE_TYPE}, {"self", SELF}, {"unit", UNIT}, {"bool", BOOL},
+                {"int32", INT32}, {"and", AND}, {"isnull", ISNULL}, {"string", STRING}};
+            std::vector<Keyword> table(32, Keyword{nullptr, 0});
+            for (const Keyword& keyword : keywords)
+                table[keywordHash(keyword.text, strlen(keyword.text))] = keyword;
+            return table;
+        }();
+        if (length < 2 || length > 7)
+            return nullptr;
+        const Keyword& slot = slots[keywordHash(text, length)];
+        if (!slot.text || strncmp(slot.text, text, length) != 0 || slot.text[length] != '\0')
+            return nullptr;
+        return &slot;
+    }
+
+    int operatorToken(const char*& p, size_t length, unsigned line, unsigned& column) {
+        int token;
+        const char* name;
+        switch (length == 2 ? p[1] : p[0]) {
+        case '{': token = LBRACE; name = "lbrace"; break;
+        case '}': token = RBRACE; name = "rbrace"; break;
+        case '(': token = LPAR; name = "lpar"; break;
+        case ')': token = RPAR; name = "rpar"; break;
+        case ':': token = COLON; name = "colon"; break;
+        case ';': token = SEMICOLON; name = "semicolon"; break;
+        case ',': token = COMMA; name = "comma"; break;
+        case '+': token = PLUS; name = "plus"; break;
+        case '-': token = length == 2 ? ASSIGN : MINUS; name = length == 2 ? "assign" : "minus"; break;
+        case '*': token = TIMES; name = "times"; break;
+        case '/': token = DIV; name = "div"; break;
+        case '^': token = POW; name = "pow"; break;
+        case '.': token = DOT; name = "dot"; break;
+        case '=': token = length == 2 ? LOWER_EQUAL : EQUAL; name = length == 2 ? "lower-equal" : "equal"; break;
+        default: token = LOWER; name = "lower"; break;
+        }
+        if (lexer_debug_mode)
+            printLine(line, column, name);
+        column += length;
+        p += length;
+        return token;
+    }
+
+    // A string literal, from its opening quote: STR, or ERROR. Its text is not copied: the
+    // token gives its offset and length in the input (only -l prints it, as lexer.l does)
+    int stringLiteral(const char*& p, unsigned& line, unsigned& column) {
+        unsigned startLine = line, startColumn = column;
+        if (lexer_debug_mode) {
+            printPosition(line, column);
+            output += "string-literal,\"";
+        }
+        ++column;
+        ++p;
+        const char* text = p;
+        bool escapes = false;
+        auto print = [&](const char* printed, size_t length) {
+            if (lexer_debug_mode)
+                output.append(printed, length);
+        };
+        for (;;) {
+            const char* run = p;
+            p = find<StringStop>(p);
+            print(run, p - run);
+            column += p - run;
+            switch (*p) {
+            case '"':
+                print("\"\n", 2);
+                yylval.literal.offset = base + (text - input.data());
+                yylval.literal.length = p - text;
+                yylval.literal.escapes = escapes;
+                ++column;
+                ++p;
+                return STR;
+            case '\n':
+                return error("character '\\n' is illegal in this context !",
+                             "character '\\n' is illegal in this context.", line, column);
+            case '\0':
+                if (p == end)
+                    return error("Unterminated string.", "Unterminated string.", startLine, startColumn);
+                escapes = true; // the string does not keep it: yytext ends at the NUL
+                ++column;
+                ++p;
+                break;
+            case '\\': {
+                if (p + 1 == end) { // the '.' rule, then the end of the input
+                    print(p, 1);
+                    ++column;
+                    ++p;
+                    break;
+                }
+                escapes = true;
+                const char* printed;
+                switch (p[1]) {
+                case '"': printed = "\\x22"; break;
+                case 'b': printed = "\\x08"; break;
+                case 't': printed = "\\x09"; break;
+                case 'n': printed = "\\x0a"; break;
+                case 'r': printed = "\\x0d"; break;
+                case '\\': printed = "\\x5c"; break;
+                case '\n': {
+                    // line continuation, and the indentation of the next line
+                    const char* next = find<SpaceEnd>(p + 2);
+                    ++line;
+                    column = next - p - 1;
+                    p = next;
+                    continue;
+                }
+                case 'x':
+                    if (isHexDigit(p[2]) && isHexDigit(p[3])) {
+                        print(p, 4);
+                        column += 4;
+                        p += 4;
+                        continue;
+                    }
+                    return error("", "", line, column);
+                default:
+                    return error("", "", line, column);
+                }
+                print(printed, 4);
+                column += 2;
+                p += 2;
+                break;
+            }
+            default: {
+                // whitespace: one space for the whole run
+                const char* spacesEnd = find<SpaceEnd>(p);
+                if (spacesEnd - p > 1 || *p != ' ')
+                    escapes = true;
+                print(" ", 1);
+                column += spacesEnd - p;
+                p = spacesEnd;
+                break;
+            }
+            }
+        }
+    }
+
+    // A comment, from its '(*': 0 once closed, or ERROR
+    int comment(const char*& p, unsigned& line, unsigned& column) {
+        openings.clear();
+        openings.emplace_back(line, column);
+        column += 2;
+        p += 2;
+        while (!openings.empty()) {
+            const char* run = p;
+            p = find<CommentStop>(p);
+            column += p - run;
+            switch (*p) {
+            case '\n':
+                ++line;
+                column = 1;
+                ++p;
+                break;
+            case '(':
+                if (p[1] == '*') {
+                    openings.emplace_back(line, column);
+                    column += 2;
+                    p += 2;
+                }
+                else {
+                    ++column;
+                    ++p;
+                }
+                break;
+            case '*': {
+                const char* stars = p;
+                while (*p == '*')
+                    ++p;
+                size_t count = p - stars;
+                if (p == end) {
+                    if (count > 1)
+                        column += count;
+                    else
+                        echo('*');
+                }
+                else if (*p != ')') {
+                    column += count + 1;
+                    ++p;
+                }
+                else if (count == 1) {
+                    openings.pop_back();
+                    column += 2;
+                    ++p;
+                }
+                else
+                    column += count; // the last star is the [^)] of '"*"+[^)]': ')' stays
+                break;
+            }
+            default:
+                if (p == end)
+                    return error("Unterminated Comment", "Unterminated Comment", openings.back().first,
+                                 openings.back().second);
+                ++column;
+                ++p;
+            }
+        }
+        return 0;
+    }
+
+    int unknownCharacter(const char*& p, unsigned line, unsigned column) {
+        const char character[2] = {*p, '\0'};
+        ++p;
+        return error("Unknown character", character + std::string("Unknown character "), line, column);
+    }
+
+    // As the error rules of lexer.l: the position in yylval, then ERROR or, with -l, the message and exit
+    int error(const char* message, const std::string& debugMessage, unsigned line, unsigned column) {
+        yylval.error_location.line_error = line;
+        yylval.error_location.column_error = column;
+        error_message = strdup(message);
+        if (!lexer_debug_mode)
+            return ERROR;
+        flushOutput();
+        reportLexicalError(debugMessage, line, column);
+        return ERROR;
+    }
+
+    void read() {
+        input.clear();
+        base = 0;
+        struct stat inputStat;
+        if (fstat(fileno(yyin), &inputStat) == 0 && inputStat.st_size > ftell(yyin))
+            input.reserve(inputStat.st_size - ftell(yyin) + blockSize + 1);
+        char chunk[1 << 16];
+        size_t count;
+        while ((count = fread(chunk, 1, sizeof(chunk), yyin)) > 0)
+            input.append(chunk, count);
+        size_t size = input.size();
+        input.append(blockSize + 1, '\0'); // the NUL which ends the input, then the padding
+        cursor = input.data();
+        end = cursor + size;
+        loaded = true;
+    }
+
+    // -l output
+    void printPosition(unsigned line, unsigned column) {
+        char digits[24];
+        output.append(digits, std::to_chars(digits, digits + sizeof(digits), line).ptr);
+        output += ',';
+        output.append(digits, std::to_chars(digits, digits + sizeof(digits), column).ptr);
+        output += ',';
+    }
+    void printLine(unsigned line, unsigned column, const char* name) {
+        printPosition(line, column);
+        output += name;
+        endLine();
+    }
+    void printLine(unsigned line, unsigned column, const char* name, const char* value, size_t length) {
+        printPosition(line, column);
+        output += name;
+        output += ',';
+        output.append(value, length);
+        endLine();
+    }
+    void printNumber(unsigned line, unsigned column, int value) {
+        char digits[16];
+        printPosition(line, column);
+        output += "integer-literal,";
+        output.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+        endLine();
+    }
+    void endLine() {
+        output += '\n';
+        if (output.size() >= (1 << 16))
+            flushOutput();
+    }
+    void flushOutput() {
+        if (!output.empty()) {
+            std::cout.write(output.data(), output.size()).flush();
+            output.clear();
+        }
+    }
+    void echo(char c) {
+        flushOutput();
+        fwrite(&c, 1, 1, stdout);
+    }
+
+    std::string input;
+    const char* cursor = nullptr;
+    const char* end = nullptr;
+    size_t base = 0; // offset of 'input' in the program text, after restart()
+    bool loaded = false;
+    std::vector<std::pair<unsigned, unsigned>> openings; // (line, column) of the open comments
+    std::string output;
+};
+
+SimdScanner simdScanner;
+
+#endif
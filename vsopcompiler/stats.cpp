@@ -0,0 +1,317 @@
+#ifndef STATS_CPP
+#define STATS_CPP
+
+#include "AST.hpp"
+
+#include <iostream>
+#include <cstring>
+
+// Compiler statistics: --time-passes and --stats, built in with -DVSOP_STATS (make STATS=1).
+//
+// --time-passes reports, for each phase of main() (input preparation, the first lexing
+// pass, yyparse, semantic analysis, each optimization pass, printing, execution), its wall
+// and CPU time, the allocations made during it (count and bytes, through a counting global
+// operator new) and the peak RSS at its end. --stats reports the number of AST nodes of
+// each kind after parsing (Object's included), the allocations of the whole run and its
+// peak RSS. With '=json' the report is a single JSON object instead of tables. Reports are
+// written on stderr at exit, also when compilation fails.
+//
+// A phase is the scope of a VSOP_PHASE, or runs from VSOP_PHASE_BEGIN to VSOP_PHASE_END.
+// Without VSOP_STATS, these macros and VSOP_COUNT_NODES expand to nothing, operator new is
+// the library's and the options are rejected: nothing is left in the compiler.
+
+#ifdef VSOP_STATS
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include <cstdint>
+#include <typeinfo>
+#include <ctime>
+#include <cxxabi.h>
+#include <sys/resource.h>
+
+/* ======================== Allocation counting ======================== */
+
+// atomic: the threads of ProgramEmitter allocate too
+static std::atomic<uint64_t> allocationCount{0};
+static std::atomic<uint64_t> allocationBytes{0};
+
+static void* countedAllocation(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new(std::size_t size) { return countedAllocation(size); }
+void* operator new[](std::size_t size) { return countedAllocation(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+
+/**
+ * CompilerStats - Phases of the run and AST node counts, reported at exit
+ */
+class CompilerStats {
+public:
+    bool timePasses = false;
+    bool nodeStats = false;
+    bool json = false;
+
+    /**
+     * Phase - Measures the scope it is declared in as the phase 'name'
+     */
+    class Phase {
+    public:
+        explicit Phase(const char* name) : index(instance().begin(name)) {}
+        ~Phase() { finish(); }
+        void finish() { instance().end(index); }
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+
+    private:
+        size_t index;
+    };
+
+    static CompilerStats& instance() {
+        static CompilerStats stats;
+        return stats;
+    }
+
+    // --time-passes[=json] or --stats[=json]; false if the option is malformed
+    bool enable(const char* option) {
+        const char* value = std::strchr(option, '=');
+        std::string name = value ? std::string(option, value - option) : std::string(option);
+        if (value && std::strcmp(value + 1, "json") != 0)
+            return false;
+        if (name == "--time-passes")
+            timePasses = true;
+        else if (name == "--stats")
+            nodeStats = true;
+        else
+            return false;
+        json = json || value;
+        if (!registered) {
+            registered = true;
+            start = now();
+            startCpu = cpuMilliseconds();
+            std::atexit([] { instance().report(std::cerr); });
+        }
+        return true;
+    }
+
+    void countNodes(ASTNode* root) {
+        if (!nodeStats || !root)
+            return;
+        nodes.clear();
+        auto* program = static_cast<Program*>(root);
+        nodes["Program"]++;
+        for (auto& cls : program->getClasses()) {
+            nodes["ClassNode"]++;
+            for (auto& field : cls->getFields()) {
+                nodes["FieldNode"]++;
+                if (field->getInitExpr())
+                    countExpr(field->getInitExpr().get());
+            }
+            for (auto& method : cls->getMethods()) {
+                nodes["MethodNode"]++;
+                for (auto& formal : method->getFormals())
+                    countExpr(formal.get());
+                if (method->getParsedBlock()) // a body left for later is not counted (nor parsed)
+                    countExpr(method->getParsedBlock());
+            }
+        }
+    }
+
+private:
+    struct Sample {
+        double wall;            // ms since start
+        double cpu;             // ms of CPU time since start
+        uint64_t allocations;
+        uint64_t bytes;
+    };
+
+    struct PhaseRecord {
+        std::string name;
+        size_t depth;
+        Sample begin;
+        Sample end;
+        long peakRssKb = 0;
+        bool finished = false;
+    };
+
+    bool registered = false;
+    std::chrono::steady_clock::time_point start;
+    double startCpu = 0;
+    std::vector<PhaseRecord> phases;        // in starting order
+    std::vector<size_t> open;               // indices of the phases not finished yet
+    std::map<std::string, uint64_t> nodes;
+
+    static std::chrono::steady_clock::time_point now() { return std::chrono::steady_clock::now(); }
+
+    static long peakRssKb() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    static double cpuMilliseconds() {
+        timespec cpu;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+        return cpu.tv_sec * 1e3 + cpu.tv_nsec / 1e6;
+    }
+
+    Sample sample() const {
+        return {std::chrono::duration<double, std::milli>(now() - start).count(), cpuMilliseconds() - startCpu,
+                allocationCount, allocationBytes};
+    }
+
+    size_t begin(const char* name) {
+        if (!registered)
+            return SIZE_MAX;
+        phases.push_back({name, open.size(), sample(), {}});
+        open.push_back(phases.size() - 1);
+        return phases.size() - 1;
+    }
+
+    void end(size_t index) {
+        if (index == SIZE_MAX || phases[index].finished)
+            return;
+        phases[index].end = sample();
+        phases[index].peakRssKb = peakRssKb();
+        phases[index].finished = true;
+        while (!open.empty() && open.back() >= index)
+            open.pop_back();
+    }
+
+    void countExpr(Expr* expr) {
+        forEachExpr(expr, [&](Expr* e) {
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(typeid(*e).name(), nullptr, nullptr, &status);
+            nodes[status == 0 ? demangled : typeid(*e).name()]++;
+            std::free(demangled);
+        });
+    }
+
+    static std::string milliseconds(double value) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.3f", value);
+        return text;
+    }
+
+    // Phases cut short by exit() end now
+    void report(std::ostream& out) {
+        while (!open.empty())
+            end(open.back());
+        Sample total = sample();
+        long peak = peakRssKb();
+
+        if (json) {
+            out << "{";
+            const char* separator = "";
+            if (timePasses) {
+                out << "\"phases\": [";
+                for (size_t i = 0; i < phases.size(); ++i) {
+                    const PhaseRecord& phase = phases[i];
+                    out << (i ? ", " : "") << "{\"name\": \"" << phase.name << "\", \"depth\": " << phase.depth
+                        << ", \"wall_ms\": " << milliseconds(phase.end.wall - phase.begin.wall)
+                        << ", \"cpu_ms\": " << milliseconds(phase.end.cpu - phase.begin.cpu)
+                        << ", \"allocations\": " << phase.end.allocations - phase.begin.allocations
+                        << ", \"allocated_bytes\": " << phase.end.bytes - phase.begin.bytes
+                        << ", \"peak_rss_kb\": " << phase.peakRssKb << "}";
+                }
+                out << "]";
+                separator = ", ";
+            }
+            if (nodeStats) {
+                out << separator << "\"nodes\": {";
+                const char* nodeSeparator = "";
+                for (auto& [kind, count] : nodes) {
+                    out << nodeSeparator << "\"" << kind << "\": " << count;
+                    nodeSeparator = ", ";
+                }
+                out << "}";
+                separator = ", ";
+            }
+            out << separator << "\"total\": {\"wall_ms\": " << milliseconds(total.wall) << ", \"cpu_ms\": "
+                << milliseconds(total.cpu) << ", \"allocations\": " << total.allocations
+                << ", \"allocated_bytes\": " << total.bytes << ", \"peak_rss_kb\": " << peak << "}}" << std::endl;
+            return;
+        }
+
+        char line[160];
+        if (timePasses) {
+            out << "===== phases =====\n";
+            std::snprintf(line, sizeof(line), "%-28s %12s %12s %12s %14s %14s\n",
+                          "phase", "wall (ms)", "cpu (ms)", "allocations", "bytes", "peak RSS (KB)");
+            out << line;
+            for (const PhaseRecord& phase : phases) {
+                std::string name = std::string(2 * phase.depth, ' ') + phase.name;
+                std::snprintf(line, sizeof(line), "%-28s %12.3f %12.3f %12llu %14llu %14ld\n", name.c_str(),
+                              phase.end.wall - phase.begin.wall, phase.end.cpu - phase.begin.cpu,
+                              (unsigned long long) (phase.end.allocations - phase.begin.allocations),
+                              (unsigned long long) (phase.end.bytes - phase.begin.bytes), phase.peakRssKb);
+                out << line;
+            }
+            std::snprintf(line, sizeof(line), "%-28s %12.3f %12.3f %12llu %14llu %14ld\n", "total", total.wall,
+                          total.cpu, (unsigned long long) total.allocations, (unsigned long long) total.bytes, peak);
+            out << line;
+        }
+        if (nodeStats) {
+            uint64_t count = 0;
+            out << "===== AST nodes =====\n";
+            for (auto& [kind, kindCount] : nodes) {
+                std::snprintf(line, sizeof(line), "%-28s %12llu\n", kind.c_str(), (unsigned long long) kindCount);
+                out << line;
+                count += kindCount;
+            }
+            std::snprintf(line, sizeof(line), "%-28s %12llu\n", "total", (unsigned long long) count);
+            out << line;
+            out << "===== memory =====\n";
+            std::snprintf(line, sizeof(line), "%-28s %12llu\n%-28s %12llu\n%-28s %12ld\n",
+                          "allocations", (unsigned long long) total.allocations,
+                          "allocated bytes", (unsigned long long) total.bytes, "peak RSS (KB)", peak);
+            out << line;
+        }
+        out.flush();
+    }
+};
+
+#define VSOP_PHASE_NAME2(line) vsopPhase##line
+#define VSOP_PHASE_NAME(line) VSOP_PHASE_NAME2(line)
+#define VSOP_PHASE(name) CompilerStats::Phase VSOP_PHASE_NAME(__LINE__){name}
+#define VSOP_PHASE_BEGIN(id, name) CompilerStats::Phase id{name}
+#define VSOP_PHASE_END(id) id.finish()
+#define VSOP_COUNT_NODES(root) CompilerStats::instance().countNodes(root)
+
+inline bool enableStats(const char* option) {
+    if (CompilerStats::instance().enable(option))
+        return true;
+    std::cerr << "Error: unknown option " << option << " (--time-passes[=json], --stats[=json])" << std::endl;
+    return false;
+}
+
+#else
+
+#define VSOP_PHASE(name)
+#define VSOP_PHASE_BEGIN(id, name)
+#define VSOP_PHASE_END(id)
+#define VSOP_COUNT_NODES(root)
+
+inline bool enableStats(const char* option) {
+    std::cerr << "Error: " << option << " needs a compiler built with statistics (make STATS=1)" << std::endl;
+    return false;
+}
+
+#endif
+
+#endif
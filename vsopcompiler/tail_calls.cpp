@@ -0,0 +1,315 @@
+#include "AST.hpp"
+#include "effects.cpp"
+
+#include <unordered_set>
+#include <string>
+#include <vector>
+
+// Tail-call elimination for self-recursive methods.
+//
+// A call is eliminated when it is in tail position (last expression of the method
+// block, through blocks, both branches of 'if' and the scope of 'let') and calls the
+// method itself on 'self', with no override in a subclass (so the call cannot dispatch
+// elsewhere). The method body is rewritten into a loop:
+//
+//     let _tcloop : bool <- true in let _tcresult : T in {
+//         while _tcloop do { _tcloop <- false; _tcresult <- <body> };
+//         _tcresult
+//     }
+//
+// where each eliminated call assigns the new arguments to the formals and sets _tcloop.
+// For int32 methods, a call that is an operand of '+', '-' or '*' in tail position (as in
+// 'n * fact(n - 1)') is eliminated too: the pending operations are kept in an accumulator
+// _tcmul * r + _tcadd, exact with wrap-around arithmetic. The recursion depth then no
+// longer depends on the input. Must run after SemanticAnalyzer::analyze.
+
+class TailCallEliminator {
+public:
+    void run(Program* program) {
+        effects.run(program);
+
+        for (auto& cls : program->getClasses()) {
+            if (cls->name == "Object")
+                continue;
+            for (auto& method : cls->getMethods())
+                eliminate(cls.get(), method.get());
+        }
+    }
+
+    // Statistics of the last run
+    size_t eliminatedCalls = 0;
+    size_t rewrittenMethods = 0;
+
+private:
+    EffectAnalyzer effects;
+    ClassNode* currentClass = nullptr;
+    MethodNode* currentMethod = nullptr;
+    std::unordered_set<std::string> formalNames;
+    bool usesAccumulator = false;
+    unsigned int tempCounter = 0;
+
+    std::string newTemp(const std::string& prefix) {
+        return "_" + prefix + std::to_string(tempCounter++);
+    }
+
+    static std::unique_ptr<Expr> makeIdentifier(const std::string& name, const std::string& type) {
+        auto identifier = std::make_unique<ObjectIdentifier>(name, 0, 0);
+        identifier->setTypeByName(type);
+        return identifier;
+    }
+
+    static std::unique_ptr<Expr> makeBinary(const std::string& op, std::unique_ptr<Expr> left, std::unique_ptr<Expr> right, const std::string& type) {
+        auto binOp = std::make_unique<BinaryOperation>(op, std::move(left), std::move(right));
+        binOp->setTypeByName(type);
+        return binOp;
+    }
+
+    static std::unique_ptr<Expr> makeAssign(const std::string& name, std::unique_ptr<Expr> value) {
+        std::string type = value->getTypeName();
+        auto assign = std::make_unique<Assign>(name, std::move(value));
+        assign->setTypeByName(type);
+        return assign;
+    }
+
+    static std::unique_ptr<Expr> makeLet(const std::string& name, const std::string& type, std::unique_ptr<Expr> init, std::unique_ptr<Expr> scope) {
+        std::string resultType = scope->getTypeName();
+        auto let = std::make_unique<Let>(name, Type(type), std::move(init), std::move(scope));
+        let->setTypeByName(resultType);
+        return let;
+    }
+
+    static std::unique_ptr<Expr> makeBlock(std::vector<std::unique_ptr<Expr>> exprs) {
+        std::string type = exprs.back()->getTypeName();
+        auto block = std::make_unique<Block>(std::move(exprs));
+        block->setTypeByName(type);
+        return block;
+    }
+
+    // A call of the current method on self, that cannot dispatch to an override
+    bool isSelfTailCall(Expr* expr) {
+        auto call = dynamic_cast<Call*>(expr);
+        if (!call || call->getMethodName() != currentMethod->getName())
+            return false;
+        if (!dynamic_cast<Self*>(call->getExprObjectIdentifier()))
+            return false;
+        auto targets = effects.getTargets(currentClass->name, currentMethod->getName());
+        return targets.size() == 1 && targets[0] == currentMethod;
+    }
+
+    static void collectNames(Expr* expr, std::unordered_set<std::string>& read, std::unordered_set<std::string>& assigned) {
+        forEachExpr(expr, [&](Expr* e) {
+            if (auto objIden = dynamic_cast<ObjectIdentifier*>(e))
+                read.insert(objIden->getName());
+            else if (auto assign = dynamic_cast<Assign*>(e))
+                assigned.insert(assign->getName());
+        });
+    }
+
+    // An operand evaluated after the call that can be evaluated before it instead
+    bool canEvaluateFirst(Expr* operand, Expr* callSide) {
+        if (dynamic_cast<IntegerLiteral*>(operand))
+            return true;
+        auto objIden = dynamic_cast<ObjectIdentifier*>(operand);
+        if (!objIden || !formalNames.count(objIden->getName()))
+            return false; // fields may be modified by the call
+        std::unordered_set<std::string> read, assigned;
+        collectNames(callSide, read, assigned);
+        return !assigned.count(objIden->getName());
+    }
+
+    // Whether the expression has an eliminable call in tail position; the tail positions
+    // are searched with an explicit stack
+    bool hasTailCall(Expr* root) {
+        std::vector<Expr*> pending{root};
+        while (!pending.empty()) {
+            Expr* expr = pending.back();
+            pending.pop_back();
+            if (!expr)
+                continue;
+            if (isSelfTailCall(expr))
+                return true;
+            if (auto block = dynamic_cast<Block*>(expr)) {
+                if (!block->getExprs().empty())
+                    pending.push_back(block->getExprs().back().get());
+            } else if (auto cond = dynamic_cast<Conditional*>(expr)) {
+                pending.push_back(cond->getElse_expr());
+                pending.push_back(cond->getThen_expr());
+            } else if (auto let = dynamic_cast<Let*>(expr)) {
+                if (!formalNames.count(let->getName()))
+                    pending.push_back(let->getScopeExpr());
+            } else if (auto binOp = dynamic_cast<BinaryOperation*>(expr)) {
+                if (!isAccumulable(binOp))
+                    continue;
+                if (canEvaluateFirst(binOp->getRight(), binOp->getLeft()))
+                    pending.push_back(binOp->getLeft());
+                pending.push_back(binOp->getRight());
+            }
+        }
+        return false;
+    }
+
+    // An int32 '+', '-' or '*', whose pending operation can go in the accumulator
+    bool isAccumulable(BinaryOperation* binOp) {
+        const std::string& op = binOp->getOperator();
+        return currentMethod->getReturnType().getName() == "int32" && (op == "+" || op == "-" || op == "*");
+    }
+
+    // For an int32 '+', '-' or '*' with a tail call in one operand, returns which one (0 or 1)
+    int accumulatedSide(BinaryOperation* binOp) {
+        if (!isAccumulable(binOp))
+            return -1;
+        if (hasTailCall(binOp->getRight()))
+            return 1;
+        if (hasTailCall(binOp->getLeft()) && canEvaluateFirst(binOp->getRight(), binOp->getLeft()))
+            return 0;
+        return -1;
+    }
+
+    // Records 'operand op r' (side 1) or 'r op operand' (side 0) in the accumulator _tcmul * r + _tcadd
+    std::vector<std::unique_ptr<Expr>> accumulate(const std::string& op, const std::string& operand, int side) {
+        usesAccumulator = true;
+        std::vector<std::unique_ptr<Expr>> updates;
+        auto scaled = [&]() {
+            return makeBinary("*", makeIdentifier("_tcmul", "int32"), makeIdentifier(operand, "int32"), "int32");
+        };
+        if (op == "*") {
+            updates.push_back(makeAssign("_tcmul", scaled()));
+        } else if (op == "+" || side == 1) {
+            // x + r, r + x and x - r add the operand
+            updates.push_back(makeAssign("_tcadd", makeBinary("+", makeIdentifier("_tcadd", "int32"), scaled(), "int32")));
+            if (op == "-")
+                updates.push_back(makeAssign("_tcmul", makeBinary("-", std::make_unique<IntegerLiteral>(0), makeIdentifier("_tcmul", "int32"), "int32")));
+        } else {
+            // r - x
+            updates.push_back(makeAssign("_tcadd", makeBinary("-", makeIdentifier("_tcadd", "int32"), scaled(), "int32")));
+        }
+        return updates;
+    }
+
+    // Replaces a tail call by the assignment of its arguments to the formals
+    std::unique_ptr<Expr> makeJump(Call* call) {
+        auto& formals = currentMethod->getFormals();
+        auto& args = call->getArgs();
+        std::string resultType = currentMethod->getReturnType().getName();
+
+        std::vector<std::pair<std::string, std::unique_ptr<Expr>>> temps;
+        std::vector<std::unique_ptr<Expr>> statements;
+        std::vector<std::unique_ptr<Expr>> literals;
+
+        for (size_t i = 0; i < args.size(); ++i) {
+            const std::string name = formals[i]->getName();
+            auto objIden = dynamic_cast<ObjectIdentifier*>(args[i].get());
+            if (objIden && objIden->getName() == name)
+                continue; // unchanged argument
+            if (dynamic_cast<IntegerLiteral*>(args[i].get()) || dynamic_cast<BooleanLiteral*>(args[i].get())
+                || dynamic_cast<StringLiteral*>(args[i].get())) {
+                literals.push_back(makeAssign(name, std::move(args[i])));
+                continue;
+            }
+            std::string temp = newTemp("tcarg");
+            statements.push_back(makeAssign(name, makeIdentifier(temp, formals[i]->getType().getName())));
+            temps.emplace_back(temp, std::move(args[i]));
+        }
+        for (auto& literal : literals)
+            statements.push_back(std::move(literal));
+
+        statements.push_back(makeAssign("_tcloop", std::make_unique<BooleanLiteral>(true)));
+        statements.push_back(makeIdentifier("_tcresult", resultType));
+        std::unique_ptr<Expr> jump = makeBlock(std::move(statements));
+
+        // arguments are all evaluated, left to right, before any formal changes
+        for (auto it = temps.rbegin(); it != temps.rend(); ++it) {
+            std::string type = it->second->getTypeName();
+            jump = makeLet(it->first, type, std::move(it->second), std::move(jump));
+        }
+        eliminatedCalls++;
+        return jump;
+    }
+
+    // Rewrites the tail positions of 'root' with an explicit stack of slots, in the order
+    // of a depth-first walk (then branches before else branches)
+    void rewriteTail(std::unique_ptr<Expr>& root) {
+        std::vector<std::unique_ptr<Expr>*> pending{&root};
+        while (!pending.empty()) {
+            std::unique_ptr<Expr>& slot = *pending.back();
+            pending.pop_back();
+            Expr* expr = slot.get();
+            if (isSelfTailCall(expr)) {
+                slot = makeJump(static_cast<Call*>(expr));
+            } else if (auto block = dynamic_cast<Block*>(expr)) {
+                if (!block->getExprs().empty())
+                    pending.push_back(&block->getExprs().back());
+            } else if (auto cond = dynamic_cast<Conditional*>(expr)) {
+                auto children = cond->getChildren();
+                pending.push_back(children[2]);
+                pending.push_back(children[1]);
+            } else if (auto let = dynamic_cast<Let*>(expr)) {
+                if (!formalNames.count(let->getName()))
+                    pending.push_back(let->getChildren().back());
+            } else if (auto binOp = dynamic_cast<BinaryOperation*>(expr)) {
+                int side = accumulatedSide(binOp);
+                if (side < 0)
+                    continue;
+                auto children = binOp->getChildren();
+                std::unique_ptr<Expr>& operand = *children[side == 1 ? 0 : 1];
+                std::unique_ptr<Expr>& callSide = *children[side];
+
+                // 'x op e' becomes 'let t <- x in { <accumulate t>; e }', e rewritten next
+                std::string temp = newTemp("tcop");
+                auto statements = accumulate(binOp->getOperator(), temp, side);
+                statements.push_back(std::move(callSide));
+                std::unique_ptr<Expr> operandValue = std::move(operand);
+                slot = makeLet(temp, "int32", std::move(operandValue), makeBlock(std::move(statements)));
+                auto let = static_cast<Let*>(slot.get());
+                pending.push_back(&static_cast<Block*>(let->getScopeExpr())->getExprs().back());
+            }
+        }
+    }
+
+    void eliminate(ClassNode* cls, MethodNode* method) {
+        currentClass = cls;
+        currentMethod = method;
+        formalNames.clear();
+        for (auto& formal : method->getFormals())
+            formalNames.insert(formal->getName());
+        usesAccumulator = false;
+
+        Block* body = method->getBlock();
+        if (body->getExprs().empty() || !hasTailCall(body))
+            return;
+
+        std::string resultType = method->getReturnType().getName();
+        std::unique_ptr<Expr> inner = makeBlock(std::move(body->getExprs()));
+        body->getExprs().clear();
+        rewriteTail(inner);
+
+        // while _tcloop do { _tcloop <- false; _tcresult <- <body> }
+        std::vector<std::unique_ptr<Expr>> iteration;
+        iteration.push_back(makeAssign("_tcloop", std::make_unique<BooleanLiteral>(false)));
+        iteration.push_back(makeAssign("_tcresult", std::move(inner)));
+        auto loop = std::make_unique<WhileLoop>(makeIdentifier("_tcloop", "bool"), makeBlock(std::move(iteration)));
+        loop->setTypeByName("unit");
+
+        std::unique_ptr<Expr> result = makeIdentifier("_tcresult", resultType);
+        if (usesAccumulator) {
+            result = makeBinary("+",
+                makeBinary("*", makeIdentifier("_tcmul", "int32"), std::move(result), "int32"),
+                makeIdentifier("_tcadd", "int32"), "int32");
+        }
+
+        std::vector<std::unique_ptr<Expr>> sequence;
+        sequence.push_back(std::move(loop));
+        sequence.push_back(std::move(result));
+        std::unique_ptr<Expr> rewritten = makeBlock(std::move(sequence));
+
+        if (usesAccumulator) {
+            rewritten = makeLet("_tcadd", "int32", std::make_unique<IntegerLiteral>(0), std::move(rewritten));
+            rewritten = makeLet("_tcmul", "int32", std::make_unique<IntegerLiteral>(1), std::move(rewritten));
+        }
+        rewritten = makeLet("_tcresult", resultType, nullptr, std::move(rewritten));
+        rewritten = makeLet("_tcloop", "bool", std::make_unique<BooleanLiteral>(true), std::move(rewritten));
+
+        body->addExpr(std::move(rewritten));
+        rewrittenMethods++;
+    }
+};
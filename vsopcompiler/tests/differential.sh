@@ -0,0 +1,48 @@
+#!/bin/bash
+# Shared by the differential checks (tests/run_*_check.sh), which source it: each runs
+# vsopc on programs in two ways that must print the same output and errors and exit with
+# the same status, with checks of its own beside.
+#
+# It moves to the vsopcompiler folder and sets VSOPC, WORK (a directory removed at exit)
+# and the counts 'checked' and 'failures'.
+
+cd "$(dirname "${BASH_SOURCE[0]}")/.." || exit 1
+VSOPC=./vsopc
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+checked=0
+failures=0
+
+# use_program <program>: the program of the next runs (vsopc writes next to its input)
+use_program() {
+    cp "$1" "$WORK/program.vsop"
+}
+
+# run <options...>: the output, the errors and the exit status of vsopc on that program
+run() {
+    timeout 60 "$VSOPC" "$@" "$WORK/program.vsop" < /dev/null 2>&1
+    echo "exit $?"
+}
+
+# same <description> <result> <other result>: one more run checked, failed if they differ
+same() {
+    checked=$((checked + 1))
+    if [ "$2" != "$3" ]; then
+        echo "DIFFERENT: $1"
+        diff <(echo "$2") <(echo "$3") | head -5
+        failures=$((failures + 1))
+    fi
+}
+
+# fail <message>: a failed check of the script's own
+fail() {
+    echo "$1"
+    failures=$((failures + 1))
+}
+
+# finish [<more of the summary>]: the summary line, and the status of the check
+finish() {
+    echo "$checked runs$1: $failures with differences"
+    [ $failures -eq 0 ]
+}
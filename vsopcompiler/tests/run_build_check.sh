@@ -0,0 +1,89 @@
+#!/bin/bash
+# Checks the separate compilation of multi-file programs (vsopc -c with several files).
+#
+# Each program of tests/ and benchmarks/ that vsopc -c accepts is split into one file per
+# class (at the lines starting with 'class'), and -c on the files must print what -c
+# printed on the program. Then a small program is built again after edits in a build
+# directory, and each edit must check again only the files it may change (VSOP_BUILD_REPORT).
+#
+# Usage: tests/run_build_check.sh     (make build-check)
+
+cd "$(dirname "$0")/.." || exit 1
+VSOPC=./vsopc
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+checked=0
+failures=0
+
+for program in tests/*.vsop benchmarks/*/*.vsop; do
+    rm -rf "$WORK/split" && mkdir "$WORK/split"
+    # vsopc -c writes next to its input
+    cp "$program" "$WORK/program.vsop"
+    "$VSOPC" -c "$WORK/program.vsop" > "$WORK/expected" 2> /dev/null || continue
+    awk -v dir="$WORK/split" 'BEGIN { n = 0 } /^class / { n++ } { printf "%s\n", $0 > sprintf("%s/%04d.vsop", dir, n) }' "$WORK/program.vsop"
+    # the text before the first class goes with it
+    if [ -f "$WORK/split/0000.vsop" ] && [ -f "$WORK/split/0001.vsop" ]; then
+        cat "$WORK/split/0000.vsop" "$WORK/split/0001.vsop" > "$WORK/first" && mv "$WORK/first" "$WORK/split/0001.vsop"
+        rm "$WORK/split/0000.vsop"
+    fi
+    checked=$((checked + 1))
+    if ! "$VSOPC" -c "$WORK"/split/*.vsop > "$WORK/actual" 2> "$WORK/errors" || ! cmp -s "$WORK/expected" "$WORK/actual"; then
+        echo "DIFFERENT: $program ($(ls "$WORK/split" | wc -l) files)"
+        head -5 "$WORK/errors"
+        failures=$((failures + 1))
+    fi
+done
+
+echo "$checked programs split: $failures with differences"
+
+# Incremental builds: 'expect <files checked> <message>' after an edit
+mkdir "$WORK/project"
+cd "$WORK/project" || exit 1
+VSOPC="$OLDPWD/$VSOPC"
+cat > A.vsop <<'EOF'
+class A {
+    x : int32 <- 3;
+    f() : int32 { x + 1 }
+}
+EOF
+cat > B.vsop <<'EOF'
+class B extends A {
+    g(a : A) : int32 { a.f() + f() }
+}
+EOF
+cat > C.vsop <<'EOF'
+class C {
+    s : string <- "C";
+}
+EOF
+cat > Main.vsop <<'EOF'
+class Main {
+    main() : int32 { let b : B <- new B in b.g(b) }
+}
+EOF
+expect() {
+    report=$(VSOP_BUILD_REPORT=1 "$VSOPC" --build-dir build -c A.vsop B.vsop C.vsop Main.vsop 2>&1 > /dev/null)
+    checkedFiles=$(echo "$report" | sed -n 's/.* interfaces read, \([0-9]*\) files checked.*/\1/p')
+    if [ "$checkedFiles" != "$1" ]; then
+        echo "INCREMENTAL: $2: $report (expected $1 files checked)"
+        failures=$((failures + 1))
+    fi
+}
+expect 4 "first build"
+expect 0 "nothing changed"
+echo "// a comment" >> C.vsop
+expect 1 "comment in C"
+sed -i 's/x + 1/x + 2/' A.vsop
+expect 1 "body of a method of A"
+sed -i 's/^}/    h() : bool { true }\n}/' A.vsop
+expect 3 "method added to A (B extends A, Main uses B)"
+sed -i 's/"C"/"D"/' C.vsop
+expect 1 "initializer of a field of C"
+sed -i 's/a.f() + f()/a.f() + h()/' B.vsop
+expect 1 "error in B"
+expect 1 "B still has an error"
+sed -i 's/a.f() + h()/a.f() + f()/' B.vsop
+expect 1 "error in B fixed"
+
+[ $failures -eq 0 ]
@@ -0,0 +1,59 @@
+#!/bin/bash
+# Checks the prebuilt class Object (builtin_registry.cpp): for each program of tests/ and
+# benchmarks/, for prefixes of the tests (cut after every few lines, and in the last
+# line, to reach the errors at the end of the text), for the tests followed by an
+# unterminated comment or string (also one ending in a line continuation) and for a
+# program without classes, vsopc -p and -c must print the same output and errors
+# and exit with the same status as with --object=parsed, which parses the text of Object
+# after the program, with both parsers, with --lazy-bodies and with both lexers.
+#
+# Usage: tests/run_builtins_check.sh     (make builtins-check)
+
+cd "$(dirname "$0")/.." || exit 1
+VSOPC=./vsopc
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+checked=0
+failures=0
+
+# compare <program> <description>
+compare() {
+    for options in -p -c "--parser=descent -c" "--lazy-bodies -c" "--lexer=simd -c"; do
+        prebuilt=$("$VSOPC" $options "$1" 2>&1; echo "exit $?")
+        parsed=$("$VSOPC" --object=parsed $options "$1" 2>&1; echo "exit $?")
+        checked=$((checked + 1))
+        if [ "$prebuilt" != "$parsed" ]; then
+            echo "DIFFERENT: $2 ($options)"
+            diff <(echo "$parsed") <(echo "$prebuilt") | head -5
+            failures=$((failures + 1))
+        fi
+    done
+}
+
+for program in tests/*.vsop benchmarks/*/*.vsop; do
+    compare "$program" "$program"
+done
+
+for program in tests/*.vsop; do
+    lines=$(wc -l < "$program")
+    step=$(( lines / 4 > 0 ? lines / 4 : 1 ))
+    for ((cut = 1; cut < lines; cut += step)); do
+        head -n "$cut" "$program" > "$WORK/prefix.vsop"
+        compare "$WORK/prefix.vsop" "$program, first $cut lines"
+    done
+    for cut in 1 3; do
+        head -c "-$cut" "$program" > "$WORK/prefix.vsop"
+        compare "$WORK/prefix.vsop" "$program, without its last $cut characters"
+    done
+    for end in '(* unterminated' '"unterminated' '"unterminated\' '$'; do
+        { cat "$program"; printf '%s' "$end"; } > "$WORK/suffix.vsop"
+        compare "$WORK/suffix.vsop" "$program, then $end"
+    done
+done
+
+printf '(* no class *)\n' > "$WORK/empty.vsop"
+compare "$WORK/empty.vsop" "a program without classes"
+
+echo "$checked runs compared: $failures difference(s)"
+[ $failures -eq 0 ]
@@ -0,0 +1,34 @@
+#!/bin/bash
+# Checks the common subexpression elimination (cse.cpp): for each program of tests/ and
+# benchmarks/cse/ that vsopc -c accepts, vsopc --cse -x must print the same output and
+# errors and exit with the same status as vsopc -x, under the interpreter and with --jit,
+# and in the tree of vsopc --cse -c each variable of the pass must have the type of its let.
+#
+# Usage: tests/run_cse_check.sh     (make cse-check)
+
+source "$(dirname "$0")/differential.sh"
+
+reused=0
+
+for program in tests/*.vsop benchmarks/cse/*.vsop; do
+    use_program "$program"
+    "$VSOPC" -c "$WORK/program.vsop" > /dev/null 2>&1 || continue
+    for options in "" "--jit"; do
+        same "$program (--cse $options -x)" "$(run $options -x)" "$(run --cse $options -x)"
+    done
+
+    if VSOP_CSE_REPORT=1 "$VSOPC" --cse -c "$WORK/program.vsop" > "$WORK/tree" 2> "$WORK/report"; then
+        checked=$((checked + 1))
+        count=$(sed -n 's/^cse: \([0-9]*\) expressions.*/\1/p' "$WORK/report")
+        reused=$((reused + ${count:-0}))
+        grep -o "Let(_cse[0-9]*, [A-Za-z0-9_]*" "$WORK/tree" | sed 's/Let(\(.*\), \(.*\)/\1 : \2/' | sort -u > "$WORK/bound"
+        grep -o "[( ]_cse[0-9]* : [A-Za-z0-9_]*" "$WORK/tree" | cut -c2- | sort -u > "$WORK/used"
+        if [ -n "$(comm -13 "$WORK/bound" "$WORK/used")" ]; then
+            fail "DIFFERENT: $program (--cse -c: variables of another type than their let)"
+        fi
+    else
+        fail "REJECTED: $program (--cse -c)"
+    fi
+done
+
+finish ", $reused expressions reused"
@@ -0,0 +1,21 @@
+#!/bin/bash
+# Checks the parallel emission of the tree (emitter.cpp): for each program of tests/ and
+# benchmarks/, vsopc -p and -c on several threads (-j 2, 3 and 8) must print the same
+# output and errors and exit with the same status as on one thread (-j 1), also after the
+# optimizations that rewrite the tree.
+#
+# Usage: tests/run_emit_check.sh     (make emit-check)
+
+source "$(dirname "$0")/differential.sh"
+
+for program in tests/*.vsop benchmarks/*/*.vsop; do
+    use_program "$program"
+    for options in -p -c "--tree-shake --loop-opt --tail-calls --cse -c" "--lazy-bodies --parser=descent -p"; do
+        single=$(run -j 1 $options)
+        for jobs in 2 3 8; do
+            same "$program ($options, -j $jobs)" "$single" "$(run -j $jobs $options)"
+        done
+    done
+done
+
+finish
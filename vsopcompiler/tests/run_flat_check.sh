@@ -0,0 +1,26 @@
+#!/bin/bash
+# Checks the flat form of the tree (flat_ast.cpp): for each program of tests/ and
+# benchmarks/, vsopc --flat-ast -p and -c, which print the tree from its flat form, must
+# print the same output and errors and exit with the same status as vsopc -p and -c, also
+# after the optimizations that rewrite the tree; and the report of VSOP_FLAT_REPORT must
+# find the same nodes in both forms.
+#
+# Usage: tests/run_flat_check.sh     (make flat-check)
+
+source "$(dirname "$0")/differential.sh"
+
+for program in tests/*.vsop benchmarks/*/*.vsop; do
+    use_program "$program"
+    for options in -p -c "--tree-shake --loop-opt --tail-calls -c"; do
+        same "$program ($options, --flat-ast)" "$(run $options)" "$(run --flat-ast $options)"
+    done
+
+    if VSOP_FLAT_REPORT=1 "$VSOPC" --flat-ast -c "$WORK/program.vsop" > /dev/null 2> "$WORK/report"; then
+        checked=$((checked + 1))
+        if grep -q "DIFFERENT" "$WORK/report"; then
+            fail "DIFFERENT: $program (VSOP_FLAT_REPORT: $(grep DIFFERENT "$WORK/report"))"
+        fi
+    fi
+done
+
+finish
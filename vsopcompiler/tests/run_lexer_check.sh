@@ -0,0 +1,73 @@
+#!/bin/bash
+# Checks that the hand-written scanner (--lexer=simd) behaves as flex's: for each program
+# of tests/ and benchmarks/, for prefixes of the tests (cut at every few bytes, to end in
+# the middle of comments and strings) and for a list of lexical corner cases, vsopc -l and
+# -c must print the same output and errors and exit with the same status with both.
+#
+# Usage: tests/run_lexer_check.sh     (make lexer-check)
+
+cd "$(dirname "$0")/.." || exit 1
+VSOPC=./vsopc
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+checked=0
+failures=0
+
+# compare <program> <description>: the program is copied, vsopc writing next to its input
+compare() {
+    cp "$1" "$WORK/program.vsop"
+    for mode in -l -c; do
+        flex=$("$VSOPC" "$mode" "$WORK/program.vsop" 2>&1; echo "exit $?")
+        simd=$("$VSOPC" --lexer=simd "$mode" "$WORK/program.vsop" 2>&1; echo "exit $?")
+        checked=$((checked + 1))
+        if [ "$flex" != "$simd" ]; then
+            echo "DIFFERENT: $2 ($mode)"
+            diff <(echo "$flex") <(echo "$simd") | head -5
+            failures=$((failures + 1))
+        fi
+    done
+}
+
+for program in tests/*.vsop benchmarks/*/*.vsop; do
+    compare "$program" "$program"
+done
+
+for program in tests/*.vsop; do
+    bytes=$(wc -c < "$program")
+    step=$(( bytes / 12 > 0 ? bytes / 12 : 1 ))
+    for ((cut = 1; cut < bytes; cut += step)); do
+        head -c "$cut" "$program" > "$WORK/prefix.vsop"
+        compare "$WORK/prefix.vsop" "$program, first $cut bytes"
+    done
+done
+
+# corner cases, as printf formats
+while IFS= read -r format; do
+    printf "$format" > "$WORK/case.vsop"
+    compare "$WORK/case.vsop" "'$format'"
+done <<'CASES'
+class classes int32 int32x in inx isnull true false Main A_1 x_
+0 007 0x1F 0xff 0x 0x1G 12ab 12AB 2147483647 0x7fffffff
+{ } ( ) : ; , + - * / ^ . = < <= <- <<- =<
+a // comment (* not a comment\n b // \n\t c
+(* a (* nested *) b *) c (*) *) d
+(* ** *) still open *) x
+(* *\n *) y\nz
+(* *( *) *) w
+(* unterminated (* twice *)
+(* ends with a star *
+*) x
+"abc" "a\\nb\\t\\b\\r\\\\\\"" "\\x4a\\x4B" "a  \\t  b\\f\\r"
+"line \\\n    continued" "line \\\ncontinued"
+"\\q"
+"\\x4"
+"new\nline"
+"unterminated
+a > b
+a ~ b
+"\\x41\\x42" 42 "\200\303\251"
+CASES
+
+echo "$checked runs compared: $failures difference(s)"
+[ $failures -eq 0 ]
@@ -0,0 +1,29 @@
+#!/bin/bash
+# Checks the language server (vsopc --lsp): for each program of tests/ and benchmarks/,
+# lsp_bench --check opens it and edits it, and after each edit the diagnostics must be the
+# errors of vsopc -c on the text at that point (the server parses and checks again only
+# what an edit may have changed); the definitions of class names must be their declarations.
+#
+# Usage: tests/run_lsp_check.sh     (make lsp-check)
+
+cd "$(dirname "$0")/.." || exit 1
+VSOPC=./vsopc
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+checked=0
+failures=0
+
+for program in tests/*.vsop benchmarks/*/*.vsop; do
+    # vsopc -c writes next to its input
+    cp "$program" "$WORK/program.vsop"
+    checked=$((checked + 1))
+    if ! ./benchmarks/compile/lsp_bench --check --edits 20 "$VSOPC" "$WORK/program.vsop" > "$WORK/report"; then
+        echo "DIFFERENT: $program"
+        head -8 "$WORK/report"
+        failures=$((failures + 1))
+    fi
+done
+
+echo "$checked programs edited: $failures with differences"
+[ $failures -eq 0 ]
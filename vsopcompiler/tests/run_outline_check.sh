@@ -0,0 +1,30 @@
+#!/bin/bash
+# Checks the outline mode and the method bodies parsed on demand: for each program of
+# tests/ and benchmarks/, vsopc --lazy-bodies -p and -c, which parse each body the first
+# time it is printed or analyzed, must print the same output and errors and exit with the
+# same status as vsopc -p and -c; and vsopc -o must accept the programs that -c accepts,
+# listing one line per method.
+#
+# Usage: tests/run_outline_check.sh     (make outline-check)
+
+source "$(dirname "$0")/differential.sh"
+
+for program in tests/*.vsop benchmarks/*/*.vsop; do
+    use_program "$program"
+    for mode in -p -c; do
+        same "$program ($mode, --lazy-bodies)" "$(run "$mode")" "$(run --lazy-bodies "$mode")"
+    done
+
+    if "$VSOPC" -p "$WORK/program.vsop" > "$WORK/tree" 2>/dev/null \
+            && "$VSOPC" -c "$WORK/program.vsop" > /dev/null 2>&1; then
+        checked=$((checked + 1))
+        methods=$(grep -o "Method(" "$WORK/tree" | wc -l)
+        if ! "$VSOPC" -o "$WORK/program.vsop" > "$WORK/outline"; then
+            fail "REJECTED: $program (-o)"
+        elif [ "$(grep -c "^[0-9]*,[0-9]*,method," "$WORK/outline")" != "$methods" ]; then
+            fail "DIFFERENT: $program (-o lists $(grep -c ",method," "$WORK/outline") methods, -p $methods)"
+        fi
+    fi
+done
+
+finish
@@ -0,0 +1,46 @@
+#!/bin/bash
+# Checks that the hand-written parser (--parser=descent) behaves as bison's: for each
+# program of tests/ and benchmarks/, and for prefixes of the tests (cut after every few
+# lines, to reach the syntax errors), vsopc -p and -c must print the same output and
+# errors and exit with the same status with both parsers.
+#
+# Usage: tests/run_parser_check.sh     (make parser-check)
+
+cd "$(dirname "$0")/.." || exit 1
+VSOPC=./vsopc
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+checked=0
+failures=0
+
+# compare <program> <description>: the program is copied, vsopc writing next to its input
+compare() {
+    cp "$1" "$WORK/program.vsop"
+    for mode in -p -c; do
+        bison=$("$VSOPC" "$mode" "$WORK/program.vsop" 2>&1; echo "exit $?")
+        descent=$("$VSOPC" --parser=descent "$mode" "$WORK/program.vsop" 2>&1; echo "exit $?")
+        checked=$((checked + 1))
+        if [ "$bison" != "$descent" ]; then
+            echo "DIFFERENT: $2 ($mode)"
+            diff <(echo "$bison") <(echo "$descent") | head -5
+            failures=$((failures + 1))
+        fi
+    done
+}
+
+for program in tests/*.vsop benchmarks/*/*.vsop; do
+    compare "$program" "$program"
+done
+
+for program in tests/*.vsop; do
+    lines=$(wc -l < "$program")
+    step=$(( lines / 8 > 0 ? lines / 8 : 1 ))
+    for ((cut = 1; cut < lines; cut += step)); do
+        head -n "$cut" "$program" > "$WORK/prefix.vsop"
+        compare "$WORK/prefix.vsop" "$program, first $cut lines"
+    done
+done
+
+echo "$checked runs compared: $failures difference(s)"
+[ $failures -eq 0 ]
@@ -0,0 +1,49 @@
+#!/bin/bash
+# Stress tests for deeply nested programs: generates programs whose main() nests one
+# construct DEPTH times (1000000 by default) and checks that vsopc -p and -c accept them.
+# vsopc runs with a 1 MB stack, so that a pass recursing once per nesting level fails.
+#
+# Usage: tests/run_stress.sh [depth]     (make stress)
+
+cd "$(dirname "$0")/.." || exit 1
+DEPTH=${1:-1000000}
+VSOPC=./vsopc
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# main() is the expression generated by the awk program given for each case
+generate() {
+    {
+        echo "class Main {"
+        echo "    f(x : int32) : int32 { x }"
+        echo "    main() : int32 {"
+        awk -v n="$DEPTH" "BEGIN { $1 }"
+        echo "    }"
+        echo "}"
+    } > "$WORK/$2.vsop"
+}
+
+generate 'for (i = 0; i < n; i++) printf "let x%d : int32 <- %d in\n", i, i; print "x0"' lets
+generate 'printf "0"; for (i = 0; i < n; i++) printf " + %d\n", i % 10; print ""' sums
+generate 'for (i = 0; i < n; i++) printf "- "; print "1"' negations
+generate 'for (i = 0; i < n; i++) printf "{ "; printf "0"; for (i = 0; i < n; i++) printf " }"; print ""' blocks
+generate 'for (i = 0; i < n; i++) printf "if %d < %d then %d else\n", i, i + 1, i; print "0"' conditionals
+generate 'for (i = 0; i < n; i++) printf "f("; printf "0"; for (i = 0; i < n; i++) printf ")"; print ""' calls
+
+failures=0
+for program in lets sums negations blocks conditionals calls; do
+    for mode in -p -c; do
+        start=$(date +%s.%N)
+        (ulimit -s 1024; "$VSOPC" "$mode" "$WORK/$program.vsop" > /dev/null 2> "$WORK/errors")
+        status=$?
+        seconds=$(awk -v start="$start" -v end="$(date +%s.%N)" 'BEGIN { print end - start }')
+        if [ $status -eq 0 ]; then
+            printf "%-14s %s  ok    %6.2f s\n" "$program" "$mode" "$seconds"
+        else
+            printf "%-14s %s  FAIL  (exit %d) %s\n" "$program" "$mode" $status "$(head -c 200 "$WORK/errors")"
+            failures=$((failures + 1))
+        fi
+    done
+done
+echo "depth $DEPTH: $failures failure(s)"
+[ $failures -eq 0 ]
@@ -0,0 +1,255 @@
+#include "AST.hpp"
+#include "effects.cpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <vector>
+
+// Whole-program tree shaking, rooted at Main.main.
+//
+// The reachability analysis is a rapid type analysis: a method is reachable if it is
+// Main.main, or if it is the implementation selected for a reachable call site on a
+// class that is instantiated by a reachable 'new' (or is Main itself). The method
+// statically bound by the type checker is kept as well, so the pruned tree still
+// type-checks. Unreachable methods, unused fields and unreferenced classes are removed
+// from the Program, so every later stage works on the smaller tree.
+//
+// Must run after SemanticAnalyzer::analyze: receivers of calls are resolved through
+// the types computed by the analyzer.
+
+class TreeShaker {
+public:
+    void run(Program* program) {
+        effects.run(program);
+        classMap.clear();
+        for (auto& cls : program->getClasses())
+            classMap[cls->name] = cls.get();
+
+        auto mainIt = classMap.find("Main");
+        if (mainIt == classMap.end())
+            return; // already reported by the analyzer
+
+        // the runtime instantiates Main and calls its main method
+        markInstantiated("Main");
+        markReachable(lookupMethod(mainIt->second, "main"));
+
+        while (!worklist.empty()) {
+            MethodNode* method = worklist.back().first;
+            ClassNode* owner = worklist.back().second;
+            worklist.pop_back();
+            scanExpression(method->getBlock(), owner);
+        }
+
+        keepReferencedClasses();
+        prune(program);
+    }
+
+    // Statistics of the last run
+    size_t removedClasses = 0;
+    size_t removedMethods = 0;
+    size_t removedFields = 0;
+
+private:
+    EffectAnalyzer effects;
+    std::unordered_map<std::string, ClassNode*> classMap;
+    std::unordered_set<std::string> instantiated;                     // classes created by a reachable 'new'
+    std::unordered_set<MethodNode*> reachable;                        // reachable method bodies
+    std::unordered_map<MethodNode*, ClassNode*> ownerOf;              // defining class of each method
+    std::vector<std::pair<MethodNode*, ClassNode*>> worklist;         // reachable methods not scanned yet
+    std::unordered_map<std::string, std::unordered_set<std::string>> callSites; // static receiver type -> called methods
+    std::unordered_map<std::string, std::unordered_set<std::string>> usedNames; // class -> identifiers used by its code
+    std::unordered_set<std::string> keptClasses;
+
+    bool isObjectClass(const std::string& name) const {
+        return name == "Object";
+    }
+
+    ClassNode* getParent(ClassNode* cls) {
+        if (cls->parent.empty() || cls->parent == "NULL_PARENT")
+            return nullptr;
+        auto it = classMap.find(cls->parent);
+        return it == classMap.end() ? nullptr : it->second;
+    }
+
+    bool isSubclassOf(ClassNode* cls, const std::string& ancestor) {
+        for (ClassNode* current = cls; current; current = getParent(current)) {
+            if (current->name == ancestor)
+                return true;
+        }
+        return false;
+    }
+
+    // Finds the implementation of 'methodName' seen by an instance of 'cls'
+    MethodNode* lookupMethod(ClassNode* cls, const std::string& methodName) {
+        for (ClassNode* current = cls; current; current = getParent(current)) {
+            for (auto& method : current->getMethods()) {
+                if (method->getName() == methodName) {
+                    ownerOf[method.get()] = current;
+                    return method.get();
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    void markReachable(MethodNode* method) {
+        if (!method || reachable.count(method))
+            return;
+        reachable.insert(method);
+        worklist.push_back({method, ownerOf[method]});
+    }
+
+    void markInstantiated(const std::string& className) {
+        auto it = classMap.find(className);
+        if (it == classMap.end() || instantiated.count(className))
+            return;
+        instantiated.insert(className);
+
+        // field initializers of the class and its ancestors run at creation
+        for (ClassNode* current = it->second; current; current = getParent(current)) {
+            for (auto& field : current->getFields()) {
+                if (field->getInitExpr())
+                    scanExpression(field->getInitExpr().get(), current);
+            }
+        }
+
+        // call sites seen before this class was instantiated may now dispatch to it
+        for (auto& site : callSites) {
+            if (!isSubclassOf(it->second, site.first))
+                continue;
+            for (const std::string& methodName : site.second)
+                markReachable(lookupMethod(it->second, methodName));
+        }
+    }
+
+    void recordCall(const std::string& receiverType, const std::string& methodName) {
+        auto clsIt = classMap.find(receiverType);
+        if (clsIt == classMap.end())
+            return;
+        if (!callSites[receiverType].insert(methodName).second)
+            return; // site already resolved against every instantiated class
+
+        // keep the statically bound method so that the pruned tree still type-checks
+        markReachable(lookupMethod(clsIt->second, methodName));
+
+        for (const std::string& className : instantiated) {
+            ClassNode* cls = classMap[className];
+            if (isSubclassOf(cls, receiverType))
+                markReachable(lookupMethod(cls, methodName));
+        }
+    }
+
+    void scanExpression(Expr* expr, ClassNode* owner) {
+        forEachExpr(expr, [&](Expr* e) {
+            if (auto call = dynamic_cast<Call*>(e)) {
+                recordCall(call->getClassName(), call->getMethodName());
+            } else if (auto newExpr = dynamic_cast<New*>(e)) {
+                markInstantiated(newExpr->getClassName());
+            } else if (auto objIden = dynamic_cast<ObjectIdentifier*>(e)) {
+                usedNames[owner->name].insert(objIden->getName());
+            } else if (auto assign = dynamic_cast<Assign*>(e)) {
+                usedNames[owner->name].insert(assign->getName());
+            }
+        });
+    }
+
+    // A field is used if its name appears in code of its class or of a subclass
+    bool isFieldUsed(ClassNode* cls, FieldNode* field) {
+        for (auto& entry : usedNames) {
+            if (!entry.second.count(field->getName()))
+                continue;
+            auto it = classMap.find(entry.first);
+            if (it != classMap.end() && isSubclassOf(it->second, cls->name))
+                return true;
+        }
+        return false;
+    }
+
+    // A field whose initializer has observable effects, or may fail or not end, is kept even
+    // if unused (EffectAnalyzer, with the calls it may reach)
+    bool hasSideEffects(FieldNode* field) {
+        Expr* init = field->getInitExpr().get();
+        return init && !effects.expressionEffects(init, {}).isHoistable();
+    }
+
+    void keepClass(const std::string& className) {
+        auto it = classMap.find(className);
+        if (it == classMap.end())
+            return;
+        for (ClassNode* current = it->second; current; current = getParent(current)) {
+            if (!keptClasses.insert(current->name).second)
+                break;
+        }
+    }
+
+    void keepTypesOf(Expr* expr) {
+        forEachExpr(expr, [&](Expr* e) {
+            if (auto let = dynamic_cast<Let*>(e))
+                keepClass(let->getType().getName());
+            keepClass(e->getTypeName());
+        });
+    }
+
+    // Classes stay if instantiated or named by a type in the code that survives
+    void keepReferencedClasses() {
+        keepClass("Object");
+        keepClass("Main");
+        for (const std::string& className : instantiated)
+            keepClass(className);
+
+        for (MethodNode* method : reachable) {
+            keepClass(method->getReturnType().getName());
+            for (auto& formal : method->getFormals())
+                keepClass(formal->getType().getName());
+            keepTypesOf(method->getBlock());
+        }
+
+        // fields of kept classes may themselves name other classes
+        size_t previousSize = 0;
+        while (previousSize != keptClasses.size()) {
+            previousSize = keptClasses.size();
+            std::vector<std::string> current(keptClasses.begin(), keptClasses.end());
+            for (const std::string& className : current) {
+                ClassNode* cls = classMap[className];
+                for (auto& field : cls->getFields()) {
+                    if (!isFieldUsed(cls, field.get()) && !hasSideEffects(field.get()))
+                        continue;
+                    keepClass(field->getTypeName());
+                    keepTypesOf(field->getInitExpr().get());
+                }
+            }
+        }
+    }
+
+    void prune(Program* program) {
+        auto& classes = program->getClasses();
+        size_t before = classes.size();
+        classes.erase(std::remove_if(classes.begin(), classes.end(),
+            [&](const std::unique_ptr<ClassNode>& cls) { return !keptClasses.count(cls->name); }),
+            classes.end());
+        removedClasses += before - classes.size();
+
+        for (auto& cls : classes) {
+            if (isObjectClass(cls->name))
+                continue; // built-in methods are provided by the runtime
+
+            auto& methods = cls->getMethods();
+            before = methods.size();
+            methods.erase(std::remove_if(methods.begin(), methods.end(),
+                [&](const std::unique_ptr<MethodNode>& method) { return !reachable.count(method.get()); }),
+                methods.end());
+            removedMethods += before - methods.size();
+
+            auto& fields = cls->getFields();
+            before = fields.size();
+            fields.erase(std::remove_if(fields.begin(), fields.end(),
+                [&](const std::unique_ptr<FieldNode>& field) {
+                    return !isFieldUsed(cls.get(), field.get()) && !hasSideEffects(field.get());
+                }),
+                fields.end());
+            removedFields += before - fields.size();
+        }
+    }
+};